@@ -20,6 +20,7 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include "fdb_errors.h"
 #ifndef _MSC_VER
 #include <stdbool.h>
 #else
@@ -115,7 +116,9 @@ enum {
     FDB_DRB_NONE = 0x0,
     /**
      * Synchronous commit through the direct IO option to bypass
-     * the OS page cache.
+     * the OS page cache. As nothing is cached by the OS, the buffer cache
+     * should be given the memory that the page cache would otherwise use.
+     * Cache misses read the aligned extent containing the block.
      */
     FDB_DRB_ODIRECT = 0x1,
     /**
@@ -270,6 +273,14 @@ typedef fdb_compact_decision (*fdb_compaction_callback)(
                                uint64_t last_newfile_offset,
                                void *ctx);
 
+/**
+ * Pointer type definition of a callback function that is invoked by
+ * fdb_commit_async() once the commit is durable on disk, or has failed.
+ */
+typedef void (*fdb_commit_callback)(fdb_file_handle *fhandle,
+                                    fdb_status status,
+                                    void *ctx);
+
 /**
  * Index traversal decision for index traversal callback function.
  * If user returns `FDB_IT_STOP`, the index traversal will be aborted.
@@ -307,6 +318,42 @@ enum {
     FDB_COMPACT_SORT_BY_KEY    = 0x1
 };
 
+/**
+ * Replacement policy of the global buffer cache.
+ */
+typedef uint8_t fdb_bcache_policy_t;
+enum {
+    /**
+     * LRU lists of clean blocks, where index node blocks get a second chance
+     * before being evicted.
+     */
+    FDB_BCACHE_POLICY_LRU = 0x0,
+    /**
+     * 2Q policy: blocks accessed only once (e.g., by a full iterator scan or
+     * compaction) are kept in a separate FIFO list and evicted first, so that
+     * they do not push out the hot working set.
+     */
+    FDB_BCACHE_POLICY_2Q = 0x1
+};
+
+/**
+ * I/O engine used to access ForestDB files.
+ */
+typedef uint8_t fdb_io_engine_t;
+enum {
+    /**
+     * Synchronous pread/pwrite system calls.
+     */
+    FDB_IO_ENGINE_POSIX = 0x0,
+    /**
+     * Linux io_uring: buffer cache flushes, read-ahead, and commit header
+     * writes followed by fdatasync are submitted as batches through a
+     * per-thread ring. Falls back to FDB_IO_ENGINE_POSIX if io_uring is not
+     * supported by the platform or the running kernel.
+     */
+    FDB_IO_ENGINE_IO_URING = 0x1
+};
+
 /**
  * Additional options for compaction.
  */
@@ -584,6 +631,98 @@ typedef struct {
      * the DB instance should be closed and then re-opened without this option.
      */
     bool bottom_up_index_build;
+    /**
+     * Replacement policy of the buffer cache. It is set to
+     * FDB_BCACHE_POLICY_LRU by default. This is a global config that is used
+     * across all ForestDB files.
+     */
+    fdb_bcache_policy_t bcache_policy;
+    /**
+     * Maximum number of blocks that can be read ahead into the buffer cache
+     * once a handle is detected to read document blocks sequentially (in
+     * either direction) or with a fixed stride, e.g., iterators or compaction.
+     * The read-ahead window starts small and doubles up to this limit, and
+     * the reads are issued asynchronously if async I/O is available.
+     * Zero disables the adaptive read-ahead. The maximum is 512 and the
+     * default is 64. This is a global config that is used across all
+     * ForestDB files.
+     */
+    uint32_t adaptive_readahead_max_blocks;
+    /**
+     * I/O engine used for all the file operations. It is set to
+     * FDB_IO_ENGINE_POSIX by default. This is a global config that is used
+     * across all ForestDB files.
+     */
+    fdb_io_engine_t io_engine;
+    /**
+     * Flag to let durable fdb_commit() calls with FDB_COMMIT_NORMAL on the
+     * same file share a single sync. A commit then releases the file lock
+     * after writing its DB header and syncs it afterwards, so the next
+     * commit may write its blocks and DB header before the earlier DB header
+     * is synced. When it is disabled, each commit writes and syncs its DB
+     * header while holding the file lock.
+     * False by default.
+     */
+    bool group_commit;
+    /**
+     * Maximum time in microseconds that a grouped commit (see group_commit
+     * and fdb_commit_async()) waits for other threads committing the same
+     * file, so that their DB headers are made durable by a single sync. The
+     * wait ends as soon as all of them have written their DB headers, so a
+     * commit without concurrent committers is not delayed. Concurrent
+     * commits are grouped even if it is zero. The maximum is 1000000 and
+     * the default is 500.
+     */
+    uint32_t group_commit_window;
+    /**
+     * Number of threads that read the previous versions of documents into
+     * the buffer cache in parallel at the beginning of a WAL flush, so that
+     * updating the indexes does not wait for them one block at a time. The
+     * index updates are still applied by the flushing thread. Blocks that
+     * are already cached are skipped, and nothing is read unless enough
+     * uncached blocks remain. Zero or one disables it. The maximum is 64
+     * and the default is 4.
+     */
+    uint32_t num_wal_prefetch_threads;
+    /**
+     * Flag to enable the background WAL flusher. If enabled, a writer that
+     * makes the number of flushable WAL entries exceed wal_threshold wakes up
+     * the daemon thread to flush the WAL into the indexes, instead of flushing
+     * it by itself. It is used only with wal_flush_before_commit.
+     */
+    bool enable_background_wal_flush;
+    /**
+     * Number of flushable WAL entries beyond which writers flush the WAL by
+     * themselves even if the background WAL flusher is enabled, so that the
+     * WAL does not grow without bound when the flusher falls behind. Zero
+     * means four times wal_threshold, which is the default.
+     */
+    uint64_t wal_flush_hard_limit;
+    /**
+     * Flag to write the B+tree nodes of variable-length keys without the
+     * common prefix of their keys, so that more keys fit in a node.
+     * Only the nodes written from now on are compressed, and files that
+     * contain them cannot be read by older versions of ForestDB.
+     * False by default.
+     */
+    bool btree_prefix_compression;
+    /**
+     * Flag to store a fingerprint of each key next to the document offset in
+     * the main index, so that most lookups of missing keys return without
+     * reading the key of another document from disk. Only the keys indexed
+     * from now on get the fingerprint, and files that contain them cannot be
+     * read by older versions of ForestDB.
+     * False by default.
+     */
+    bool key_fingerprint;
+    /**
+     * Memory budget in bytes of the cache that each KV store handle keeps of
+     * the doc offsets of its recently read keys, so that repeated lookups of
+     * hot keys do not traverse the main index. The cache is dropped whenever
+     * the index is updated by a WAL flush or a commit. Zero disables the
+     * cache, which is the default.
+     */
+    uint64_t index_cache_size;
 } fdb_config;
 
 typedef struct {
@@ -758,6 +897,19 @@ typedef struct {
      * Total number of live index nodes across all KV stores.
      */
     uint64_t num_live_nodes;
+    /**
+     * Number of data syncs issued by the group commit of durable commits.
+     */
+    uint64_t num_group_commit_syncs;
+    /**
+     * Number of commits made durable by those syncs. The average group
+     * commit batch size is this divided by num_group_commit_syncs.
+     */
+    uint64_t num_group_commits;
+    /**
+     * Largest number of commits made durable by a single sync.
+     */
+    uint64_t max_group_commit_batch;
 } fdb_file_info;
 
 /**
@@ -825,7 +977,7 @@ typedef struct {
 } fdb_kvs_ops_info;
 
 /**
- * Latency stat type for each public API
+ * Latency stat type for each public API and internal phase
  */
 typedef uint8_t fdb_latency_stat_type;
 enum {
@@ -851,6 +1003,18 @@ enum {
     FDB_LATENCY_NUM_STATS    = 19  // Number of stats (keep as highest elem)
 };
 
+/**
+ * Latency stat types of internal phases, which follow the API calls above so
+ * that FDB_LATENCY_NUM_STATS is unchanged. Like the others, they are only
+ * recorded if ForestDB is built with _LATENCY_STATS.
+ */
+enum {
+    FDB_LATENCY_WAL_FLUSH     = 19, // WAL flush into the main index
+    FDB_LATENCY_BCACHE_FLUSH  = 20, // buffer cache flush of dirty blocks
+    FDB_LATENCY_FSYNC         = 21, // data sync of the DB file
+    FDB_LATENCY_NUM_ALL_STATS = 22  // Number of API and phase stats
+};
+
 /**
  * Latency statistics of a specific ForestDB api call
  */
@@ -873,6 +1037,60 @@ typedef struct {
     uint32_t lat_avg;
 } fdb_latency_stat;
 
+/**
+ * Latency distribution of a specific ForestDB api call or internal phase.
+ * Percentiles are taken from a log-bucketed histogram, and are accurate
+ * within about 3%.
+ */
+typedef struct {
+    /**
+     * Total number this call was invoked.
+     */
+    uint64_t lat_count;
+    /**
+     * The fastest call took this amount of time in micro seconds.
+     */
+    uint32_t lat_min;
+    /**
+     * The slowest call took this amount of time in micro seconds.
+     */
+    uint32_t lat_max;
+    /**
+     * Median latency in micro seconds.
+     */
+    uint32_t lat_p50;
+    /**
+     * 90th percentile latency in micro seconds.
+     */
+    uint32_t lat_p90;
+    /**
+     * 99th percentile latency in micro seconds.
+     */
+    uint32_t lat_p99;
+    /**
+     * 99.9th percentile latency in micro seconds.
+     */
+    uint32_t lat_p999;
+} fdb_latency_histogram;
+
+/**
+ * Statistics of the global buffer cache
+ */
+typedef struct {
+    /**
+     * Number of block reads served from the buffer cache.
+     */
+    uint64_t num_hits;
+    /**
+     * Number of blocks loaded into the buffer cache on a read miss.
+     */
+    uint64_t num_misses;
+    /**
+     * Number of blocks evicted from the buffer cache.
+     */
+    uint64_t num_evictions;
+} fdb_buffer_cache_stats;
+
 /**
  * List of ForestDB KV store names
  */
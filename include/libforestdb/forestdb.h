@@ -239,6 +239,27 @@ LIBFDB_API
 fdb_status fdb_get(fdb_kvs_handle *handle,
                    fdb_doc *doc);
 
+/**
+ * Retrieve the metadata and doc body for multiple keys at once.
+ * Each FDB_DOC instance is filled as fdb_get does. The keys missing in the WAL
+ * are looked up in the main index in key order, and then all the docs are
+ * read in file offset order, using async I/O if the platform supports it.
+ * Note that the same FDB_DOC instance should not appear twice in the array.
+ *
+ * @param handle Pointer to ForestDB KV store handle.
+ * @param docs Array of pointers to ForestDB doc instances whose keys are
+ *        searched. Their contents are populated as results of this API call.
+ * @param n Number of docs in the array.
+ * @param results Array of n statuses that receives the result of each doc,
+ *        or NULL if the caller does not need them.
+ * @return FDB_RESULT_SUCCESS if all the keys are found, otherwise the status
+ *         of a key that could not be retrieved.
+ */
+LIBFDB_API
+fdb_status fdb_get_multi(fdb_kvs_handle *handle,
+                         fdb_doc **docs,
+                         size_t n,
+                         fdb_status *results);
 
 /**
  * Retrieve the document for a given key.
@@ -386,6 +407,24 @@ LIBFDB_API
 fdb_status fdb_set(fdb_kvs_handle *handle,
                    fdb_doc *doc);
 
+/**
+ * Update the metadata and doc body for multiple keys at once.
+ * This is equivalent to calling fdb_set for each of the given docs in order,
+ * but the docs are appended to the file and inserted into the WAL while the
+ * file lock is held only once, which is much cheaper for large batches.
+ * Sequence numbers and offsets are written back to each FDB_DOC instance as
+ * fdb_set does. If writing a doc fails, the docs before it remain updated.
+ *
+ * @param handle Pointer to ForestDB KV store handle.
+ * @param docs Array of pointers to ForestDB doc instances to be updated.
+ * @param n Number of docs in the array.
+ * @return FDB_RESULT_SUCCESS on success.
+ */
+LIBFDB_API
+fdb_status fdb_set_multi(fdb_kvs_handle *handle,
+                         fdb_doc **docs,
+                         size_t n);
+
 /**
  * Delete a key, its metadata and value
  * Note that FDB_DOC instance should be created by calling
@@ -467,6 +506,29 @@ fdb_status fdb_free_block(void *ptr);
 LIBFDB_API
 fdb_status fdb_commit(fdb_file_handle *fhandle, fdb_commit_opt_t opt);
 
+/**
+ * Commit all pending changes on a ForestDB file without waiting for them to
+ * become durable. As with fdb_commit, the WAL flush (if any) and the writes
+ * of the dirty blocks and the DB header are done before this API returns;
+ * only `fsync` is deferred to a background thread that invokes the given
+ * callback afterwards. The callbacks of a file handle are invoked in the
+ * order of its commits, and a single `fsync` may complete several commits.
+ * Note that this API should be invoked with a ForestDB file handle, and that
+ * `fdb_close` waits for the callbacks of the file handle to be invoked;
+ * calling it from a callback of the same file handle returns
+ * FDB_RESULT_HANDLE_BUSY.
+ *
+ * @param fhandle Pointer to ForestDB file handle.
+ * @param opt Commit option.
+ * @param callback Callback function invoked once the commit is durable.
+ * @param ctx Client context passed to the callback function.
+ * @return FDB_RESULT_SUCCESS if the commit has been written and the callback
+ *         will be invoked. The callback is not invoked on failure.
+ */
+LIBFDB_API
+fdb_status fdb_commit_async(fdb_file_handle *fhandle, fdb_commit_opt_t opt,
+                            fdb_commit_callback callback, void *ctx);
+
 /**
  * Same as `fdb_commit`, but does not call `fsync` internally.
  *
@@ -889,6 +951,16 @@ fdb_status fdb_rekey(fdb_file_handle *fhandle,
 LIBFDB_API
 size_t fdb_get_buffer_cache_used();
 
+/**
+ * Return the hit, miss, and eviction counters of the global buffer cache,
+ * which can be used to compare the buffer cache replacement policies.
+ *
+ * @param stats Pointer to the buffer cache stats instance to be populated.
+ * @return FDB_RESULT_SUCCESS on success.
+ */
+LIBFDB_API
+fdb_status fdb_get_buffer_cache_stats(fdb_buffer_cache_stats *stats);
+
 /**
  * Return the overall disk space actively used by a ForestDB file.
  * Note that this doesn't include the disk space used by stale btree nodes
@@ -959,6 +1031,22 @@ fdb_status fdb_get_latency_stats(fdb_file_handle *fhandle,
                                  fdb_latency_stat *stats,
                                  fdb_latency_stat_type type);
 
+/**
+ * Return the latency percentiles of a forestdb api call or an internal
+ * phase (e.g., WAL flush, buffer cache flush, or fsync). Latencies are
+ * only recorded if ForestDB is built with _LATENCY_STATS; otherwise the
+ * histogram is zero-filled.
+ *
+ * @param fhandle Pointer to ForestDB KV file handle
+ * @param hist Pointer to a latency histogram instance to be populated
+ * @param type Type of latency stat to be retrieved
+ * @return FDB_RESULT_SUCCESS on success.
+ */
+LIBFDB_API
+fdb_status fdb_get_latency_histogram(fdb_file_handle *fhandle,
+                                     fdb_latency_histogram *hist,
+                                     fdb_latency_stat_type type);
+
 /**
  * Return the name of the latency stat
  *
@@ -80,6 +80,13 @@
 #define FDB_BGFLUSHER_SLEEP_DURATION (2)
 #define FDB_BGFLUSHER_DIRTY_THRESHOLD (1024) //if more than this 4MB dirty
                                              // wake up any sleeping bgflusher
+// interval in secs at which the WAL flusher checks files without being woken up
+#define FDB_WALFLUSHER_SLEEP_DURATION (1)
+// default hard limit of the WAL size, as a multiple of wal_threshold
+#define FDB_WAL_FLUSH_HARD_LIMIT_RATIO (4)
+// max number of WAL entries that the WAL flusher flushes while holding the
+// file lock; it releases the lock between the chunks of a flush
+#define FDB_WALFLUSHER_CHUNK_SIZE (1024)
 
 //#define BCACHE_NBUCKET (4099) // a prime number
 #define BCACHE_NBUCKET (257) // a prime number
@@ -134,6 +141,16 @@
 // Asynchronous I/O queue depth
 #define ASYNC_IO_QUEUE_DEPTH (64)
 
+// Adaptive read-ahead window (in blocks)
+#define MIN_READAHEAD_BLOCKS (4)
+#define MAX_READAHEAD_BLOCKS (512)
+
+// Maximum group commit window (in microseconds)
+#define MAX_GROUP_COMMIT_WINDOW (1000000)
+
+// Maximum number of threads reading old documents during WAL flush
+#define MAX_NUM_WAL_PREFETCH_THREADS (64)
+
 // Number of daemon compactor threads
 #define DEFAULT_NUM_COMPACTOR_THREADS (4)
 #define MAX_NUM_COMPACTOR_THREADS (128)
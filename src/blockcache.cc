@@ -23,6 +23,12 @@
 
 #if !defined(WIN32) && !defined(_WIN32)
 #include <sys/time.h>
+#include <unistd.h>
+#endif
+#if defined(__linux__)
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
 #endif
 
 #include "hash_functions.h"
@@ -34,6 +40,7 @@
 #include "avltree.h"
 #include "atomic.h"
 #include "fdb_internal.h"
+#include "timing.h"
 
 #include "memleak.h"
 
@@ -54,10 +61,50 @@ static spin_t bcache_lock;
 // hash table for filename
 static struct hash fnamedic;
 
-// free block list
+// total number of free blocks
 static atomic_uint64_t freelist_count(0);
-static struct list freelist;
-static spin_t freelist_lock;
+
+/*
+ * Buffer cache arena.
+ *
+ * The cache memory is split into one region per NUMA node, each of which is
+ * backed by huge pages where available and bound to its node. Free blocks
+ * of each region are kept in the node's pool, and each CPU caches a small
+ * batch of free blocks of its own node so that allocating and releasing
+ * blocks usually do not contend on a global lock.
+ */
+struct bcache_node_pool {
+    spin_t lock;
+    struct list freelist;
+    size_t count;
+    // memory region of the node
+    void *addr;
+    size_t len;
+    // true if 'addr' is mapped by mmap(), false if allocated by calloc()
+    bool mapped;
+};
+
+struct bcache_cpu_cache {
+    spin_t lock;
+    struct list freelist;
+    size_t count;
+    // avoid false sharing between CPUs
+    char padding[64];
+};
+
+// Maximum number of NUMA nodes supported.
+#define BCACHE_MAX_NODES (64)
+// Number of free blocks moved between a CPU cache and its node pool at once.
+#define BCACHE_CPU_CACHE_BATCH (32)
+
+static struct bcache_node_pool *node_pools;
+static size_t num_nodes;
+static struct bcache_cpu_cache *cpu_caches;
+static size_t num_cpus;
+// CPU ID -> NUMA node ID
+static uint16_t *cpu_to_node;
+// 0 if per-CPU caches are disabled (e.g., too small cache)
+static size_t cpu_cache_batch;
 
 static const size_t MAX_VICTIM_SELECTIONS = 5;
 
@@ -77,16 +124,66 @@ static size_t bcache_flush_unit;
 
 static bcache_config bcache_global_config;
 
+// Coarse logical clock used for the per-file access timestamp. It is
+// advanced only when a new block is brought into the cache, so that cache
+// hits never need to read the system clock.
+static atomic_uint64_t bcache_clock(0);
+
+// cache statistics
+static atomic_uint64_t bcache_nhits(0);
+static atomic_uint64_t bcache_nmisses(0);
+static atomic_uint64_t bcache_nevictions(0);
+
+/*
+ * Open-addressing hash index (bid -> bcache_item) of a shard, using linear
+ * probing with backward-shift deletion (no tombstones).
+ *
+ * Insertions and removals are done under the shard lock, while readers probe
+ * the table without any lock. A lock-free probe may miss an entry that is
+ * being moved, in which case the reader falls back to the locked lookup;
+ * a found entry is validated after pinning the item
+ * (see _bcache_pin_lockfree()). When the table grows, the previous one is
+ * kept in the 'retired' chain until the shard is destroyed, as readers may
+ * still be probing it. Its total size is bounded by that of the live table.
+ */
+struct bcache_slot {
+    // BID hint to avoid dereferencing items while probing
+    atomic_uint64_t bid;
+    std::atomic<struct bcache_item *> item;
+};
+
+struct bcache_table {
+    // number of slots (power of 2)
+    size_t nslots;
+    // number of items
+    size_t nitems;
+    struct bcache_table *retired;
+    struct bcache_slot slots[1];
+};
+
+#define BCACHE_TABLE_MIN_SLOTS (64)
+
 struct bcache_shard {
     spin_t lock;
     // list for clean blocks
+    // (LRU list, or the hot list 'Am' in 2Q policy)
     struct list cleanlist;
+    // 2Q policy only: FIFO list for clean blocks referenced once ('A1in')
+    struct list a1list;
+    // 2Q policy only: IDs of blocks recently evicted from 'A1in' ('A1out')
+    struct list ghostlist;
+    struct hash ghosthash;
+    size_t nclean;
+    size_t na1;
+    size_t nghost;
     // tree for normal dirty blocks
     struct avl_tree tree;
     // tree for index nodes
     struct avl_tree tree_idx;
-    // hash table for block lookup
-    struct hash hashtable;
+    // index for block lookup
+    std::atomic<struct bcache_table *> table;
+    // NUMA node preferred for the shard's blocks
+    size_t node;
     // list elem for shard LRU
     struct list_elem le;
 };
@@ -114,27 +211,37 @@ struct fnamedic_item {
     atomic_uint64_t nimmutable;
     atomic_uint64_t access_timestamp;
     size_t num_shards;
+    // Serializes the flushers that write staged copies of dirty blocks
+    // (see _flush_dirty_blocks()), so that an older copy of a block cannot
+    // be written after a newer one.
+    mutex_t flush_lock;
 };
 
 #define BCACHE_DIRTY (0x1)
 #define BCACHE_IMMUTABLE (0x2)
 #define BCACHE_FREE (0x4)
-
-static void *buffercache_addr = NULL;
+#define BCACHE_HOT (0x8) // 2Q policy: the block is in 'Am' list
+// the block was dropped from the index while pinned, and is freed by
+// whoever releases the last pin (see _bcache_unpin_item())
+#define BCACHE_STALE (0x10)
 
 struct bcache_item {
-    // BID
-    bid_t bid;
+    // BID (read by lock-free readers for validation)
+    atomic_uint64_t bid;
     // contents address
     void *addr;
-    // hash elem for lookup hash table
-    struct hash_elem hash_elem;
+    // NUMA node that 'addr' belongs to
+    uint16_t node;
     // list elem for {free, clean, dirty} lists
     struct list_elem list_elem;
     // flag
     atomic_uint8_t flag;
     // score
     uint8_t score;
+    // number of readers referring to 'addr' in place (see bcache_pin())
+    atomic_uint32_t pin_count;
+    // CLOCK reference bit, set on cache hits without reordering any list
+    atomic_uint8_t referenced;
 };
 
 struct dirty_item {
@@ -142,6 +249,12 @@ struct dirty_item {
     struct avl_node avl;
 };
 
+struct ghost_item {
+    bid_t bid;
+    struct hash_elem hash_elem;
+    struct list_elem list_elem;
+};
+
 INLINE int _dirty_cmp(struct avl_node *a, struct avl_node *b, void *aux)
 {
     struct dirty_item *aa, *bb;
@@ -185,17 +298,17 @@ INLINE int _fname_cmp(struct hash_elem *a, struct hash_elem *b)
     }
 }
 
-INLINE uint32_t _bcache_hash(struct hash *hash, struct hash_elem *e)
+INLINE uint32_t _ghost_hash(struct hash *hash, struct hash_elem *e)
 {
-    struct bcache_item *item = _get_entry(e, struct bcache_item, hash_elem);
+    struct ghost_item *item = _get_entry(e, struct ghost_item, hash_elem);
     return (item->bid) % ((uint32_t)BCACHE_NBUCKET);
 }
 
-INLINE int _bcache_cmp(struct hash_elem *a, struct hash_elem *b)
+INLINE int _ghost_cmp(struct hash_elem *a, struct hash_elem *b)
 {
-    struct bcache_item *aa, *bb;
-    aa = _get_entry(a, struct bcache_item, hash_elem);
-    bb = _get_entry(b, struct bcache_item, hash_elem);
+    struct ghost_item *aa, *bb;
+    aa = _get_entry(a, struct ghost_item, hash_elem);
+    bb = _get_entry(b, struct ghost_item, hash_elem);
 
     #ifdef __BIT_CMP
 
@@ -210,6 +323,196 @@ INLINE int _bcache_cmp(struct hash_elem *a, struct hash_elem *b)
     #endif
 }
 
+INLINE size_t _bcache_table_pos(bid_t bid, size_t nslots)
+{
+    // Fibonacci hashing; BIDs in a shard are strided by the number of shards.
+    return (size_t)((bid * 0x9e3779b97f4a7c15ULL) >> 32) & (nslots - 1);
+}
+
+static struct bcache_table *_bcache_table_create(size_t nslots)
+{
+    struct bcache_table *table;
+    table = (struct bcache_table *)
+            calloc(1, sizeof(struct bcache_table) +
+                      sizeof(struct bcache_slot) * (nslots - 1));
+    table->nslots = nslots;
+    return table;
+}
+
+static void _bcache_table_free(struct bcache_shard *bshard)
+{
+    struct bcache_table *table, *retired;
+
+    table = bshard->table.load(std::memory_order_relaxed);
+    while (table) {
+        retired = table->retired;
+        free(table);
+        table = retired;
+    }
+    bshard->table.store(NULL, std::memory_order_relaxed);
+}
+
+// Return the index of the slot holding the given BID, or -1 if not found.
+// This function can be called without grabbing the shard lock.
+INLINE int64_t _bcache_table_find(struct bcache_table *table,
+                                  bid_t bid,
+                                  struct bcache_item **item_out)
+{
+    size_t mask = table->nslots - 1;
+    size_t pos = _bcache_table_pos(bid, table->nslots);
+    struct bcache_slot *slot;
+    struct bcache_item *item;
+
+    for (size_t i = 0; i < table->nslots; ++i, pos = (pos + 1) & mask) {
+        slot = &table->slots[pos];
+        item = slot->item.load();
+        if (item == NULL) {
+            break;
+        }
+        if (atomic_get_uint64_t(&slot->bid, std::memory_order_relaxed) == bid) {
+            *item_out = item;
+            return pos;
+        }
+    }
+    return -1;
+}
+
+// Lookup under the shard lock.
+INLINE struct bcache_item *_bcache_table_lookup(struct bcache_shard *bshard,
+                                                bid_t bid)
+{
+    struct bcache_item *item = NULL;
+    _bcache_table_find(bshard->table.load(std::memory_order_relaxed),
+                       bid, &item);
+    return item;
+}
+
+INLINE void _bcache_table_set(struct bcache_slot *slot, bid_t bid,
+                              struct bcache_item *item)
+{
+    atomic_store_uint64_t(&slot->bid, bid, std::memory_order_relaxed);
+    slot->item.store(item);
+}
+
+static void _bcache_table_put(struct bcache_table *table,
+                              bid_t bid, struct bcache_item *item)
+{
+    size_t mask = table->nslots - 1;
+    size_t pos = _bcache_table_pos(bid, table->nslots);
+
+    while (table->slots[pos].item.load(std::memory_order_relaxed)) {
+        pos = (pos + 1) & mask;
+    }
+    _bcache_table_set(&table->slots[pos], bid, item);
+    table->nitems++;
+}
+
+// Should be called while the shard lock is grabbed.
+static void _bcache_table_insert(struct bcache_shard *bshard,
+                                 struct bcache_item *item)
+{
+    struct bcache_table *table, *new_table;
+    struct bcache_item *cur;
+
+    table = bshard->table.load(std::memory_order_relaxed);
+    if ((table->nitems + 1) * 2 > table->nslots) {
+        // keep the load factor below 50% .. grow the table
+        new_table = _bcache_table_create(table->nslots * 2);
+        for (size_t i = 0; i < table->nslots; ++i) {
+            cur = table->slots[i].item.load(std::memory_order_relaxed);
+            if (cur) {
+                _bcache_table_put(new_table,
+                    atomic_get_uint64_t(&table->slots[i].bid,
+                                        std::memory_order_relaxed), cur);
+            }
+        }
+        new_table->retired = table;
+        bshard->table.store(new_table);
+        table = new_table;
+    }
+    _bcache_table_put(table, item->bid, item);
+}
+
+// Should be called while the shard lock is grabbed.
+static void _bcache_table_remove(struct bcache_shard *bshard,
+                                 struct bcache_item *item)
+{
+    struct bcache_table *table = bshard->table.load(std::memory_order_relaxed);
+    struct bcache_item *found = NULL, *cur;
+    size_t mask = table->nslots - 1;
+    size_t hole, pos, home;
+    int64_t idx = _bcache_table_find(table, item->bid, &found);
+
+    fdb_assert(found == item, found, item);
+    table->nitems--;
+
+    // Shift the following entries of the cluster back to fill the hole.
+    hole = idx;
+    pos = idx;
+    while (true) {
+        pos = (pos + 1) & mask;
+        cur = table->slots[pos].item.load(std::memory_order_relaxed);
+        if (cur == NULL) {
+            break;
+        }
+        bid_t bid = atomic_get_uint64_t(&table->slots[pos].bid,
+                                        std::memory_order_relaxed);
+        home = _bcache_table_pos(bid, table->nslots);
+        // the entry cannot be moved if its home lies in (hole, pos]
+        if ((hole <= pos) ? (hole < home && home <= pos)
+                          : (hole < home || home <= pos)) {
+            continue;
+        }
+        _bcache_table_set(&table->slots[hole], bid, cur);
+        hole = pos;
+    }
+    table->slots[hole].item.store(NULL);
+}
+
+// Detach an item from the shard index so that it can be freed, unless a
+// lock-free reader has pinned it in the meantime (see _bcache_pin_lockfree()).
+// Should be called while the shard lock is grabbed.
+static bool _bcache_table_unlink(struct bcache_shard *bshard,
+                                 struct bcache_item *item)
+{
+    _bcache_table_remove(bshard, item);
+    // The slot stores above and the load below are sequentially consistent,
+    // which pairs with the pin-then-recheck of the reader.
+    if (atomic_get_uint32_t(&item->pin_count)) {
+        _bcache_table_insert(bshard, item);
+        return false;
+    }
+    return true;
+}
+
+static void _bcache_unpin_item(struct bcache_item *item);
+
+// Find and pin a clean block without grabbing the shard lock. Returns NULL
+// if the block is not found or is not safe to read in place (e.g., dirty);
+// the caller should then fall back to the lookup under the shard lock.
+INLINE struct bcache_item *_bcache_pin_lockfree(struct bcache_shard *bshard,
+                                                bid_t bid)
+{
+    struct bcache_item *item = NULL, *item2 = NULL;
+
+    if (_bcache_table_find(bshard->table.load(), bid, &item) < 0) {
+        return NULL;
+    }
+    atomic_incr_uint32_t(&item->pin_count);
+    // The item may have been unlinked, or even reused for another block,
+    // before being pinned. Once it is seen in the index again after pinning,
+    // it cannot be freed until unpinned.
+    if (_bcache_table_find(bshard->table.load(), bid, &item2) < 0 ||
+        item2 != item || atomic_get_uint64_t(&item->bid) != bid ||
+        (atomic_get_uint8_t(&item->flag) &
+         (BCACHE_FREE | BCACHE_DIRTY | BCACHE_STALE))) {
+        // This may be the last pin of a stale block.
+        _bcache_unpin_item(item);
+        return NULL;
+    }
+    return item;
+}
+
 #define _list_empty(list) (list.head == NULL)
 #define _tree_empty(tree) (tree.root == NULL)
 
@@ -233,6 +536,7 @@ static bool _file_empty(struct fnamedic_item *fname) {
     _acquire_all_shard_locks(fname);
     for (; i < fname->num_shards; ++i) {
         if (!(_list_empty(fname->shards[i].cleanlist) &&
+              _list_empty(fname->shards[i].a1list) &&
               _tree_empty(fname->shards[i].tree) &&
               _tree_empty(fname->shards[i].tree_idx))) {
             empty = false;
@@ -246,10 +550,240 @@ static bool _file_empty(struct fnamedic_item *fname) {
 INLINE bool _shard_empty(struct bcache_shard *bshard) {
     // Caller should grab the shard lock before calling this function.
     return _list_empty(bshard->cleanlist) &&
+           _list_empty(bshard->a1list) &&
            _tree_empty(bshard->tree) &&
            _tree_empty(bshard->tree_idx);
 }
 
+/*
+ * Replacement policies for clean blocks.
+ * All functions below should be called while the shard lock is grabbed.
+ */
+struct bcache_policy_ops {
+    // A clean block enters the clean set (cache fill or write-back).
+    // Note that cache hits are not reported to the policy; they only set the
+    // item's reference bit, which is examined by pop_victim (CLOCK).
+    void (*insert)(struct bcache_shard *bshard, struct bcache_item *item);
+    // A clean block leaves the clean set (dirtied, invalidated, or dropped).
+    void (*remove)(struct bcache_shard *bshard, struct bcache_item *item);
+    // Detach and return the next block to be evicted, or NULL if there is
+    // no evictable clean block in the shard. Pinned blocks are skipped.
+    struct bcache_item *(*pop_victim)(struct bcache_shard *bshard);
+};
+
+static struct bcache_policy_ops *bcache_policy;
+
+INLINE void _bcache_set_score(struct bcache_item *item);
+
+// Give a referenced item another round in the list instead of evicting it.
+INLINE bool _bcache_test_and_clear_ref(struct bcache_item *item)
+{
+    if (atomic_get_uint8_t(&item->referenced, std::memory_order_relaxed)) {
+        atomic_store_uint8_t(&item->referenced, 0, std::memory_order_relaxed);
+        // refresh the second chance of b-tree nodes as well
+        _bcache_set_score(item);
+        return true;
+    }
+    return false;
+}
+
+// --- CLOCK with second chance (default) ---
+
+static void _lru_insert(struct bcache_shard *bshard, struct bcache_item *item)
+{
+    list_push_front(&bshard->cleanlist, &item->list_elem);
+    bshard->nclean++;
+}
+
+static void _lru_remove(struct bcache_shard *bshard, struct bcache_item *item)
+{
+    list_remove(&bshard->cleanlist, &item->list_elem);
+    bshard->nclean--;
+}
+
+static struct bcache_item *_lru_pop_victim(struct bcache_shard *bshard)
+{
+    struct list_elem *e;
+    struct bcache_item *item;
+    // Each item can be skipped at most three times
+    // (pinned, referenced, or second chance).
+    size_t num_attempts = bshard->nclean * 3;
+
+    for (; num_attempts; --num_attempts) {
+        e = list_pop_back(&bshard->cleanlist);
+        if (!e) {
+            break;
+        }
+        item = _get_entry(e, struct bcache_item, list_elem);
+        if (atomic_get_uint32_t(&item->pin_count)) {
+            // pinned by a reader .. cannot be evicted, skip it
+            list_push_front(&bshard->cleanlist, &item->list_elem);
+            continue;
+        }
+        if (_bcache_test_and_clear_ref(item)) {
+            list_push_front(&bshard->cleanlist, &item->list_elem);
+            continue;
+        }
+#ifdef __BCACHE_SECOND_CHANCE
+        // repeat until zero-score item is found
+        // If `do not cache doc blocks` option is on, second chance
+        // policy is disabled.
+        if (item->score && !bcache_global_config.do_not_cache_doc_blocks) {
+            // give second chance to the item
+            item->score--;
+            list_push_front(&bshard->cleanlist, &item->list_elem);
+            continue;
+        }
+#endif
+        bshard->nclean--;
+        return item;
+    }
+    return NULL;
+}
+
+static struct bcache_policy_ops bcache_lru_ops = {
+    _lru_insert,
+    _lru_remove,
+    _lru_pop_victim
+};
+
+// --- 2Q ---
+// Newly cached blocks go to the FIFO list 'A1in' and stay there regardless of
+// hits, so that blocks read only once by a scan or compaction are dropped
+// first. Blocks evicted from 'A1in' are remembered in the ghost list 'A1out';
+// if such a block is read again, it is promoted to the hot LRU list 'Am'.
+
+// Maximum portion of 'A1in' in the shard's clean blocks (%).
+#define BCACHE_2Q_A1IN_RATIO (25)
+// Maximum number of ghost entries relative to the shard's clean blocks (%).
+#define BCACHE_2Q_A1OUT_RATIO (50)
+
+static void _2q_add_ghost(struct bcache_shard *bshard, bid_t bid)
+{
+    struct ghost_item *ghost;
+    size_t limit = (bshard->nclean + bshard->na1) *
+                   BCACHE_2Q_A1OUT_RATIO / 100 + 1;
+
+    while (bshard->nghost >= limit) {
+        struct list_elem *e = list_pop_back(&bshard->ghostlist);
+        ghost = _get_entry(e, struct ghost_item, list_elem);
+        hash_remove(&bshard->ghosthash, &ghost->hash_elem);
+        mempool_free(ghost);
+        bshard->nghost--;
+    }
+    ghost = (struct ghost_item *)mempool_alloc(sizeof(struct ghost_item));
+    ghost->bid = bid;
+    hash_insert(&bshard->ghosthash, &ghost->hash_elem);
+    list_push_front(&bshard->ghostlist, &ghost->list_elem);
+    bshard->nghost++;
+}
+
+static void _2q_insert(struct bcache_shard *bshard, struct bcache_item *item)
+{
+    struct ghost_item query, *ghost;
+    struct hash_elem *h = NULL;
+
+    if (item->flag & BCACHE_HOT) {
+        // Write-back of a block that was hot before it became dirty.
+        list_push_front(&bshard->cleanlist, &item->list_elem);
+        bshard->nclean++;
+        return;
+    }
+
+    if (bshard->nghost) {
+        query.bid = item->bid;
+        h = hash_find(&bshard->ghosthash, &query.hash_elem);
+    }
+    if (h) {
+        // re-referenced after eviction from 'A1in' .. promote to 'Am'
+        ghost = _get_entry(h, struct ghost_item, hash_elem);
+        hash_remove(&bshard->ghosthash, &ghost->hash_elem);
+        list_remove(&bshard->ghostlist, &ghost->list_elem);
+        mempool_free(ghost);
+        bshard->nghost--;
+
+        item->flag |= BCACHE_HOT;
+        list_push_front(&bshard->cleanlist, &item->list_elem);
+        bshard->nclean++;
+    } else {
+        list_push_front(&bshard->a1list, &item->list_elem);
+        bshard->na1++;
+    }
+}
+
+static void _2q_remove(struct bcache_shard *bshard, struct bcache_item *item)
+{
+    if (item->flag & BCACHE_HOT) {
+        list_remove(&bshard->cleanlist, &item->list_elem);
+        bshard->nclean--;
+    } else {
+        list_remove(&bshard->a1list, &item->list_elem);
+        bshard->na1--;
+    }
+}
+
+static struct bcache_item *_2q_pop_victim(struct bcache_shard *bshard)
+{
+    struct list_elem *e;
+    struct bcache_item *item;
+    size_t num_attempts;
+    size_t a1_limit = (bshard->nclean + bshard->na1) *
+                      BCACHE_2Q_A1IN_RATIO / 100;
+
+    if (bshard->na1 > a1_limit || bshard->nclean == 0) {
+        for (num_attempts = bshard->na1; num_attempts; --num_attempts) {
+            e = list_pop_back(&bshard->a1list);
+            item = _get_entry(e, struct bcache_item, list_elem);
+            if (atomic_get_uint32_t(&item->pin_count)) {
+                list_push_front(&bshard->a1list, &item->list_elem);
+                continue;
+            }
+            // Hits on 'A1in' are regarded as correlated references.
+            atomic_store_uint8_t(&item->referenced, 0,
+                                 std::memory_order_relaxed);
+            bshard->na1--;
+            _2q_add_ghost(bshard, item->bid);
+            return item;
+        }
+    }
+
+    // 'Am' is managed by CLOCK instead of strict LRU
+    for (num_attempts = bshard->nclean * 2; num_attempts; --num_attempts) {
+        e = list_pop_back(&bshard->cleanlist);
+        item = _get_entry(e, struct bcache_item, list_elem);
+        if (atomic_get_uint32_t(&item->pin_count) ||
+            _bcache_test_and_clear_ref(item)) {
+            list_push_front(&bshard->cleanlist, &item->list_elem);
+            continue;
+        }
+        bshard->nclean--;
+        return item;
+    }
+    return NULL;
+}
+
+static struct bcache_policy_ops bcache_2q_ops = {
+    _2q_insert,
+    _2q_remove,
+    _2q_pop_victim
+};
+
+static void _bcache_free_ghosts(struct bcache_shard *bshard)
+{
+    struct list_elem *e;
+    struct ghost_item *ghost;
+
+    e = list_begin(&bshard->ghostlist);
+    while (e) {
+        ghost = _get_entry(e, struct ghost_item, list_elem);
+        e = list_remove(&bshard->ghostlist, e);
+        hash_remove(&bshard->ghosthash, &ghost->hash_elem);
+        mempool_free(ghost);
+    }
+    bshard->nghost = 0;
+    hash_free(&bshard->ghosthash);
+}
+
 struct fnamedic_item *_bcache_get_victim()
 {
     struct fnamedic_item *ret = NULL;
@@ -293,33 +827,382 @@ struct fnamedic_item *_bcache_get_victim()
     return ret;
 }
 
-static struct bcache_item *_bcache_alloc_freeblock()
+INLINE size_t _bcache_cur_cpu(void)
 {
-    struct list_elem *e = NULL;
-    struct bcache_item *item;
-
-    spin_lock(&freelist_lock);
-    e = list_pop_front(&freelist);
-    if (e) {
-        freelist_count--;
+#if defined(__linux__)
+    int cpu = sched_getcpu();
+    if (cpu >= 0) {
+        return (size_t)cpu % num_cpus;
     }
-    spin_unlock(&freelist_lock);
+#endif
+    return 0;
+}
 
+// Pop a free block from the list, or return NULL.
+// Should be called while the corresponding lock is grabbed.
+INLINE struct bcache_item *_bcache_pop_free(struct list *freelist,
+                                            size_t *count)
+{
+    struct list_elem *e = list_pop_front(freelist);
     if (e) {
-        item = _get_entry(e, struct bcache_item, list_elem);
-        return item;
+        (*count)--;
+        return _get_entry(e, struct bcache_item, list_elem);
     }
     return NULL;
 }
 
+// Move up to 'n' free blocks from a list to another.
+INLINE void _bcache_move_free(struct list *from, size_t *from_count,
+                              struct list *to, size_t *to_count, size_t n)
+{
+    struct list_elem *e;
+    for (; n && (e = list_pop_front(from)); --n) {
+        (*from_count)--;
+        list_push_front(to, e);
+        (*to_count)++;
+    }
+}
+
+static struct bcache_item *_bcache_alloc_freeblock(size_t node)
+{
+    struct bcache_item *item = NULL;
+    size_t i;
+
+    if (cpu_cache_batch) {
+        size_t cpu = _bcache_cur_cpu();
+        if (cpu_to_node[cpu] == node) {
+            struct bcache_cpu_cache *cache = &cpu_caches[cpu];
+            struct bcache_node_pool *pool = &node_pools[node];
+            spin_lock(&cache->lock);
+            if (cache->count == 0) {
+                // refill the CPU cache from the node pool
+                spin_lock(&pool->lock);
+                _bcache_move_free(&pool->freelist, &pool->count,
+                                  &cache->freelist, &cache->count,
+                                  cpu_cache_batch);
+                spin_unlock(&pool->lock);
+            }
+            item = _bcache_pop_free(&cache->freelist, &cache->count);
+            spin_unlock(&cache->lock);
+        }
+    }
+
+    // preferred node first, then the other nodes
+    for (i = 0; !item && i < num_nodes; ++i) {
+        struct bcache_node_pool *pool = &node_pools[(node + i) % num_nodes];
+        spin_lock(&pool->lock);
+        item = _bcache_pop_free(&pool->freelist, &pool->count);
+        spin_unlock(&pool->lock);
+    }
+
+    // free blocks cached by other CPUs, before giving up and evicting
+    for (i = 0; !item && cpu_cache_batch && i < num_cpus; ++i) {
+        spin_lock(&cpu_caches[i].lock);
+        item = _bcache_pop_free(&cpu_caches[i].freelist, &cpu_caches[i].count);
+        spin_unlock(&cpu_caches[i].lock);
+    }
+
+    if (item) {
+        atomic_decr_uint64_t(&freelist_count);
+    }
+    return item;
+}
+
 static void _bcache_release_freeblock(struct bcache_item *item)
 {
-    spin_lock(&freelist_lock);
+    struct bcache_node_pool *pool = &node_pools[item->node];
+
     item->flag = BCACHE_FREE;
     item->score = 0;
-    list_push_front(&freelist, &item->list_elem);
-    freelist_count++;
-    spin_unlock(&freelist_lock);
+    atomic_store_uint8_t(&item->referenced, 0, std::memory_order_relaxed);
+    atomic_incr_uint64_t(&freelist_count);
+
+    if (cpu_cache_batch) {
+        size_t cpu = _bcache_cur_cpu();
+        if (cpu_to_node[cpu] == item->node) {
+            struct bcache_cpu_cache *cache = &cpu_caches[cpu];
+            spin_lock(&cache->lock);
+            list_push_front(&cache->freelist, &item->list_elem);
+            cache->count++;
+            if (cache->count > cpu_cache_batch * 2) {
+                // return a batch to the node pool
+                spin_lock(&pool->lock);
+                _bcache_move_free(&cache->freelist, &cache->count,
+                                  &pool->freelist, &pool->count,
+                                  cpu_cache_batch);
+                spin_unlock(&pool->lock);
+            }
+            spin_unlock(&cache->lock);
+            return;
+        }
+    }
+
+    spin_lock(&pool->lock);
+    list_push_front(&pool->freelist, &item->list_elem);
+    pool->count++;
+    spin_unlock(&pool->lock);
+}
+
+// Free a stale block if it is no longer pinned. Only one of the racing
+// callers (the dropper and the unpinners) wins the STALE flag and frees it.
+static void _bcache_try_free_stale(struct bcache_item *item)
+{
+    uint8_t flag = atomic_get_uint8_t(&item->flag);
+    while (flag & BCACHE_STALE) {
+        if (atomic_get_uint32_t(&item->pin_count)) {
+            return;
+        }
+        if (atomic_cas_uint8_t(&item->flag, flag, flag & ~BCACHE_STALE)) {
+            _bcache_release_freeblock(item);
+            return;
+        }
+        flag = atomic_get_uint8_t(&item->flag);
+    }
+}
+
+static void _bcache_unpin_item(struct bcache_item *item)
+{
+    if (atomic_decr_uint32_t(&item->pin_count) == 0) {
+        _bcache_try_free_stale(item);
+    }
+}
+
+// Free a block that has been removed from the shard index and lists. If it
+// is still pinned, its contents must stay valid until the last pin is
+// released, but it can no longer be found by any lookup.
+static void _bcache_drop_item(struct bcache_item *item)
+{
+    item->flag |= BCACHE_STALE;
+    _bcache_try_free_stale(item);
+}
+
+#if defined(__linux__)
+// Parse a Linux CPU/node list string (e.g., "0-3,8-11") and mark the IDs.
+static void _bcache_parse_id_list(const char *path, uint8_t *ids, size_t max)
+{
+    char buf[4096];
+    char *ptr, *end;
+    unsigned long first, last;
+    FILE *fp = fopen(path, "r");
+
+    if (!fp) {
+        return;
+    }
+    if (!fgets(buf, sizeof(buf), fp)) {
+        fclose(fp);
+        return;
+    }
+    fclose(fp);
+
+    ptr = buf;
+    while (*ptr >= '0' && *ptr <= '9') {
+        first = last = strtoul(ptr, &end, 10);
+        if (*end == '-') {
+            last = strtoul(end + 1, &end, 10);
+        }
+        for (; first <= last && first < max; ++first) {
+            ids[first] = 1;
+        }
+        ptr = (*end == ',') ? end + 1 : end;
+    }
+}
+
+// Allocate a memory region backed by 1 GB or 2 MB huge pages if possible,
+// and bind it to the given NUMA node.
+static void *_bcache_map_region(size_t len, size_t node, size_t *len_out)
+{
+    const size_t huge_1g = 1UL << 30, huge_2m = 1UL << 21;
+    const int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    void *addr = MAP_FAILED;
+    size_t maplen;
+
+#if defined(MAP_HUGETLB)
+#if defined(MAP_HUGE_SHIFT)
+    if (len >= huge_1g) {
+        maplen = (len + huge_1g - 1) & ~(huge_1g - 1);
+        addr = mmap(NULL, maplen, PROT_READ | PROT_WRITE,
+                    flags | MAP_HUGETLB | (30 << MAP_HUGE_SHIFT), -1, 0);
+    }
+#endif
+    if (addr == MAP_FAILED && len >= huge_2m) {
+        maplen = (len + huge_2m - 1) & ~(huge_2m - 1);
+        addr = mmap(NULL, maplen, PROT_READ | PROT_WRITE,
+                    flags | MAP_HUGETLB, -1, 0);
+    }
+#endif
+    if (addr == MAP_FAILED) {
+        // no reserved huge pages .. ask for transparent huge pages instead
+        maplen = len;
+        addr = mmap(NULL, maplen, PROT_READ | PROT_WRITE, flags, -1, 0);
+        if (addr == MAP_FAILED) {
+            return NULL;
+        }
+#if defined(MADV_HUGEPAGE)
+        madvise(addr, maplen, MADV_HUGEPAGE);
+#endif
+    }
+
+#if defined(SYS_mbind)
+    if (num_nodes > 1) {
+        // MPOL_PREFERRED: fall back to other nodes rather than failing
+        unsigned long nodemask[BCACHE_MAX_NODES / (8 * sizeof(unsigned long))];
+        memset(nodemask, 0, sizeof(nodemask));
+        nodemask[node / (8 * sizeof(unsigned long))] |=
+            1UL << (node % (8 * sizeof(unsigned long)));
+        syscall(SYS_mbind, addr, maplen, 1 /* MPOL_PREFERRED */,
+                nodemask, (unsigned long)BCACHE_MAX_NODES, 0);
+    }
+#else
+    (void)node;
+#endif
+
+    *len_out = maplen;
+    return addr;
+}
+#endif
+
+static void _bcache_arena_init(int nblock)
+{
+    size_t i, j, node_nblock;
+    struct bcache_item *item;
+    uint8_t *block_ptr;
+    uint8_t node_ids[BCACHE_MAX_NODES];
+
+#if !defined(WIN32) && !defined(_WIN32)
+    long ncpu = sysconf(_SC_NPROCESSORS_CONF);
+    num_cpus = (ncpu > 0) ? (size_t)ncpu : 1;
+#else
+    num_cpus = 1;
+#endif
+    cpu_to_node = (uint16_t *)calloc(num_cpus, sizeof(uint16_t));
+
+    num_nodes = 1;
+#if defined(__linux__)
+    memset(node_ids, 0, sizeof(node_ids));
+    _bcache_parse_id_list("/sys/devices/system/node/online",
+                          node_ids, BCACHE_MAX_NODES);
+    for (i = 0; i < BCACHE_MAX_NODES; ++i) {
+        if (node_ids[i]) {
+            num_nodes = i + 1;
+        }
+    }
+    if (num_nodes > 1) {
+        uint8_t *cpus = (uint8_t *)malloc(num_cpus);
+        char path[256];
+        for (i = 0; i < num_nodes; ++i) {
+            memset(cpus, 0, num_cpus);
+            snprintf(path, sizeof(path),
+                     "/sys/devices/system/node/node%d/cpulist", (int)i);
+            _bcache_parse_id_list(path, cpus, num_cpus);
+            for (j = 0; j < num_cpus; ++j) {
+                if (cpus[j]) {
+                    cpu_to_node[j] = i;
+                }
+            }
+        }
+        free(cpus);
+    }
+#else
+    (void)node_ids;
+#endif
+    // Don't let nodes get a tiny portion of the cache.
+    if ((size_t)nblock < num_nodes * BCACHE_CPU_CACHE_BATCH * 4) {
+        num_nodes = 1;
+        memset(cpu_to_node, 0, sizeof(uint16_t) * num_cpus);
+    }
+
+    // Enable per-CPU caches only if they hold a small portion of the cache.
+    cpu_cache_batch = 0;
+#if defined(__linux__)
+    if ((size_t)nblock >= num_cpus * BCACHE_CPU_CACHE_BATCH * 16) {
+        cpu_cache_batch = BCACHE_CPU_CACHE_BATCH;
+    }
+#endif
+    cpu_caches = (struct bcache_cpu_cache *)
+                 calloc(num_cpus, sizeof(struct bcache_cpu_cache));
+    for (i = 0; i < num_cpus; ++i) {
+        spin_init(&cpu_caches[i].lock);
+        list_init(&cpu_caches[i].freelist);
+    }
+
+    node_pools = (struct bcache_node_pool *)
+                 calloc(num_nodes, sizeof(struct bcache_node_pool));
+    for (i = 0; i < num_nodes; ++i) {
+        struct bcache_node_pool *pool = &node_pools[i];
+        spin_init(&pool->lock);
+        list_init(&pool->freelist);
+
+        node_nblock = nblock / num_nodes +
+                      ((i < (size_t)nblock % num_nodes) ? 1 : 0);
+        pool->len = node_nblock * (uint64_t)bcache_blocksize;
+#if defined(__linux__)
+        pool->addr = _bcache_map_region(pool->len, i, &pool->len);
+        pool->mapped = (pool->addr != NULL);
+#endif
+        if (!pool->addr) {
+            pool->addr = calloc(node_nblock, (uint64_t)bcache_blocksize);
+            pool->mapped = false;
+        }
+
+        block_ptr = (uint8_t *)pool->addr;
+        for (j = 0; j < node_nblock; ++j) {
+            item = (struct bcache_item *)malloc(sizeof(struct bcache_item));
+
+            item->bid = BLK_NOT_FOUND;
+            item->flag = 0x0 | BCACHE_FREE;
+            item->score = 0;
+            atomic_init_uint32_t(&item->pin_count, 0);
+            atomic_init_uint8_t(&item->referenced, 0);
+            item->addr = block_ptr;
+            item->node = i;
+            block_ptr += bcache_blocksize;
+
+            list_push_front(&pool->freelist, &item->list_elem);
+            pool->count++;
+            freelist_count++;
+        }
+    }
+}
+
+static void _bcache_free_list_items(struct list *freelist)
+{
+    struct list_elem *e = list_begin(freelist);
+    struct bcache_item *item;
+
+    while (e) {
+        item = _get_entry(e, struct bcache_item, list_elem);
+        e = list_remove(freelist, e);
+        freelist_count--;
+        free(item);
+    }
+}
+
+static void _bcache_arena_free(void)
+{
+    size_t i;
+
+    for (i = 0; i < num_cpus; ++i) {
+        _bcache_free_list_items(&cpu_caches[i].freelist);
+        spin_destroy(&cpu_caches[i].lock);
+    }
+    for (i = 0; i < num_nodes; ++i) {
+        _bcache_free_list_items(&node_pools[i].freelist);
+#if defined(__linux__)
+        if (node_pools[i].mapped) {
+            munmap(node_pools[i].addr, node_pools[i].len);
+        } else
+#endif
+        {
+            free(node_pools[i].addr);
+        }
+        spin_destroy(&node_pools[i].lock);
+    }
+    free(cpu_caches);
+    free(node_pools);
+    free(cpu_to_node);
+    cpu_caches = NULL;
+    node_pools = NULL;
+    cpu_to_node = NULL;
 }
 
 static struct fnamedic_item *_next_dead_fname_zombie(void) {
@@ -387,6 +1270,62 @@ static void _free_dirty_bids(struct dirty_bid **dirty_bids, size_t n) {
     }
 }
 
+// Copies of dirty blocks to be written in a single batch.
+struct bcache_flush_batch {
+    uint8_t *buf;
+    // one request per run of consecutive blocks
+    struct filemgr_io_req *reqs;
+    // staged items, pinned until their copies are written
+    struct bcache_item **items;
+    size_t nreqs;
+    size_t nblocks;
+    size_t max_blocks;
+};
+
+// Copy a dirty block into the batch. The item is pinned so that it is not
+// evicted (and then re-read from the file) before the copy is written.
+INLINE void _bcache_flush_batch_add(struct bcache_flush_batch *batch,
+                                    struct bcache_item *item)
+{
+    uint8_t *dst = batch->buf + batch->nblocks * bcache_blocksize;
+    cs_off_t offset = (cs_off_t)item->bid * bcache_blocksize;
+    struct filemgr_io_req *req = NULL;
+
+    memcpy(dst, item->addr, bcache_blocksize);
+    if (batch->nreqs) {
+        req = &batch->reqs[batch->nreqs - 1];
+        if (req->offset + (cs_off_t)req->count != offset) {
+            req = NULL;
+        }
+    }
+    if (req) {
+        req->count += bcache_blocksize;
+    } else {
+        req = &batch->reqs[batch->nreqs++];
+        req->buf = dst;
+        req->count = bcache_blocksize;
+        req->offset = offset;
+        req->result = 0;
+    }
+    atomic_incr_uint32_t(&item->pin_count);
+    batch->items[batch->nblocks++] = item;
+}
+
+static fdb_status _bcache_flush_batch_submit(struct fnamedic_item *fname_item,
+                                             struct bcache_flush_batch *batch)
+{
+    fdb_status status = FDB_RESULT_SUCCESS;
+    if (batch->nreqs) {
+        status = filemgr_write_blocks_batch(fname_item->curfile, batch->reqs,
+                                            batch->nreqs);
+    }
+    for (size_t i = 0; i < batch->nblocks; ++i) {
+        _bcache_unpin_item(batch->items[i]);
+    }
+    batch->nreqs = batch->nblocks = 0;
+    return status;
+}
+
 // Flush some consecutive or all dirty blocks for a given file and
 // move them to the clean list.
 static fdb_status _flush_dirty_blocks(struct fnamedic_item *fname_item,
@@ -394,46 +1333,51 @@ static fdb_status _flush_dirty_blocks(struct fnamedic_item *fname_item,
                                       bool immutables_only)
 {
     void *buf = NULL;
-    struct list_elem *prevhead = NULL;
     struct avl_tree *cur_tree = NULL;
     struct avl_node *node = NULL;
     struct dirty_bid *dbid = NULL;
     uint64_t count = 0;
-    ssize_t ret = 0;
-    bid_t start_bid = 0, prev_bid = 0;
+    bid_t prev_bid = 0;
     void *ptr = NULL;
     uint8_t marker = 0x0;
     fdb_status status = FDB_RESULT_SUCCESS;
-    bool o_direct = false;
     bool data_block_completed = false;
     struct avl_tree dirty_blocks; // Cross-shard dirty block list for sequential writes.
-
-    if (fname_item->curfile->config->flag & _ARCH_O_DIRECT) {
-        o_direct = true;
-    }
-
-    // scan and write back dirty blocks sequentially for O_DIRECT option.
-    if (sync && o_direct) {
-        malloc_align(buf, FDB_SECTOR_SIZE, bcache_flush_unit);
-        _acquire_all_shard_locks(fname_item);
+    struct bcache_flush_batch batch;
+
+    // Dirty blocks are copied into an aligned staging buffer under each
+    // shard lock, and then written in batches without holding any shard
+    // lock. This is also the write path of O_DIRECT files, so that readers
+    // are not blocked during a flush.
+    memset(&batch, 0x0, sizeof(batch));
+    if (sync) {
+        mutex_lock(&fname_item->flush_lock);
+        batch.max_blocks = bcache_flush_unit / bcache_blocksize;
+        if (!batch.max_blocks) {
+            batch.max_blocks = 1;
+        }
+        malloc_align(buf, FDB_SECTOR_SIZE,
+                     batch.max_blocks * bcache_blocksize);
+        batch.buf = (uint8_t *)buf;
+        batch.reqs = (struct filemgr_io_req *)
+                     malloc(sizeof(struct filemgr_io_req) * batch.max_blocks);
+        batch.items = (struct bcache_item **)
+                      malloc(sizeof(struct bcache_item *) * batch.max_blocks);
     }
 
-    prev_bid = start_bid = BLK_NOT_FOUND;
+    prev_bid = BLK_NOT_FOUND;
     count = 0;
 
     avl_init(&dirty_blocks, NULL);
 
     // Try to flush the dirty data blocks first and then index blocks.
     size_t i = 0;
-    bool consecutive_blocks = true;
     struct dirty_bid **dirty_bids = alca(struct dirty_bid *, fname_item->num_shards);
     memset(dirty_bids, 0x0, sizeof(dirty_bid *) * fname_item->num_shards);
     while (1) {
         if (!(node = avl_first(&dirty_blocks))) {
             for (i = 0; i < fname_item->num_shards; ++i) {
-                if (!(sync && o_direct)) {
-                    spin_lock(&fname_item->shards[i].lock);
-                }
+                spin_lock(&fname_item->shards[i].lock);
                 if (!data_block_completed) {
                     node = avl_first(&fname_item->shards[i].tree);
                 } else {
@@ -453,9 +1397,7 @@ static fdb_status _flush_dirty_blocks(struct fnamedic_item *fname_item,
                                    _dirty_bid_cmp);
                     }
                 }
-                if (!(sync && o_direct)) {
-                    spin_unlock(&fname_item->shards[i].lock);
-                }
+                spin_unlock(&fname_item->shards[i].lock);
             }
             if (!(node = avl_first(&dirty_blocks))) {
                 if (!data_block_completed) {
@@ -476,9 +1418,7 @@ static fdb_status _flush_dirty_blocks(struct fnamedic_item *fname_item,
         dbid = _get_entry(node, struct dirty_bid, avl);
 
         size_t shard_num = dbid->bid % fname_item->num_shards;
-        if (!(sync && o_direct)) {
-            spin_lock(&fname_item->shards[shard_num].lock);
-        }
+        spin_lock(&fname_item->shards[shard_num].lock);
         if (!data_block_completed) {
             cur_tree = &fname_item->shards[shard_num].tree;
         } else {
@@ -499,9 +1439,7 @@ static fdb_status _flush_dirty_blocks(struct fnamedic_item *fname_item,
         if (!item_exist) {
             // The original first item in the shard dirty block list was removed.
             // Grab the next one from the cross-shard dirty block list.
-            if (!(sync && o_direct)) {
-                spin_unlock(&fname_item->shards[shard_num].lock);
-            }
+            spin_unlock(&fname_item->shards[shard_num].lock);
             if (immutables_only &&
                 !atomic_get_uint64_t(&fname_item->nimmutable)) {
                 break;
@@ -509,22 +1447,11 @@ static fdb_status _flush_dirty_blocks(struct fnamedic_item *fname_item,
             continue;
         }
 
-        consecutive_blocks = true;
         // if BID of next dirty block is not consecutive .. stop
         if (dirty_block->item->bid != prev_bid + 1 && prev_bid != BLK_NOT_FOUND &&
-            sync) {
-            if (flush_all) {
-                consecutive_blocks = false;
-            } else {
-                if (!(sync && o_direct)) {
-                    spin_unlock(&fname_item->shards[shard_num].lock);
-                }
-                break;
-            }
-        }
-        // set START_BID if this is the start block for a single batch write.
-        if (start_bid == BLK_NOT_FOUND) {
-            start_bid = dirty_block->item->bid;
+            sync && !flush_all) {
+            spin_unlock(&fname_item->shards[shard_num].lock);
+            break;
         }
         // set PREV_BID and go to next block
         prev_bid = dirty_block->item->bid;
@@ -549,9 +1476,7 @@ static fdb_status _flush_dirty_blocks(struct fnamedic_item *fname_item,
         avl_remove(cur_tree, &dirty_block->avl);
         if (dirty_block->item->flag & BCACHE_IMMUTABLE) {
             atomic_decr_uint64_t(&fname_item->nimmutable);
-            if (!(sync && o_direct)) {
-                spin_unlock(&fname_item->shards[shard_num].lock);
-            }
+            spin_unlock(&fname_item->shards[shard_num].lock);
         }
 
         if (sync) {
@@ -568,110 +1493,65 @@ static fdb_status _flush_dirty_blocks(struct fnamedic_item *fname_item,
                 memcpy((uint8_t *)(ptr) + BTREE_CRC_OFFSET, &crc, sizeof(crc));
             }
 #endif
-            if (o_direct) {
-                if (count > 0 && !consecutive_blocks) {
-                    int64_t bytes_written;
-                    // Note that this path can be only executed in flush_all case.
-                    bytes_written = filemgr_write_blocks(fname_item->curfile,
-                                                         buf, count, start_bid);
-                    if ((uint64_t)bytes_written != count * bcache_blocksize) {
-                        count = 0;
-                        status = bytes_written < 0 ?
-                            (fdb_status) bytes_written : FDB_RESULT_WRITE_FAIL;
-                        break;
-                    }
-                    // Start a new batch again.
-                    count = 0;
-                    start_bid = dirty_block->item->bid;
-                }
-                memcpy((uint8_t *)(buf) + count*bcache_blocksize,
-                       dirty_block->item->addr, bcache_blocksize);
-            } else {
-                ret = filemgr_write_blocks(fname_item->curfile,
-                                           dirty_block->item->addr,
-                                           1,
-                                           dirty_block->item->bid);
-                if (ret != bcache_blocksize) {
-                    if (!(dirty_block->item->flag & BCACHE_IMMUTABLE) &&
-                        !(sync && o_direct)) {
-                        spin_unlock(&fname_item->shards[shard_num].lock);
-                    }
-                    status = ret < 0 ? (fdb_status) ret : FDB_RESULT_WRITE_FAIL;
-                    break;
-                }
-            }
+            _bcache_flush_batch_add(&batch, dirty_block->item);
         }
 
-        if (!(sync && o_direct)) {
-            if (dirty_block->item->flag & BCACHE_IMMUTABLE) {
-                spin_lock(&fname_item->shards[shard_num].lock);
-            }
+        if (dirty_block->item->flag & BCACHE_IMMUTABLE) {
+            spin_lock(&fname_item->shards[shard_num].lock);
         }
 
         dirty_block->item->flag &= ~(BCACHE_DIRTY);
         dirty_block->item->flag &= ~(BCACHE_IMMUTABLE);
-        // move to the shard clean block list.
-        prevhead = fname_item->shards[shard_num].cleanlist.head;
-        (void)prevhead;
 
         uint8_t marker = *((uint8_t*)(dirty_block->item->addr) + bcache_blocksize-1);
         if ( bcache_global_config.do_not_cache_doc_blocks &&
              marker != BLK_MARKER_BNODE ) {
             // If caching option is ON, and not a B-tree node, free here.
-            atomic_decr_uint64_t(&fname_item->nitems);
-            // remove from hash and insert into freelist
-            hash_remove( &fname_item->shards[shard_num].hashtable,
-                         &dirty_block->item->hash_elem );
-            // add to freelist
-            _bcache_release_freeblock(dirty_block->item);
+            if (_bcache_table_unlink(&fname_item->shards[shard_num],
+                                     dirty_block->item)) {
+                atomic_decr_uint64_t(&fname_item->nitems);
+                // add to freelist
+                _bcache_release_freeblock(dirty_block->item);
+            } else {
+                // pinned by a reader .. keep it as a clean block
+                bcache_policy->insert(&fname_item->shards[shard_num],
+                                      dirty_block->item);
+            }
         } else {
-            // B-tree node, push front.
-            list_push_front(&fname_item->shards[shard_num].cleanlist,
-                            &dirty_block->item->list_elem);
-
+            // move to the shard clean block list.
             fdb_assert(!(dirty_block->item->flag & BCACHE_FREE),
                        dirty_block->item->flag, BCACHE_FREE);
-            fdb_assert(dirty_block->item->list_elem.prev == NULL &&
-                       prevhead == dirty_block->item->list_elem.next,
-                       prevhead, dirty_block->item->list_elem.next);
+            bcache_policy->insert(&fname_item->shards[shard_num],
+                                  dirty_block->item);
         }
 
         mempool_free(dirty_block);
 
-        if (!(sync && o_direct)) {
-            spin_unlock(&fname_item->shards[shard_num].lock);
-        }
+        spin_unlock(&fname_item->shards[shard_num].lock);
 
-        count++;
-        if (count*bcache_blocksize >= bcache_flush_unit && sync) {
-            if (flush_all) {
-                if (o_direct) {
-                    ret = filemgr_write_blocks(fname_item->curfile, buf, count, start_bid);
-                    if ((size_t)ret != count * bcache_blocksize) {
-                        count = 0;
-                        status = ret < 0 ? (fdb_status) ret : FDB_RESULT_WRITE_FAIL;
-                        break;
-                    }
-                    count = 0;
-                    start_bid = BLK_NOT_FOUND;
-                    prev_bid = BLK_NOT_FOUND;
-                }
-            } else {
+        if (batch.max_blocks && batch.nblocks == batch.max_blocks) {
+            status = _bcache_flush_batch_submit(fname_item, &batch);
+            if (status != FDB_RESULT_SUCCESS) {
                 break;
             }
         }
+
+        count++;
+        if (count*bcache_blocksize >= bcache_flush_unit && sync &&
+            !flush_all) {
+            break;
+        }
     }
 
-    // synchronize
-    if (sync && o_direct) {
-        if (count > 0) {
-            ret = filemgr_write_blocks(fname_item->curfile, buf, count, start_bid);
-            if ((size_t)ret != count * bcache_blocksize) {
-                status = ret < 0 ? (fdb_status) ret : FDB_RESULT_WRITE_FAIL;
-            }
+    if (sync) {
+        fdb_status fs = _bcache_flush_batch_submit(fname_item, &batch);
+        if (status == FDB_RESULT_SUCCESS) {
+            status = fs;
         }
-        _release_all_shard_locks(fname_item);
+        free(batch.items);
+        free(batch.reqs);
         free_align(buf);
+        mutex_unlock(&fname_item->flush_lock);
     }
 
     _free_dirty_bids(dirty_bids, fname_item->num_shards);
@@ -682,8 +1562,7 @@ static fdb_status _flush_dirty_blocks(struct fnamedic_item *fname_item,
 static struct list_elem * _bcache_evict(struct fnamedic_item *curfile)
 {
     size_t n_evict;
-    struct list_elem *e = NULL;
-    struct bcache_item *item;
+    struct bcache_item *item = NULL;
     struct fnamedic_item *victim = NULL;
 
     // We don't need to grab the global buffer cache lock here because
@@ -724,8 +1603,8 @@ static struct list_elem * _bcache_evict(struct fnamedic_item *curfile)
                 spin_unlock(&bshard->lock);
                 continue;
             }
-            e = list_pop_back(&bshard->cleanlist);
-            if(!e) {
+            item = bcache_policy->pop_victim(bshard);
+            if (!item) {
                 spin_unlock(&bshard->lock);
                 // When the victim shard has no clean block, evict some dirty blocks
                 // from shards.
@@ -737,25 +1616,8 @@ static struct list_elem * _bcache_evict(struct fnamedic_item *curfile)
                 continue; // Select a victim shard again.
             }
 
-            item = _get_entry(e, struct bcache_item, list_elem);
-#ifdef __BCACHE_SECOND_CHANCE
-            // repeat until zero-score item is found
-            // If `do not cache doc blocks` option is on, second chance
-            // policy is disabled.
-            if ( item->score == 0 ||
-                 bcache_global_config.do_not_cache_doc_blocks ) {
-                found_victim_shard = true;
-                break;
-            } else {
-                // give second chance to the item
-                item->score--;
-                list_push_front(&bshard->cleanlist, &item->list_elem);
-                spin_unlock(&bshard->lock);
-            }
-#else
             found_victim_shard = true;
             break;
-#endif
         }
         if (!found_victim_shard) {
             // We couldn't find any non-empty shards even after 'num_shards'
@@ -766,9 +1628,14 @@ static struct list_elem * _bcache_evict(struct fnamedic_item *curfile)
             return NULL;
         }
 
+        if (!_bcache_table_unlink(bshard, item)) {
+            // pinned by a lock-free reader in the meantime
+            bcache_policy->insert(bshard, item);
+            spin_unlock(&bshard->lock);
+            continue;
+        }
         atomic_decr_uint64_t(&victim->nitems);
-        // remove from hash and insert into freelist
-        hash_remove(&bshard->hashtable, &item->hash_elem);
+        atomic_incr_uint64_t(&bcache_nevictions, std::memory_order_relaxed);
         // add to freelist
         _bcache_release_freeblock(item);
         n_evict++;
@@ -807,6 +1674,7 @@ static struct fnamedic_item * _fname_create(struct filemgr *file) {
     atomic_init_uint64_t(&fname_new->nimmutable, 0);
     atomic_init_uint32_t(&fname_new->ref_count, 0);
     atomic_init_uint64_t(&fname_new->access_timestamp, 0);
+    mutex_init(&fname_new->flush_lock);
     if (file->config->num_bcache_shards) {
         fname_new->num_shards = file->config->num_bcache_shards;
     } else {
@@ -822,11 +1690,20 @@ static struct fnamedic_item * _fname_create(struct filemgr *file) {
         // initialize tree
         avl_init(&fname_new->shards[i].tree, NULL);
         avl_init(&fname_new->shards[i].tree_idx, NULL);
-        // initialize clean list
+        // initialize clean lists
         list_init(&fname_new->shards[i].cleanlist);
-        // initialize hash table
-        hash_init(&fname_new->shards[i].hashtable, BCACHE_NBUCKET,
-                  _bcache_hash, _bcache_cmp);
+        list_init(&fname_new->shards[i].a1list);
+        list_init(&fname_new->shards[i].ghostlist);
+        hash_init(&fname_new->shards[i].ghosthash, BCACHE_NBUCKET,
+                  _ghost_hash, _ghost_cmp);
+        fname_new->shards[i].nclean = 0;
+        fname_new->shards[i].na1 = 0;
+        fname_new->shards[i].nghost = 0;
+        // initialize shard index
+        fname_new->shards[i].table.store(
+            _bcache_table_create(BCACHE_TABLE_MIN_SLOTS),
+            std::memory_order_relaxed);
+        fname_new->shards[i].node = i % num_nodes;
         spin_init(&fname_new->shards[i].lock);
     }
 
@@ -909,10 +1786,12 @@ static void _fname_free(struct fnamedic_item *fname)
     // free hash
     size_t i = 0;
     for (; i < fname->num_shards; ++i) {
-        hash_free(&fname->shards[i].hashtable);
+        _bcache_table_free(&fname->shards[i]);
+        _bcache_free_ghosts(&fname->shards[i]);
         spin_destroy(&fname->shards[i].lock);
     }
 
+    mutex_destroy(&fname->flush_lock);
     free(fname->shards);
     free(fname->filename);
     free(fname);
@@ -934,11 +1813,31 @@ INLINE void _bcache_set_score(struct bcache_item *item)
 #endif
 }
 
+// Update the file's access timestamp with the coarse clock.
+INLINE void _bcache_update_access_time(struct fnamedic_item *fname)
+{
+    uint64_t now = atomic_get_uint64_t(&bcache_clock,
+                                       std::memory_order_relaxed);
+    // avoid writing to the shared cache line if it is already up-to-date
+    if (atomic_get_uint64_t(&fname->access_timestamp,
+                            std::memory_order_relaxed) != now) {
+        atomic_store_uint64_t(&fname->access_timestamp, now,
+                              std::memory_order_relaxed);
+    }
+}
+
+// Mark a cached block as recently used. No list is modified here, thus the
+// caller doesn't need to hold the shard lock for recency tracking.
+INLINE void _bcache_reference(struct bcache_item *item)
+{
+    if (!atomic_get_uint8_t(&item->referenced, std::memory_order_relaxed)) {
+        atomic_store_uint8_t(&item->referenced, 1, std::memory_order_relaxed);
+    }
+}
+
 int bcache_read(struct filemgr *file, bid_t bid, void *buf)
 {
-    struct hash_elem *h;
     struct bcache_item *item;
-    struct bcache_item query;
     struct fnamedic_item *fname;
 
     // Note that we don't need to grab bcache_lock here as the block cache
@@ -948,51 +1847,45 @@ int bcache_read(struct filemgr *file, bid_t bid, void *buf)
 
     if (fname) {
         // file exists
-        // set query
-        query.bid = bid;
-        // Update the access timestamp.
-        struct timeval tp;
-        gettimeofday(&tp, NULL); // TODO: Need to implement a better way of
-                                 // getting the timestamp to avoid the overhead of
-                                 // gettimeofday()
-        atomic_store_uint64_t(&fname->access_timestamp,
-                              (uint64_t) (tp.tv_sec * 1000000 + tp.tv_usec),
-                              std::memory_order_relaxed);
+        _bcache_update_access_time(fname);
 
         size_t shard_num = bid % fname->num_shards;
-        spin_lock(&fname->shards[shard_num].lock);
+        struct bcache_shard *bshard = &fname->shards[shard_num];
 
-        // search shard hash table
-        h = hash_find(&fname->shards[shard_num].hashtable, &query.hash_elem);
-        if (h) {
+        // fast path: clean block, no shard lock
+        item = _bcache_pin_lockfree(bshard, bid);
+        if (item) {
+            memcpy(buf, item->addr, bcache_blocksize);
+            _bcache_reference(item);
+            _bcache_unpin_item(item);
+            atomic_incr_uint64_t(&bcache_nhits, std::memory_order_relaxed);
+            return bcache_blocksize;
+        }
+
+        spin_lock(&bshard->lock);
+
+        // search shard index
+        item = _bcache_table_lookup(bshard, bid);
+        if (item) {
             // cache hit
-            item = _get_entry(h, struct bcache_item, hash_elem);
             if (item->flag & BCACHE_FREE) {
-                spin_unlock(&fname->shards[shard_num].lock);
+                spin_unlock(&bshard->lock);
                 DBG("Warning: failed to read the buffer cache entry for a file '%s' "
                     "because the entry belongs to the free list!\n",
                     file->filename);
                 return 0;
             }
 
-            // move the item to the head of list if the block is clean
-            // (don't care if the block is dirty)
-            if (!(item->flag & BCACHE_DIRTY)) {
-                // TODO: Scanning the list would cause some overhead. We need to devise
-                // the better data structure to provide a fast lookup for the clean list.
-                list_remove(&fname->shards[shard_num].cleanlist, &item->list_elem);
-                list_push_front(&fname->shards[shard_num].cleanlist, &item->list_elem);
-            }
-
             memcpy(buf, item->addr, bcache_blocksize);
-            _bcache_set_score(item);
+            _bcache_reference(item);
+            atomic_incr_uint64_t(&bcache_nhits, std::memory_order_relaxed);
 
-            spin_unlock(&fname->shards[shard_num].lock);
+            spin_unlock(&bshard->lock);
 
             return bcache_blocksize;
         } else {
             // cache miss
-            spin_unlock(&fname->shards[shard_num].lock);
+            spin_unlock(&bshard->lock);
         }
     }
 
@@ -1000,11 +1893,60 @@ int bcache_read(struct filemgr *file, bid_t bid, void *buf)
     return 0;
 }
 
+void *bcache_pin(struct filemgr *file, bid_t bid, struct bcache_item **pinned)
+{
+    struct bcache_item *item;
+    struct fnamedic_item *fname;
+    void *addr = NULL;
+
+    *pinned = NULL;
+    fname = file->bcache.load(std::memory_order_relaxed);
+    if (!fname) {
+        return NULL;
+    }
+
+    _bcache_update_access_time(fname);
+
+    size_t shard_num = bid % fname->num_shards;
+    struct bcache_shard *bshard = &fname->shards[shard_num];
+
+    item = _bcache_pin_lockfree(bshard, bid);
+    if (item) {
+        _bcache_reference(item);
+        atomic_incr_uint64_t(&bcache_nhits, std::memory_order_relaxed);
+        *pinned = item;
+        return item->addr;
+    }
+
+    spin_lock(&bshard->lock);
+
+    item = _bcache_table_lookup(bshard, bid);
+    if (item) {
+        if (!(item->flag & BCACHE_FREE)) {
+            _bcache_reference(item);
+            atomic_incr_uint64_t(&bcache_nhits, std::memory_order_relaxed);
+            // Pin count is incremented under the shard lock so that
+            // _bcache_evict() never frees an item being pinned.
+            atomic_incr_uint32_t(&item->pin_count);
+            *pinned = item;
+            addr = item->addr;
+        }
+    }
+    spin_unlock(&bshard->lock);
+
+    return addr;
+}
+
+void bcache_unpin(struct bcache_item *pinned)
+{
+    if (pinned) {
+        _bcache_unpin_item(pinned);
+    }
+}
+
 bool bcache_invalidate_block(struct filemgr *file, bid_t bid)
 {
-    struct hash_elem *h;
     struct bcache_item *item;
-    struct bcache_item query;
     struct fnamedic_item *fname;
     bool ret = false;
 
@@ -1015,25 +1957,18 @@ bool bcache_invalidate_block(struct filemgr *file, bid_t bid)
 
     if (fname) {
         // file exists
-        // set query
-        query.bid = bid;
-        // Update the access timestamp.
-        struct timeval tp;
-        gettimeofday(&tp, NULL);
-        atomic_store_uint64_t(&fname->access_timestamp,
-                              (uint64_t) (tp.tv_sec * 1000000 + tp.tv_usec),
-                              std::memory_order_relaxed);
+        _bcache_update_access_time(fname);
 
         size_t shard_num = bid % fname->num_shards;
-        spin_lock(&fname->shards[shard_num].lock);
+        struct bcache_shard *bshard = &fname->shards[shard_num];
+        spin_lock(&bshard->lock);
 
-        // search BHASH
-        h = hash_find(&fname->shards[shard_num].hashtable, &query.hash_elem);
-        if (h) {
+        // search shard index
+        item = _bcache_table_lookup(bshard, bid);
+        if (item) {
             // cache hit
-            item = _get_entry(h, struct bcache_item, hash_elem);
             if (item->flag & BCACHE_FREE) {
-                spin_unlock(&fname->shards[shard_num].lock);
+                spin_unlock(&bshard->lock);
                 DBG("Warning: failed to invalidate the buffer cache entry for a file '%s' "
                     "because the entry belongs to the free list!\n",
                     file->filename);
@@ -1041,25 +1976,27 @@ bool bcache_invalidate_block(struct filemgr *file, bid_t bid)
             }
 
             if (!(item->flag & BCACHE_DIRTY)) {
-                atomic_decr_uint64_t(&fname->nitems);
                 // only for clean blocks
-                // remove from hash and insert into freelist
-                hash_remove(&fname->shards[shard_num].hashtable, &item->hash_elem);
+                // The block is going to be rewritten, so it must not be
+                // found by any later lookup even if a reader has pinned it;
+                // in that case it is freed when the last pin is released.
+                _bcache_table_remove(bshard, item);
+                atomic_decr_uint64_t(&fname->nitems);
                 // remove from clean list
-                list_remove(&fname->shards[shard_num].cleanlist, &item->list_elem);
-                spin_unlock(&fname->shards[shard_num].lock);
+                bcache_policy->remove(bshard, item);
+                spin_unlock(&bshard->lock);
 
                 // add to freelist
-                _bcache_release_freeblock(item);
+                _bcache_drop_item(item);
                 ret = true;
             } else {
                 item->flag |= BCACHE_IMMUTABLE; // (stale index node block)
                 atomic_incr_uint64_t(&fname->nimmutable);
-                spin_unlock(&fname->shards[shard_num].lock);
+                spin_unlock(&bshard->lock);
             }
         } else {
             // cache miss
-            spin_unlock(&fname->shards[shard_num].lock);
+            spin_unlock(&bshard->lock);
         }
     }
     return ret;
@@ -1072,9 +2009,7 @@ int bcache_write(struct filemgr *file,
                  bool final_write,
                  bool ignore_if_exist)
 {
-    struct hash_elem *h = NULL;
-    struct bcache_item *item;
-    struct bcache_item query;
+    struct bcache_item *item, *found;
     struct fnamedic_item *fname_new;
 
     fname_new = file->bcache;
@@ -1088,25 +2023,19 @@ int bcache_write(struct filemgr *file,
         spin_unlock(&bcache_lock);
     }
 
-    // Update the access timestamp.
-    struct timeval tp;
-    gettimeofday(&tp, NULL);
-    atomic_store_uint64_t(&fname_new->access_timestamp,
-                          (uint64_t) (tp.tv_sec * 1000000 + tp.tv_usec),
-                          std::memory_order_relaxed);
+    _bcache_update_access_time(fname_new);
 
     size_t shard_num = bid % fname_new->num_shards;
-    // set query
-    query.bid = bid;
 
     spin_lock(&fname_new->shards[shard_num].lock);
 
-    // search hash table
-    h = hash_find(&fname_new->shards[shard_num].hashtable, &query.hash_elem);
-    if (h == NULL) {
+    // search shard index
+    item = _bcache_table_lookup(&fname_new->shards[shard_num], bid);
+    if (item == NULL) {
         // cache miss
         // get a free block
-        while ((item = _bcache_alloc_freeblock()) == NULL) {
+        while ((item = _bcache_alloc_freeblock(
+                           fname_new->shards[shard_num].node)) == NULL) {
             // no free block .. perform eviction
             spin_unlock(&fname_new->shards[shard_num].lock);
 
@@ -1115,18 +2044,17 @@ int bcache_write(struct filemgr *file,
             spin_lock(&fname_new->shards[shard_num].lock);
         }
 
-        // re-search hash table
-        h = hash_find(&fname_new->shards[shard_num].hashtable, &query.hash_elem);
-        if (h == NULL) {
-            // insert into hash table
+        // re-search shard index
+        found = _bcache_table_lookup(&fname_new->shards[shard_num], bid);
+        if (found == NULL) {
+            // insert into shard index
             item->bid = bid;
             item->flag = BCACHE_FREE;
-            hash_insert(&fname_new->shards[shard_num].hashtable, &item->hash_elem);
-            h = &item->hash_elem;
+            _bcache_table_insert(&fname_new->shards[shard_num], item);
         } else {
             // insert into freelist again
             _bcache_release_freeblock(item);
-            item = _get_entry(h, struct bcache_item, hash_elem);
+            item = found;
         }
     } else {
         // cache hit.
@@ -1134,18 +2062,26 @@ int bcache_write(struct filemgr *file,
             spin_unlock(&fname_new->shards[shard_num].lock);
             return 0;
         }
-        item = _get_entry(h, struct bcache_item, hash_elem);
     }
 
-    fdb_assert(h, h, NULL);
+    // Copy the contents before the FREE flag is cleared below, as lock-free
+    // readers treat a non-free clean block as readable.
+    memcpy(item->addr, buf, bcache_blocksize);
 
+    bool was_clean = false;
     if (item->flag & BCACHE_FREE) {
         atomic_incr_uint64_t(&fname_new->nitems);
-    }
-
-    // remove from the list if the block is in clean list
-    if (!(item->flag & BCACHE_DIRTY) && !(item->flag & BCACHE_FREE)) {
-        list_remove(&fname_new->shards[shard_num].cleanlist, &item->list_elem);
+        atomic_incr_uint64_t(&bcache_clock, std::memory_order_relaxed);
+        if (dirty == BCACHE_REQ_CLEAN && !ignore_if_exist) {
+            // filled on a read miss (not by read-ahead)
+            atomic_incr_uint64_t(&bcache_nmisses, std::memory_order_relaxed);
+        }
+    } else if (!(item->flag & BCACHE_DIRTY)) {
+        was_clean = true;
+        if (dirty == BCACHE_REQ_DIRTY) {
+            // remove from the clean list
+            bcache_policy->remove(&fname_new->shards[shard_num], item);
+        }
     }
     item->flag &= ~BCACHE_FREE;
 
@@ -1179,13 +2115,13 @@ int bcache_write(struct filemgr *file,
     } else {
         // CLEAN request
         // insert into clean list only when it was originally clean
-        if (!(item->flag & BCACHE_DIRTY)) {
-            list_push_front(&fname_new->shards[shard_num].cleanlist, &item->list_elem);
-            item->flag &= ~(BCACHE_DIRTY);
+        if (was_clean) {
+            _bcache_reference(item);
+        } else if (!(item->flag & BCACHE_DIRTY)) {
+            bcache_policy->insert(&fname_new->shards[shard_num], item);
         }
     }
 
-    memcpy(item->addr, buf, bcache_blocksize);
     _bcache_set_score(item);
 
     spin_unlock(&fname_new->shards[shard_num].lock);
@@ -1200,9 +2136,7 @@ int bcache_write_partial(struct filemgr *file,
                          size_t len,
                          bool final_write)
 {
-    struct hash_elem *h;
     struct bcache_item *item;
-    struct bcache_item query;
     struct fnamedic_item *fname_new;
 
     fname_new = file->bcache;
@@ -1216,29 +2150,18 @@ int bcache_write_partial(struct filemgr *file,
         spin_unlock(&bcache_lock);
     }
 
-    // Update the access timestamp.
-    struct timeval tp;
-    gettimeofday(&tp, NULL);
-    atomic_store_uint64_t(&fname_new->access_timestamp,
-                          (uint64_t) (tp.tv_sec * 1000000 + tp.tv_usec),
-                          std::memory_order_relaxed);
+    _bcache_update_access_time(fname_new);
 
     size_t shard_num = bid % fname_new->num_shards;
-    // set query
-    query.bid = bid;
 
     spin_lock(&fname_new->shards[shard_num].lock);
 
-    // search hash table
-    h = hash_find(&fname_new->shards[shard_num].hashtable, &query.hash_elem);
-    if (h == NULL) {
+    // search shard index
+    item = _bcache_table_lookup(&fname_new->shards[shard_num], bid);
+    if (item == NULL) {
         // cache miss .. partial write fail .. return 0
         spin_unlock(&fname_new->shards[shard_num].lock);
         return 0;
-
-    } else {
-        // cache hit .. get the block
-        item = _get_entry(h, struct bcache_item, hash_elem);
     }
 
     if (item->flag & BCACHE_FREE) {
@@ -1256,7 +2179,7 @@ int bcache_write_partial(struct filemgr *file,
         struct dirty_item *ditem;
 
         // remove from clean list
-        list_remove(&fname_new->shards[shard_num].cleanlist, &item->list_elem);
+        bcache_policy->remove(&fname_new->shards[shard_num], item);
 
         ditem = (struct dirty_item *)mempool_alloc(sizeof(struct dirty_item));
         ditem->item = item;
@@ -1341,18 +2264,23 @@ void bcache_remove_clean_blocks(struct filemgr *file)
         // remove all clean blocks from each shard in a file.
         size_t i = 0;
         for (; i < fname_item->num_shards; ++i) {
-            spin_lock(&fname_item->shards[i].lock);
-            e = list_begin(&fname_item->shards[i].cleanlist);
-            while(e){
-                item = _get_entry(e, struct bcache_item, list_elem);
-                // remove from clean list
-                e = list_remove(&fname_item->shards[i].cleanlist, e);
-                // remove from hash table
-                hash_remove(&fname_item->shards[i].hashtable, &item->hash_elem);
-                // insert into free list
-                _bcache_release_freeblock(item);
+            struct bcache_shard *bshard = &fname_item->shards[i];
+            struct list *lists[] = {&bshard->cleanlist, &bshard->a1list};
+            spin_lock(&bshard->lock);
+            for (size_t j = 0; j < sizeof(lists) / sizeof(lists[0]); ++j) {
+                e = list_begin(lists[j]);
+                while(e){
+                    item = _get_entry(e, struct bcache_item, list_elem);
+                    // remove from clean list
+                    e = list_remove(lists[j], e);
+                    // remove from shard index
+                    _bcache_table_remove(bshard, item);
+                    // insert into free list, once no reader pins it
+                    _bcache_drop_item(item);
+                }
             }
-            spin_unlock(&fname_item->shards[i].lock);
+            bshard->nclean = bshard->na1 = 0;
+            spin_unlock(&bshard->lock);
         }
     }
 }
@@ -1406,23 +2334,21 @@ fdb_status bcache_flush(struct filemgr *file)
     fname_item = file->bcache;
 
     if (fname_item) {
+        LATENCY_STAT_START();
         // Note that this function is invoked as part of a commit operation while
         // the filemgr's lock is already grabbed by a committer.
         // Therefore, we don't need to grab all the shard locks at once.
         status = _flush_dirty_blocks(fname_item, true, true, false);
+        LATENCY_STAT_END(file, FDB_LATENCY_BCACHE_FLUSH);
     }
     return status;
 }
 
 void bcache_init(int nblock, int blocksize, const bcache_config& bconfig)
 {
-    int i;
-    struct bcache_item *item;
-    uint8_t *block_ptr;
     struct timeval begin, end;
     gettimeofday(&begin, NULL);
 
-    list_init(&freelist);
     list_init(&file_zombies);
 
     hash_init(&fnamedic, BCACHE_NDICBUCKET, _fname_hash, _fname_cmp);
@@ -1431,8 +2357,15 @@ void bcache_init(int nblock, int blocksize, const bcache_config& bconfig)
     bcache_flush_unit = BCACHE_FLUSH_UNIT;
     bcache_nblock = nblock;
     bcache_global_config = bconfig;
+    if (bconfig.policy == FDB_BCACHE_POLICY_2Q) {
+        bcache_policy = &bcache_2q_ops;
+    } else {
+        bcache_policy = &bcache_lru_ops;
+    }
+    atomic_store_uint64_t(&bcache_nhits, 0);
+    atomic_store_uint64_t(&bcache_nmisses, 0);
+    atomic_store_uint64_t(&bcache_nevictions, 0);
     spin_init(&bcache_lock);
-    spin_init(&freelist_lock);
 
     int rv = init_rw_lock(&filelist_lock);
     if (rv != 0) {
@@ -1447,32 +2380,23 @@ void bcache_init(int nblock, int blocksize, const bcache_config& bconfig)
     file_array_capacity = 65536; // Initial capacity of file list array.
     file_list = (fnamedic_item **) calloc(file_array_capacity, sizeof(fnamedic_item *));
     // Allocate entire buffer cache memory
-    block_ptr = (uint8_t *)calloc(nblock, (uint64_t)bcache_blocksize);
-    buffercache_addr = block_ptr;
-
-    for (i=0;i<nblock;++i){
-        item = (struct bcache_item *)malloc(sizeof(struct bcache_item));
-
-        item->bid = BLK_NOT_FOUND;
-        item->flag = 0x0 | BCACHE_FREE;
-        item->score = 0;
-        item->addr = block_ptr;
-        block_ptr += bcache_blocksize;
-
-        list_push_front(&freelist, &item->list_elem);
-        freelist_count++;
-    }
+    _bcache_arena_init(nblock);
 
     gettimeofday(&end, NULL);
     long elapsed = (end.tv_sec - begin.tv_sec) * 1000000 + (end.tv_usec - begin.tv_usec);
     fdb_log(NULL, FDB_LOG_INFO, FDB_RESULT_SUCCESS,
             "Forestdb blockcache size %" _F64
-            " cache %s, num buckets per file %zu, initialized in %ld us\n",
+            " cache %s, policy %s, initial index slots per shard %d, "
+            "NUMA nodes %d, per-CPU free block cache %s, "
+            "initialized in %ld us\n",
             (uint64_t)bcache_blocksize * nblock,
             ( bcache_global_config.do_not_cache_doc_blocks
               ? "DO NOT CACHE DOC BLOCKS"
               : "SECOND CHANCE" ),
-            BCACHE_NBUCKET,
+            ( bcache_policy == &bcache_2q_ops ? "2Q" : "LRU" ),
+            BCACHE_TABLE_MIN_SLOTS,
+            (int)num_nodes,
+            ( cpu_cache_batch ? "ON" : "OFF" ),
             elapsed);
 }
 
@@ -1481,6 +2405,16 @@ uint64_t bcache_get_num_free_blocks()
     return freelist_count;
 }
 
+void bcache_get_stats(fdb_buffer_cache_stats *stats)
+{
+    stats->num_hits = atomic_get_uint64_t(&bcache_nhits,
+                                          std::memory_order_relaxed);
+    stats->num_misses = atomic_get_uint64_t(&bcache_nmisses,
+                                            std::memory_order_relaxed);
+    stats->num_evictions = atomic_get_uint64_t(&bcache_nevictions,
+                                               std::memory_order_relaxed);
+}
+
 uint64_t bcache_get_num_blocks(struct filemgr *file)
 {
     struct fnamedic_item *fname = file->bcache;
@@ -1548,6 +2482,11 @@ void bcache_print_items()
         for (; i < fname->num_shards; ++i) {
             spin_lock(&fname->shards[i].lock);
             ee = list_begin(&fname->shards[i].cleanlist);
+            bool a1_visited = false;
+            if (!ee) {
+                ee = list_begin(&fname->shards[i].a1list);
+                a1_visited = true;
+            }
             a = avl_first(&fname->shards[i].tree);
 
             while(ee){
@@ -1569,6 +2508,11 @@ void bcache_print_items()
                 }
 #endif
                 ee = list_next(ee);
+                if (!ee && !a1_visited) {
+                    // 2Q policy: continue to 'A1in' list
+                    ee = list_begin(&fname->shards[i].a1list);
+                    a1_visited = true;
+                }
             }
             while(a){
                 dirty = _get_entry(a, struct dirty_item, avl);
@@ -1638,10 +2582,18 @@ void bcache_print_items()
 // LCOV_EXCL_STOP
 
 // LCOV_EXCL_START
-INLINE void _bcache_free_bcache_item(struct hash_elem *h)
+INLINE void _bcache_free_bcache_items(struct bcache_shard *bshard)
 {
-    struct bcache_item *item = _get_entry(h, struct bcache_item, hash_elem);
-    free(item);
+    struct bcache_table *table = bshard->table.load(std::memory_order_relaxed);
+    struct bcache_item *item;
+
+    for (size_t i = 0; i < table->nslots; ++i) {
+        item = table->slots[i].item.load(std::memory_order_relaxed);
+        if (item) {
+            free(item);
+        }
+    }
+    _bcache_table_free(bshard);
 }
 // LCOV_EXCL_STOP
 
@@ -1653,7 +2605,8 @@ INLINE void _bcache_free_fnamedic(struct hash_elem *h)
     item = _get_entry(h, struct fnamedic_item, hash_elem);
 
     for (; i < item->num_shards; ++i) {
-        hash_free_active(&item->shards[i].hashtable, _bcache_free_bcache_item);
+        _bcache_free_bcache_items(&item->shards[i]);
+        _bcache_free_ghosts(&item->shards[i]);
         spin_destroy(&item->shards[i].lock);
     }
 
@@ -1666,19 +2619,8 @@ INLINE void _bcache_free_fnamedic(struct hash_elem *h)
 
 void bcache_shutdown()
 {
-    struct bcache_item *item;
     struct list_elem *e;
 
-    spin_lock(&freelist_lock);
-    e = list_begin(&freelist);
-    while(e) {
-        item = _get_entry(e, struct bcache_item, list_elem);
-        e = list_remove(&freelist, e);
-        freelist_count--;
-        free(item);
-    }
-    spin_unlock(&freelist_lock);
-
     writer_lock(&filelist_lock);
     // Force clean zombies if any
     e = list_begin(&file_zombies);
@@ -1691,15 +2633,14 @@ void bcache_shutdown()
     free(file_list);
     writer_unlock(&filelist_lock);
 
-    // Free entire buffercache memory
-    free(buffercache_addr);
-
     spin_lock(&bcache_lock);
     hash_free_active(&fnamedic, _bcache_free_fnamedic);
     spin_unlock(&bcache_lock);
 
+    // Free entire buffercache memory
+    _bcache_arena_free();
+
     spin_destroy(&bcache_lock);
-    spin_destroy(&freelist_lock);
 
     int rv = destroy_rw_lock(&filelist_lock);
     if (rv != 0) {
@@ -24,18 +24,30 @@
 extern "C" {
 #endif
 
+struct bcache_item;
+
 typedef enum {
     BCACHE_REQ_CLEAN,
     BCACHE_REQ_DIRTY
 } bcache_dirty_t;
 
 struct bcache_config {
-    bcache_config() : do_not_cache_doc_blocks(false) {}
+    bcache_config() : do_not_cache_doc_blocks(false)
+                    , policy(FDB_BCACHE_POLICY_LRU) {}
     bool do_not_cache_doc_blocks;
+    fdb_bcache_policy_t policy;
 };
 
 void bcache_init(int nblock, int blocksize, const bcache_config& bconfig);
 int bcache_read(struct filemgr *file, bid_t bid, void *buf);
+/**
+ * Pin a cached block and return the address of its contents, or NULL
+ * on a cache miss. The returned memory is owned by the block cache and must
+ * be treated as read-only; the block is never evicted until the handle
+ * returned through 'pinned' is released by bcache_unpin().
+ */
+void *bcache_pin(struct filemgr *file, bid_t bid, struct bcache_item **pinned);
+void bcache_unpin(struct bcache_item *pinned);
 bool bcache_invalidate_block(struct filemgr *file, bid_t bid);
 int bcache_write(struct filemgr *file, bid_t bid, void *buf,
                  bcache_dirty_t dirty, bool final_write, bool ignore_if_exist);
@@ -50,6 +62,7 @@ uint64_t bcache_get_num_immutable(struct filemgr *file);
 fdb_status bcache_flush_immutable(struct filemgr *file);
 void bcache_shutdown();
 uint64_t bcache_get_num_free_blocks();
+void bcache_get_stats(fdb_buffer_cache_stats *stats);
 void bcache_print_items();
 
 #ifdef __cplusplus
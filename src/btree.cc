@@ -9,6 +9,7 @@
 #include <string.h>
 
 #include "btree.h"
+#include "btree_kv.h"
 #include "common.h"
 
 #include "forestdb_endian.h"
@@ -415,6 +416,151 @@ btree_result btree_init(
     return BTREE_RESULT_SUCCESS;
 }
 
+/*
+Accesses to the key-value pairs of nodes, with which the routines below are
+instantiated. btree_kv_any calls the functions of btree->kv_ops so that it
+works with any layout, while btree_kv_fixed is specialized at compile time
+for fixed-size keys and 8-byte values, so that the pairs are accessed and
+compared in place without indirect calls.
+*/
+struct btree_kv_any {
+    static INLINE void get_kv(struct btree *btree, struct bnode *node,
+                              idx_t idx, void *key, void *value) {
+        btree->kv_ops->get_kv(node, idx, key, value);
+    }
+    static INLINE void set_kv(struct btree *btree, struct bnode *node,
+                              idx_t idx, void *key, void *value) {
+        btree->kv_ops->set_kv(node, idx, key, value);
+    }
+    static INLINE void ins_kv(struct btree *btree, struct bnode *node,
+                              idx_t idx, void *key, void *value) {
+        btree->kv_ops->ins_kv(node, idx, key, value);
+    }
+    static INLINE void set_value(struct btree *btree, void *dst, void *src) {
+        btree->kv_ops->set_value(btree, dst, src);
+    }
+    static INLINE bid_t value2bid(struct btree *btree, void *value) {
+        return btree->kv_ops->value2bid(value);
+    }
+    static INLINE int cmp(struct btree *btree, void *key1, void *key2) {
+        return btree->kv_ops->cmp(key1, key2, btree->aux);
+    }
+    static INLINE void init_kv_var(struct btree *btree, void *key, void *value) {
+        if (btree->kv_ops->init_kv_var) {
+            btree->kv_ops->init_kv_var(btree, key, value);
+        }
+    }
+    static INLINE void free_kv_var(struct btree *btree, void *key, void *value) {
+        if (btree->kv_ops->free_kv_var) {
+            btree->kv_ops->free_kv_var(btree, key, value);
+        }
+    }
+};
+
+// KSIZE-byte keys in binary (memcmp) order if BINARY is set, or in native
+// unsigned integer order otherwise, and 8-byte values.
+template <size_t KSIZE, bool BINARY>
+struct btree_kv_fixed {
+    static const size_t VSIZE = 8;
+
+    static INLINE uint8_t * ptr(struct bnode *node, idx_t idx) {
+        return (uint8_t *)node->data + idx * (KSIZE + VSIZE);
+    }
+    static INLINE void get_kv(struct btree *btree, struct bnode *node,
+                              idx_t idx, void *key, void *value) {
+        memcpy(key, ptr(node, idx), KSIZE);
+        if (value) {
+            memcpy(value, ptr(node, idx) + KSIZE, VSIZE);
+        }
+    }
+    static INLINE void set_kv(struct btree *btree, struct bnode *node,
+                              idx_t idx, void *key, void *value) {
+        memcpy(ptr(node, idx), key, KSIZE);
+        memcpy(ptr(node, idx) + KSIZE, value, VSIZE);
+    }
+    static INLINE void ins_kv(struct btree *btree, struct bnode *node,
+                              idx_t idx, void *key, void *value) {
+        if (key && value) {
+            // insert
+            memmove(ptr(node, idx + 1), ptr(node, idx),
+                    (node->nentry - idx) * (KSIZE + VSIZE));
+            set_kv(btree, node, idx, key, value);
+        } else {
+            // remove
+            memmove(ptr(node, idx), ptr(node, idx + 1),
+                    (node->nentry - (idx + 1)) * (KSIZE + VSIZE));
+        }
+    }
+    static INLINE void set_value(struct btree *btree, void *dst, void *src) {
+        memcpy(dst, src, VSIZE);
+    }
+    static INLINE bid_t value2bid(struct btree *btree, void *value) {
+        return deref64(value);
+    }
+    static INLINE uint64_t key2int(void *key) {
+        if (KSIZE == 8) {
+            uint64_t k = deref64(key);
+#if defined(_LITTLE_ENDIAN)
+            if (BINARY) k = bitswap64(k);
+#endif
+            return k;
+        } else {
+            uint32_t k = deref32(key);
+#if defined(_LITTLE_ENDIAN)
+            if (BINARY) k = bitswap32(k);
+#endif
+            return k;
+        }
+    }
+    static INLINE int cmp(struct btree *btree, void *key1, void *key2) {
+        uint64_t a = key2int(key1), b = key2int(key2);
+        return (a > b) - (a < b);
+    }
+    static INLINE void init_kv_var(struct btree *btree, void *key, void *value) {
+        // nothing to initialize
+    }
+    static INLINE void free_kv_var(struct btree *btree, void *key, void *value) {
+        // nothing to free
+    }
+};
+
+typedef btree_kv_fixed<8, true> btree_kv_kb64_vb64;
+typedef btree_kv_fixed<8, false> btree_kv_ku64_vb64;
+typedef btree_kv_fixed<4, true> btree_kv_kb32_vb64;
+
+// Returns the layout of the key-value pairs of BTREE. The layout set in
+// btree->kv_ops is used only if the key and value sizes match it.
+INLINE btree_kv_layout_t _btree_kv_layout(struct btree *btree)
+{
+    switch (btree->kv_ops->layout) {
+    case BTREE_KV_LAYOUT_KB64_VB64:
+    case BTREE_KV_LAYOUT_KU64_VB64:
+        if (btree->ksize == 8 && btree->vsize == 8) {
+            return btree->kv_ops->layout;
+        }
+        break;
+    case BTREE_KV_LAYOUT_KB32_VB64:
+        if (btree->ksize == 4 && btree->vsize == 8) {
+            return btree->kv_ops->layout;
+        }
+        break;
+    }
+    return BTREE_KV_LAYOUT_ANY;
+}
+
+// Returns FUNC instantiated for the key-value layout of BTREE.
+#define _BTREE_KV_DISPATCH(btree, func, ...)                        \
+    switch (_btree_kv_layout(btree)) {                              \
+    case BTREE_KV_LAYOUT_KB64_VB64:                                 \
+        return func<btree_kv_kb64_vb64>(__VA_ARGS__);               \
+    case BTREE_KV_LAYOUT_KU64_VB64:                                 \
+        return func<btree_kv_ku64_vb64>(__VA_ARGS__);               \
+    case BTREE_KV_LAYOUT_KB32_VB64:                                 \
+        return func<btree_kv_kb32_vb64>(__VA_ARGS__);               \
+    default:                                                        \
+        return func<btree_kv_any>(__VA_ARGS__);                     \
+    }
+
 /*
 return index# of largest key equal or smaller than KEY
 example)
@@ -423,7 +569,8 @@ key: 5
 largest key equal or smaller than KEY: 4
 return: 1 (index# of the key '4')
 */
-static idx_t _btree_find_entry(struct btree *btree, struct bnode *node, void *key)
+template <typename KV>
+static idx_t _btree_find_entry_kv(struct btree *btree, struct bnode *node, void *key)
 {
     idx_t start, end, middle, temp;
     uint8_t *k = alca(uint8_t, btree->ksize);
@@ -433,25 +580,25 @@ static idx_t _btree_find_entry(struct btree *btree, struct bnode *node, void *ke
         idx_t *_map2[3] = {&temp, &end, &temp};
     #endif
 
-    if (btree->kv_ops->init_kv_var) btree->kv_ops->init_kv_var(btree, k, NULL);
+    KV::init_kv_var(btree, k, NULL);
 
     start = middle = 0;
     end = node->nentry;
 
     if (end > 0) {
         // compare with smallest key
-        btree->kv_ops->get_kv(node, 0, k, NULL);
+        KV::get_kv(btree, node, 0, k, NULL);
         // smaller than smallest key
-        if (btree->kv_ops->cmp(key, k, btree->aux) < 0) {
-            if (btree->kv_ops->free_kv_var) btree->kv_ops->free_kv_var(btree, k, NULL);
+        if (KV::cmp(btree, key, k) < 0) {
+            KV::free_kv_var(btree, k, NULL);
             return BTREE_IDX_NOT_FOUND;
         }
 
         // compare with largest key
-        btree->kv_ops->get_kv(node, end-1, k, NULL);
+        KV::get_kv(btree, node, end-1, k, NULL);
         // larger than largest key
-        if (btree->kv_ops->cmp(key, k, btree->aux) >= 0) {
-            if (btree->kv_ops->free_kv_var) btree->kv_ops->free_kv_var(btree, k, NULL);
+        if (KV::cmp(btree, key, k) >= 0) {
+            KV::free_kv_var(btree, k, NULL);
             return end-1;
         }
 
@@ -460,8 +607,8 @@ static idx_t _btree_find_entry(struct btree *btree, struct bnode *node, void *ke
             middle = (start + end) >> 1;
 
             // get key at middle
-            btree->kv_ops->get_kv(node, middle, k, NULL);
-            cmp = btree->kv_ops->cmp(key, k, btree->aux);
+            KV::get_kv(btree, node, middle, k, NULL);
+            cmp = KV::cmp(btree, key, k);
 
             #ifdef __BIT_CMP
                 cmp = _MAP(cmp) + 1;
@@ -471,36 +618,58 @@ static idx_t _btree_find_entry(struct btree *btree, struct bnode *node, void *ke
                 if (cmp < 0) end = middle;
                 else if (cmp > 0) start = middle;
                 else {
-                    if (btree->kv_ops->free_kv_var) btree->kv_ops->free_kv_var(btree, k, NULL);
+                    KV::free_kv_var(btree, k, NULL);
                     return middle;
                 }
             #endif
         }
-        if (btree->kv_ops->free_kv_var) btree->kv_ops->free_kv_var(btree, k, NULL);
+        KV::free_kv_var(btree, k, NULL);
         return start;
     }
 
-    if (btree->kv_ops->free_kv_var) btree->kv_ops->free_kv_var(btree, k, NULL);
+    KV::free_kv_var(btree, k, NULL);
     return BTREE_IDX_NOT_FOUND;
 }
 
-static idx_t _btree_add_entry(struct btree *btree, struct bnode *node, void *key, void *value)
+// 8-byte keys are searched by btree_kv.cc, which compares several keys at once
+// with SIMD instructions if they are available.
+template <>
+idx_t _btree_find_entry_kv<btree_kv_kb64_vb64>(struct btree *btree,
+                                               struct bnode *node, void *key)
+{
+    return btree_kv_find_entry_kb64(node, key);
+}
+
+template <>
+idx_t _btree_find_entry_kv<btree_kv_ku64_vb64>(struct btree *btree,
+                                               struct bnode *node, void *key)
+{
+    return btree_kv_find_entry_ku64(node, key);
+}
+
+static idx_t _btree_find_entry(struct btree *btree, struct bnode *node, void *key)
+{
+    _BTREE_KV_DISPATCH(btree, _btree_find_entry_kv, btree, node, key);
+}
+
+template <typename KV>
+static idx_t _btree_add_entry_kv(struct btree *btree, struct bnode *node, void *key, void *value)
 {
     idx_t idx, idx_insert;
     uint8_t *k = alca(uint8_t, btree->ksize);
 
-    if (btree->kv_ops->init_kv_var) btree->kv_ops->init_kv_var(btree, k, NULL);
+    KV::init_kv_var(btree, k, NULL);
 
     if (node->nentry > 0) {
-        idx = _btree_find_entry(btree, node, key);
+        idx = _btree_find_entry_kv<KV>(btree, node, key);
 
         if (idx == BTREE_IDX_NOT_FOUND) idx_insert = 0;
         else {
-            btree->kv_ops->get_kv(node, idx, k, NULL);
-            if (!btree->kv_ops->cmp(key, k, btree->aux)) {
+            KV::get_kv(btree, node, idx, k, NULL);
+            if (!KV::cmp(btree, key, k)) {
                 // if same key already exists -> update its value
-                btree->kv_ops->set_kv(node, idx, key, value);
-                if (btree->kv_ops->free_kv_var) btree->kv_ops->free_kv_var(btree, k, NULL);
+                KV::set_kv(btree, node, idx, key, value);
+                KV::free_kv_var(btree, k, NULL);
                 return idx;
             }else{
                 idx_insert = idx+1;
@@ -516,30 +685,36 @@ static idx_t _btree_add_entry(struct btree *btree, struct bnode *node, void *key
             [2 4 6 8] -> [2 4 _ 6 8]
             return 2
             */
-            btree->kv_ops->ins_kv(node, idx_insert, key, value);
+            KV::ins_kv(btree, node, idx_insert, key, value);
         }else{
-            btree->kv_ops->set_kv(node, idx_insert, key, value);
+            KV::set_kv(btree, node, idx_insert, key, value);
         }
 
     }else{
         idx_insert = 0;
         // add at idx_insert
-        btree->kv_ops->set_kv(node, idx_insert, key, value);
+        KV::set_kv(btree, node, idx_insert, key, value);
     }
 
     // add at idx_insert
     node->nentry++;
 
-    if (btree->kv_ops->free_kv_var) btree->kv_ops->free_kv_var(btree, k, NULL);
+    KV::free_kv_var(btree, k, NULL);
     return idx_insert;
 }
 
-static idx_t _btree_remove_entry(struct btree *btree, struct bnode *node, void *key)
+static idx_t _btree_add_entry(struct btree *btree, struct bnode *node, void *key, void *value)
+{
+    _BTREE_KV_DISPATCH(btree, _btree_add_entry_kv, btree, node, key, value);
+}
+
+template <typename KV>
+static idx_t _btree_remove_entry_kv(struct btree *btree, struct bnode *node, void *key)
 {
     idx_t idx;
 
     if (node->nentry > 0) {
-        idx = _btree_find_entry(btree, node, key);
+        idx = _btree_find_entry_kv<KV>(btree, node, key);
 
         if (idx == BTREE_IDX_NOT_FOUND) return idx;
 
@@ -550,7 +725,7 @@ static idx_t _btree_remove_entry(struct btree *btree, struct bnode *node, void *
         [2 4 6 8 10] -> [2 4 8 10]
         return 2
         */
-        btree->kv_ops->ins_kv(node, idx, NULL, NULL);
+        KV::ins_kv(btree, node, idx, NULL, NULL);
 
         node->nentry--;
 
@@ -561,6 +736,11 @@ static idx_t _btree_remove_entry(struct btree *btree, struct bnode *node, void *
     }
 }
 
+static idx_t _btree_remove_entry(struct btree *btree, struct bnode *node, void *key)
+{
+    _BTREE_KV_DISPATCH(btree, _btree_remove_entry_kv, btree, node, key);
+}
+
 static void _btree_print_node(struct btree *btree, int depth,
                               bid_t bid, btree_print_func func)
 {
@@ -667,7 +847,8 @@ btree_result btree_get_key_range(
     return BTREE_RESULT_SUCCESS;
 }
 
-btree_result btree_find(struct btree *btree, void *key, void *value_buf)
+template <typename KV>
+static btree_result _btree_find_kv(struct btree *btree, void *key, void *value_buf)
 {
     void *addr;
     uint8_t *k = alca(uint8_t, btree->ksize);
@@ -677,7 +858,7 @@ btree_result btree_find(struct btree *btree, void *key, void *value_buf)
     struct bnode **node = alca(struct bnode *, btree->height);
     int i;
 
-    if (btree->kv_ops->init_kv_var) btree->kv_ops->init_kv_var(btree, k, v);
+    KV::init_kv_var(btree, k, v);
 
     // set root
     bid[btree->height-1] = btree->root_bid;
@@ -689,34 +870,32 @@ btree_result btree_find(struct btree *btree, void *key, void *value_buf)
         node[i] = _fetch_bnode(btree, addr, i+1);
 
         // lookup key in current node
-        idx[i] = _btree_find_entry(btree, node[i], key);
+        idx[i] = _btree_find_entry_kv<KV>(btree, node[i], key);
 
         if (idx[i] == BTREE_IDX_NOT_FOUND) {
             // not found .. return NULL
             if (btree->blk_ops->blk_operation_end)
                 btree->blk_ops->blk_operation_end(btree->blk_handle);
-            if (btree->kv_ops->free_kv_var) btree->kv_ops->free_kv_var(btree, k, v);
+            KV::free_kv_var(btree, k, v);
             return BTREE_RESULT_FAIL;
         }
 
-        btree->kv_ops->get_kv(node[i], idx[i], k, v);
+        KV::get_kv(btree, node[i], idx[i], k, v);
 
         if (i>0) {
             // index (non-leaf) node
             // get bid of child node from value
-            bid[i-1] = btree->kv_ops->value2bid(v);
+            bid[i-1] = KV::value2bid(btree, v);
             bid[i-1] = _endian_decode(bid[i-1]);
         }else{
             // leaf node
             // return (address of) value if KEY == k
-            if (!btree->kv_ops->cmp(key, k, btree->aux)) {
-                btree->kv_ops->set_value(btree, value_buf, v);
+            if (!KV::cmp(btree, key, k)) {
+                KV::set_value(btree, value_buf, v);
             }else{
                 if (btree->blk_ops->blk_operation_end)
                     btree->blk_ops->blk_operation_end(btree->blk_handle);
-                if (btree->kv_ops->free_kv_var) {
-                    btree->kv_ops->free_kv_var(btree, k, v);
-                }
+                KV::free_kv_var(btree, k, v);
                 return BTREE_RESULT_FAIL;
             }
         }
@@ -724,10 +903,15 @@ btree_result btree_find(struct btree *btree, void *key, void *value_buf)
     if (btree->blk_ops->blk_operation_end) {
         btree->blk_ops->blk_operation_end(btree->blk_handle);
     }
-    if (btree->kv_ops->free_kv_var) btree->kv_ops->free_kv_var(btree, k, v);
+    KV::free_kv_var(btree, k, v);
     return BTREE_RESULT_SUCCESS;
 }
 
+btree_result btree_find(struct btree *btree, void *key, void *value_buf)
+{
+    _BTREE_KV_DISPATCH(btree, _btree_find_kv, btree, key, value_buf);
+}
+
 static int _btree_split_node(
     struct btree *btree, void *key, struct bnode **node, bid_t *bid, idx_t *idx, int i,
     struct list *kv_ins_list, size_t nsplitnode, void *k, void *v,
@@ -1131,6 +1315,104 @@ btree_result btree_insert(struct btree *btree, void *key, void *value)
     }
 }
 
+btree_result btree_insert_batch(struct btree *btree, void **keys,
+                                void **values, size_t n)
+{
+    void *addr;
+    uint8_t *k = alca(uint8_t, btree->ksize);
+    uint8_t *v = alca(uint8_t, btree->vsize);
+    // smallest key of the next leaf node (upper bound of the current leaf)
+    uint8_t *bound = alca(uint8_t, btree->ksize);
+    struct bnode *node = NULL;
+    bid_t bid;
+    idx_t idx;
+    size_t pos = 0, nodesize;
+    int i, has_bound, out_of_leaf;
+    btree_result br, ret = BTREE_RESULT_SUCCESS;
+
+    if (btree->kv_ops->init_kv_var) {
+        btree->kv_ops->init_kv_var(btree, k, v);
+        btree->kv_ops->init_kv_var(btree, bound, NULL);
+    }
+
+    while (pos < n && ret == BTREE_RESULT_SUCCESS) {
+        // find the leaf node of the first key in this run
+        bid = btree->root_bid;
+        has_bound = 0;
+        for (i=btree->height-1; i>=0; --i) {
+            addr = btree->blk_ops->blk_read(btree->blk_handle, bid);
+            node = _fetch_bnode(btree, addr, i+1);
+            if (i == 0) {
+                break;
+            }
+
+            idx = _btree_find_entry(btree, node, keys[pos]);
+            if (idx == BTREE_IDX_NOT_FOUND) {
+                idx = 0;
+            }
+            if (idx + 1 < node->nentry) {
+                // separators get tighter as we go down
+                btree->kv_ops->get_kv(node, idx + 1, bound, NULL);
+                has_bound = 1;
+            }
+            btree->kv_ops->get_kv(node, idx, k, v);
+            bid = btree->kv_ops->value2bid(v);
+            bid = _endian_decode(bid);
+        }
+
+        nodesize = btree->blk_ops->blk_get_size(btree->blk_handle, bid);
+#ifdef __CRC32
+        nodesize -= BLK_MARKER_SIZE;
+#endif
+
+        // add the keys that belong to this leaf in place
+        out_of_leaf = 0;
+        while (pos < n) {
+            if (has_bound &&
+                btree->kv_ops->cmp(keys[pos], bound, btree->aux) >= 0) {
+                out_of_leaf = 1;
+                break;
+            }
+            if (node->nentry == 0 ||
+                !btree->blk_ops->blk_is_writable(btree->blk_handle, bid)) {
+                break;
+            }
+            // a new smallest key should be propagated to the index nodes
+            btree->kv_ops->get_kv(node, 0, k, NULL);
+            if (btree->kv_ops->cmp(keys[pos], k, btree->aux) < 0) {
+                break;
+            }
+            if ((size_t)_bnode_size(btree, node, NULL, keys[pos],
+                                    values[pos], 1) > nodesize) {
+                break;
+            }
+            _btree_add_entry(btree, node, keys[pos], values[pos]);
+            btree->blk_ops->blk_set_dirty(btree->blk_handle, bid);
+            ++pos;
+        }
+
+        if (pos < n && !out_of_leaf) {
+            // the leaf needs to be split, moved, or its key range changed
+            br = btree_insert(btree, keys[pos], values[pos]);
+            if (br == BTREE_RESULT_FAIL) {
+                // stop at the first failure and leave the rest
+                ret = br;
+            }
+            ++pos;
+        }
+    }
+
+    if (btree->blk_ops->blk_operation_end) {
+        btree->blk_ops->blk_operation_end(btree->blk_handle);
+    }
+    if (btree->kv_ops->free_kv_var) {
+        btree->kv_ops->free_kv_var(btree, k, v);
+        btree->kv_ops->free_kv_var(btree, bound, NULL);
+    }
+
+    return ret;
+}
+
 btree_result btree_remove(struct btree *btree, void *key)
 {
     void *addr;
@@ -1276,6 +1558,11 @@ btree_result btree_remove(struct btree *btree, void *key)
                     }
                     new_rootsize += btree->kv_ops->get_data_size(child, NULL, NULL, NULL, 0);
                     new_rootsize += sizeof(struct bnode);
+                    if (child->flag & BNODE_MASK_PREFIX) {
+                        // the offset array is aligned again after the
+                        // metadata of the new root
+                        new_rootsize += BNODE_PREFIX_ALIGN_SIZE;
+                    }
 
                     if (new_rootsize < nodesize) {
                         // new root node has enough space for metadata .. shrink height
@@ -58,6 +58,11 @@ struct bnode{
 #define BNODE_MASK_ROOT 0x1
 #define BNODE_MASK_METADATA 0x2
 #define BNODE_MASK_SEQTREE 0x4
+// the keys are stored without their common prefix (see btree_fast_str_kv.cc)
+#define BNODE_MASK_PREFIX 0x8
+// the offset array of a node in the prefix-compressed format is aligned to
+// this size, relative to the start of the node block
+#define BNODE_PREFIX_ALIGN_SIZE (64)
 
 typedef uint16_t metasize_t;
 struct btree_meta{
@@ -107,6 +112,21 @@ typedef struct {
     uint8_t chunksize;
 } btree_cmp_args ;
 
+/**
+ * Key-value layouts of B+tree nodes.
+ */
+typedef uint8_t btree_kv_layout_t;
+enum {
+    // any layout; every access goes through btree_kv_ops
+    BTREE_KV_LAYOUT_ANY = 0,
+    // 8-byte keys in binary (memcmp) order, 8-byte values
+    BTREE_KV_LAYOUT_KB64_VB64 = 1,
+    // 8-byte keys in native unsigned integer order, 8-byte values
+    BTREE_KV_LAYOUT_KU64_VB64 = 2,
+    // 4-byte keys in binary (memcmp) order, 8-byte values
+    BTREE_KV_LAYOUT_KB32_VB64 = 3
+};
+
 struct btree_kv_ops {
     void (*get_kv)(struct bnode *node, idx_t idx, void *key, void *value);
     void (*set_kv)(struct bnode *node, idx_t idx, void *key, void *value);
@@ -131,6 +151,12 @@ struct btree_kv_ops {
     btree_cmp_func *cmp;
     bid_t (*value2bid)(void *value);
     voidref (*bid2value)(bid_t *bid);
+
+    // layout of the key-value pairs, for which btree.cc uses code specialized
+    // at compile time instead of the functions above. It must agree with
+    // 'cmp', so it should be reset to BTREE_KV_LAYOUT_ANY whenever 'cmp'
+    // is replaced.
+    btree_kv_layout_t layout;
 };
 
 struct btree_iterator {
@@ -212,6 +238,17 @@ btree_result btree_get_key_range(
 
 btree_result btree_find(struct btree *btree, void *key, void *value_buf);
 btree_result btree_insert(struct btree *btree, void *key, void *value);
+/**
+ * Insert (or update) N key-value pairs whose keys are sorted in ascending
+ * order. The tree is descended once per run of keys that fall into the same
+ * leaf node, and the keys of a run are added to the leaf directly as long as
+ * the leaf is writable and has enough space. The other keys (e.g., ones that
+ * cause a node split or a copy-on-write) are inserted by btree_insert().
+ * If one of them fails, the remaining keys are not inserted and
+ * BTREE_RESULT_FAIL is returned.
+ */
+btree_result btree_insert_batch(struct btree *btree, void **keys,
+                                void **values, size_t n);
 btree_result btree_remove(struct btree *btree, void *key);
 btree_result btree_operation_end(struct btree *btree);
 
@@ -41,14 +41,312 @@ typedef uint16_t key_len_t;
 [key n][value n]
 
 Note that the maximum node size is limited to 2^(8*sizeof(key_len_t)) bytes
+
+=== node->data structure overview (prefix-compressed, BNODE_MASK_PREFIX) ===
+
+[length of the common prefix]: sizeof(key_len_t) bytes
+[offset of the offset array]: sizeof(key_len_t) bytes
+[common prefix of all keys in the node]
+[padding]
+[offset of key 1]: sizeof(key_len_t) bytes
+...
+[offset of key n+1]
+[key 1 without the common prefix][value 1]
+...
+[key n without the common prefix][value n]
+
+All offsets are relative to node->data, as in the format above. A node gets
+its format when its first entry is set, and keeps it until it becomes empty
+again, so that both formats can be read regardless of the kv_ops in use.
 */
 
+#define FAST_STR_PREFIX_HEADER_SIZE (sizeof(key_len_t) * 2)
+
+// a key-value pair to be written into a node, whose key is the
+// concatenation of HEAD and TAIL
+struct fast_str_entry {
+    uint8_t *head;
+    uint8_t *tail;
+    key_len_t hlen;
+    key_len_t tlen;
+    void *value;
+};
+
+INLINE key_len_t _get_prefix_len(struct bnode *node)
+{
+    key_len_t plen;
+
+    if (!(node->flag & BNODE_MASK_PREFIX)) {
+        return 0;
+    }
+    memcpy(&plen, node->data, sizeof(key_len_t));
+    return _endian_decode(plen);
+}
+
+INLINE uint8_t * _get_prefix(struct bnode *node)
+{
+    return (uint8_t*)node->data + FAST_STR_PREFIX_HEADER_SIZE;
+}
+
+INLINE key_len_t * _get_offset_arr(struct bnode *node)
+{
+    key_len_t arr_offset;
+
+    if (!(node->flag & BNODE_MASK_PREFIX)) {
+        return (key_len_t*)node->data;
+    }
+    memcpy(&arr_offset, (uint8_t*)node->data + sizeof(key_len_t),
+           sizeof(key_len_t));
+    return (key_len_t*)((uint8_t*)node->data + _endian_decode(arr_offset));
+}
+
+// return the offset of the offset array of NODE in the prefix-compressed
+// format with N entries and a common prefix of PLEN bytes
+INLINE size_t _get_prefix_arr_offset(struct bnode *node, key_len_t plen,
+                                     size_t n)
+{
+    size_t offset = FAST_STR_PREFIX_HEADER_SIZE + plen;
+    // node->data starts right after the node header and its metadata
+    size_t data_offset = (uint8_t*)node->data - (uint8_t*)node;
+
+    if ((n + 1) * sizeof(key_len_t) > BNODE_PREFIX_ALIGN_SIZE) {
+        // align the offset array to a cache line of the block
+        offset += data_offset;
+        offset = (offset + BNODE_PREFIX_ALIGN_SIZE - 1) &
+                 ~((size_t)BNODE_PREFIX_ALIGN_SIZE - 1);
+        offset -= data_offset;
+    } else {
+        offset = (offset + sizeof(key_len_t) - 1) & ~(sizeof(key_len_t) - 1);
+    }
+    return offset;
+}
+
+INLINE void _get_key_str(void *key, uint8_t **str, key_len_t *len)
+{
+    void *key_ptr;
+    key_len_t _keylen;
+
+    memcpy(&key_ptr, key, sizeof(void *));
+    memcpy(&_keylen, key_ptr, sizeof(key_len_t));
+    *len = _endian_decode(_keylen);
+    *str = (uint8_t*)key_ptr + sizeof(key_len_t);
+}
+
+INLINE uint8_t _entry_byte(struct fast_str_entry *entry, key_len_t i)
+{
+    return (i < entry->hlen) ? entry->head[i] : entry->tail[i - entry->hlen];
+}
+
+// copy the key of ENTRY, except for its first FROM bytes, into DST
+INLINE void _entry_copy_key(struct fast_str_entry *entry, key_len_t from,
+                            uint8_t *dst)
+{
+    if (from < entry->hlen) {
+        memcpy(dst, entry->head + from, entry->hlen - from);
+        dst += entry->hlen - from;
+        from = entry->hlen;
+    }
+    memcpy(dst, entry->tail + (from - entry->hlen),
+           entry->hlen + entry->tlen - from);
+}
+
+// return the length of the common prefix of the keys of ENTRIES
+static key_len_t _entry_common_prefix(struct fast_str_entry *entries, size_t n)
+{
+    size_t i;
+    key_len_t j, plen;
+
+    if (n == 0) {
+        return 0;
+    }
+    plen = entries[0].hlen + entries[0].tlen;
+    for (i=1; i<n && plen; ++i) {
+        key_len_t len = entries[i].hlen + entries[i].tlen;
+        if (len < plen) {
+            plen = len;
+        }
+        for (j=0; j<plen; ++j) {
+            if (_entry_byte(&entries[i], j) != _entry_byte(&entries[0], j)) {
+                break;
+            }
+        }
+        plen = j;
+    }
+    return plen;
+}
+
+// return the length of the common prefix of the node and STR
+INLINE key_len_t _get_common_prefix_len(struct bnode *node, key_len_t plen,
+                                        uint8_t *str, key_len_t len)
+{
+    uint8_t *prefix = _get_prefix(node);
+    key_len_t i;
+
+    if (len < plen) {
+        plen = len;
+    }
+    for (i=0; i<plen && prefix[i] == str[i]; ++i);
+    return i;
+}
+
+// read LEN key-value pairs from IDX in NODE, without copying them
+static void _read_entries(struct bnode *node, idx_t idx, idx_t len,
+                          struct fast_str_entry *entries)
+{
+    int ksize, vsize;
+    idx_t i;
+    key_len_t *_offset_arr = _get_offset_arr(node);
+    key_len_t offset, offset_next;
+    key_len_t plen = _get_prefix_len(node);
+
+    _get_kvsize(node->kvsize, ksize, vsize);
+    (void)ksize;
+
+    for (i=0; i<len; ++i) {
+        offset = _endian_decode(_offset_arr[idx+i]);
+        offset_next = _endian_decode(_offset_arr[idx+i+1]);
+        entries[i].head = _get_prefix(node);
+        entries[i].hlen = plen;
+        entries[i].tail = (uint8_t*)node->data + offset;
+        entries[i].tlen = offset_next - offset - vsize;
+        entries[i].value = (uint8_t*)node->data + offset_next - vsize;
+    }
+}
+
+INLINE size_t _get_prefix_data_size(struct bnode *node,
+                                    struct fast_str_entry *entries, size_t n,
+                                    key_len_t plen, int vsize)
+{
+    size_t i, size;
+
+    size = _get_prefix_arr_offset(node, plen, n) + sizeof(key_len_t) * (n+1);
+    for (i=0; i<n; ++i) {
+        size += entries[i].hlen + entries[i].tlen - plen + vsize;
+    }
+    return size;
+}
+
+// overwrite NODE with ENTRIES in the prefix-compressed format,
+// whose common prefix is PLEN bytes long
+static void _write_prefix_entries(struct bnode *node,
+                                  struct fast_str_entry *entries, idx_t n,
+                                  key_len_t plen, int vsize)
+{
+    uint8_t *buf;
+    size_t size, arr_offset;
+    key_len_t *_offset_arr, offset, _plen, _arr_offset;
+    idx_t i;
+
+    // ENTRIES may point to NODE itself
+    size = _get_prefix_data_size(node, entries, n, plen, vsize);
+    buf = (uint8_t*)malloc(size);
+
+    arr_offset = _get_prefix_arr_offset(node, plen, n);
+    _plen = _endian_encode(plen);
+    _arr_offset = _endian_encode((key_len_t)arr_offset);
+    memcpy(buf, &_plen, sizeof(key_len_t));
+    memcpy(buf + sizeof(key_len_t), &_arr_offset, sizeof(key_len_t));
+    if (n) {
+        if (entries[0].hlen) {
+            memcpy(buf + FAST_STR_PREFIX_HEADER_SIZE, entries[0].head,
+                   MIN(plen, entries[0].hlen));
+        }
+        if (plen > entries[0].hlen) {
+            memcpy(buf + FAST_STR_PREFIX_HEADER_SIZE + entries[0].hlen,
+                   entries[0].tail, plen - entries[0].hlen);
+        }
+    }
+    memset(buf + FAST_STR_PREFIX_HEADER_SIZE + plen, 0,
+           arr_offset - FAST_STR_PREFIX_HEADER_SIZE - plen);
+
+    _offset_arr = (key_len_t*)(buf + arr_offset);
+    offset = arr_offset + sizeof(key_len_t) * (n+1);
+    for (i=0; i<n; ++i) {
+        _offset_arr[i] = _endian_encode(offset);
+        _entry_copy_key(&entries[i], plen, buf + offset);
+        offset += entries[i].hlen + entries[i].tlen - plen;
+        memcpy(buf + offset, entries[i].value, vsize);
+        offset += vsize;
+    }
+    _offset_arr[n] = _endian_encode(offset);
+
+    memcpy(node->data, buf, size);
+    free(buf);
+    node->flag |= BNODE_MASK_PREFIX;
+}
+
+// shorten the common prefix of NODE to PLEN bytes
+static void _shrink_prefix(struct bnode *node, key_len_t plen)
+{
+    int ksize, vsize;
+    struct fast_str_entry *entries;
+
+    _get_kvsize(node->kvsize, ksize, vsize);
+    (void)ksize;
+
+    entries = (struct fast_str_entry *)
+              malloc(sizeof(struct fast_str_entry) * node->nentry);
+    _read_entries(node, 0, node->nentry, entries);
+    _write_prefix_entries(node, entries, node->nentry, plen, vsize);
+    free(entries);
+}
+
+// prepare NODE to store the key STR, and return the number of bytes of STR
+// that are not stored in the node, i.e. the length of the common prefix
+static key_len_t _fit_key(struct bnode *node, uint8_t *str, key_len_t len)
+{
+    key_len_t plen, common;
+
+    plen = _get_prefix_len(node);
+    if (plen) {
+        common = _get_common_prefix_len(node, plen, str, len);
+        if (common < plen) {
+            _shrink_prefix(node, common);
+            plen = common;
+        }
+    }
+    return plen;
+}
+
+// set the first key-value pair of an empty NODE in the given format
+static void _set_first_kv(struct bnode *node, void *key, void *value,
+                          bool prefix)
+{
+    int ksize, vsize;
+    struct fast_str_entry entry;
+    key_len_t *_offset_arr, offset;
+
+    _get_kvsize(node->kvsize, ksize, vsize);
+    (void)ksize;
+
+    entry.head = NULL;
+    entry.hlen = 0;
+    _get_key_str(key, &entry.tail, &entry.tlen);
+    entry.value = value;
+
+    if (prefix) {
+        // the only key is the common prefix
+        _write_prefix_entries(node, &entry, 1, entry.tlen, vsize);
+        return;
+    }
+
+    node->flag &= ~BNODE_MASK_PREFIX;
+    _offset_arr = (key_len_t*)node->data;
+    offset = sizeof(key_len_t) * 2;
+    _offset_arr[0] = _endian_encode(offset);
+    memcpy((uint8_t*)node->data + offset, entry.tail, entry.tlen);
+    offset += entry.tlen;
+    memcpy((uint8_t*)node->data + offset, value, vsize);
+    offset += vsize;
+    _offset_arr[1] = _endian_encode(offset);
+}
+
 static void _get_fast_str_kv(struct bnode *node, idx_t idx, void *key, void *value)
 {
     int ksize, vsize;
     void *key_ptr, *ptr;
     key_len_t *_offset_arr;
-    key_len_t keylen, _keylen;
+    key_len_t keylen, _keylen, plen;
     key_len_t offset;
 
     _get_kvsize(node->kvsize, ksize, vsize);
@@ -57,7 +355,8 @@ static void _get_fast_str_kv(struct bnode *node, idx_t idx, void *key, void *val
     ptr = node->data;
 
     // get offset array
-    _offset_arr = (key_len_t*)ptr;
+    _offset_arr = _get_offset_arr(node);
+    plen = _get_prefix_len(node);
 
     // get keylen & offset
     offset = _endian_decode(_offset_arr[idx]);
@@ -70,12 +369,15 @@ static void _get_fast_str_kv(struct bnode *node, idx_t idx, void *key, void *val
     }
 
     // allocate space for key
-    key_ptr = (void*)malloc(sizeof(key_len_t) + keylen);
+    key_ptr = (void*)malloc(sizeof(key_len_t) + plen + keylen);
 
     // copy key
-    _keylen = _endian_encode(keylen);
+    _keylen = _endian_encode((key_len_t)(plen + keylen));
     memcpy(key_ptr, &_keylen, sizeof(key_len_t));
-    memcpy((uint8_t*)key_ptr + sizeof(key_len_t),
+    if (plen) {
+        memcpy((uint8_t*)key_ptr + sizeof(key_len_t), _get_prefix(node), plen);
+    }
+    memcpy((uint8_t*)key_ptr + sizeof(key_len_t) + plen,
            (uint8_t*)ptr + offset, keylen);
     // copy key pointer
     memcpy(key, &key_ptr, ksize);
@@ -85,27 +387,34 @@ static void _get_fast_str_kv(struct bnode *node, idx_t idx, void *key, void *val
     }
 }
 
-static void _set_fast_str_kv(struct bnode *node, idx_t idx, void *key, void *value)
+static void _set_kv(struct bnode *node, idx_t idx, void *key, void *value,
+                    bool prefix)
 {
     int ksize, vsize, i;
-    void *key_ptr, *ptr;
+    void *ptr;
+    uint8_t *str;
     key_len_t *_offset_arr, offset;
-    key_len_t keylen_ins, keylen_idx;
-    key_len_t _keylen_ins;
+    key_len_t keylen_ins, keylen_idx, plen;
     key_len_t offset_idx, offset_next, next_len;
 
     _get_kvsize(node->kvsize, ksize, vsize);
-    ksize = sizeof(void *);
+    (void)ksize;
+
+    if (node->nentry == 0) {
+        _set_first_kv(node, key, value, prefix);
+        return;
+    }
+
+    // copy key info from KEY, without the common prefix of the node
+    _get_key_str(key, &str, &keylen_ins);
+    plen = _fit_key(node, str, keylen_ins);
+    str += plen;
+    keylen_ins -= plen;
 
     ptr = node->data;
 
     // get offset array
-    _offset_arr = (key_len_t*)ptr;
-
-    // copy key info from KEY
-    memcpy(&key_ptr, key, ksize);
-    memcpy(&_keylen_ins, key_ptr, sizeof(key_len_t));
-    keylen_ins = _endian_decode(_keylen_ins);
+    _offset_arr = _get_offset_arr(node);
 
     // get (previous) keylen & offset
     if (idx < node->nentry) {
@@ -135,53 +444,63 @@ static void _set_fast_str_kv(struct bnode *node, idx_t idx, void *key, void *val
         }
     } else {
         // append at the end (new entry)
-        if (node->nentry > 0) {
-            // shift KV pairs to right by sizeof(key_len_t) bytes
-            // for making a room in offset array
-            offset = _endian_decode(_offset_arr[0]);
-            next_len = _endian_decode(_offset_arr[node->nentry]) - offset;
-            memmove((uint8_t*)ptr + offset + sizeof(key_len_t),
-                    (uint8_t*)ptr + offset, next_len);
+        // shift KV pairs to right by sizeof(key_len_t) bytes
+        // for making a room in offset array
+        offset = _endian_decode(_offset_arr[0]);
+        next_len = _endian_decode(_offset_arr[node->nentry]) - offset;
+        memmove((uint8_t*)ptr + offset + sizeof(key_len_t),
+                (uint8_t*)ptr + offset, next_len);
 
-            // update offset array
-            for (i=0;i<=node->nentry;++i){
-                offset = _endian_decode(_offset_arr[i]);
-                offset = offset + sizeof(key_len_t);
-                _offset_arr[i] = _endian_encode(offset);
-            }
-            offset_idx = _endian_decode(_offset_arr[idx]);
-        } else {
-            // this means that idx == 0, and
-            // there are two (idx, idx+1) entries in offset array
-            offset_idx = sizeof(key_len_t) * 2;
-            _offset_arr[0] = _endian_encode(offset_idx);
+        // update offset array
+        for (i=0;i<=node->nentry;++i){
+            offset = _endian_decode(_offset_arr[i]);
+            offset = offset + sizeof(key_len_t);
+            _offset_arr[i] = _endian_encode(offset);
         }
-        offset = _endian_decode(_offset_arr[idx]);
-        offset = offset + keylen_ins + vsize;
+        offset_idx = _endian_decode(_offset_arr[idx]);
+        offset = offset_idx + keylen_ins + vsize;
         _offset_arr[idx+1] = _endian_encode(offset);
     }
     // copy key into the node
-    memcpy((uint8_t*)ptr + offset_idx, (uint8_t*)key_ptr + sizeof(key_len_t), keylen_ins);
+    memcpy((uint8_t*)ptr + offset_idx, str, keylen_ins);
     // copy value
     memcpy((uint8_t*)ptr + offset_idx + keylen_ins, value, vsize);
 }
 
+static void _set_fast_str_kv(struct bnode *node, idx_t idx, void *key, void *value)
+{
+    _set_kv(node, idx, key, value, false);
+}
+
+static void _set_prefix_str_kv(struct bnode *node, idx_t idx, void *key, void *value)
+{
+    _set_kv(node, idx, key, value, true);
+}
+
 static void _ins_fast_str_kv(struct bnode *node, idx_t idx, void *key, void *value)
 {
     int ksize, vsize, i;
-    void *key_ptr, *ptr;
+    void *ptr;
+    uint8_t *str;
     key_len_t *_offset_arr;
-    key_len_t keylen_ins;
-    key_len_t _keylen_ins;
+    key_len_t keylen_ins, plen;
     key_len_t offset, offset_begin, offset_idx, offset_next, next_len;
 
     _get_kvsize(node->kvsize, ksize, vsize);
-    ksize = sizeof(void *);
+    (void)ksize;
+
+    if (key && value) {
+        // copy key info from KEY, without the common prefix of the node
+        _get_key_str(key, &str, &keylen_ins);
+        plen = _fit_key(node, str, keylen_ins);
+        str += plen;
+        keylen_ins -= plen;
+    }
 
     ptr = node->data;
 
     // get offset array
-    _offset_arr = (key_len_t*)ptr;
+    _offset_arr = _get_offset_arr(node);
 
     // get (previous) keylen & offset
     offset_begin = _endian_decode(_offset_arr[0]);
@@ -191,11 +510,6 @@ static void _ins_fast_str_kv(struct bnode *node, idx_t idx, void *key, void *val
     if (key && value) {
         // insert
 
-        // copy key info from KEY to KEY_PTR
-        memcpy(&key_ptr, key, ksize);
-        memcpy(&_keylen_ins, key_ptr, sizeof(key_len_t));
-        keylen_ins = _endian_decode(_keylen_ins);
-
         // move idx ~ nentry-1 KVs to right by (keylen + vsize + sizeof(key_len_t))
         next_len = _endian_decode(_offset_arr[node->nentry]) - offset_idx;
         memmove((uint8_t*)ptr + offset_idx + keylen_ins + vsize + sizeof(key_len_t),
@@ -212,7 +526,7 @@ static void _ins_fast_str_kv(struct bnode *node, idx_t idx, void *key, void *val
                 sizeof(key_len_t) * (node->nentry - idx + 1));
 
         // copy key into the node
-        memcpy((uint8_t*)ptr + offset_idx, (uint8_t*)key_ptr + sizeof(key_len_t), keylen_ins);
+        memcpy((uint8_t*)ptr + offset_idx, str, keylen_ins);
         // copy value
         memcpy((uint8_t*)ptr + offset_idx + keylen_ins, value, vsize);
 
@@ -260,6 +574,35 @@ static void _ins_fast_str_kv(struct bnode *node, idx_t idx, void *key, void *val
     }
 }
 
+// copy LEN key-value pairs of a prefix-compressed node
+static void _copy_prefix_str_kv(struct bnode *node_dst,
+                                struct bnode *node_src,
+                                idx_t src_idx,
+                                idx_t len)
+{
+    int ksize, vsize;
+    struct fast_str_entry *entries;
+    key_len_t plen, plen_src;
+
+    _get_kvsize(node_src->kvsize, ksize, vsize);
+    (void)ksize;
+
+    entries = (struct fast_str_entry *)
+              malloc(sizeof(struct fast_str_entry) * (len ? len : 1));
+    _read_entries(node_src, src_idx, len, entries);
+
+    // the copied keys may have a longer common prefix,
+    // but it may not pay for a larger padding before the offset array
+    plen_src = _get_prefix_len(node_src);
+    plen = _entry_common_prefix(entries, len);
+    if (_get_prefix_data_size(node_dst, entries, len, plen, vsize) >
+        _get_prefix_data_size(node_dst, entries, len, plen_src, vsize)) {
+        plen = plen_src;
+    }
+    _write_prefix_entries(node_dst, entries, len, plen, vsize);
+    free(entries);
+}
+
 static void _copy_fast_str_kv(struct bnode *node_dst,
                          struct bnode *node_src,
                          idx_t dst_idx,
@@ -275,6 +618,13 @@ static void _copy_fast_str_kv(struct bnode *node_dst,
     // not support when dst_idx != 0
     assert(dst_idx == 0);
 
+    if (node_src->flag & BNODE_MASK_PREFIX) {
+        // the new node keeps the format of the source node
+        _copy_prefix_str_kv(node_dst, node_src, src_idx, len);
+        return;
+    }
+    node_dst->flag &= ~BNODE_MASK_PREFIX;
+
     _get_kvsize(node_src->kvsize, ksize, vsize);
     (void)ksize;
     (void)vsize;
@@ -336,8 +686,67 @@ static size_t _get_fast_str_kv_size(struct btree *tree, void *key, void *value)
 }
 // LCOV_EXCL_STOP
 
-static size_t _get_fast_str_data_size(
-    struct bnode *node, void *new_minkey, void *key_arr, void *value_arr, size_t len)
+// return the data size of a prefix-compressed node after NEW_MINKEY and
+// the keys in KEY_ARR are set
+static size_t _get_prefix_node_data_size(
+    struct bnode *node, void *new_minkey, void *key_arr, size_t len)
+{
+    int ksize, vsize;
+    size_t size, i;
+    uint8_t *str;
+    key_len_t *_offset_arr;
+    key_len_t keylen, plen, plen_new, common;
+    key_len_t entries_offset, entries_end;
+
+    _get_kvsize(node->kvsize, ksize, vsize);
+    ksize = sizeof(void *);
+
+    _offset_arr = _get_offset_arr(node);
+    plen = plen_new = _get_prefix_len(node);
+
+    // the common prefix gets shorter if any new key does not start with it
+    if (new_minkey) {
+        _get_key_str(new_minkey, &str, &keylen);
+        common = _get_common_prefix_len(node, plen_new, str, keylen);
+        plen_new = MIN(plen_new, common);
+    }
+    for (i=0; i<len; ++i) {
+        _get_key_str((uint8_t*)key_arr + ksize*i, &str, &keylen);
+        common = _get_common_prefix_len(node, plen_new, str, keylen);
+        plen_new = MIN(plen_new, common);
+    }
+
+    entries_end = _endian_decode(_offset_arr[node->nentry]);
+    if (plen_new == plen) {
+        size = entries_end;
+    } else {
+        // all the pairs are written again with a longer key,
+        // and the offset array may have to be aligned again
+        entries_offset = _endian_decode(_offset_arr[0]);
+        size = _get_prefix_arr_offset(node, plen_new, node->nentry + len) +
+               sizeof(key_len_t) * (node->nentry + 1) +
+               (entries_end - entries_offset) +
+               (size_t)node->nentry * (plen - plen_new);
+    }
+
+    if (new_minkey) {
+        // replace the smallest key
+        _get_key_str(new_minkey, &str, &keylen);
+        size -= _endian_decode(_offset_arr[1]) -
+                _endian_decode(_offset_arr[0]) - vsize + (plen - plen_new);
+        size += keylen - plen_new;
+    }
+    for (i=0; i<len; ++i) {
+        _get_key_str((uint8_t*)key_arr + ksize*i, &str, &keylen);
+        size += sizeof(key_len_t) + keylen - plen_new + vsize;
+    }
+
+    return size;
+}
+
+static size_t _get_data_size(
+    struct bnode *node, void *new_minkey, void *key_arr, void *value_arr,
+    size_t len, bool prefix)
 {
     int ksize, vsize;
     void *ptr, *key_ptr;
@@ -348,6 +757,38 @@ static size_t _get_fast_str_data_size(
     _get_kvsize(node->kvsize, ksize, vsize);
     ksize = sizeof(void *);
 
+    if (node->nentry && (node->flag & BNODE_MASK_PREFIX)) {
+        return _get_prefix_node_data_size(node, new_minkey,
+                                          (key_arr && value_arr) ? key_arr : NULL,
+                                          (key_arr && value_arr) ? len : 0);
+    }
+    if (!node->nentry && prefix) {
+        // an empty node is written in the prefix-compressed format
+        struct fast_str_entry *entries;
+        key_len_t plen, maxlen = 0;
+
+        if (!key_arr || !value_arr || len == 0) {
+            return 0;
+        }
+        entries = (struct fast_str_entry *)
+                  malloc(sizeof(struct fast_str_entry) * len);
+        for (i=0; i<len; ++i) {
+            entries[i].head = NULL;
+            entries[i].hlen = 0;
+            _get_key_str((uint8_t*)key_arr + ksize*i,
+                         &entries[i].tail, &entries[i].tlen);
+            maxlen = MAX(maxlen, entries[i].tlen);
+        }
+        plen = _entry_common_prefix(entries, len);
+        // the first key is the common prefix until the others are set, so
+        // the offset array may have been placed after a longer prefix
+        size = _get_prefix_data_size(node, entries, len, plen, vsize) -
+               _get_prefix_arr_offset(node, plen, len) +
+               _get_prefix_arr_offset(node, maxlen, len);
+        free(entries);
+        return size;
+    }
+
     ptr = node->data;
     size = 0;
 
@@ -383,6 +824,18 @@ static size_t _get_fast_str_data_size(
     return size;
 }
 
+static size_t _get_fast_str_data_size(
+    struct bnode *node, void *new_minkey, void *key_arr, void *value_arr, size_t len)
+{
+    return _get_data_size(node, new_minkey, key_arr, value_arr, len, false);
+}
+
+static size_t _get_prefix_str_data_size(
+    struct bnode *node, void *new_minkey, void *key_arr, void *value_arr, size_t len)
+{
+    return _get_data_size(node, new_minkey, key_arr, value_arr, len, true);
+}
+
 INLINE void _init_fast_str_kv_var(struct btree *tree, void *key, void *value)
 {
     if (key) memset(key, 0, sizeof(void *));
@@ -602,9 +1055,22 @@ struct btree_kv_ops * btree_fast_str_kv_get_kb64_vb64(struct btree_kv_ops *kv_op
     btree_kv_ops->get_nth_splitter = _get_fast_str_nth_splitter;
 
     btree_kv_ops->cmp = _cmp_fast_str64;
+    btree_kv_ops->layout = BTREE_KV_LAYOUT_ANY;
 
     btree_kv_ops->bid2value = _fast_str_bid_to_value_64;
     btree_kv_ops->value2bid = _fast_str_value_to_bid_64;
 
     return btree_kv_ops;
 }
+
+void btree_fast_str_kv_set_prefix_compression(struct btree_kv_ops *kv_ops,
+                                              bool enable)
+{
+    if (enable) {
+        kv_ops->set_kv = _set_prefix_str_kv;
+        kv_ops->get_data_size = _get_prefix_str_data_size;
+    } else {
+        kv_ops->set_kv = _set_fast_str_kv;
+        kv_ops->get_data_size = _get_fast_str_data_size;
+    }
+}
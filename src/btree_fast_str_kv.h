@@ -33,6 +33,13 @@ void btree_fast_str_kv_free_key(void *key);
 
 struct btree_kv_ops;
 struct btree_kv_ops *btree_fast_str_kv_get_kb64_vb64(struct btree_kv_ops *kv_ops);
+/**
+ * Write the nodes that get their first entry in the prefix-compressed
+ * format if ENABLE is true, or in the original format otherwise.
+ * Existing nodes keep their format, and both formats are always readable.
+ */
+void btree_fast_str_kv_set_prefix_compression(struct btree_kv_ops *kv_ops,
+                                              bool enable);
 
 #ifdef __cplusplus
 }
@@ -22,6 +22,11 @@
 #include "btree_kv.h"
 #include "memleak.h"
 
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define _BTREE_KV_AVX2
+#include <immintrin.h>
+#endif
+
 INLINE void _get_kv(struct bnode *node, idx_t idx, void *key, void *value)
 {
     int ksize, vsize;
@@ -198,7 +203,7 @@ INLINE int _cmp_binary32(void *key1, void *key2, void *aux)
     b = _endian_encode(deref32(key2));
     return _CMP_U32(a, b);
 #else
-    return memcmp(key1, key2, 8);
+    return memcmp(key1, key2, 4);
 #endif
 }
 
@@ -221,6 +226,134 @@ INLINE int _cmp_binary_general(void *key1, void *key2, void *aux)
     return memcmp(key1, key2, args->chunksize);
 }
 
+// Once the binary search narrows the range down to this number of entries,
+// the remaining keys are compared at once with SIMD instructions.
+#define BTREE_KV_SEARCH_WINDOW (16)
+
+#if defined(_LITTLE_ENDIAN)
+// binary keys are big endian, so their bytes are swapped before comparison
+#define BTREE_KV_BINARY64_BSWAP (true)
+#else
+#define BTREE_KV_BINARY64_BSWAP (false)
+#endif
+
+INLINE uint64_t _read_key64(uint8_t *ptr, bool bswap)
+{
+    uint64_t key = deref64(ptr);
+    return (bswap) ? bitswap64(key) : key;
+}
+
+#ifdef _BTREE_KV_AVX2
+static bool _btree_kv_avx2_supported()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+static const bool btree_kv_avx2 = _btree_kv_avx2_supported();
+
+// Count the keys equal or smaller than QUERY among N sorted 8-byte keys
+// whose values are 8 bytes long, comparing four keys per instruction.
+__attribute__((target("avx2")))
+static idx_t _count_le_key64_avx2(uint8_t *ptr, idx_t n,
+                                  uint64_t query, bool bswap)
+{
+    const __m256i bswap_mask = _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0,
+                                                15, 14, 13, 12, 11, 10, 9, 8,
+                                                7, 6, 5, 4, 3, 2, 1, 0,
+                                                15, 14, 13, 12, 11, 10, 9, 8);
+    // flip the sign bits, as AVX2 only compares signed integers
+    const __m256i sign = _mm256_set1_epi64x((long long)0x8000000000000000ULL);
+    __m256i q = _mm256_xor_si256(_mm256_set1_epi64x((long long)query), sign);
+    idx_t i, count = 0;
+    int gt;
+
+    for (i = 0; i + 4 <= n; i += 4) {
+        // [k0 v0 k1 v1] and [k2 v2 k3 v3] -> [k0 k2 k1 k3]
+        __m256i a = _mm256_loadu_si256((__m256i *)(ptr + i * 16));
+        __m256i b = _mm256_loadu_si256((__m256i *)(ptr + i * 16 + 32));
+        __m256i k = _mm256_unpacklo_epi64(a, b);
+        if (bswap) {
+            k = _mm256_shuffle_epi8(k, bswap_mask);
+        }
+        k = _mm256_xor_si256(k, sign);
+        gt = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(k, q)));
+        count += 4 - __builtin_popcount(gt);
+        if (gt) {
+            // all the following keys are larger
+            return count;
+        }
+    }
+    for (; i < n && _read_key64(ptr + i * 16, bswap) <= query; ++i) {
+        count++;
+    }
+    return count;
+}
+#endif
+
+// Same as _btree_find_entry() in btree.cc, but compares 8-byte keys in place
+// as unsigned integers instead of copying each of them out and calling
+// 'cmp' through the function pointer.
+INLINE idx_t _find_entry_key64(struct bnode *node, void *key, bool bswap)
+{
+    int ksize, vsize;
+    uint8_t *data = (uint8_t *)node->data;
+    idx_t start, end, middle;
+    uint64_t query, k;
+    size_t kvsize;
+
+    _get_kvsize(node->kvsize, ksize, vsize);
+    kvsize = ksize + vsize;
+    end = node->nentry;
+    if (end == 0) {
+        return BTREE_IDX_NOT_FOUND;
+    }
+
+    query = _read_key64((uint8_t *)key, bswap);
+    // smaller than smallest key
+    if (query < _read_key64(data, bswap)) {
+        return BTREE_IDX_NOT_FOUND;
+    }
+    // larger than largest key
+    if (query >= _read_key64(data + (end - 1) * kvsize, bswap)) {
+        return end - 1;
+    }
+
+    // the key at START is equal or smaller than KEY,
+    // and the key at END is larger than KEY.
+    start = 0;
+    while (start + 1 < end) {
+#ifdef _BTREE_KV_AVX2
+        if (btree_kv_avx2 && kvsize == 16 &&
+            end - start <= BTREE_KV_SEARCH_WINDOW) {
+            return start - 1 +
+                   _count_le_key64_avx2(data + start * kvsize, end - start,
+                                        query, bswap);
+        }
+#endif
+        middle = (start + end) >> 1;
+        k = _read_key64(data + middle * kvsize, bswap);
+        if (query < k) {
+            end = middle;
+        } else if (query > k) {
+            start = middle;
+        } else {
+            return middle;
+        }
+    }
+    return start;
+}
+
+idx_t btree_kv_find_entry_kb64(struct bnode *node, void *key)
+{
+    return _find_entry_key64(node, key, BTREE_KV_BINARY64_BSWAP);
+}
+
+idx_t btree_kv_find_entry_ku64(struct bnode *node, void *key)
+{
+    return _find_entry_key64(node, key, false);
+}
+
 // key: uint64_t, value: uint64_t
 static struct btree_kv_ops kv_ops_ku64_vu64 = {
     _get_kv, _set_kv, _ins_kv, _copy_kv, _get_data_size, _get_kv_size, _init_kv_var, NULL,
@@ -266,6 +399,7 @@ struct btree_kv_ops * btree_kv_get_kb64_vb64(struct btree_kv_ops *kv_ops)
     btree_kv_ops->get_nth_splitter = _get_nth_splitter;
 
     btree_kv_ops->cmp = _cmp_binary64;
+    btree_kv_ops->layout = BTREE_KV_LAYOUT_KB64_VB64;
 
     btree_kv_ops->bid2value = _bid_to_value_64;
     btree_kv_ops->value2bid = _value_to_bid_64;
@@ -297,6 +431,7 @@ struct btree_kv_ops * btree_kv_get_kb32_vb64(struct btree_kv_ops *kv_ops)
     btree_kv_ops->get_nth_splitter = _get_nth_splitter;
 
     btree_kv_ops->cmp = _cmp_binary32;
+    btree_kv_ops->layout = BTREE_KV_LAYOUT_KB32_VB64;
 
     btree_kv_ops->bid2value = _bid_to_value_64;
     btree_kv_ops->value2bid = _value_to_bid_64;
@@ -328,6 +463,7 @@ struct btree_kv_ops * btree_kv_get_kbn_vb64(struct btree_kv_ops *kv_ops)
     btree_kv_ops->get_nth_splitter = _get_nth_splitter;
 
     btree_kv_ops->cmp = _cmp_binary_general;
+    btree_kv_ops->layout = BTREE_KV_LAYOUT_ANY;
 
     btree_kv_ops->bid2value = _bid_to_value_64;
     btree_kv_ops->value2bid = _value_to_bid_64;
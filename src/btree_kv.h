@@ -21,6 +21,7 @@
 #include <stdio.h>
 #include <stdint.h>
 #include "common.h"
+#include "btree.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -61,6 +62,11 @@ struct btree_kv_ops * btree_kv_get_kb64_vb64(struct btree_kv_ops *kv_ops);
 struct btree_kv_ops * btree_kv_get_kb32_vb64(struct btree_kv_ops *kv_ops);
 struct btree_kv_ops * btree_kv_get_kbn_vb64(struct btree_kv_ops *kv_ops);
 
+// node search for 8-byte keys compared as binary strings (memcmp order)
+idx_t btree_kv_find_entry_kb64(struct bnode *node, void *key);
+// node search for 8-byte keys compared as native unsigned integers
+idx_t btree_kv_find_entry_ku64(struct bnode *node, void *key);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,275 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2010 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "arch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libforestdb/forestdb.h"
+#include "fdb_internal.h"
+#include "filemgr.h"
+#include "common.h"
+#include "list.h"
+#include "commitsyncer.h"
+#include "memleak.h"
+
+#ifdef __DEBUG
+#ifndef __DEBUG_COMMITSYNCER
+    #undef DBG
+    #undef DBGCMD
+    #undef DBGSW
+    #define DBG(...)
+    #define DBGCMD(...)
+    #define DBGSW(n, ...)
+#endif
+#endif
+
+// variables for initialization
+volatile uint8_t commitsyncer_initialized = 0;
+static mutex_t cs_lock = MUTEX_INITIALIZER;
+
+// Number of the worker threads. The commits of a file handle are handled by
+// one worker at a time in their order, while those of different handles are
+// handled in parallel, so that a slow disk or a slow callback only delays
+// the commits of its own file handle.
+#define COMMITSYNCER_NUM_THREADS (4)
+
+// the worker threads are created when the first commit is queued
+static bool commitsyncer_running = false;
+static thread_t commitsyncer_tids[COMMITSYNCER_NUM_THREADS];
+
+// 'cs_lock' protects the queues and the terminate signal
+static thread_cond_t queue_cond;
+// signaled whenever a callback is invoked
+static thread_cond_t done_cond;
+// file handles that have pending commits and are not taken by any worker
+static struct list ready_queue;
+// all the file handles that have pending commits or are being handled
+static struct list handle_list;
+static volatile uint8_t commitsyncer_terminate_signal = 0;
+
+// file handle whose callback is being invoked by the current thread
+static thread_local fdb_file_handle *cur_callback_fhandle = NULL;
+
+struct commit_queue_elem {
+    fdb_file_handle *fhandle;
+    struct filemgr *file;
+    uint64_t seq;
+    fdb_status status;
+    uint32_t window;
+    fdb_commit_callback callback;
+    void *ctx;
+    struct list_elem le;
+};
+
+// pending commits of a file handle
+struct commit_handle_queue {
+    fdb_file_handle *fhandle;
+    struct list commits;
+    // true if a worker is handling a commit of this file handle
+    bool busy;
+    // list elem for 'ready_queue'
+    struct list_elem le_ready;
+    // list elem for 'handle_list'
+    struct list_elem le;
+};
+
+// Should be called while 'cs_lock' is grabbed.
+static struct commit_handle_queue *_commitsyncer_get_queue(
+                                              fdb_file_handle *fhandle)
+{
+    struct list_elem *e;
+    struct commit_handle_queue *queue;
+
+    for (e = list_begin(&handle_list); e; e = list_next(e)) {
+        queue = _get_entry(e, struct commit_handle_queue, le);
+        if (queue->fhandle == fhandle) {
+            return queue;
+        }
+    }
+
+    queue = (struct commit_handle_queue *)
+            calloc(1, sizeof(struct commit_handle_queue));
+    queue->fhandle = fhandle;
+    list_init(&queue->commits);
+    list_push_back(&handle_list, &queue->le);
+    return queue;
+}
+
+static void * commitsyncer_thread(void *voidargs)
+{
+    char filename[FDB_MAX_FILENAME_LEN];
+    struct list_elem *e;
+    struct commit_queue_elem *elem;
+    struct commit_handle_queue *queue;
+    fdb_status fs;
+
+    while (1) {
+        mutex_lock(&cs_lock);
+        while (!list_begin(&ready_queue) && !commitsyncer_terminate_signal) {
+            thread_cond_wait(&queue_cond, &cs_lock);
+        }
+        e = list_pop_front(&ready_queue);
+        if (!e) {
+            // all the queues are drained and the terminate signal is set
+            mutex_unlock(&cs_lock);
+            break;
+        }
+        queue = _get_entry(e, struct commit_handle_queue, le_ready);
+        queue->busy = true;
+        e = list_pop_front(&queue->commits);
+        mutex_unlock(&cs_lock);
+
+        // The sync of a commit also covers the DB headers written later.
+        elem = _get_entry(e, struct commit_queue_elem, le);
+        fs = elem->status;
+        if (elem->seq) {
+            fs = filemgr_group_commit_sync(elem->file, elem->seq,
+                                           elem->window,
+                                           &elem->fhandle->root->log_callback);
+        }
+        cur_callback_fhandle = elem->fhandle;
+        elem->callback(elem->fhandle, fs, elem->ctx);
+        cur_callback_fhandle = NULL;
+        strcpy(filename, elem->file->filename);
+        filemgr_close(elem->file, 0, filename, NULL);
+
+        mutex_lock(&cs_lock);
+        queue->busy = false;
+        if (list_begin(&queue->commits)) {
+            // the next commit of the file handle can be taken by any worker
+            list_push_back(&ready_queue, &queue->le_ready);
+            thread_cond_signal(&queue_cond);
+        } else {
+            list_remove(&handle_list, &queue->le);
+            free(queue);
+        }
+        atomic_decr_uint32_t(&elem->fhandle->num_async_commits);
+        thread_cond_broadcast(&done_cond);
+        mutex_unlock(&cs_lock);
+        free(elem);
+    }
+    return NULL;
+}
+
+void commitsyncer_init(void)
+{
+    if (!commitsyncer_initialized) {
+        // Note that this function is synchronized by spin lock in fdb_init API.
+        mutex_init(&cs_lock);
+
+        mutex_lock(&cs_lock);
+        if (!commitsyncer_initialized) {
+            list_init(&ready_queue);
+            list_init(&handle_list);
+            commitsyncer_terminate_signal = 0;
+            commitsyncer_running = false;
+
+            thread_cond_init(&queue_cond);
+            thread_cond_init(&done_cond);
+
+            commitsyncer_initialized = 1;
+        }
+        mutex_unlock(&cs_lock);
+    }
+}
+
+void commitsyncer_shutdown(void)
+{
+    void *ret;
+    size_t i;
+
+    if (!commitsyncer_initialized) {
+        return;
+    }
+
+    mutex_lock(&cs_lock);
+    if (commitsyncer_running) {
+        // set terminate signal; the threads drain the queues before exiting
+        commitsyncer_terminate_signal = 1;
+        thread_cond_broadcast(&queue_cond);
+        mutex_unlock(&cs_lock);
+
+        for (i = 0; i < COMMITSYNCER_NUM_THREADS; ++i) {
+            thread_join(commitsyncer_tids[i], &ret);
+        }
+
+        mutex_lock(&cs_lock);
+        commitsyncer_running = false;
+    }
+    commitsyncer_initialized = 0;
+    thread_cond_destroy(&queue_cond);
+    thread_cond_destroy(&done_cond);
+    mutex_unlock(&cs_lock);
+
+    mutex_destroy(&cs_lock);
+}
+
+void commitsyncer_enqueue(fdb_file_handle *fhandle, struct filemgr *file,
+                          uint64_t seq, fdb_status status, uint32_t window,
+                          fdb_commit_callback callback, void *ctx)
+{
+    struct commit_queue_elem *elem;
+    struct commit_handle_queue *queue;
+    size_t i;
+
+    elem = (struct commit_queue_elem *)calloc(1, sizeof(struct commit_queue_elem));
+    elem->fhandle = fhandle;
+    elem->file = file;
+    elem->seq = seq;
+    elem->status = status;
+    elem->window = window;
+    elem->callback = callback;
+    elem->ctx = ctx;
+    // keep the file open until the callback is invoked, as the file handle
+    // may be switched to the compacted file in the meantime.
+    filemgr_incr_ref_count(file);
+    atomic_incr_uint32_t(&fhandle->num_async_commits);
+
+    mutex_lock(&cs_lock);
+    queue = _commitsyncer_get_queue(fhandle);
+    if (!list_begin(&queue->commits) && !queue->busy) {
+        list_push_back(&ready_queue, &queue->le_ready);
+    }
+    list_push_back(&queue->commits, &elem->le);
+    if (!commitsyncer_running) {
+        commitsyncer_terminate_signal = 0;
+        for (i = 0; i < COMMITSYNCER_NUM_THREADS; ++i) {
+            thread_create(&commitsyncer_tids[i], commitsyncer_thread, NULL);
+        }
+        commitsyncer_running = true;
+    }
+    thread_cond_signal(&queue_cond);
+    mutex_unlock(&cs_lock);
+}
+
+bool commitsyncer_in_callback(fdb_file_handle *fhandle)
+{
+    return cur_callback_fhandle == fhandle;
+}
+
+void commitsyncer_wait(fdb_file_handle *fhandle)
+{
+    if (!commitsyncer_initialized) return;
+
+    mutex_lock(&cs_lock);
+    while (atomic_get_uint32_t(&fhandle->num_async_commits)) {
+        thread_cond_wait(&done_cond, &cs_lock);
+    }
+    mutex_unlock(&cs_lock);
+}
@@ -0,0 +1,67 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2010 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#ifndef _FDB_COMMITSYNCER_H
+#define _FDB_COMMITSYNCER_H
+
+#include "internal_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Initialize the daemon that makes the commits of fdb_commit_async()
+ * durable and invokes their callbacks. Its worker threads are started when
+ * the first commit is queued. The commits of each file handle are handled
+ * in their order, and those of different file handles in parallel.
+ */
+void commitsyncer_init(void);
+void commitsyncer_shutdown(void);
+/**
+ * Queue the callback of an asynchronous commit whose DB header is written.
+ *
+ * @param fhandle Pointer to the file handle that made the commit.
+ * @param file Pointer to the file that the DB header is written to. It is
+ *        kept open until the callback is invoked.
+ * @param seq Group commit sequence number to be synced, or zero if the commit
+ *        does not need to be synced.
+ * @param status Result of the commit to be passed to the callback, if it
+ *        does not need to be synced.
+ * @param window Group commit window of the file in microseconds.
+ * @param callback Callback function of the commit.
+ * @param ctx Client context of the callback function.
+ */
+void commitsyncer_enqueue(fdb_file_handle *fhandle, struct filemgr *file,
+                          uint64_t seq, fdb_status status, uint32_t window,
+                          fdb_commit_callback callback, void *ctx);
+/**
+ * Check if the current thread is invoking a commit callback of the given
+ * file handle.
+ */
+bool commitsyncer_in_callback(fdb_file_handle *fhandle);
+/**
+ * Wait until the callbacks of all the asynchronous commits made by the given
+ * file handle are invoked.
+ */
+void commitsyncer_wait(fdb_file_handle *fhandle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _FDB_COMMITSYNCER_H
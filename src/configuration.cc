@@ -126,6 +126,38 @@ fdb_config get_default_config(void) {
     // Disable bottom-up build by default.
     fconfig.bottom_up_index_build = false;
 
+    // LRU buffer cache replacement by default.
+    fconfig.bcache_policy = FDB_BCACHE_POLICY_LRU;
+
+    // Adaptive read-ahead of up to 64 blocks by default.
+    fconfig.adaptive_readahead_max_blocks = 64;
+
+    // POSIX I/O by default.
+    fconfig.io_engine = FDB_IO_ENGINE_POSIX;
+
+    // Durable commits sync their DB headers on their own by default.
+    fconfig.group_commit = false;
+
+    // Wait up to 500 us for concurrent committers by default.
+    fconfig.group_commit_window = 500;
+
+    // Read old documents with up to 4 threads during WAL flush by default.
+    fconfig.num_wal_prefetch_threads = 4;
+
+    // Writers flush the WAL by themselves by default.
+    fconfig.enable_background_wal_flush = false;
+    fconfig.wal_flush_hard_limit = 0;
+
+    // B+tree nodes store their keys in full by default.
+    fconfig.btree_prefix_compression = false;
+
+    // Doc offsets in the main index are not tagged with key fingerprints
+    // by default.
+    fconfig.key_fingerprint = false;
+
+    // No key cache over the main index by default.
+    fconfig.index_cache_size = 0;
+
     return fconfig;
 }
 
@@ -205,6 +237,27 @@ bool validate_fdb_config(fdb_config *fconfig) {
         // Log level: 0 to 6.
         return false;
     }
+    if (fconfig->bcache_policy != FDB_BCACHE_POLICY_LRU &&
+        fconfig->bcache_policy != FDB_BCACHE_POLICY_2Q) {
+        return false;
+    }
+    if (fconfig->adaptive_readahead_max_blocks > MAX_READAHEAD_BLOCKS) {
+        return false;
+    }
+    if (fconfig->io_engine != FDB_IO_ENGINE_POSIX &&
+        fconfig->io_engine != FDB_IO_ENGINE_IO_URING) {
+        return false;
+    }
+    if (fconfig->group_commit_window > MAX_GROUP_COMMIT_WINDOW) {
+        return false;
+    }
+    if (fconfig->num_wal_prefetch_threads > MAX_NUM_WAL_PREFETCH_THREADS) {
+        return false;
+    }
+    if (fconfig->wal_flush_hard_limit &&
+        fconfig->wal_flush_hard_limit < fconfig->wal_threshold) {
+        return false;
+    }
 
     return true;
 }
@@ -40,10 +40,17 @@ fdb_status docio_init(struct docio_handle *handle,
     handle->lastbid = BLK_NOT_FOUND;
     handle->lastBmpRevnum = 0;
     handle->compress_document_body = compress_document_body;
-    malloc_align(handle->readbuffer, FDB_SECTOR_SIZE, file->blocksize);
-    if (!handle->readbuffer) {
+    handle->readpin = NULL;
+    handle->readahead = (struct filemgr_readahead *)
+                        malloc(sizeof(struct filemgr_readahead));
+    if (handle->readahead) {
+        filemgr_readahead_init(handle->readahead);
+    }
+    malloc_align(handle->privbuffer, FDB_SECTOR_SIZE, file->blocksize);
+    handle->readbuffer = handle->privbuffer;
+    if (!handle->privbuffer || !handle->readahead) {
         fdb_log(NULL, FDB_LOG_ERROR, FDB_RESULT_ALLOC_FAIL,
-                "(docio_init) malloc_align failed: "
+                "(docio_init) memory allocation failed: "
                 "database file '%s'\n",
                 handle->file->filename);
         return FDB_RESULT_ALLOC_FAIL;
@@ -53,7 +60,14 @@ fdb_status docio_init(struct docio_handle *handle,
 
 void docio_free(struct docio_handle *handle)
 {
-    free_align(handle->readbuffer);
+    filemgr_unpin(handle->readpin);
+    handle->readpin = NULL;
+    if (handle->readahead) {
+        filemgr_readahead_free(handle->readahead);
+        free(handle->readahead);
+        handle->readahead = NULL;
+    }
+    free_align(handle->privbuffer);
 }
 
 #ifdef __CRC32
@@ -691,6 +705,26 @@ bid_t docio_append_doc_system(struct docio_handle *handle, struct docio_object *
     return _docio_append_doc(handle, doc);
 }
 
+// Drop the reference to the current block so that 'readbuffer' points to
+// the handle's private buffer again.
+INLINE void _docio_release_buffer(struct docio_handle *handle)
+{
+    if (handle->readpin) {
+        filemgr_unpin(handle->readpin);
+        handle->readpin = NULL;
+    }
+    handle->readbuffer = handle->privbuffer;
+    handle->lastbid = BLK_NOT_FOUND;
+}
+
+void docio_release_buffer(struct docio_handle *handle)
+{
+    _docio_release_buffer(handle);
+    if (handle->readahead) {
+        filemgr_readahead_stop(handle->readahead);
+    }
+}
+
 INLINE fdb_status _docio_read_through_buffer(struct docio_handle *handle,
                                              bid_t bid,
                                              err_log_callback *log_callback,
@@ -702,11 +736,26 @@ INLINE fdb_status _docio_read_through_buffer(struct docio_handle *handle,
     // then 'lastbid' should be reset as it might be reused.
     if (handle->lastbid != BLK_NOT_FOUND &&
         filemgr_get_sb_bmp_revnum(handle->file) != handle->lastBmpRevnum) {
-        handle->lastbid = BLK_NOT_FOUND;
+        _docio_release_buffer(handle);
     }
 
     // to reduce the overhead from memcpy the same block
     if (handle->lastbid != bid) {
+        _docio_release_buffer(handle);
+        filemgr_readahead(handle->readahead, handle->file, bid, log_callback);
+
+        if (!filemgr_is_writable(handle->file, bid)) {
+            // immutable block .. read it in place if it is cached.
+            void *addr = filemgr_read_pinned(handle->file, bid,
+                                             &handle->readpin);
+            if (addr) {
+                handle->readbuffer = addr;
+                handle->lastbid = bid;
+                handle->lastBmpRevnum = filemgr_get_sb_bmp_revnum(handle->file);
+                return status;
+            }
+        }
+
         status = filemgr_read(handle->file, bid, handle->readbuffer,
                               log_callback, read_on_cache_miss);
         if (status != FDB_RESULT_SUCCESS) {
@@ -715,9 +764,8 @@ INLINE fdb_status _docio_read_through_buffer(struct docio_handle *handle,
                         "Error in reading a doc block with id %" _F64 " from "
                         "a database file '%s'", bid, handle->file->filename);
             }
-            // we must reset 'lastbid' here because now 'readbuffer'
+            // 'lastbid' is already reset here because now 'readbuffer'
             // may contain other data unrelated to 'lastbid'.
-            handle->lastbid = BLK_NOT_FOUND;
             return status;
         }
 
@@ -787,7 +835,7 @@ static int64_t _docio_read_length(struct docio_handle *handle,
 
     bid_t bid = offset / real_blocksize;
     uint32_t pos = offset % real_blocksize;
-    void *buf = handle->readbuffer;
+    void *buf;
     uint32_t restsize = 0;
 
     if (blocksize > pos) {
@@ -810,6 +858,7 @@ static int64_t _docio_read_length(struct docio_handle *handle,
     if (!_docio_check_buffer(handle, (uint64_t)-1)) {
         return (int64_t) FDB_RESULT_READ_FAIL; // Need to define a better error code
     }
+    buf = handle->readbuffer;
 
     if (restsize >= sizeof(struct docio_length)) {
         memcpy(length, (uint8_t *)buf + pos, sizeof(struct docio_length));
@@ -845,6 +894,7 @@ static int64_t _docio_read_length(struct docio_handle *handle,
         if (!_docio_check_buffer(handle, (uint64_t)-1)) {
             return (int64_t) FDB_RESULT_READ_FAIL; // Need to define a better error code
         }
+        buf = handle->readbuffer;
         // memcpy rest of data
         memcpy((uint8_t *)length + restsize, buf,
                sizeof(struct docio_length) - restsize);
@@ -878,7 +928,7 @@ static int64_t _docio_read_doc_component(struct docio_handle *handle,
     bid_t bid = offset / real_blocksize;
     uint32_t pos = offset % real_blocksize;
     //uint8_t buf[handle->file->blocksize];
-    void *buf = handle->readbuffer;
+    void *buf;
     uint32_t restsize;
     fdb_status fs = FDB_RESULT_SUCCESS;
 
@@ -892,6 +942,7 @@ static int64_t _docio_read_doc_component(struct docio_handle *handle,
                     "a database file '%s'", bid, handle->file->filename);
             return (int64_t)fs;
         }
+        buf = handle->readbuffer;
         restsize = blocksize - pos;
 
         if (restsize >= rest_len) {
@@ -1553,7 +1604,7 @@ static int _submit_async_io_requests(struct docio_handle *handle,
             // I/O path (i.e., buffer cache -> disk read if cache miss).
             // As these additional blocks are sequential reads, we don't expect
             // asynchronous I/O to give us performance boost.
-            void *tmp_buffer = handle->readbuffer;
+            _docio_release_buffer(handle);
             handle->readbuffer = buf;
             handle->lastbid = offset / aio_handle->block_size;
             memset(&doc_array[doc_idx], 0x0, sizeof(struct docio_object));
@@ -1566,12 +1617,10 @@ static int _submit_async_io_requests(struct docio_handle *handle,
             }
             if (_offset <= 0) {
                 ++doc_idx;
-                handle->readbuffer = tmp_buffer;
-                handle->lastbid = BLK_NOT_FOUND;
+                _docio_release_buffer(handle);
                 continue;
             }
-            handle->readbuffer = tmp_buffer;
-            handle->lastbid = BLK_NOT_FOUND;
+            _docio_release_buffer(handle);
 
             (*sum_doc_size) += _fdb_get_docsize(doc_array[doc_idx].length);
             if (keymeta_only) {
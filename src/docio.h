@@ -36,7 +36,13 @@ struct docio_handle {
     // for buffer purpose
     bid_t lastbid;
     uint64_t lastBmpRevnum;
+    // contents of 'lastbid': either 'privbuffer' or a block pinned
+    // in the buffer cache (read in place without copying).
     void *readbuffer;
+    void *privbuffer;
+    struct bcache_item *readpin;
+    // read-ahead state of this handle's block accesses
+    struct filemgr_readahead *readahead;
     err_log_callback *log_callback;
     bool compress_document_body;
 };
@@ -191,6 +197,15 @@ bool docio_check_buffer(struct docio_handle *handle,
                         uint64_t sb_bmp_revnum);
 
 
+/**
+ * Release the buffer cache block pinned by the handle's last read, if any,
+ * and stop the handle's read-ahead.
+ * This should be called before the underlying file is closed.
+ *
+ * @param handle Pointer to DocIO handle.
+ */
+void docio_release_buffer(struct docio_handle *handle);
+
 INLINE void docio_reset(struct docio_handle *dhandle) {
     dhandle->curblock = BLK_NOT_FOUND;
 }
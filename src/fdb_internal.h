@@ -82,6 +82,11 @@ fdb_status fdb_open_for_compactor(fdb_file_handle **ptr_fhandle,
                                   const char *filename,
                                   fdb_config *fconfig,
                                   struct list *cmp_func_list);
+fdb_status fdb_open_for_wal_flusher(fdb_file_handle **ptr_fhandle,
+                                    const char *filename,
+                                    fdb_config *fconfig,
+                                    struct list *cmp_func_list);
+fdb_status fdb_flush_wal_background(fdb_file_handle *fhandle);
 
 fdb_status fdb_compact_file(fdb_file_handle *fhandle,
                             const char *new_filename,
@@ -35,6 +35,7 @@
 #include "time_utils.h"
 #include "encryption.h"
 #include "version.h"
+#include "timing.h"
 
 #include "memleak.h"
 
@@ -54,6 +55,16 @@
 // NBUCKET must be power of 2
 #define NBUCKET (1024)
 
+// Largest jump (in blocks) between two accesses that is still regarded as
+// a sequential run by read-ahead.
+#define FILEMGR_READAHEAD_MAX_GAP (16)
+// Number of consecutive accesses following the same stride that trigger
+// read-ahead.
+#define FILEMGR_READAHEAD_TRIGGER (2)
+// Number of blocks in the aligned extent that is read at once on a cache
+// miss of an O_DIRECT file (at most 64).
+#define FILEMGR_DIRECT_READ_BLOCKS (16)
+
 // global static variables
 #ifdef SPIN_INITIALIZER
 static spin_t initial_lock = SPIN_INITIALIZER;
@@ -66,6 +77,9 @@ static spin_t initial_lock;
 static volatile uint8_t filemgr_initialized = 0;
 extern volatile uint8_t bgflusher_initialized;
 static struct filemgr_config global_config;
+// File ops of the I/O engine selected by 'global_config.io_engine'.
+// NULL means the default POSIX ops.
+static struct filemgr_ops *io_engine_ops = NULL;
 static struct hash hash;
 static spin_t filemgr_openlock;
 
@@ -211,8 +225,20 @@ void filemgr_init(struct filemgr_config *config)
             memset(&sb_ops, 0x0, sizeof(sb_ops));
             global_config = *config;
 
+            io_engine_ops = NULL;
+            if (global_config.io_engine == FDB_IO_ENGINE_IO_URING) {
+                io_engine_ops = get_io_uring_filemgr_ops();
+                if (!io_engine_ops) {
+                    fdb_log(NULL, FDB_LOG_WARNING,
+                            FDB_RESULT_AIO_NOT_SUPPORTED,
+                            "io_uring is not supported, "
+                            "falling back to POSIX I/O");
+                }
+            }
+
             bcache_config bconfig;
             bconfig.do_not_cache_doc_blocks = global_config.do_not_cache_doc_blocks;
+            bconfig.policy = global_config.bcache_policy;
             if (global_config.ncacheblock > 0) {
                 bcache_init(global_config.ncacheblock,
                             global_config.blocksize,
@@ -235,6 +261,11 @@ void filemgr_init(struct filemgr_config *config)
     }
 }
 
+struct filemgr_ops * filemgr_get_ops(void)
+{
+    return io_engine_ops ? io_engine_ops : get_filemgr_ops();
+}
+
 void filemgr_set_lazy_file_deletion(bool enable,
                                     register_file_removal_func regis_func,
                                     check_file_removal_func check_func)
@@ -332,25 +363,55 @@ ssize_t filemgr_write_blocks(struct filemgr *file, void *buf, unsigned num_block
     if (file->encryption.ops == NULL) {
         return file->ops->pwrite(file->fd, buf, nbytes, offset);
     } else {
-        uint8_t *encrypted_buf;
-        if (nbytes > 4096)
-            encrypted_buf = (uint8_t*)malloc(nbytes);
-        else
-            encrypted_buf = alca(uint8_t, nbytes); // most common case (writing single block)
+        // The encrypted copy should be aligned as well for O_DIRECT.
+        void *encrypted_buf = NULL;
+        if (num_blocks > 1) {
+            malloc_align(encrypted_buf, FDB_SECTOR_SIZE, nbytes);
+        } else {
+            // most common case (writing single block)
+            encrypted_buf = _filemgr_get_temp_buf();
+        }
         if (!encrypted_buf)
             return FDB_RESULT_ALLOC_FAIL;
-        fdb_status status = fdb_encrypt_blocks(&file->encryption,
-                                               encrypted_buf,
-                                               buf,
-                                               blocksize,
-                                               num_blocks,
-                                               start_bid);
-        if (nbytes > 4096)
-            free(encrypted_buf);
-        if (status != FDB_RESULT_SUCCESS)
-            return status;
-        return file->ops->pwrite(file->fd, encrypted_buf, nbytes, offset);
+        ssize_t rv = fdb_encrypt_blocks(&file->encryption,
+                                        encrypted_buf,
+                                        buf,
+                                        blocksize,
+                                        num_blocks,
+                                        start_bid);
+        if (rv == FDB_RESULT_SUCCESS) {
+            rv = file->ops->pwrite(file->fd, encrypted_buf, nbytes, offset);
+        }
+        if (num_blocks > 1) {
+            free_align(encrypted_buf);
+        } else {
+            _filemgr_release_temp_buf(encrypted_buf);
+        }
+        return rv;
+    }
+}
+
+// Write runs of consecutive blocks, encrypting if necessary. The runs are
+// submitted as a single batch if the I/O engine supports it.
+fdb_status filemgr_write_blocks_batch(struct filemgr *file,
+                                      struct filemgr_io_req *reqs,
+                                      size_t num)
+{
+    size_t blocksize = file->blocksize;
+    if (file->encryption.ops == NULL && file->ops->pwrite_batch) {
+        return (fdb_status) file->ops->pwrite_batch(file->fd, reqs, num,
+                                                    false);
+    }
+    for (size_t i = 0; i < num; ++i) {
+        reqs[i].result = filemgr_write_blocks(file, reqs[i].buf,
+                                              reqs[i].count / blocksize,
+                                              reqs[i].offset / blocksize);
+        if (reqs[i].result != (ssize_t)reqs[i].count) {
+            return reqs[i].result < 0 ? (fdb_status) reqs[i].result
+                                      : FDB_RESULT_WRITE_FAIL;
+        }
     }
+    return FDB_RESULT_SUCCESS;
 }
 
 int filemgr_is_writable(struct filemgr *file, bid_t bid)
@@ -597,6 +658,14 @@ uint64_t filemgr_get_bcache_used_space(void)
     return bcache_free_space;
 }
 
+void filemgr_get_bcache_stats(fdb_buffer_cache_stats *stats)
+{
+    memset(stats, 0x0, sizeof(fdb_buffer_cache_stats));
+    if (global_config.ncacheblock) {
+        bcache_get_stats(stats);
+    }
+}
+
 struct filemgr_prefetch_args {
     struct filemgr *file;
     uint64_t duration;
@@ -703,7 +772,7 @@ void filemgr_prefetch(struct filemgr *file,
 }
 
 fdb_status filemgr_does_file_exist(char *filename) {
-    struct filemgr_ops *ops = get_filemgr_ops();
+    struct filemgr_ops *ops = filemgr_get_ops();
     int fd = ops->open(filename, O_RDONLY, 0444);
     if (fd < 0) {
         return (fdb_status) fd;
@@ -928,10 +997,12 @@ filemgr_open_result filemgr_open(char *filename, struct filemgr_ops *ops,
     atomic_init_uint64_t(&file->latest_filesize, offset);
     atomic_init_uint32_t(&file->throttling_delay, 0);
     atomic_init_uint64_t(&file->num_invalidated_blocks, 0);
+    atomic_init_uint64_t(&file->num_reused_blocks, 0);
+    atomic_init_uint64_t(&file->num_index_updates, 0);
     atomic_init_uint8_t(&file->io_in_prog, 0);
 
 #ifdef _LATENCY_STATS
-    for (int i = 0; i < FDB_LATENCY_NUM_STATS; ++i) {
+    for (int i = 0; i < FDB_LATENCY_NUM_ALL_STATS; ++i) {
         filemgr_init_latency_stat(&file->lat_stats[i]);
     }
 #endif // _LATENCY_STATS
@@ -990,7 +1061,25 @@ filemgr_open_result filemgr_open(char *filename, struct filemgr_ops *ops,
 #endif //__FILEMGR_DATA_PARTIAL_LOCK
 
     mutex_init(&file->writer_lock.mutex);
+    init_rw_lock(&file->writer_lock.shared);
     file->writer_lock.locked = false;
+    for (size_t j=0;j<FILEMGR_KVS_WRITER_LOCKS;++j) {
+        mutex_init(&file->kvs_writer_lock[j]);
+    }
+    spin_init(&file->stale_list_lock);
+
+    mutex_init(&file->group_commit.lock);
+    thread_cond_init(&file->group_commit.cond);
+    file->group_commit.written_seq = 0;
+    file->group_commit.synced_seq = 0;
+    file->group_commit.num_pending = 0;
+    file->group_commit.syncing = false;
+    file->group_commit.failed_from = 0;
+    file->group_commit.failed_to = 0;
+    file->group_commit.failed_status = FDB_RESULT_SUCCESS;
+    atomic_init_uint64_t(&file->group_commit.num_syncs, 0);
+    atomic_init_uint64_t(&file->group_commit.num_commits, 0);
+    atomic_init_uint64_t(&file->group_commit.max_batch, 0);
 
     // Note: CRC must be initialized before superblock loading
     // initialize CRC mode
@@ -1671,7 +1760,7 @@ void filemgr_free_func(struct hash_elem *h)
     free(file->wal);
 
 #ifdef _LATENCY_STATS
-    for (int x = 0; x < FDB_LATENCY_NUM_STATS; ++x) {
+    for (int x = 0; x < FDB_LATENCY_NUM_ALL_STATS; ++x) {
         filemgr_destroy_latency_stat(&file->lat_stats[x]);
     }
 #endif // _LATENCY_STATS
@@ -1702,6 +1791,13 @@ void filemgr_free_func(struct hash_elem *h)
 #endif //__FILEMGR_DATA_PARTIAL_LOCK
 
     mutex_destroy(&file->writer_lock.mutex);
+    destroy_rw_lock(&file->writer_lock.shared);
+    for (size_t j=0;j<FILEMGR_KVS_WRITER_LOCKS;++j) {
+        mutex_destroy(&file->kvs_writer_lock[j]);
+    }
+    spin_destroy(&file->stale_list_lock);
+    mutex_destroy(&file->group_commit.lock);
+    thread_cond_destroy(&file->group_commit.cond);
 
     // free superblock
     if (sb_ops.release) {
@@ -1828,6 +1924,9 @@ bid_t filemgr_alloc(struct filemgr *file, err_log_callback *log_callback)
     if (filemgr_get_file_status(file) == FILE_NORMAL &&
         file->sb && sb_ops.alloc_block) {
         bid = sb_ops.alloc_block(file);
+        if (bid != BLK_NOT_FOUND) {
+            atomic_incr_uint64_t(&file->num_reused_blocks);
+        }
     }
     if (bid == BLK_NOT_FOUND) {
         bid = atomic_get_uint64_t(&file->pos) / file->blocksize;
@@ -1965,6 +2064,121 @@ uint64_t filemgr_flush_immutable(struct filemgr *file,
     return ret;
 }
 
+// Put a block that was read without grabbing the partial lock (by read-ahead
+// or an extent read) into the buffer cache. 'reuse_seq' is the number of
+// reused blocks of the file before the read.
+static void _filemgr_install_block(struct filemgr *file, bid_t bid, void *buf,
+                                   uint64_t reuse_seq)
+{
+    plock_entry_t *plock_entry;
+    bid_t is_writer = 0;
+
+    // The reader skips blocks that were writable at the time of the read.
+    // Any other block can be overwritten only after being reallocated by
+    // block reusing, so the contents are still valid if no block has been
+    // reused since then.
+    plock_entry = plock_lock(&file->plock, &bid, &is_writer);
+    if (atomic_get_uint64_t(&file->num_reused_blocks) == reuse_seq) {
+        fdb_status status = FDB_RESULT_SUCCESS;
+        if (file->encryption.ops) {
+            status = fdb_decrypt_block(&file->encryption, buf,
+                                       file->blocksize, bid);
+        }
+        // superblocks and DB headers are not cached.
+        uint8_t marker = *((uint8_t*)buf + file->blocksize - 1);
+        if (status == FDB_RESULT_SUCCESS &&
+            (marker == BLK_MARKER_DOC || marker == BLK_MARKER_BNODE) &&
+            _filemgr_crc32_check(file, buf) == FDB_RESULT_SUCCESS) {
+            bcache_write(file, bid, buf, BCACHE_REQ_CLEAN, false, true);
+        }
+    }
+    plock_unlock(&file->plock, plock_entry);
+}
+
+// Aligned extent of an O_DIRECT file that was read on a cache miss.
+struct filemgr_direct_extent {
+    uint8_t *buf;
+    bid_t first_bid;
+    size_t nblocks;
+    uint64_t reuse_seq;
+    // bitmap of the blocks that were not writable before the read
+    uint64_t installable;
+};
+
+/**
+ * Read a block of an O_DIRECT file on a cache miss. As there is no
+ * read-ahead by the OS page cache, the aligned extent containing the block
+ * is read at once into an aligned per-thread buffer, and the block is copied
+ * into 'buf' (which does not need to be aligned). The other blocks of the
+ * extent are cached by _filemgr_install_direct_extent() once the caller
+ * releases the partial lock of 'bid'.
+ */
+static ssize_t _filemgr_read_block_direct(struct filemgr *file, void *buf,
+                                          bid_t bid, uint64_t total_blocks,
+                                          struct filemgr_direct_extent *ext)
+{
+    thread_local void *direct_buf = NULL;
+    thread_local FdbGcFunc gc([&](){ free_align(direct_buf); });
+    size_t blocksize = file->blocksize;
+    size_t nblocks = FILEMGR_DIRECT_READ_BLOCKS;
+    bid_t first = bid - (bid % FILEMGR_DIRECT_READ_BLOCKS);
+
+    if (!direct_buf) {
+        malloc_align(direct_buf, FDB_SECTOR_SIZE,
+                     (size_t)global_config.blocksize *
+                     FILEMGR_DIRECT_READ_BLOCKS);
+        if (!direct_buf) {
+            return FDB_RESULT_ALLOC_FAIL;
+        }
+    }
+    if (global_config.do_not_cache_doc_blocks) {
+        first = bid;
+        nblocks = 1;
+    }
+    if (first + nblocks > total_blocks) {
+        nblocks = total_blocks - first;
+    }
+
+    ext->buf = (uint8_t *)direct_buf;
+    ext->first_bid = first;
+    ext->nblocks = 0;
+    ext->reuse_seq = atomic_get_uint64_t(&file->num_reused_blocks);
+    ext->installable = 0;
+    for (size_t i = 0; i < nblocks; ++i) {
+        if (first + i != bid && !filemgr_is_writable(file, first + i)) {
+            ext->installable |= (uint64_t)1 << i;
+        }
+    }
+
+    ssize_t r = filemgr_read_blocks(file, direct_buf, nblocks, first);
+    if (r < (ssize_t)((bid - first + 1) * blocksize)) {
+        return r < 0 ? r : (ssize_t)FDB_RESULT_READ_FAIL;
+    }
+    memcpy(buf, (uint8_t *)direct_buf + (bid - first) * blocksize, blocksize);
+    if (file->encryption.ops) {
+        fdb_status status = fdb_decrypt_block(&file->encryption, buf,
+                                              blocksize, bid);
+        if (status != FDB_RESULT_SUCCESS) {
+            return status;
+        }
+    }
+    ext->nblocks = r / blocksize;
+    return blocksize;
+}
+
+static void _filemgr_install_direct_extent(struct filemgr *file,
+                                           struct filemgr_direct_extent *ext)
+{
+    for (size_t i = 0; i < ext->nblocks; ++i) {
+        if (ext->installable & ((uint64_t)1 << i)) {
+            _filemgr_install_block(file, ext->first_bid + i,
+                                   ext->buf + i * file->blocksize,
+                                   ext->reuse_seq);
+        }
+    }
+    ext->nblocks = 0;
+}
+
 void* alloc_buf_for_readahead() {
     void* ret = nullptr;
     if (!global_config.num_blocks_readahead) return ret;
@@ -2053,6 +2267,8 @@ fdb_status filemgr_read(struct filemgr *file, bid_t bid, void *buf,
         plock_entry_t *plock_entry = NULL;
         bid_t is_writer = 0;
         bool locked = false; (void)locked;
+        struct filemgr_direct_extent extent;
+        extent.nblocks = 0;
 
         r = bcache_read(file, bid, buf);
         if (r == 0) {
@@ -2104,8 +2320,14 @@ fdb_status filemgr_read(struct filemgr *file, bid_t bid, void *buf,
                 if (status != FDB_RESULT_SUCCESS) return status;
 
             } else {
-                // if normal file, just read a block
-                r = filemgr_read_block(file, buf, bid);
+                if (file->config->flag & _ARCH_O_DIRECT) {
+                    // no page cache underneath, read the aligned extent
+                    r = _filemgr_read_block_direct(file, buf, bid,
+                                                   total_blocks, &extent);
+                } else {
+                    // if normal file, just read a block
+                    r = filemgr_read_block(file, buf, bid);
+                }
                 if (r != (ssize_t)file->blocksize) {
                     _log_errno_str(file->ops, log_callback,
                                    (fdb_status) r, "READ", file->filename);
@@ -2174,6 +2396,11 @@ fdb_status filemgr_read(struct filemgr *file, bid_t bid, void *buf,
         if (locked) {
             plock_unlock(&file->plock, plock_entry);
         }
+        if (extent.nblocks) {
+            // The partial lock of 'bid' should be released first, as each
+            // block is cached under its own partial lock.
+            _filemgr_install_direct_extent(file, &extent);
+        }
     } else {
         if (!read_on_cache_miss) {
             const char *msg = "Read error: BID %" _F64 " in a database file '%s':"
@@ -2217,6 +2444,362 @@ fdb_status filemgr_read(struct filemgr *file, bid_t bid, void *buf,
     return status;
 }
 
+void *filemgr_read_pinned(struct filemgr *file, bid_t bid,
+                          struct bcache_item **pinned)
+{
+    *pinned = NULL;
+    if (global_config.ncacheblock <= 0 ||
+        bid * file->blocksize >= atomic_get_uint64_t(&file->pos)) {
+        return NULL;
+    }
+    return bcache_pin(file, bid, pinned);
+}
+
+void filemgr_unpin(struct bcache_item *pinned)
+{
+    bcache_unpin(pinned);
+}
+
+void filemgr_readahead_init(struct filemgr_readahead *ra)
+{
+    memset(ra, 0x0, sizeof(struct filemgr_readahead));
+    ra->last_bid = BLK_NOT_FOUND;
+    ra->next_bid = BLK_NOT_FOUND;
+}
+
+#if defined(_ASYNC_IO) && !defined(WIN32) && !defined(_WIN32)
+static void _filemgr_readahead_aio_destroy(struct filemgr_readahead *ra)
+{
+    ra->aio_ops->aio_destroy(ra->aio);
+    free(ra->aio);
+    ra->aio = NULL;
+    ra->aio_pending = 0;
+}
+
+// Reap completed async reads. If 'wait' is set, wait for all of them.
+static void _filemgr_readahead_reap(struct filemgr_readahead *ra,
+                                    bool wait,
+                                    err_log_callback *log_callback)
+{
+    struct io_event *io_evt;
+    int num_events;
+
+    while (ra->aio_pending) {
+        num_events = ra->aio_ops->aio_getevents(ra->aio,
+                                                wait ? ra->aio_pending : 0,
+                                                ra->aio_pending,
+                                                wait ? (unsigned int) -1 : 0);
+        if (num_events < 0) {
+            fdb_log(log_callback, FDB_LOG_WARNING, (fdb_status) num_events,
+                    "Error in getting async read-ahead events for a file '%s', "
+                    "falling back to synchronous read-ahead",
+                    ra->file->filename);
+            _filemgr_readahead_aio_destroy(ra);
+            return;
+        }
+        if (num_events == 0) {
+            break;
+        }
+        ra->aio_pending -= num_events;
+        for (io_evt = ra->aio->events; num_events > 0; --num_events, ++io_evt) {
+            uint64_t offset = *((uint64_t *) io_evt->data);
+            if (io_evt->res == ra->aio->block_size) {
+                _filemgr_install_block(ra->file, offset / ra->file->blocksize,
+                                       io_evt->obj->u.c.buf, ra->reuse_seq);
+            }
+        }
+        if (!wait) {
+            break;
+        }
+    }
+}
+
+// Issue async reads for the given blocks.
+static void _filemgr_readahead_submit(struct filemgr_readahead *ra,
+                                      bid_t *bids, size_t n,
+                                      err_log_callback *log_callback)
+{
+    size_t i;
+    for (i = 0; i < n; ++i) {
+        ra->aio_ops->aio_prep_read(ra->aio, i, ra->file->blocksize,
+                                   bids[i] * ra->file->blocksize);
+    }
+    int num_sub = ra->aio_ops->aio_submit(ra->aio, n);
+    if (num_sub < 0) {
+        fdb_log(log_callback, FDB_LOG_WARNING, (fdb_status) num_sub,
+                "Error in submitting async read-ahead requests to a file '%s', "
+                "falling back to synchronous read-ahead", ra->file->filename);
+        _filemgr_readahead_aio_destroy(ra);
+        return;
+    }
+    // requests that were not submitted are simply skipped.
+    ra->aio_pending = num_sub;
+    ra->aio_min_bid = ra->aio_max_bid = bids[0];
+    for (i = 1; i < (size_t)num_sub; ++i) {
+        ra->aio_min_bid = MIN(ra->aio_min_bid, bids[i]);
+        ra->aio_max_bid = MAX(ra->aio_max_bid, bids[i]);
+    }
+}
+#endif
+
+// Read the given blocks with a single batch of requests, one per run of
+// consecutive blocks, so that the blocks between them are not read.
+static void _filemgr_readahead_read_batch(struct filemgr_readahead *ra,
+                                          bid_t *bids, size_t n, bid_t first)
+{
+    struct filemgr *file = ra->file;
+    size_t blocksize = file->blocksize;
+    struct filemgr_io_req *reqs = alca(struct filemgr_io_req, n);
+    struct filemgr_io_req *req;
+    size_t i, nreqs = 0;
+
+    for (i = 0; i < n; ++i) {
+        uint8_t *dst = (uint8_t*)ra->buf + (bids[i] - first) * blocksize;
+        cs_off_t offset = (cs_off_t)bids[i] * blocksize;
+        req = nreqs ? &reqs[nreqs - 1] : NULL;
+        if (req && req->offset + (cs_off_t)req->count == offset) {
+            req->count += blocksize;
+        } else if (req && offset + (cs_off_t)blocksize == req->offset) {
+            // backward scan
+            req->buf = dst;
+            req->offset = offset;
+            req->count += blocksize;
+        } else {
+            req = &reqs[nreqs++];
+            req->buf = dst;
+            req->offset = offset;
+            req->count = blocksize;
+        }
+        req->result = 0;
+    }
+
+    file->ops->pread_batch(file->fd, reqs, nreqs);
+    for (i = 0; i < nreqs; ++i) {
+        if (reqs[i].result != (ssize_t)reqs[i].count) {
+            continue;
+        }
+        bid_t bid = reqs[i].offset / blocksize;
+        for (size_t j = 0; j < reqs[i].count / blocksize; ++j) {
+            _filemgr_install_block(ra->file, bid + j, (uint8_t*)reqs[i].buf +
+                                   j * blocksize, ra->reuse_seq);
+        }
+    }
+}
+
+// Read the given blocks synchronously. 'bids' should be consecutive
+// (in either direction), so that they are fetched with a single read.
+static void _filemgr_readahead_read(struct filemgr_readahead *ra,
+                                    bid_t *bids, size_t n)
+{
+    struct filemgr *file = ra->file;
+    bid_t first = MIN(bids[0], bids[n-1]);
+    bid_t last = MAX(bids[0], bids[n-1]);
+    size_t nblocks = last - first + 1;
+    ssize_t r;
+
+    if (!ra->buf) {
+        malloc_align(ra->buf, FDB_SECTOR_SIZE,
+                     (size_t)file->blocksize *
+                     global_config.adaptive_readahead_max_blocks);
+        if (!ra->buf) {
+            return;
+        }
+    }
+
+    if (file->ops->pread_batch) {
+        _filemgr_readahead_read_batch(ra, bids, n, first);
+        return;
+    }
+
+    r = filemgr_read_blocks(file, ra->buf, nblocks, first);
+    if (r <= 0) {
+        return;
+    }
+    // other blocks in the range (cached or writable ones) are not installed.
+    nblocks = r / file->blocksize;
+    for (size_t i = 0; i < n; ++i) {
+        if (bids[i] - first < nblocks) {
+            _filemgr_install_block(ra->file, bids[i], (uint8_t*)ra->buf +
+                                   (bids[i] - first) * file->blocksize,
+                                   ra->reuse_seq);
+        }
+    }
+}
+
+static void _filemgr_readahead_set_file(struct filemgr_readahead *ra,
+                                        struct filemgr *file)
+{
+    filemgr_readahead_stop(ra);
+    ra->file = file;
+
+#if defined(_ASYNC_IO) && !defined(WIN32) && !defined(_WIN32)
+    if (!ra->aio) {
+        ra->aio = (struct async_io_handle *)
+                  calloc(1, sizeof(struct async_io_handle));
+        ra->aio->queue_depth = global_config.adaptive_readahead_max_blocks;
+        ra->aio->block_size = file->blocksize;
+        ra->aio_ops = file->ops;
+        if (ra->aio_ops->aio_init(ra->aio) != FDB_RESULT_SUCCESS) {
+            free(ra->aio);
+            ra->aio = NULL;
+        }
+    }
+    if (ra->aio) {
+        ra->aio->fd = file->fd;
+    }
+#endif
+}
+
+void filemgr_readahead(struct filemgr_readahead *ra,
+                       struct filemgr *file,
+                       bid_t bid,
+                       err_log_callback *log_callback)
+{
+    uint32_t max_window = global_config.adaptive_readahead_max_blocks;
+    if (!max_window || global_config.ncacheblock <= 0 ||
+        global_config.do_not_cache_doc_blocks) {
+        return;
+    }
+
+    if (ra->file != file) {
+        _filemgr_readahead_set_file(ra, file);
+    }
+
+#if defined(_ASYNC_IO) && !defined(WIN32) && !defined(_WIN32)
+    if (ra->aio_pending) {
+        // wait if the block is being read ahead, to avoid reading it twice.
+        _filemgr_readahead_reap(ra,
+                                bid >= ra->aio_min_bid && bid <= ra->aio_max_bid,
+                                log_callback);
+    }
+#endif
+
+    if (ra->last_bid == BLK_NOT_FOUND) {
+        ra->last_bid = bid;
+        return;
+    }
+
+    // Jumps within the blocks read ahead already, or small jumps otherwise
+    // (e.g., over index nodes written between document blocks), are
+    // regarded as a sequential run.
+    int64_t step = (int64_t)bid - (int64_t)ra->last_bid;
+    if (step == 0) {
+        return;
+    }
+    if ((ra->stride == 1 || ra->stride == -1) &&
+        ra->next_bid != BLK_NOT_FOUND && step * ra->stride > 0 &&
+        ((int64_t)ra->next_bid - (int64_t)bid) * ra->stride > 0) {
+        step = ra->stride;
+    } else if (step > 0 && step <= FILEMGR_READAHEAD_MAX_GAP) {
+        step = 1;
+    } else if (step < 0 && step >= -FILEMGR_READAHEAD_MAX_GAP) {
+        step = -1;
+    }
+    ra->last_bid = bid;
+
+    if (step != ra->stride) {
+        // a new run starts.
+        ra->stride = step;
+        ra->nhits = 1;
+        ra->window = 0;
+        ra->next_bid = BLK_NOT_FOUND;
+        return;
+    }
+    if (++ra->nhits < FILEMGR_READAHEAD_TRIGGER) {
+        return;
+    }
+    if (step != 1 && step != -1 && !ra->aio) {
+        // reading strided blocks synchronously is not beneficial.
+        return;
+    }
+    if (ra->aio_pending) {
+        // the previous batch is still in flight.
+        return;
+    }
+
+    int64_t ahead = -1;
+    if (ra->next_bid != BLK_NOT_FOUND) {
+        ahead = ((int64_t)ra->next_bid - (int64_t)bid) / step - 1;
+    }
+    if (ahead < 0) {
+        // nothing has been read ahead yet, or the reader has overtaken it.
+        ra->next_bid = bid + step;
+        ahead = 0;
+    }
+    if (!ra->window) {
+        ra->window = MIN(MIN_READAHEAD_BLOCKS, max_window);
+    }
+    if (ahead > ra->window / 2) {
+        // enough blocks have been read ahead.
+        return;
+    }
+
+    // Collect blocks in the next window that are committed and not cached.
+    bid_t *bids = alca(bid_t, ra->window);
+    size_t n = 0;
+    int64_t limit = atomic_get_uint64_t(&file->pos) / file->blocksize;
+    int64_t next = ra->next_bid;
+    ra->reuse_seq = atomic_get_uint64_t(&file->num_reused_blocks);
+    for (uint32_t i = 0; i < ra->window; ++i, next += step) {
+        if (next < 0 || next >= limit) {
+            break;
+        }
+        struct bcache_item *pinned;
+        if (bcache_pin(file, next, &pinned)) {
+            bcache_unpin(pinned);
+            continue;
+        }
+        if (filemgr_is_writable(file, next)) {
+            continue;
+        }
+        bids[n++] = next;
+    }
+    ra->next_bid = next;
+    ra->window = MIN(ra->window * 2, max_window);
+
+    if (!n) {
+        return;
+    }
+#if defined(_ASYNC_IO) && !defined(WIN32) && !defined(_WIN32)
+    if (ra->aio) {
+        _filemgr_readahead_submit(ra, bids, n, log_callback);
+        if (ra->aio) {
+            return;
+        }
+    }
+#endif
+    _filemgr_readahead_read(ra, bids, n);
+}
+
+void filemgr_readahead_stop(struct filemgr_readahead *ra)
+{
+#if defined(_ASYNC_IO) && !defined(WIN32) && !defined(_WIN32)
+    if (ra->aio_pending) {
+        _filemgr_readahead_reap(ra, true, NULL);
+    }
+#endif
+    ra->file = NULL;
+    ra->last_bid = BLK_NOT_FOUND;
+    ra->stride = 0;
+    ra->nhits = 0;
+    ra->window = 0;
+    ra->next_bid = BLK_NOT_FOUND;
+}
+
+void filemgr_readahead_free(struct filemgr_readahead *ra)
+{
+    if (ra->file) {
+        filemgr_readahead_stop(ra);
+    }
+#if defined(_ASYNC_IO) && !defined(WIN32) && !defined(_WIN32)
+    if (ra->aio) {
+        _filemgr_readahead_aio_destroy(ra);
+    }
+#endif
+    free_align(ra->buf);
+    ra->buf = NULL;
+}
+
 fdb_status filemgr_write_offset(struct filemgr *file, bid_t bid,
                                 uint64_t offset, uint64_t len, void *buf,
                                 bool final_write,
@@ -2374,6 +2957,46 @@ fdb_status filemgr_commit(struct filemgr *file, bool sync,
                               sync, log_callback);
 }
 
+static int _filemgr_fsync(struct filemgr *file)
+{
+    LATENCY_STAT_START();
+    int rv = file->ops->fsync(file->fd);
+    LATENCY_STAT_END(file, FDB_LATENCY_FSYNC);
+    return rv;
+}
+
+// Write a DB header block. If 'sync' is set and the I/O engine supports
+// batched writes, the write is linked with a data sync and 'synced' is set.
+static fdb_status _filemgr_write_header_block(struct filemgr *file, void *buf,
+                                              bid_t bid, bool sync,
+                                              bool *synced,
+                                              err_log_callback *log_callback)
+{
+    if (sync && file->ops->pwrite_batch && file->encryption.ops == NULL) {
+        struct filemgr_io_req req;
+        req.buf = buf;
+        req.count = file->blocksize;
+        req.offset = (cs_off_t)bid * file->blocksize;
+        req.result = 0;
+        LATENCY_STAT_START();
+        fdb_status fs = (fdb_status) file->ops->pwrite_batch(file->fd, &req,
+                                                             1, true);
+        LATENCY_STAT_END(file, FDB_LATENCY_FSYNC);
+        _log_errno_str(file->ops, log_callback, fs, "WRITE+FSYNC",
+                       file->filename);
+        *synced = (fs == FDB_RESULT_SUCCESS);
+        return fs;
+    }
+
+    ssize_t rv = filemgr_write_blocks(file, buf, 1, bid);
+    _log_errno_str(file->ops, log_callback, (fdb_status) rv,
+                   "WRITE", file->filename);
+    if (rv != (ssize_t)file->blocksize) {
+        return rv < 0 ? (fdb_status) rv : FDB_RESULT_WRITE_FAIL;
+    }
+    return FDB_RESULT_SUCCESS;
+}
+
 fdb_status filemgr_commit_bid(struct filemgr *file, bid_t bid,
                               uint64_t bmp_revnum, bool sync,
                               err_log_callback *log_callback)
@@ -2386,6 +3009,10 @@ fdb_status filemgr_commit_bid(struct filemgr *file, bid_t bid,
     filemgr_header_revnum_t _revnum;
     int result = FDB_RESULT_SUCCESS;
     bool block_reusing = false;
+    void *header_buf = NULL;
+    bid_t header_bid = BLK_NOT_FOUND;
+    uint64_t last_commit;
+    bool update_bmp_revnum = false;
 
     filemgr_set_io_inprog(file);
     uint64_t exp_filesize = atomic_get_uint64_t(&file->pos);
@@ -2495,52 +3122,75 @@ fdb_status filemgr_commit_bid(struct filemgr *file, bid_t bid,
             bcache_invalidate_block(file, bid);
         }
 
-        ssize_t rv = filemgr_write_blocks(file, buf, 1, bid);
-        _log_errno_str(file->ops, log_callback, (fdb_status) rv,
-                       "WRITE", file->filename);
-        if (rv != (ssize_t)file->blocksize) {
-            _filemgr_release_temp_buf(buf);
-            spin_unlock(&file->lock);
-            filemgr_clear_io_inprog(file);
-            return rv < 0 ? (fdb_status) rv : FDB_RESULT_WRITE_FAIL;
-        }
-
-        if (prev_bid) {
-            // mark prev DB header as stale
-            filemgr_add_stale_block(file, prev_bid * file->blocksize, file->blocksize);
-        }
-
-        atomic_store_uint64_t(&file->header.bid, bid);
         if (!block_reusing) {
+            // reserve the header block; it is written after releasing the
+            // lock, and becomes the current header once the write is done.
             atomic_add_uint64_t(&file->pos, file->blocksize);
         }
-
-        _filemgr_release_temp_buf(buf);
+        header_buf = buf;
+        header_bid = bid;
     }
 
     if (sb_bmp_exists(file->sb) &&
         atomic_get_uint64_t(&file->sb->cur_alloc_bid) != BLK_NOT_FOUND &&
         atomic_get_uint8_t(&file->status) == FILE_NORMAL) {
         // block reusing is currently enabled
-        atomic_store_uint64_t(&file->last_commit,
-            atomic_get_uint64_t(&file->sb->cur_alloc_bid) * file->blocksize);
+        last_commit = atomic_get_uint64_t(&file->sb->cur_alloc_bid) *
+                      file->blocksize;
         // Since some more blocks may be allocated after the header block
         // (for storing BMP data or system docs for stale info)
         // so that the block pointed to by 'cur_alloc_bid' may have
         // different BMP revision number. So we have to use the
         // up-to-date bmp_revnum here.
-        atomic_store_uint64_t(&file->last_writable_bmp_revnum,
-                              filemgr_get_sb_bmp_revnum(file));
+        update_bmp_revnum = true;
     } else {
-        atomic_store_uint64_t(&file->last_commit, atomic_get_uint64_t(&file->pos));
+        last_commit = atomic_get_uint64_t(&file->pos);
         // WARNING: if `last_commit` is at the end of file,
         //          we should NOT update `last_writable_bmp_revnum`.
     }
 
     spin_unlock(&file->lock);
 
+    if (header_buf) {
+        bool synced = false;
+        result = _filemgr_write_header_block(file, header_buf, header_bid,
+                                             sync, &synced, log_callback);
+        if (result != FDB_RESULT_SUCCESS) {
+            if (!block_reusing) {
+                // give the reserved block back, unless the file has grown
+                // in the meantime; 'last_commit' has not been moved yet.
+                uint64_t reserved_end = (header_bid + 1) * file->blocksize;
+                atomic_cas_uint64_t(&file->pos, reserved_end,
+                                    reserved_end - file->blocksize);
+            }
+            _filemgr_release_temp_buf(header_buf);
+            filemgr_clear_io_inprog(file);
+            return (fdb_status) result;
+        }
+        _filemgr_release_temp_buf(header_buf);
+        if (synced) {
+            sync = false;
+        }
+    }
+
+    // the commit point moves only once its DB header is written
+    spin_lock(&file->lock);
+    if (header_bid != BLK_NOT_FOUND) {
+        if (prev_bid) {
+            // mark prev DB header as stale
+            filemgr_add_stale_block(file, prev_bid * file->blocksize, file->blocksize);
+        }
+        atomic_store_uint64_t(&file->header.bid, header_bid);
+    }
+    atomic_store_uint64_t(&file->last_commit, last_commit);
+    if (update_bmp_revnum) {
+        atomic_store_uint64_t(&file->last_writable_bmp_revnum,
+                              filemgr_get_sb_bmp_revnum(file));
+    }
+    spin_unlock(&file->lock);
+
     if (sync) {
-        result = file->ops->fsync(file->fd);
+        result = _filemgr_fsync(file);
         _log_errno_str(file->ops, log_callback, (fdb_status)result,
                        "FSYNC", file->filename);
     }
@@ -2565,7 +3215,7 @@ fdb_status filemgr_sync(struct filemgr *file, bool sync_option,
     }
 
     if (sync_option && file->fflags & FILEMGR_SYNC) {
-        int rv = file->ops->fsync(file->fd);
+        int rv = _filemgr_fsync(file);
         _log_errno_str(file->ops, log_callback, (fdb_status)rv, "FSYNC", file->filename);
         return (fdb_status) rv;
     }
@@ -2574,6 +3224,102 @@ fdb_status filemgr_sync(struct filemgr *file, bool sync_option,
     return result;
 }
 
+// Interval at which the group commit leader checks whether the other
+// committers have written their DB headers.
+#define FILEMGR_GROUP_COMMIT_POLL_US (50)
+
+void filemgr_group_commit_enter(struct filemgr *file)
+{
+    struct filemgr_group_commit *gc = &file->group_commit;
+    mutex_lock(&gc->lock);
+    gc->num_pending++;
+    mutex_unlock(&gc->lock);
+}
+
+void filemgr_group_commit_leave(struct filemgr *file)
+{
+    struct filemgr_group_commit *gc = &file->group_commit;
+    mutex_lock(&gc->lock);
+    gc->num_pending--;
+    mutex_unlock(&gc->lock);
+}
+
+uint64_t filemgr_group_commit_written(struct filemgr *file)
+{
+    struct filemgr_group_commit *gc = &file->group_commit;
+    uint64_t seq;
+    mutex_lock(&gc->lock);
+    gc->num_pending--;
+    seq = ++gc->written_seq;
+    mutex_unlock(&gc->lock);
+    return seq;
+}
+
+fdb_status filemgr_group_commit_sync(struct filemgr *file, uint64_t seq,
+                                     uint32_t window,
+                                     err_log_callback *log_callback)
+{
+    struct filemgr_group_commit *gc = &file->group_commit;
+    fdb_status fs = FDB_RESULT_SUCCESS;
+
+    mutex_lock(&gc->lock);
+    while (gc->synced_seq < seq) {
+        if (gc->syncing) {
+            // follower: wait for the current leader.
+            thread_cond_wait(&gc->cond, &gc->lock);
+            continue;
+        }
+
+        // leader: let the committers that are still building their
+        // headers join this sync, as long as the window allows.
+        gc->syncing = true;
+        uint32_t waited = 0;
+        while (gc->num_pending && waited < window) {
+            mutex_unlock(&gc->lock);
+            usleep(FILEMGR_GROUP_COMMIT_POLL_US);
+            waited += FILEMGR_GROUP_COMMIT_POLL_US;
+            mutex_lock(&gc->lock);
+        }
+        uint64_t from = gc->synced_seq + 1;
+        uint64_t to = gc->written_seq;
+        mutex_unlock(&gc->lock);
+
+        // all the headers up to 'to' have been written already.
+        fs = (fdb_status) _filemgr_fsync(file);
+        _log_errno_str(file->ops, log_callback, fs, "FSYNC", file->filename);
+
+        uint64_t batch = to - from + 1;
+        atomic_incr_uint64_t(&gc->num_syncs, std::memory_order_relaxed);
+        atomic_add_uint64_t(&gc->num_commits, batch,
+                            std::memory_order_relaxed);
+        if (batch > atomic_get_uint64_t(&gc->max_batch,
+                                        std::memory_order_relaxed)) {
+            atomic_store_uint64_t(&gc->max_batch, batch,
+                                  std::memory_order_relaxed);
+        }
+
+        mutex_lock(&gc->lock);
+        if (fs != FDB_RESULT_SUCCESS) {
+            // The failure is kept for the followers of this sync. As the
+            // contents of a file whose sync failed are unknown, the range
+            // is extended by any later failure rather than replaced.
+            if (gc->failed_to + 1 < from) {
+                gc->failed_from = from;
+            }
+            gc->failed_to = to;
+            gc->failed_status = fs;
+        }
+        gc->synced_seq = to;
+        gc->syncing = false;
+        thread_cond_broadcast(&gc->cond);
+    }
+    if (seq >= gc->failed_from && seq <= gc->failed_to) {
+        fs = gc->failed_status;
+    }
+    mutex_unlock(&gc->lock);
+    return fs;
+}
+
 fdb_status filemgr_copy_file_range(struct filemgr *src_file,
                                    struct filemgr *dst_file,
                                    bid_t src_bid, bid_t dst_bid,
@@ -2902,7 +3648,7 @@ fdb_status filemgr_destroy_file(char *filename,
         file = (struct filemgr *)alca(struct filemgr, 1);
         memset(file, 0x0, sizeof(struct filemgr));
         file->filename = filename;
-        file->ops = get_filemgr_ops();
+        file->ops = filemgr_get_ops();
         file->fd = file->ops->open(file->filename, O_RDWR, 0666);
         file->blocksize = global_config.blocksize;
         file->config = (struct filemgr_config *)alca(struct filemgr_config, 1);
@@ -3084,11 +3830,14 @@ void filemgr_mutex_openunlock(void)
 void filemgr_mutex_lock(struct filemgr *file)
 {
     mutex_lock(&file->writer_lock.mutex);
+    // wait for the shared writers in progress
+    writer_lock(&file->writer_lock.shared);
     file->writer_lock.locked = true;
 }
 
 bool filemgr_mutex_trylock(struct filemgr *file) {
     if (mutex_trylock(&file->writer_lock.mutex)) {
+        writer_lock(&file->writer_lock.shared);
         file->writer_lock.locked = true;
         return true;
     }
@@ -3099,10 +3848,27 @@ void filemgr_mutex_unlock(struct filemgr *file)
 {
     if (file->writer_lock.locked) {
         file->writer_lock.locked = false;
+        writer_unlock(&file->writer_lock.shared);
         mutex_unlock(&file->writer_lock.mutex);
     }
 }
 
+void filemgr_mutex_lock_shared(struct filemgr *file, fdb_kvs_id_t kv_id)
+{
+    // pass through the mutex so that a waiting exclusive writer is not
+    // starved by a stream of shared writers.
+    mutex_lock(&file->writer_lock.mutex);
+    reader_lock(&file->writer_lock.shared);
+    mutex_unlock(&file->writer_lock.mutex);
+    mutex_lock(&file->kvs_writer_lock[kv_id % FILEMGR_KVS_WRITER_LOCKS]);
+}
+
+void filemgr_mutex_unlock_shared(struct filemgr *file, fdb_kvs_id_t kv_id)
+{
+    mutex_unlock(&file->kvs_writer_lock[kv_id % FILEMGR_KVS_WRITER_LOCKS]);
+    reader_unlock(&file->writer_lock.shared);
+}
+
 bool filemgr_is_commit_header(void *head_buffer, size_t blocksize)
 {
     uint8_t marker[BLK_MARKER_SIZE];
@@ -3212,6 +3978,7 @@ void filemgr_add_stale_block(struct filemgr *file,
         struct stale_data *item;
         struct list_elem *e;
 
+        spin_lock(&file->stale_list_lock);
         e = list_end(file->stale_list);
 
         if (e) {
@@ -3219,6 +3986,7 @@ void filemgr_add_stale_block(struct filemgr *file,
             if (item->pos + item->len == pos) {
                 // merge if consecutive item
                 item->len += len;
+                spin_unlock(&file->stale_list_lock);
                 return;
             }
         }
@@ -3227,6 +3995,7 @@ void filemgr_add_stale_block(struct filemgr *file,
         item->pos = pos;
         item->len = len;
         list_push_back(file->stale_list, &item->le);
+        spin_unlock(&file->stale_list_lock);
     }
 }
 
@@ -4108,50 +4877,148 @@ const char *filemgr_latency_stat_name(fdb_latency_stat_type stat)
         case FDB_LATENCY_OPEN:          return "fdb_open        ";
         case FDB_LATENCY_KVS_OPEN:      return "fdb_kvs_open    ";
         case FDB_LATENCY_SNAP_CLONE:    return "clone-snapshot  ";
+        case FDB_LATENCY_WAL_FLUSH:     return "wal-flush       ";
+        case FDB_LATENCY_BCACHE_FLUSH:  return "bcache-flush    ";
+        case FDB_LATENCY_FSYNC:         return "fsync           ";
     }
     return NULL;
 }
 
 #ifdef _LATENCY_STATS
 void filemgr_init_latency_stat(struct latency_stat *val) {
-    atomic_init_uint32_t(&val->lat_max, 0);
-    atomic_init_uint32_t(&val->lat_min, (uint32_t)(-1));
-    atomic_init_uint64_t(&val->lat_sum, 0);
-    atomic_init_uint64_t(&val->lat_num, 0);
+    for (int i = 0; i < LATENCY_STAT_SHARDS; ++i) {
+        struct latency_stat_shard *shard = &val->shards[i];
+        atomic_init_uint32_t(&shard->lat_max, 0);
+        atomic_init_uint32_t(&shard->lat_min, (uint32_t)(-1));
+        atomic_init_uint64_t(&shard->lat_sum, 0);
+        atomic_init_uint64_t(&shard->lat_num, 0);
+        for (int j = 0; j < LATENCY_HIST_NUM_BUCKETS; ++j) {
+            atomic_init_uint64_t(&shard->buckets[j], 0);
+        }
+    }
+}
+
+// Sum of all the shards of a latency stat.
+struct latency_stat_sum {
+    uint32_t lat_min;
+    uint32_t lat_max;
+    uint64_t lat_sum;
+    uint64_t lat_num;
+    uint64_t buckets[LATENCY_HIST_NUM_BUCKETS];
+};
+
+static void _filemgr_sum_latency_stat(struct latency_stat *val,
+                                      struct latency_stat_sum *sum,
+                                      bool with_buckets)
+{
+    sum->lat_min = (uint32_t)(-1);
+    sum->lat_max = 0;
+    sum->lat_sum = 0;
+    sum->lat_num = 0;
+    if (with_buckets) {
+        memset(sum->buckets, 0, sizeof(sum->buckets));
+    }
+    for (int i = 0; i < LATENCY_STAT_SHARDS; ++i) {
+        struct latency_stat_shard *shard = &val->shards[i];
+        uint32_t lat_min = atomic_get_uint32_t(&shard->lat_min,
+                                               std::memory_order_relaxed);
+        uint32_t lat_max = atomic_get_uint32_t(&shard->lat_max,
+                                               std::memory_order_relaxed);
+        sum->lat_min = MIN(sum->lat_min, lat_min);
+        sum->lat_max = MAX(sum->lat_max, lat_max);
+        sum->lat_sum += atomic_get_uint64_t(&shard->lat_sum,
+                                            std::memory_order_relaxed);
+        sum->lat_num += atomic_get_uint64_t(&shard->lat_num,
+                                            std::memory_order_relaxed);
+        if (with_buckets) {
+            for (int j = 0; j < LATENCY_HIST_NUM_BUCKETS; ++j) {
+                sum->buckets[j] +=
+                    atomic_get_uint64_t(&shard->buckets[j],
+                                        std::memory_order_relaxed);
+            }
+        }
+    }
 }
 
 void filemgr_migrate_latency_stats(struct filemgr *src, struct filemgr *dst) {
-    for (int type = 0; type < FDB_LATENCY_NUM_STATS; ++type) {
-        atomic_store_uint32_t(&dst->lat_stats[type].lat_min,
-                              atomic_get_uint32_t(&src->lat_stats[type].lat_min),
+    struct latency_stat_sum *sum = (struct latency_stat_sum *)
+                                   malloc(sizeof(struct latency_stat_sum));
+    if (!sum) {
+        return;
+    }
+    for (int type = 0; type < FDB_LATENCY_NUM_ALL_STATS; ++type) {
+        // the sum of the source shards is moved into the first shard of
+        // the destination.
+        _filemgr_sum_latency_stat(&src->lat_stats[type], sum, true);
+        filemgr_init_latency_stat(&dst->lat_stats[type]);
+        struct latency_stat_shard *shard = &dst->lat_stats[type].shards[0];
+        atomic_store_uint32_t(&shard->lat_min, sum->lat_min,
                               std::memory_order_relaxed);
-        atomic_store_uint32_t(&dst->lat_stats[type].lat_max,
-                              atomic_get_uint32_t(&src->lat_stats[type].lat_max),
+        atomic_store_uint32_t(&shard->lat_max, sum->lat_max,
                               std::memory_order_relaxed);
-        atomic_store_uint64_t(&dst->lat_stats[type].lat_sum,
-                              atomic_get_uint64_t(&src->lat_stats[type].lat_sum),
+        atomic_store_uint64_t(&shard->lat_sum, sum->lat_sum,
                               std::memory_order_relaxed);
-        atomic_store_uint64_t(&dst->lat_stats[type].lat_num,
-                              atomic_get_uint64_t(&src->lat_stats[type].lat_num),
+        atomic_store_uint64_t(&shard->lat_num, sum->lat_num,
                               std::memory_order_relaxed);
+        for (int j = 0; j < LATENCY_HIST_NUM_BUCKETS; ++j) {
+            atomic_store_uint64_t(&shard->buckets[j], sum->buckets[j],
+                                  std::memory_order_relaxed);
+        }
     }
+    free(sum);
 }
 
 void filemgr_destroy_latency_stat(struct latency_stat *val) {
     (void) val;
 }
 
+static INLINE int _latency_hist_bucket(uint32_t val)
+{
+    if (val < LATENCY_HIST_SUB_BUCKETS) {
+        return val;
+    }
+#if defined(__GNUC__) || defined(__clang__)
+    int msb = 31 - __builtin_clz(val);
+#else
+    int msb = LATENCY_HIST_SUB_BITS;
+    while (val >> (msb + 1)) {
+        ++msb;
+    }
+#endif
+    int shift = msb - LATENCY_HIST_SUB_BITS;
+    return LATENCY_HIST_SUB_BUCKETS * (shift + 1) +
+           (int)(val >> shift) - LATENCY_HIST_SUB_BUCKETS;
+}
+
+// Largest value that falls into the given bucket.
+static uint32_t _latency_hist_bucket_max(int bucket)
+{
+    if (bucket < LATENCY_HIST_SUB_BUCKETS) {
+        return bucket;
+    }
+    int shift = bucket / LATENCY_HIST_SUB_BUCKETS - 1;
+    uint64_t base = LATENCY_HIST_SUB_BUCKETS + bucket % LATENCY_HIST_SUB_BUCKETS;
+    return (uint32_t)(((base + 1) << shift) - 1);
+}
+
 void filemgr_update_latency_stat(struct filemgr *file,
                                  fdb_latency_stat_type type,
                                  uint32_t val)
 {
+    // Each thread sticks to one shard, so that min/max rarely need to retry
+    // and counters are not bounced between the cores.
+    static atomic_uint32_t next_shard(0);
+    thread_local uint32_t shard_no =
+        atomic_incr_uint32_t(&next_shard, std::memory_order_relaxed) %
+        LATENCY_STAT_SHARDS;
+    struct latency_stat_shard *shard = &file->lat_stats[type].shards[shard_no];
+
     int retry = MAX_STAT_UPDATE_RETRIES;
     do {
-        uint32_t lat_max = atomic_get_uint32_t(&file->lat_stats[type].lat_max,
+        uint32_t lat_max = atomic_get_uint32_t(&shard->lat_max,
                                                std::memory_order_relaxed);
         if (lat_max < val) {
-            if (!atomic_cas_uint32_t(&file->lat_stats[type].lat_max,
-                                     lat_max, val)) {
+            if (!atomic_cas_uint32_t(&shard->lat_max, lat_max, val)) {
                 continue;
             }
         }
@@ -4159,38 +5026,72 @@ void filemgr_update_latency_stat(struct filemgr *file,
     } while (--retry);
     retry = MAX_STAT_UPDATE_RETRIES;
     do {
-        uint32_t lat_min = atomic_get_uint32_t(&file->lat_stats[type].lat_min,
+        uint32_t lat_min = atomic_get_uint32_t(&shard->lat_min,
                                                std::memory_order_relaxed);
         if (val < lat_min) {
-            if (!atomic_cas_uint32_t(&file->lat_stats[type].lat_min,
-                                     lat_min, val)) {
+            if (!atomic_cas_uint32_t(&shard->lat_min, lat_min, val)) {
                 continue;
             }
         }
         break;
     } while (--retry);
-    atomic_add_uint64_t(&file->lat_stats[type].lat_sum, val,
-                        std::memory_order_relaxed);
-    atomic_incr_uint64_t(&file->lat_stats[type].lat_num,
+    atomic_add_uint64_t(&shard->lat_sum, val, std::memory_order_relaxed);
+    atomic_incr_uint64_t(&shard->lat_num, std::memory_order_relaxed);
+    atomic_incr_uint64_t(&shard->buckets[_latency_hist_bucket(val)],
                          std::memory_order_relaxed);
 }
 
 void filemgr_get_latency_stat(struct filemgr *file, fdb_latency_stat_type type,
                               fdb_latency_stat *stat)
 {
-    uint64_t num = atomic_get_uint64_t(&file->lat_stats[type].lat_num,
-                                       std::memory_order_relaxed);
-    if (!num) {
+    struct latency_stat_sum sum;
+    _filemgr_sum_latency_stat(&file->lat_stats[type], &sum, false);
+    if (!sum.lat_num) {
         memset(stat, 0, sizeof(fdb_latency_stat));
         return;
     }
-    stat->lat_max = atomic_get_uint32_t(&file->lat_stats[type].lat_max,
-                                        std::memory_order_relaxed);
-    stat->lat_min = atomic_get_uint32_t(&file->lat_stats[type].lat_min,
-                                        std::memory_order_relaxed);
-    stat->lat_count = num;
-    stat->lat_avg = atomic_get_uint64_t(&file->lat_stats[type].lat_sum,
-                                        std::memory_order_relaxed) / num;
+    stat->lat_max = sum.lat_max;
+    stat->lat_min = sum.lat_min;
+    stat->lat_count = sum.lat_num;
+    stat->lat_avg = sum.lat_sum / sum.lat_num;
+}
+
+// Smallest bucket bound that covers 'permille' of the samples.
+static uint32_t _latency_hist_percentile(struct latency_stat_sum *sum,
+                                         uint64_t permille)
+{
+    uint64_t rank = (sum->lat_num * permille + 999) / 1000;
+    uint64_t count = 0;
+    for (int i = 0; i < LATENCY_HIST_NUM_BUCKETS; ++i) {
+        count += sum->buckets[i];
+        if (count >= rank && count) {
+            return MIN(_latency_hist_bucket_max(i), sum->lat_max);
+        }
+    }
+    return sum->lat_max;
+}
+
+void filemgr_get_latency_histogram(struct filemgr *file,
+                                   fdb_latency_stat_type type,
+                                   fdb_latency_histogram *hist)
+{
+    struct latency_stat_sum *sum = (struct latency_stat_sum *)
+                                   malloc(sizeof(struct latency_stat_sum));
+    memset(hist, 0, sizeof(fdb_latency_histogram));
+    if (!sum) {
+        return;
+    }
+    _filemgr_sum_latency_stat(&file->lat_stats[type], sum, true);
+    if (sum->lat_num) {
+        hist->lat_count = sum->lat_num;
+        hist->lat_min = sum->lat_min;
+        hist->lat_max = sum->lat_max;
+        hist->lat_p50 = _latency_hist_percentile(sum, 500);
+        hist->lat_p90 = _latency_hist_percentile(sum, 900);
+        hist->lat_p99 = _latency_hist_percentile(sum, 990);
+        hist->lat_p999 = _latency_hist_percentile(sum, 999);
+    }
+    free(sum);
 }
 
 #ifdef _LATENCY_STATS_DUMP_TO_FILE
@@ -4208,25 +5109,21 @@ void filemgr_dump_latency_stat(struct filemgr *file,
         fdb_log(log_callback, FDB_LOG_ERROR, status, msg, latency_file_path);
         return;
     }
-    fprintf(lat_file, "latency(us)\t\tmin\t\tavg\t\tmax\t\tnum_samples\n");
-    for (int i = 0; i < FDB_LATENCY_NUM_STATS; ++i) {
-        uint32_t avg;
-        uint64_t num;
-        num = atomic_get_uint64_t(&file->lat_stats[i].lat_num,
-                                  std::memory_order_relaxed);
-        if (!num) {
+    fprintf(lat_file, "latency(us)\t\tmin\t\tavg\t\tp50\t\tp99\t\tp99.9"
+            "\t\tmax\t\tnum_samples\n");
+    for (int i = 0; i < FDB_LATENCY_NUM_ALL_STATS; ++i) {
+        fdb_latency_stat stat;
+        fdb_latency_histogram hist;
+        filemgr_get_latency_stat(file, i, &stat);
+        if (!stat.lat_count) {
             continue;
         }
-        avg = atomic_get_uint64_t(&file->lat_stats[i].lat_sum,
-                                  std::memory_order_relaxed) / num;
-        fprintf(lat_file, "%s:\t\t%u\t\t%u\t\t%u\t\t%" _F64 "\n",
+        filemgr_get_latency_histogram(file, i, &hist);
+        fprintf(lat_file, "%s:\t\t%u\t\t%u\t\t%u\t\t%u\t\t%u\t\t%u\t\t%"
+                _F64 "\n",
                 filemgr_latency_stat_name(i),
-                atomic_get_uint32_t(&file->lat_stats[i].lat_min,
-                                    std::memory_order_relaxed),
-                avg,
-                atomic_get_uint32_t(&file->lat_stats[i].lat_max,
-                                    std::memory_order_relaxed),
-                num);
+                stat.lat_min, stat.lat_avg, hist.lat_p50, hist.lat_p99,
+                hist.lat_p999, stat.lat_max, stat.lat_count);
     }
     fflush(lat_file);
     fclose(lat_file);
@@ -79,6 +79,10 @@ struct filemgr_config {
                               std::memory_order_relaxed);
         do_not_cache_doc_blocks = config.do_not_cache_doc_blocks;
         num_blocks_readahead = config.num_blocks_readahead;
+        bcache_policy = config.bcache_policy;
+        adaptive_readahead_max_blocks = config.adaptive_readahead_max_blocks;
+        io_engine = config.io_engine;
+        num_wal_prefetch_threads = config.num_wal_prefetch_threads;
         return *this;
     }
 
@@ -100,6 +104,10 @@ struct filemgr_config {
     atomic_uint64_t num_keeping_headers;
     bool do_not_cache_doc_blocks;
     uint32_t num_blocks_readahead;
+    fdb_bcache_policy_t bcache_policy;
+    uint32_t adaptive_readahead_max_blocks;
+    fdb_io_engine_t io_engine;
+    uint32_t num_wal_prefetch_threads;
 };
 
 #ifndef _LATENCY_STATS
@@ -113,11 +121,28 @@ struct filemgr_config {
         uint64_t end = get_monotonic_ts();\
         filemgr_update_latency_stat(file, type, ts_diff(begin, end));} while(0)
 
-struct latency_stat {
+// Latencies are recorded in a log-linear histogram: values below
+// LATENCY_HIST_SUB_BUCKETS have their own buckets, and every power-of-two
+// range above is split into LATENCY_HIST_SUB_BUCKETS buckets, so that the
+// relative error of a percentile is at most 1/LATENCY_HIST_SUB_BUCKETS.
+#define LATENCY_HIST_SUB_BITS (5)
+#define LATENCY_HIST_SUB_BUCKETS (1 << LATENCY_HIST_SUB_BITS)
+#define LATENCY_HIST_NUM_BUCKETS \
+    ((32 - LATENCY_HIST_SUB_BITS + 1) * LATENCY_HIST_SUB_BUCKETS)
+// Number of shards of each latency stat; threads are spread across them so
+// that they do not contend on the same counters.
+#define LATENCY_STAT_SHARDS (4)
+
+struct latency_stat_shard {
     atomic_uint32_t lat_min;
     atomic_uint32_t lat_max;
     atomic_uint64_t lat_sum;
     atomic_uint64_t lat_num;
+    atomic_uint64_t buckets[LATENCY_HIST_NUM_BUCKETS];
+};
+
+struct latency_stat {
+    struct latency_stat_shard shards[LATENCY_STAT_SHARDS];
 };
 
 #endif // _LATENCY_STATS
@@ -137,6 +162,42 @@ struct async_io_handle {
     int fd;
 };
 
+/**
+ * Per-reader state of the adaptive read-ahead.
+ *
+ * Block accesses of a reader (e.g., a DocIO handle) are tracked to detect
+ * a sequential run in either direction (small gaps are tolerated) or a fixed
+ * stride. Once a run is detected, blocks ahead of the reader are read into
+ * the buffer cache, and the window grows from MIN_READAHEAD_BLOCKS up to
+ * 'adaptive_readahead_max_blocks' as long as the run continues.
+ */
+struct filemgr_readahead {
+    struct filemgr *file;
+    // last block accessed by the reader
+    bid_t last_bid;
+    // distance between consecutive blocks of the current run
+    // (+1/-1 for a sequential run)
+    int64_t stride;
+    // number of consecutive accesses that followed 'stride'
+    uint32_t nhits;
+    // number of blocks to be read ahead at the next trigger
+    uint32_t window;
+    // next block to be read ahead
+    bid_t next_bid;
+    // value of 'num_reused_blocks' of the file when the read was issued
+    uint64_t reuse_seq;
+    // buffer for synchronous read-ahead
+    void *buf;
+    // async I/O handle, NULL if async I/O is not available
+    struct async_io_handle *aio;
+    struct filemgr_ops *aio_ops;
+    // number of async read requests in flight
+    size_t aio_pending;
+    // range of blocks being read asynchronously
+    bid_t aio_min_bid;
+    bid_t aio_max_bid;
+};
+
 typedef int filemgr_fs_type_t;
 enum {
     FILEMGR_FS_NO_COW = 0x01,
@@ -173,13 +234,46 @@ enum {
 #define DLOCK_MAX (41) /* a prime number */
 struct wal;
 struct fnamedic_item;
+struct bcache_item;
 struct kvs_header;
 
 typedef struct {
     mutex_t mutex;
+    // held in shared mode by writers that append documents in parallel,
+    // and in exclusive mode by the owner of 'mutex'.
+    fdb_rw_lock shared;
     bool locked;
 } mutex_lock_t;
 
+// Number of locks that serialize the shared writers of the same KV store
+#define FILEMGR_KVS_WRITER_LOCKS (31) /* a prime number */
+
+/**
+ * Group commit stage of a file. Committers write their DB headers one by
+ * one under the file mutex, and then share a single data sync issued by
+ * whichever of them becomes the leader.
+ */
+struct filemgr_group_commit {
+    mutex_t lock;
+    thread_cond_t cond;
+    // sequence number of the last DB header written by a committer
+    uint64_t written_seq;
+    // sequence number of the last DB header made durable
+    uint64_t synced_seq;
+    // number of committers that have not written their DB header yet
+    uint64_t num_pending;
+    // true while a leader is syncing the file
+    bool syncing;
+    // range of DB headers whose sync failed, and the error returned
+    uint64_t failed_from;
+    uint64_t failed_to;
+    fdb_status failed_status;
+    // stats
+    atomic_uint64_t num_syncs;
+    atomic_uint64_t num_commits;
+    atomic_uint64_t max_batch;
+};
+
 struct filemgr {
     char *filename; // Current file name.
     atomic_uint32_t ref_count;
@@ -192,6 +286,12 @@ struct filemgr {
     atomic_uint64_t last_commit;
     atomic_uint64_t last_writable_bmp_revnum;
     atomic_uint64_t num_invalidated_blocks;
+    // number of blocks reallocated through block reusing, used by
+    // read-ahead to detect the on-disk contents it read being overwritten
+    atomic_uint64_t num_reused_blocks;
+    // number of WAL flushes into the indexes, used by the key caches of
+    // KV store handles to detect index updates
+    atomic_uint64_t num_index_updates;
     atomic_uint8_t io_in_prog;
     struct wal *wal;
     struct filemgr_header header;
@@ -222,7 +322,7 @@ struct filemgr {
     struct superblock *sb;
 
 #ifdef _LATENCY_STATS
-    struct latency_stat lat_stats[FDB_LATENCY_NUM_STATS];
+    struct latency_stat lat_stats[FDB_LATENCY_NUM_ALL_STATS];
 #endif //_LATENCY_STATS
 
     // spin lock for small region
@@ -239,6 +339,11 @@ struct filemgr {
 
     // mutex for synchronization among multiple writers.
     mutex_lock_t writer_lock;
+    // locks of shared writers, indexed by KV store ID
+    mutex_t kvs_writer_lock[FILEMGR_KVS_WRITER_LOCKS];
+
+    // group commit stage
+    struct filemgr_group_commit group_commit;
 
     // CRC the file is using.
     crc_mode_e crc_mode;
@@ -247,6 +352,8 @@ struct filemgr {
 
     // temporary in-memory list of stale blocks
     struct list *stale_list;
+    // protects 'stale_list' against shared writers
+    spin_t stale_list_lock;
     // in-memory clone of system docs for reusable block info
     // (they are pointed to by stale-block-tree)
     struct avl_tree stale_info_tree;
@@ -319,6 +426,10 @@ typedef struct {
 } filemgr_open_result;
 
 void filemgr_init(struct filemgr_config *config);
+/**
+ * Return the file ops of the I/O engine selected at the initialization.
+ */
+struct filemgr_ops * filemgr_get_ops(void);
 void filemgr_set_lazy_file_deletion(bool enable,
                                     register_file_removal_func regis_func,
                                     check_file_removal_func check_func);
@@ -332,6 +443,7 @@ void filemgr_set_lazy_file_deletion(bool enable,
 void filemgr_set_sb_operation(struct sb_ops ops);
 
 uint64_t filemgr_get_bcache_used_space(void);
+void filemgr_get_bcache_stats(fdb_buffer_cache_stats *stats);
 
 bool filemgr_set_kv_header(struct filemgr *file, struct kvs_header *kv_header,
                            void (*free_kv_header)(struct filemgr *file));
@@ -427,12 +539,45 @@ fdb_status filemgr_read(struct filemgr *file,
                         err_log_callback *log_callback,
                         bool read_on_cache_miss);
 
+/**
+ * Return the address of the given block's contents inside the buffer cache
+ * and pin the block so that it can be read in place without being copied.
+ * Returns NULL if the block is not cached (or the cache is disabled); the
+ * caller should fall back to filemgr_read() in that case.
+ * The returned memory is read-only and should be released by filemgr_unpin().
+ */
+void *filemgr_read_pinned(struct filemgr *file, bid_t bid,
+                          struct bcache_item **pinned);
+void filemgr_unpin(struct bcache_item *pinned);
+
+void filemgr_readahead_init(struct filemgr_readahead *ra);
+/**
+ * Wait for the read-ahead requests in flight and detach the read-ahead state
+ * from its file. This should be called before the file is closed.
+ */
+void filemgr_readahead_stop(struct filemgr_readahead *ra);
+void filemgr_readahead_free(struct filemgr_readahead *ra);
+/**
+ * Notify the read-ahead state of a reader that the given block is about to
+ * be read, so that the following blocks of a detected sequential or strided
+ * run are read into the buffer cache in advance.
+ * Read-ahead is best-effort: errors are not reported to the caller, which
+ * reads the block through filemgr_read() as usual.
+ */
+void filemgr_readahead(struct filemgr_readahead *ra,
+                       struct filemgr *file,
+                       bid_t bid,
+                       err_log_callback *log_callback);
+
 fdb_status filemgr_write_offset(struct filemgr *file, bid_t bid, uint64_t offset,
                           uint64_t len, void *buf, bool final_write,
                           err_log_callback *log_callback);
 fdb_status filemgr_write(struct filemgr *file, bid_t bid, void *buf,
                    err_log_callback *log_callback);
 ssize_t filemgr_write_blocks(struct filemgr *file, void *buf, unsigned num_blocks, bid_t start_bid);
+fdb_status filemgr_write_blocks_batch(struct filemgr *file,
+                                      struct filemgr_io_req *reqs,
+                                      size_t num);
 int filemgr_is_writable(struct filemgr *file, bid_t bid);
 
 void filemgr_remove_file(struct filemgr *file);
@@ -466,6 +611,47 @@ fdb_status filemgr_commit_bid(struct filemgr *file, bid_t bid,
 fdb_status filemgr_sync(struct filemgr *file, bool sync_option,
                         err_log_callback *log_callback);
 
+/**
+ * Register a committer that will join the group commit of the file. It
+ * should be followed by either filemgr_group_commit_written() or
+ * filemgr_group_commit_leave().
+ *
+ * @param file Pointer to filemgr handle.
+ */
+void filemgr_group_commit_enter(struct filemgr *file);
+/**
+ * Unregister a committer that gives up the group commit without writing a
+ * DB header.
+ *
+ * @param file Pointer to filemgr handle.
+ */
+void filemgr_group_commit_leave(struct filemgr *file);
+/**
+ * Notify that a committer has written its DB header (without syncing it).
+ * Must be called while holding the file mutex, so that the returned
+ * sequence numbers follow the order of the DB headers in the file.
+ *
+ * @param file Pointer to filemgr handle.
+ * @return Sequence number of the DB header to be passed to
+ *         filemgr_group_commit_sync().
+ */
+uint64_t filemgr_group_commit_written(struct filemgr *file);
+/**
+ * Wait until the given DB header becomes durable. If no other committer is
+ * syncing the file, the caller becomes the leader: it waits up to 'window'
+ * microseconds for the other registered committers to write their headers,
+ * and then syncs the file once on behalf of all of them.
+ *
+ * @param file Pointer to filemgr handle.
+ * @param seq Sequence number returned by filemgr_group_commit_written().
+ * @param window Maximum time in microseconds to wait for other committers.
+ * @param log_callback Pointer to log callback function.
+ * @return FDB_RESULT_SUCCESS on success.
+ */
+fdb_status filemgr_group_commit_sync(struct filemgr *file, uint64_t seq,
+                                     uint32_t window,
+                                     err_log_callback *log_callback);
+
 fdb_status filemgr_shutdown();
 void filemgr_update_file_status(struct filemgr *file, file_status_t status);
 
@@ -538,6 +724,17 @@ void filemgr_get_latency_stat(struct filemgr *file,
                               fdb_latency_stat_type type,
                               fdb_latency_stat *stat);
 
+/**
+ * Get the latency percentiles from a given file manager
+ *
+ * @param file Pointer to the file manager
+ * @param type Type of a latency stat to be retrieved
+ * @param hist Pointer to the histogram instance to be populated
+ */
+void filemgr_get_latency_histogram(struct filemgr *file,
+                                   fdb_latency_stat_type type,
+                                   fdb_latency_histogram *hist);
+
 #ifdef _LATENCY_STATS_DUMP_TO_FILE
 /**
  * Write all the latency stats for a given file manager to a stat log file
@@ -611,6 +808,15 @@ void filemgr_mutex_openunlock(void);
 void filemgr_mutex_lock(struct filemgr *file);
 bool filemgr_mutex_trylock(struct filemgr *file);
 void filemgr_mutex_unlock(struct filemgr *file);
+/**
+ * Acquire the writer lock of the file in shared mode, together with the lock
+ * of the given KV store. Writers to different KV stores can then append their
+ * documents and insert them into the WAL in parallel, while writers to the
+ * same KV store are still serialized. filemgr_mutex_lock() excludes all the
+ * shared writers, and the new ones wait for its owner.
+ */
+void filemgr_mutex_lock_shared(struct filemgr *file, fdb_kvs_id_t kv_id);
+void filemgr_mutex_unlock_shared(struct filemgr *file, fdb_kvs_id_t kv_id);
 
 bool filemgr_is_commit_header(void *head_buffer, size_t blocksize);
 
@@ -25,6 +25,17 @@
 extern "C" {
 #endif
 
+/**
+ * A single request of a batched I/O operation.
+ */
+struct filemgr_io_req {
+    void *buf;
+    size_t count;
+    cs_off_t offset;
+    // Number of bytes transferred, or an error code.
+    ssize_t result;
+};
+
 // Note: Please try to ensure that the following filemgr ops also have
 // equivalent test/filemgr_anomalous_ops.h/cc test apis for failure testing
 struct filemgr_ops {
@@ -50,9 +61,24 @@ struct filemgr_ops {
     int (*get_fs_type)(int src_fd);
     int (*copy_file_range)(int fs_type, int src_fd, int dst_fd,
                            uint64_t src_off, uint64_t dst_off, uint64_t len);
+
+    // Batched I/O operations: all the requests are submitted together and
+    // completed before returning. If 'sync' is true, the data is synced
+    // (fdatasync) once all the writes are done. Returns FDB_RESULT_SUCCESS
+    // if every request transferred all of its bytes. These are NULL if the
+    // I/O engine has no native batching, in which case the callers issue
+    // the requests one by one through pread/pwrite.
+    int (*pread_batch)(int fd, struct filemgr_io_req *reqs, size_t num);
+    int (*pwrite_batch)(int fd, struct filemgr_io_req *reqs, size_t num,
+                        bool sync);
 };
 
 struct filemgr_ops * get_filemgr_ops();
+/**
+ * Return the file ops that perform I/O through io_uring, or NULL if io_uring
+ * is not supported by the platform or the running kernel.
+ */
+struct filemgr_ops * get_io_uring_filemgr_ops();
 
 #ifdef __cplusplus
 }
@@ -495,7 +495,10 @@ struct filemgr_ops linux_ops = {
     _filemgr_aio_getevents,
     _filemgr_aio_destroy,
     _filemgr_linux_get_fs_type,
-    _filemgr_linux_copy_file_range
+    _filemgr_linux_copy_file_range,
+    // Batched I/O operations (done one by one through pread/pwrite)
+    NULL,
+    NULL
 };
 
 struct filemgr_ops * get_linux_filemgr_ops()
@@ -503,4 +506,472 @@ struct filemgr_ops * get_linux_filemgr_ops()
     return &linux_ops;
 }
 
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define _FILEMGR_IO_URING
+#endif
+#endif
+
+#ifdef _FILEMGR_IO_URING
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+#define IO_URING_QUEUE_DEPTH (256)
+
+// Batched operations through pread/pwrite, used if a thread has no ring.
+static int _filemgr_linux_pread_batch(int fd, struct filemgr_io_req *reqs,
+                                      size_t num)
+{
+    int ret = FDB_RESULT_SUCCESS;
+    for (size_t i = 0; i < num; ++i) {
+        reqs[i].result = _filemgr_linux_pread(fd, reqs[i].buf, reqs[i].count,
+                                              reqs[i].offset);
+        if (reqs[i].result != (ssize_t)reqs[i].count &&
+            ret == FDB_RESULT_SUCCESS) {
+            ret = (reqs[i].result < 0) ? (int)reqs[i].result
+                                       : (int)FDB_RESULT_READ_FAIL;
+        }
+    }
+    return ret;
+}
+
+static int _filemgr_linux_pwrite_batch(int fd, struct filemgr_io_req *reqs,
+                                       size_t num, bool sync)
+{
+    int ret = FDB_RESULT_SUCCESS;
+    for (size_t i = 0; i < num; ++i) {
+        reqs[i].result = _filemgr_linux_pwrite(fd, reqs[i].buf, reqs[i].count,
+                                               reqs[i].offset);
+        if (reqs[i].result != (ssize_t)reqs[i].count &&
+            ret == FDB_RESULT_SUCCESS) {
+            ret = (reqs[i].result < 0) ? (int)reqs[i].result
+                                       : (int)FDB_RESULT_WRITE_FAIL;
+        }
+    }
+    if (sync && ret == FDB_RESULT_SUCCESS) {
+        ret = _filemgr_linux_fdatasync(fd);
+    }
+    return ret;
+}
+
+/**
+ * io_uring instance set up through the raw system calls, so that liburing
+ * is not needed. Each thread owns its own ring, and completions are always
+ * reaped by the thread that submitted the requests.
+ */
+struct io_uring_ctx {
+    int ring_fd;
+    unsigned entries;
+    // Submission queue.
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    struct io_uring_sqe *sqes;
+    // Completion queue.
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+    // Mapped regions.
+    void *sq_ring;
+    size_t sq_ring_len;
+    void *cq_ring;
+    size_t cq_ring_len;
+    size_t sqes_len;
+};
+
+static int _io_uring_setup(struct io_uring_ctx *ctx, unsigned entries)
+{
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    int fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+    if (fd < 0) {
+        return -1;
+    }
+
+    ctx->ring_fd = fd;
+    ctx->entries = p.sq_entries;
+    ctx->sq_ring_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ctx->cq_ring_len = p.cq_off.cqes +
+                       p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ctx->cq_ring_len > ctx->sq_ring_len) {
+            ctx->sq_ring_len = ctx->cq_ring_len;
+        }
+        ctx->cq_ring_len = ctx->sq_ring_len;
+    }
+
+    ctx->sq_ring = mmap(NULL, ctx->sq_ring_len, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (ctx->sq_ring == MAP_FAILED) {
+        close(fd);
+        return -1;
+    }
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        ctx->cq_ring = ctx->sq_ring;
+    } else {
+        ctx->cq_ring = mmap(NULL, ctx->cq_ring_len, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (ctx->cq_ring == MAP_FAILED) {
+            munmap(ctx->sq_ring, ctx->sq_ring_len);
+            close(fd);
+            return -1;
+        }
+    }
+    ctx->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+    ctx->sqes = (struct io_uring_sqe *)
+                mmap(NULL, ctx->sqes_len, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (ctx->sqes == MAP_FAILED) {
+        if (ctx->cq_ring != ctx->sq_ring) {
+            munmap(ctx->cq_ring, ctx->cq_ring_len);
+        }
+        munmap(ctx->sq_ring, ctx->sq_ring_len);
+        close(fd);
+        return -1;
+    }
+
+    uint8_t *sq = (uint8_t *)ctx->sq_ring;
+    uint8_t *cq = (uint8_t *)ctx->cq_ring;
+    ctx->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+    ctx->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+    ctx->sq_array = (unsigned *)(sq + p.sq_off.array);
+    ctx->cq_head = (unsigned *)(cq + p.cq_off.head);
+    ctx->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+    ctx->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+    ctx->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    return 0;
+}
+
+static void _io_uring_teardown(struct io_uring_ctx *ctx)
+{
+    munmap(ctx->sqes, ctx->sqes_len);
+    if (ctx->cq_ring != ctx->sq_ring) {
+        munmap(ctx->cq_ring, ctx->cq_ring_len);
+    }
+    munmap(ctx->sq_ring, ctx->sq_ring_len);
+    close(ctx->ring_fd);
+}
+
+struct io_uring_thread_ring {
+    io_uring_thread_ring() : initialized(false), failed(false) { }
+    ~io_uring_thread_ring() {
+        if (initialized) {
+            _io_uring_teardown(&ctx);
+        }
+    }
+    struct io_uring_ctx ctx;
+    bool initialized;
+    bool failed;
+};
+
+static thread_local struct io_uring_thread_ring thread_ring;
+
+// Return the calling thread's ring, or NULL if it cannot be set up, in
+// which case the caller falls back to the POSIX calls.
+static struct io_uring_ctx *_io_uring_get_ctx()
+{
+    if (!thread_ring.initialized && !thread_ring.failed) {
+        if (_io_uring_setup(&thread_ring.ctx, IO_URING_QUEUE_DEPTH) == 0) {
+            thread_ring.initialized = true;
+        } else {
+            thread_ring.failed = true;
+        }
+    }
+    return thread_ring.initialized ? &thread_ring.ctx : NULL;
+}
+
+// Give up the calling thread's ring after an unrecoverable submission error.
+static void _io_uring_disable_ctx()
+{
+    if (thread_ring.initialized) {
+        _io_uring_teardown(&thread_ring.ctx);
+        thread_ring.initialized = false;
+    }
+    thread_ring.failed = true;
+}
+
+static void _io_uring_prep(struct io_uring_ctx *ctx, uint8_t opcode, int fd,
+                           const void *addr, unsigned len, uint64_t offset,
+                           uint8_t flags, uint32_t fsync_flags,
+                           uint64_t user_data)
+{
+    unsigned tail = *ctx->sq_tail;
+    unsigned idx = tail & *ctx->sq_mask;
+    struct io_uring_sqe *sqe = &ctx->sqes[idx];
+
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    sqe->opcode = opcode;
+    sqe->flags = flags;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)addr;
+    sqe->len = len;
+    sqe->off = offset;
+    sqe->user_data = user_data;
+    if (opcode == IORING_OP_FSYNC) {
+        sqe->fsync_flags = fsync_flags;
+    }
+    ctx->sq_array[idx] = idx;
+    // Publish the entry to the kernel.
+    __atomic_store_n(ctx->sq_tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Submit 'num' prepared entries and wait until all of them complete.
+ * The result of each entry is stored in 'results' at the index given by its
+ * user data. Returns 0 on success, or -1 if the ring is no longer usable.
+ */
+static int _io_uring_submit_and_wait(struct io_uring_ctx *ctx, unsigned num,
+                                     int *results)
+{
+    unsigned to_submit = num;
+    unsigned done = 0;
+    int rv;
+
+    while (to_submit) {
+        rv = (int)syscall(__NR_io_uring_enter, ctx->ring_fd, to_submit,
+                          to_submit, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (rv < 0) {
+            if (errno == EINTR || errno == EAGAIN) {
+                continue;
+            }
+            return -1;
+        }
+        to_submit -= rv;
+    }
+
+    while (done < num) {
+        unsigned head = *ctx->cq_head;
+        unsigned tail = __atomic_load_n(ctx->cq_tail, __ATOMIC_ACQUIRE);
+        if (head == tail) {
+            rv = (int)syscall(__NR_io_uring_enter, ctx->ring_fd, 0, 1,
+                              IORING_ENTER_GETEVENTS, NULL, 0);
+            if (rv < 0 && errno != EINTR) {
+                return -1;
+            }
+            continue;
+        }
+        for (; head != tail; ++head) {
+            struct io_uring_cqe *cqe = &ctx->cqes[head & *ctx->cq_mask];
+            results[cqe->user_data] = cqe->res;
+            ++done;
+        }
+        __atomic_store_n(ctx->cq_head, head, __ATOMIC_RELEASE);
+    }
+    return 0;
+}
+
+/**
+ * Perform a batch of reads or writes through the calling thread's ring.
+ * Requests are submitted in chunks of the ring size. If 'sync' is set, the
+ * last chunk is followed by a datasync: a single write is linked to it, and
+ * otherwise the datasync drains all the writes submitted before it.
+ * Short transfers are completed through the POSIX calls.
+ */
+static int _filemgr_io_uring_rw_batch(int fd, struct filemgr_io_req *reqs,
+                                      size_t num, bool write, bool sync)
+{
+    struct io_uring_ctx *ctx = _io_uring_get_ctx();
+    if (!ctx) {
+        return write ? _filemgr_linux_pwrite_batch(fd, reqs, num, sync)
+                     : _filemgr_linux_pread_batch(fd, reqs, num);
+    }
+
+    int ret = FDB_RESULT_SUCCESS;
+    bool need_sync = sync;
+    size_t max_chunk = ctx->entries - 1;
+    struct iovec *iovs = alca(struct iovec, max_chunk);
+    int *results = alca(int, max_chunk + 1);
+    fdb_status fail = write ? FDB_RESULT_WRITE_FAIL : FDB_RESULT_READ_FAIL;
+
+    for (size_t begin = 0; begin < num; begin += max_chunk) {
+        size_t n = num - begin;
+        if (n > max_chunk) {
+            n = max_chunk;
+        }
+        bool last = (begin + n == num);
+        bool sync_here = write && sync && last;
+
+        for (size_t i = 0; i < n; ++i) {
+            struct filemgr_io_req *req = &reqs[begin + i];
+            iovs[i].iov_base = req->buf;
+            iovs[i].iov_len = req->count;
+            uint8_t flags = (sync_here && n == 1) ? IOSQE_IO_LINK : 0;
+            _io_uring_prep(ctx, write ? IORING_OP_WRITEV : IORING_OP_READV,
+                           fd, &iovs[i], 1, req->offset, flags, 0, i);
+        }
+        if (sync_here) {
+            _io_uring_prep(ctx, IORING_OP_FSYNC, fd, NULL, 0, 0,
+                           (n == 1) ? 0 : IOSQE_IO_DRAIN,
+                           IORING_FSYNC_DATASYNC, n);
+        }
+
+        unsigned num_sqes = n + (sync_here ? 1 : 0);
+        if (_io_uring_submit_and_wait(ctx, num_sqes, results) < 0) {
+            // The ring is in an unknown state, so do the remaining requests
+            // (including the current chunk) through the POSIX calls.
+            _io_uring_disable_ctx();
+            int rv = write
+                     ? _filemgr_linux_pwrite_batch(fd, reqs + begin,
+                                                   num - begin, sync)
+                     : _filemgr_linux_pread_batch(fd, reqs + begin,
+                                                  num - begin);
+            return (ret == FDB_RESULT_SUCCESS) ? rv : ret;
+        }
+
+        for (size_t i = 0; i < n; ++i) {
+            struct filemgr_io_req *req = &reqs[begin + i];
+            int res = results[i];
+            if (res < 0) {
+                errno = -res;
+                req->result = (ssize_t)convert_errno_to_fdb_status(-res, fail);
+            } else if ((size_t)res < req->count) {
+                // Short transfer: complete the rest synchronously.
+                ssize_t rv;
+                if (write) {
+                    rv = _filemgr_linux_pwrite(fd, (uint8_t *)req->buf + res,
+                                               req->count - res,
+                                               req->offset + res);
+                } else {
+                    rv = _filemgr_linux_pread(fd, (uint8_t *)req->buf + res,
+                                              req->count - res,
+                                              req->offset + res);
+                }
+                req->result = (rv < 0) ? rv : res + rv;
+                if (sync_here) {
+                    // The datasync did not (reliably) cover this write.
+                    results[n] = -ECANCELED;
+                }
+            } else {
+                req->result = res;
+            }
+            if (req->result != (ssize_t)req->count &&
+                ret == FDB_RESULT_SUCCESS) {
+                ret = (req->result < 0) ? (int)req->result : (int)fail;
+            }
+        }
+        if (sync_here && results[n] == 0) {
+            need_sync = false;
+        }
+    }
+
+    if (need_sync && ret == FDB_RESULT_SUCCESS) {
+        ret = _filemgr_linux_fdatasync(fd);
+    }
+    return ret;
+}
+
+int _filemgr_io_uring_pread_batch(int fd, struct filemgr_io_req *reqs,
+                                  size_t num)
+{
+    return _filemgr_io_uring_rw_batch(fd, reqs, num, false, false);
+}
+
+int _filemgr_io_uring_pwrite_batch(int fd, struct filemgr_io_req *reqs,
+                                   size_t num, bool sync)
+{
+    return _filemgr_io_uring_rw_batch(fd, reqs, num, true, sync);
+}
+
+ssize_t _filemgr_io_uring_pwrite(int fd, void *buf, size_t count,
+                                 cs_off_t offset)
+{
+    struct filemgr_io_req req = {buf, count, offset, 0};
+    _filemgr_io_uring_rw_batch(fd, &req, 1, true, false);
+    return req.result;
+}
+
+ssize_t _filemgr_io_uring_pread(int fd, void *buf, size_t count,
+                                cs_off_t offset)
+{
+    struct filemgr_io_req req = {buf, count, offset, 0};
+    _filemgr_io_uring_rw_batch(fd, &req, 1, false, false);
+    return req.result;
+}
+
+static int _filemgr_io_uring_sync(int fd, bool datasync)
+{
+    struct io_uring_ctx *ctx = _io_uring_get_ctx();
+    if (!ctx) {
+        return datasync ? _filemgr_linux_fdatasync(fd)
+                        : _filemgr_linux_fsync(fd);
+    }
+
+    int result = 0;
+    _io_uring_prep(ctx, IORING_OP_FSYNC, fd, NULL, 0, 0, 0,
+                   datasync ? IORING_FSYNC_DATASYNC : 0, 0);
+    if (_io_uring_submit_and_wait(ctx, 1, &result) < 0) {
+        _io_uring_disable_ctx();
+        return datasync ? _filemgr_linux_fdatasync(fd)
+                        : _filemgr_linux_fsync(fd);
+    }
+    if (result < 0) {
+        errno = -result;
+        return (int) convert_errno_to_fdb_status(-result,
+                                                 FDB_RESULT_FSYNC_FAIL);
+    }
+    return FDB_RESULT_SUCCESS;
+}
+
+int _filemgr_io_uring_fdatasync(int fd)
+{
+    return _filemgr_io_uring_sync(fd, true);
+}
+
+int _filemgr_io_uring_fsync(int fd)
+{
+    return _filemgr_io_uring_sync(fd, false);
+}
+
+struct filemgr_ops io_uring_ops = {
+    _filemgr_linux_open,
+    _filemgr_io_uring_pwrite,
+    _filemgr_io_uring_pread,
+    _filemgr_linux_close,
+    _filemgr_linux_goto_eof,
+    _filemgr_linux_file_size,
+    _filemgr_io_uring_fdatasync,
+    _filemgr_io_uring_fsync,
+    _filemgr_linux_get_errno_str,
+    // Async I/O operations
+    _filemgr_aio_init,
+    _filemgr_aio_prep_read,
+    _filemgr_aio_submit,
+    _filemgr_aio_getevents,
+    _filemgr_aio_destroy,
+    _filemgr_linux_get_fs_type,
+    _filemgr_linux_copy_file_range,
+    // Batched I/O operations
+    _filemgr_io_uring_pread_batch,
+    _filemgr_io_uring_pwrite_batch
+};
+
+struct filemgr_ops * get_io_uring_filemgr_ops()
+{
+    // Probe once whether the running kernel supports io_uring.
+    static int supported = -1;
+    if (supported < 0) {
+        struct io_uring_ctx ctx;
+        if (_io_uring_setup(&ctx, 1) == 0) {
+            _io_uring_teardown(&ctx);
+            supported = 1;
+        } else {
+            supported = 0;
+        }
+    }
+    return supported ? &io_uring_ops : NULL;
+}
+
+#else // _FILEMGR_IO_URING
+
+struct filemgr_ops * get_io_uring_filemgr_ops()
+{
+    return NULL;
+}
+
+#endif // _FILEMGR_IO_URING
+
 #endif
@@ -265,7 +265,10 @@ struct filemgr_ops win_ops = {
     _filemgr_aio_getevents,
     _filemgr_aio_destroy,
     _filemgr_win_get_fs_type,
-    _filemgr_win_copy_file_range
+    _filemgr_win_copy_file_range,
+    // Batched I/O operations (done one by one through pread/pwrite)
+    NULL,
+    NULL
 };
 
 struct filemgr_ops * get_win_filemgr_ops()
@@ -273,4 +276,9 @@ struct filemgr_ops * get_win_filemgr_ops()
     return &win_ops;
 }
 
+struct filemgr_ops * get_io_uring_filemgr_ops()
+{
+    return NULL;
+}
+
 #endif
@@ -26,6 +26,7 @@
 #include <sys/time.h>
 #endif
 
+#include <algorithm>
 #include <vector>
 
 #include "libforestdb/forestdb.h"
@@ -45,6 +46,9 @@
 #include "configuration.h"
 #include "internal_types.h"
 #include "bgflusher.h"
+#include "walflusher.h"
+#include "keycache.h"
+#include "commitsyncer.h"
 #include "compactor.h"
 #include "memleak.h"
 #include "time_utils.h"
@@ -85,6 +89,13 @@ INLINE int _cmp_uint64_t_endian_safe(void *key1, void *key2, void *aux)
     return _CMP_U64(a, b);
 }
 
+// B+tree node layout that agrees with _cmp_uint64_t_endian_safe()
+#ifdef __ENDIAN_SAFE
+#define _layout_uint64_t_endian_safe BTREE_KV_LAYOUT_KB64_VB64
+#else
+#define _layout_uint64_t_endian_safe BTREE_KV_LAYOUT_KU64_VB64
+#endif
+
 size_t _fdb_readkey_wrap(void *handle, uint64_t offset, void *buf)
 {
     fdb_status fs;
@@ -300,6 +311,18 @@ void fdb_dummy_log_callback(int err_code, const char *err_msg, void *ctx_data)
     return;
 }
 
+// Check if the doc of KEY at DOC_OFFSET is already in the main index.
+INLINE bool _fdb_restore_doc_indexed(fdb_kvs_handle *handle, void *key,
+                                     size_t keylen, uint64_t doc_offset)
+{
+    hbtrie_result hr;
+    uint64_t offset;
+
+    hr = hbtrie_find(handle->trie, key, keylen, (void *)&offset);
+    btreeblk_end(handle->bhandle);
+    return hr == HBTRIE_RESULT_SUCCESS && _endian_decode(offset) == doc_offset;
+}
+
 INLINE void _fdb_restore_wal(fdb_kvs_handle *handle,
                              fdb_restore_mode_t mode,
                              bid_t hdr_bid,
@@ -463,6 +486,20 @@ INLINE void _fdb_restore_wal(fdb_kvs_handle *handle,
                             continue;
                         }
 
+                        // Skip the doc if it is already in the index, as
+                        // the WAL may be flushed in background before a
+                        // commit that does not make the WAL clean.
+                        if (!handle->shandle &&
+                            _fdb_restore_doc_indexed(handle, doc.key,
+                                                     doc.length.keylen,
+                                                     doc_offset)) {
+                            free(doc.key);
+                            free(doc.meta);
+                            free(doc.body);
+                            offset = _offset;
+                            continue;
+                        }
+
                         // restore document
                         fdb_doc wal_doc;
                         wal_doc.keylen = doc.length.keylen;
@@ -726,6 +763,10 @@ fdb_status fdb_init(fdb_config *config)
         f_config.seqtree_opt = _config.seqtree_opt;
         f_config.do_not_cache_doc_blocks = _config.do_not_cache_doc_blocks;
         f_config.num_blocks_readahead = _config.num_blocks_readahead;
+        f_config.bcache_policy = _config.bcache_policy;
+        f_config.adaptive_readahead_max_blocks =
+            _config.adaptive_readahead_max_blocks;
+        f_config.io_engine = _config.io_engine;
         filemgr_init(&f_config);
 
         // WARNING: If background compactor is disabled,
@@ -748,6 +789,15 @@ fdb_status fdb_init(fdb_config *config)
         c_config = _config;
         compactor_init(&c_config);
 
+        // initialize background WAL flusher daemon
+        walflusher_init();
+
+        // initialize the daemon for asynchronous commits
+        commitsyncer_init();
+
+        // initialize the prefetch threads of WAL flushes
+        wal_prefetch_init();
+
         // initialize background flusher daemon
         // Temporarily disable background flushers until blockcache contention
         // issue is resolved.
@@ -936,10 +986,11 @@ fdb_status fdb_open_custom_cmp(fdb_file_handle **ptr_fhandle,
     return fs;
 }
 
-fdb_status fdb_open_for_compactor(fdb_file_handle **ptr_fhandle,
-                                  const char *filename,
-                                  fdb_config *fconfig,
-                                  struct list *cmp_func_list)
+static fdb_status _fdb_open_internal(fdb_file_handle **ptr_fhandle,
+                                     const char *filename,
+                                     fdb_filename_mode_t filename_mode,
+                                     fdb_config *fconfig,
+                                     struct list *cmp_func_list)
 {
 #ifdef _MEMPOOL
     mempool_init();
@@ -966,7 +1017,7 @@ fdb_status fdb_open_for_compactor(fdb_file_handle **ptr_fhandle,
     if (cmp_func_list && list_begin(cmp_func_list)) {
         fdb_file_handle_clone_cmp_func_list(fhandle, cmp_func_list);
     }
-    fdb_status fs = _fdb_open(handle, filename, FDB_VFILENAME, fconfig);
+    fdb_status fs = _fdb_open(handle, filename, filename_mode, fconfig);
     if (fs == FDB_RESULT_SUCCESS) {
         *ptr_fhandle = fhandle;
         filemgr_fhandle_add(handle->file, fhandle);
@@ -978,6 +1029,24 @@ fdb_status fdb_open_for_compactor(fdb_file_handle **ptr_fhandle,
     return fs;
 }
 
+fdb_status fdb_open_for_compactor(fdb_file_handle **ptr_fhandle,
+                                  const char *filename,
+                                  fdb_config *fconfig,
+                                  struct list *cmp_func_list)
+{
+    return _fdb_open_internal(ptr_fhandle, filename, FDB_VFILENAME, fconfig,
+                              cmp_func_list);
+}
+
+fdb_status fdb_open_for_wal_flusher(fdb_file_handle **ptr_fhandle,
+                                    const char *filename,
+                                    fdb_config *fconfig,
+                                    struct list *cmp_func_list)
+{
+    return _fdb_open_internal(ptr_fhandle, filename, FDB_AFILENAME, fconfig,
+                              cmp_func_list);
+}
+
 LIBFDB_API
 fdb_status fdb_snapshot_open(fdb_kvs_handle *handle_in,
                              fdb_kvs_handle **ptr_handle, fdb_seqnum_t seqnum)
@@ -1503,6 +1572,11 @@ static void _fdb_init_file_config(const fdb_config *config,
                           std::memory_order_relaxed);
     fconfig->do_not_cache_doc_blocks = config->do_not_cache_doc_blocks;
     fconfig->num_blocks_readahead = config->num_blocks_readahead;
+    fconfig->bcache_policy = config->bcache_policy;
+    fconfig->adaptive_readahead_max_blocks =
+        config->adaptive_readahead_max_blocks;
+    fconfig->io_engine = config->io_engine;
+    fconfig->num_wal_prefetch_threads = config->num_wal_prefetch_threads;
 }
 
 fdb_status _fdb_clone_snapshot(fdb_kvs_handle *handle_in,
@@ -1565,6 +1639,10 @@ fdb_status _fdb_clone_snapshot(fdb_kvs_handle *handle_in,
     // set aux for cmp wrapping function
     hbtrie_set_leaf_height_limit(handle_out->trie, 0xff);
     hbtrie_set_leaf_cmp(handle_out->trie, _fdb_custom_cmp_wrap);
+    hbtrie_set_leaf_prefix_compression(handle_out->trie,
+                                handle_out->config.btree_prefix_compression);
+    hbtrie_set_key_fingerprint(handle_out->trie,
+                               handle_out->config.key_fingerprint);
 
     if (handle_out->kvs) {
         hbtrie_set_map_function(handle_out->trie, fdb_kvs_find_cmp_chunk);
@@ -1587,6 +1665,7 @@ fdb_status _fdb_clone_snapshot(fdb_kvs_handle *handle_in,
                 (struct btree_kv_ops *)malloc(sizeof(struct btree_kv_ops));
             seq_kv_ops = btree_kv_get_kb64_vb64(seq_kv_ops);
             seq_kv_ops->cmp = _cmp_uint64_t_endian_safe;
+            seq_kv_ops->layout = _layout_uint64_t_endian_safe;
 
             handle_out->seqtree = (struct btree*)malloc(sizeof(struct btree));
             // Init the seq tree using the root bid of the source snapshot.
@@ -1687,7 +1766,7 @@ fdb_status _fdb_open(fdb_kvs_handle *handle,
         fconfig.options |= FILEMGR_CREATE_CRC32;
     }
 
-    handle->fileops = get_filemgr_ops();
+    handle->fileops = filemgr_get_ops();
     filemgr_open_result result = filemgr_open((char *)actual_filename,
                                               handle->fileops,
                                               &fconfig, &handle->log_callback);
@@ -2137,6 +2216,9 @@ fdb_status _fdb_open(fdb_kvs_handle *handle,
     // set aux for cmp wrapping function
     hbtrie_set_leaf_height_limit(handle->trie, 0xff);
     hbtrie_set_leaf_cmp(handle->trie, _fdb_custom_cmp_wrap);
+    hbtrie_set_leaf_prefix_compression(handle->trie,
+                                       config->btree_prefix_compression);
+    hbtrie_set_key_fingerprint(handle->trie, config->key_fingerprint);
 
     if (handle->kvs) {
         hbtrie_set_map_function(handle->trie, fdb_kvs_find_cmp_chunk);
@@ -2158,6 +2240,7 @@ fdb_status _fdb_open(fdb_kvs_handle *handle,
                 (struct btree_kv_ops *)malloc(sizeof(struct btree_kv_ops));
             seq_kv_ops = btree_kv_get_kb64_vb64(seq_kv_ops);
             seq_kv_ops->cmp = _cmp_uint64_t_endian_safe;
+            seq_kv_ops->layout = _layout_uint64_t_endian_safe;
 
             handle->seqtree = (struct btree*)malloc(sizeof(struct btree));
             if (seq_root_bid == BLK_NOT_FOUND) {
@@ -2183,6 +2266,7 @@ fdb_status _fdb_open(fdb_kvs_handle *handle,
             (struct btree_kv_ops *)calloc(1, sizeof(struct btree_kv_ops));
         stale_kv_ops = btree_kv_get_kb64_vb64(stale_kv_ops);
         stale_kv_ops->cmp = _cmp_uint64_t_endian_safe;
+        stale_kv_ops->layout = _layout_uint64_t_endian_safe;
 
         handle->staletree = (struct btree*)calloc(1, sizeof(struct btree));
         if (stale_root_bid == BLK_NOT_FOUND) {
@@ -2282,6 +2366,12 @@ fdb_status _fdb_open(fdb_kvs_handle *handle,
                                              (fdb_config *)config,
                                              &handle->log_callback);
         }
+        if (status == FDB_RESULT_SUCCESS &&
+            config->enable_background_wal_flush &&
+            config->wal_flush_before_commit) {
+            status = walflusher_register_file(handle->file,
+                                              (fdb_config *)config);
+        }
     }
 
     if (config->bottom_up_index_build) {
@@ -2544,8 +2634,82 @@ INLINE int _kvs_delta_stat_cmp(struct avl_node *a, struct avl_node *b, void *aux
     }
 }
 
+// A sequence tree entry of a flushed WAL item. In single KV instance mode,
+// the entries are inserted into the sequence B+tree together in seqnum order
+// once all the items of a WAL flush are flushed.
+struct wal_seq_entry {
+    fdb_seqnum_t seqnum;
+    fdb_seqnum_t _seqnum; // endian-encoded key
+    int64_t _offset; // endian-encoded value
+    struct avl_node avl_entry;
+};
+
+INLINE int _fdb_seq_batch_cmp(struct avl_node *a, struct avl_node *b, void *aux)
+{
+    (void) aux;
+    struct wal_seq_entry *entry1 = _get_entry(a, struct wal_seq_entry,
+                                              avl_entry);
+    struct wal_seq_entry *entry2 = _get_entry(b, struct wal_seq_entry,
+                                              avl_entry);
+    if (entry1->seqnum < entry2->seqnum) {
+        return -1;
+    } else if (entry1->seqnum > entry2->seqnum) {
+        return 1;
+    } else {
+        return 0;
+    }
+}
+
+INLINE void _fdb_free_seq_batch(struct avl_tree *seqnum_list)
+{
+    struct wal_seq_entry *seq_entry;
+    struct avl_node *node = avl_first(seqnum_list);
+    while (node) {
+        seq_entry = _get_entry(node, struct wal_seq_entry, avl_entry);
+        node = avl_next(node);
+        avl_remove(seqnum_list, &seq_entry->avl_entry);
+        free(seq_entry);
+    }
+}
+
+INLINE void _fdb_wal_flush_seq_batch(fdb_kvs_handle *handle,
+                                     struct avl_tree *seqnum_list,
+                                     struct avl_tree *kvs_delta_stats)
+{
+    struct wal_kvs_delta_stat *delta_stat;
+    struct wal_kvs_delta_stat kvs_delta_query;
+    struct wal_seq_entry *seq_entry;
+    struct avl_node *node;
+    int64_t nlivenodes = handle->bhandle->nlivenodes;
+    int64_t ndeltanodes = handle->bhandle->ndeltanodes;
+    std::vector<void *> keys, values;
+
+    for (node = avl_first(seqnum_list); node; node = avl_next(node)) {
+        seq_entry = _get_entry(node, struct wal_seq_entry, avl_entry);
+        keys.push_back(&seq_entry->_seqnum);
+        values.push_back(&seq_entry->_offset);
+    }
+    btree_insert_batch(handle->seqtree, keys.data(), values.data(),
+                       keys.size());
+    btreeblk_end(handle->bhandle);
+    _fdb_free_seq_batch(seqnum_list);
+
+    kvs_delta_query.kv_id = 0;
+    avl_node *delta_stat_node = avl_search(kvs_delta_stats,
+                                           &kvs_delta_query.avl_entry,
+                                           _kvs_delta_stat_cmp);
+    if (delta_stat_node) {
+        delta_stat = _get_entry(delta_stat_node, struct wal_kvs_delta_stat,
+                                avl_entry);
+        delta_stat->nlivenodes += handle->bhandle->nlivenodes - nlivenodes;
+        delta_stat->deltasize += (handle->bhandle->ndeltanodes - ndeltanodes) *
+                                 (int64_t)handle->config.blocksize;
+    }
+}
+
 INLINE void _fdb_wal_flush_seq_purge(void *dbhandle,
                                      struct avl_tree *stale_seqnum_list,
+                                     struct avl_tree *seqnum_list,
                                      struct avl_tree *kvs_delta_stats)
 {
     fdb_seqnum_t _seqnum;
@@ -2558,6 +2722,9 @@ INLINE void _fdb_wal_flush_seq_purge(void *dbhandle,
     struct wal_kvs_delta_stat kvs_delta_query;
 
     fdb_kvs_handle *handle = (fdb_kvs_handle *)dbhandle;
+    if (avl_first(seqnum_list)) {
+        _fdb_wal_flush_seq_batch(handle, seqnum_list, kvs_delta_stats);
+    }
     struct avl_node *node = avl_first(stale_seqnum_list);
     while (node) {
         seq_entry = _get_entry(node, struct wal_stale_seq_entry, avl_entry);
@@ -2618,9 +2785,10 @@ INLINE void _fdb_wal_flush_kvs_delta_stats(struct filemgr *file,
     }
 }
 
-INLINE fdb_status _fdb_wal_flush_func(void *voidhandle,
+INLINE fdb_status _fdb_wal_flush_item(void *voidhandle,
                                       struct wal_item *item,
                                       struct avl_tree *stale_seqnum_list,
+                                      struct avl_tree *seqnum_list,
                                       struct avl_tree *kvs_delta_stats)
 {
     hbtrie_result hr;
@@ -2695,13 +2863,28 @@ INLINE fdb_status _fdb_wal_flush_func(void *voidhandle,
                 memcpy(kvid_seqnum + size_id, &_seqnum, size_seq);
                 hbtrie_insert(handle->seqtrie, kvid_seqnum, size_id + size_seq,
                               (void *)&_offset, (void *)&old_offset_local);
+                fs = btreeblk_end(handle->bhandle);
+                if (fs != FDB_RESULT_SUCCESS) {
+                    return fs;
+                }
             } else {
-                btree_insert(handle->seqtree, (void *)&_seqnum,
-                             (void *)&_offset);
-            }
-            fs = btreeblk_end(handle->bhandle);
-            if (fs != FDB_RESULT_SUCCESS) {
-                return fs;
+                struct avl_node *node;
+                struct wal_seq_entry *entry = (struct wal_seq_entry *)
+                    malloc(sizeof(struct wal_seq_entry));
+                entry->seqnum = item->seqnum;
+                entry->_seqnum = _seqnum;
+                entry->_offset = _offset;
+                node = avl_search(seqnum_list, &entry->avl_entry,
+                                  _fdb_seq_batch_cmp);
+                if (node) {
+                    // custom seqnum already used by another item
+                    _get_entry(node, struct wal_seq_entry,
+                               avl_entry)->_offset = _offset;
+                    free(entry);
+                } else {
+                    avl_insert(seqnum_list, &entry->avl_entry,
+                               _fdb_seq_batch_cmp);
+                }
             }
         }
 
@@ -2841,6 +3024,21 @@ INLINE fdb_status _fdb_wal_flush_func(void *voidhandle,
     return FDB_RESULT_SUCCESS;
 }
 
+INLINE fdb_status _fdb_wal_flush_func(void *voidhandle,
+                                      struct wal_item *item,
+                                      struct avl_tree *stale_seqnum_list,
+                                      struct avl_tree *seqnum_list,
+                                      struct avl_tree *kvs_delta_stats)
+{
+    fdb_status fs = _fdb_wal_flush_item(voidhandle, item, stale_seqnum_list,
+                                        seqnum_list, kvs_delta_stats);
+    if (fs != FDB_RESULT_SUCCESS) {
+        // the indexes are rolled back, so drop the pending seqtree entries
+        _fdb_free_seq_batch(seqnum_list);
+    }
+    return fs;
+}
+
 void fdb_sync_db_header(fdb_kvs_handle *handle)
 {
     uint64_t cur_revnum = filemgr_get_header_revnum(handle->file);
@@ -3052,6 +3250,41 @@ static void _fdb_release_dirty_root(fdb_kvs_handle *handle)
     }
 }
 
+// Look up KEY in the main index through the key cache of HANDLE, if enabled.
+// The caller should have synced the trie root of HANDLE.
+static hbtrie_result _fdb_index_find(fdb_kvs_handle *handle, void *key,
+                                     size_t keylen, uint64_t *offset)
+{
+    struct keycache_version version;
+    hbtrie_result hr;
+
+    if (!handle->config.index_cache_size) {
+        return hbtrie_find(handle->trie, key, keylen, (void *)offset);
+    }
+
+    if (!handle->keycache) {
+        handle->keycache = (struct keycache *)malloc(sizeof(struct keycache));
+        keycache_init(handle->keycache, handle->config.index_cache_size);
+    }
+    // the update count is read before the lookup, so that an entry read
+    // while the WAL is being flushed is dropped by the next lookup
+    version.num_index_updates =
+        atomic_get_uint64_t(&handle->file->num_index_updates);
+    version.file = (void *)handle->file;
+    version.root_bid = handle->trie->root_bid;
+    version.header_revnum = atomic_get_uint64_t(&handle->cur_header_revnum);
+    keycache_validate(handle->keycache, &version);
+
+    if (keycache_find(handle->keycache, key, keylen, offset)) {
+        return HBTRIE_RESULT_SUCCESS;
+    }
+    hr = hbtrie_find(handle->trie, key, keylen, (void *)offset);
+    if (hr == HBTRIE_RESULT_SUCCESS) {
+        keycache_insert(handle->keycache, key, keylen, *offset);
+    }
+    return hr;
+}
+
 LIBFDB_API
 fdb_status fdb_get(fdb_kvs_handle *handle, fdb_doc *doc)
 {
@@ -3130,11 +3363,9 @@ fdb_status fdb_get(fdb_kvs_handle *handle, fdb_doc *doc)
         _fdb_sync_dirty_root(handle);
 
         if (handle->kvs) {
-            hr = hbtrie_find(handle->trie, doc_kv.key, doc_kv.keylen,
-                             (void *)&offset);
+            hr = _fdb_index_find(handle, doc_kv.key, doc_kv.keylen, &offset);
         } else {
-            hr = hbtrie_find(handle->trie, doc->key, doc->keylen,
-                             (void *)&offset);
+            hr = _fdb_index_find(handle, doc->key, doc->keylen, &offset);
         }
         btreeblk_end(handle->bhandle);
         offset = _endian_decode(offset);
@@ -3193,6 +3424,287 @@ fdb_status fdb_get(fdb_kvs_handle *handle, fdb_doc *doc)
     return FDB_RESULT_KEY_NOT_FOUND;
 }
 
+// Number of consecutive HB+trie lookups of fdb_get_multi that share the
+// B+tree nodes read by the previous lookups before they are released.
+#define FDB_GET_MULTI_DESCENT_BATCH (16)
+
+struct _fdb_get_multi_item {
+    fdb_doc *doc;
+    void *key; // key including KV ID prefix in multi KV instance mode
+    size_t keylen;
+    size_t idx; // position in the caller's array
+    uint64_t offset;
+    fdb_status rs;
+};
+
+static int _fdb_get_multi_key_cmp(const void *a, const void *b)
+{
+    const struct _fdb_get_multi_item *aa, *bb;
+    aa = (const struct _fdb_get_multi_item *)a;
+    bb = (const struct _fdb_get_multi_item *)b;
+    size_t len = aa->keylen < bb->keylen ? aa->keylen : bb->keylen;
+    int cmp = memcmp(aa->key, bb->key, len);
+    if (cmp) {
+        return cmp;
+    }
+    return (aa->keylen > bb->keylen) - (aa->keylen < bb->keylen);
+}
+
+// Copy a document read by docio into the caller's doc, in the same way
+// as fdb_get() does.
+static fdb_status _fdb_get_multi_fill(struct _fdb_get_multi_item *item,
+                                      struct docio_object *_doc)
+{
+    fdb_doc *doc = item->doc;
+
+    if (_doc->length.keylen != item->keylen ||
+        _doc->length.flag & DOCIO_DELETED) {
+        return FDB_RESULT_KEY_NOT_FOUND;
+    }
+
+    if (_doc->length.metalen) {
+        if (!doc->meta) {
+            doc->meta = malloc(_doc->length.metalen);
+        }
+        memcpy(doc->meta, _doc->meta, _doc->length.metalen);
+    }
+    if (_doc->length.bodylen) {
+        if (!doc->body) {
+            doc->body = malloc(_doc->length.bodylen);
+        }
+        memcpy(doc->body, _doc->body, _doc->length.bodylen);
+    }
+    doc->seqnum = _doc->seqnum;
+    doc->metalen = _doc->length.metalen;
+    doc->bodylen = _doc->length.bodylen;
+    doc->deleted = false;
+    doc->size_ondisk = _fdb_get_docsize(_doc->length);
+    doc->offset = item->offset;
+    return FDB_RESULT_SUCCESS;
+}
+
+LIBFDB_API
+fdb_status fdb_get_multi(fdb_kvs_handle *handle, fdb_doc **docs, size_t n,
+                         fdb_status *results)
+{
+    uint64_t offset;
+    size_t i, j, m, nlookups, size_chunk = 0, keybuf_size = 0;
+    uint8_t *keybuf = NULL, *key;
+    uint64_t *offset_array;
+    struct _fdb_get_multi_item *items;
+    struct docio_object *doc_array;
+    struct _fdb_key_cmp_info cmp_info;
+    struct async_io_handle *aio_handle_ptr = NULL;
+    struct async_io_handle aio_handle;
+    fdb_status wr, fs = FDB_RESULT_SUCCESS;
+    hbtrie_result hr;
+    fdb_txn *txn;
+    fdb_doc doc_kv;
+    LATENCY_STAT_START();
+
+    if (!handle) {
+        return FDB_RESULT_INVALID_HANDLE;
+    }
+
+    if (n && !docs) {
+        return FDB_RESULT_INVALID_ARGS;
+    }
+    for (i = 0; i < n; ++i) {
+        fdb_doc *doc = docs[i];
+        if (!doc || !doc->key || doc->keylen == 0 ||
+            doc->keylen > FDB_MAX_KEYLEN ||
+            (handle->kvs_config.custom_cmp &&
+                doc->keylen > handle->config.blocksize - HBTRIE_HEADROOM)) {
+            return FDB_RESULT_INVALID_ARGS;
+        }
+        keybuf_size += doc->keylen;
+    }
+    if (n == 0) {
+        return FDB_RESULT_SUCCESS;
+    }
+
+    if (!atomic_cas_uint8_t(&handle->handle_busy, 0, 1)) {
+        return FDB_RESULT_HANDLE_BUSY;
+    }
+
+    items = (struct _fdb_get_multi_item *)
+            calloc(n, sizeof(struct _fdb_get_multi_item));
+    if (handle->kvs) {
+        // multi KV instance mode
+        size_chunk = handle->config.chunksize;
+        keybuf = (uint8_t *)malloc(keybuf_size + n * size_chunk);
+    }
+    key = keybuf;
+    for (i = 0; i < n; ++i) {
+        items[i].doc = docs[i];
+        items[i].idx = i;
+        items[i].offset = BLK_NOT_FOUND;
+        items[i].rs = FDB_RESULT_KEY_NOT_FOUND;
+        if (handle->kvs) {
+            items[i].keylen = docs[i]->keylen + size_chunk;
+            items[i].key = key;
+            kvid2buf(size_chunk, handle->kvs->id, key);
+            memcpy(key + size_chunk, docs[i]->key, docs[i]->keylen);
+            key += items[i].keylen;
+        } else {
+            items[i].keylen = docs[i]->keylen;
+            items[i].key = docs[i]->key;
+        }
+    }
+    // keys sharing a prefix are looked up one after another
+    qsort(items, n, sizeof(struct _fdb_get_multi_item),
+          _fdb_get_multi_key_cmp);
+
+    if (!handle->shandle) {
+        fdb_check_file_reopen(handle, NULL);
+        txn = handle->fhandle->root->txn;
+        if (!txn) {
+            txn = &handle->file->global_txn;
+        }
+    } else {
+        txn = handle->shandle->snap_txn;
+    }
+
+    cmp_info.kvs_config = handle->kvs_config;
+    cmp_info.kvs = handle->kvs;
+
+    // 1) search the WAL
+    nlookups = n;
+    if (!handle->config.do_not_search_wal) {
+        for (i = 0; i < n; ++i) {
+            doc_kv = *items[i].doc;
+            doc_kv.key = items[i].key;
+            doc_kv.keylen = items[i].keylen;
+            wr = wal_find(txn, handle->file, &cmp_info, handle->shandle,
+                          &doc_kv, &offset);
+            if (wr == FDB_RESULT_SUCCESS) {
+                // the WAL has the latest version, even if it is a deletion
+                items[i].rs = FDB_RESULT_SUCCESS;
+                if (offset != BLK_NOT_FOUND && !doc_kv.deleted) {
+                    items[i].offset = offset;
+                }
+                nlookups--;
+            }
+        }
+    }
+
+    if (!handle->shandle) {
+        fdb_sync_db_header(handle);
+    }
+
+    atomic_add_uint64_t(&handle->op_stats->num_gets, n,
+                        std::memory_order_relaxed);
+
+    // 2) search the main index for the rest, in key order
+    if (nlookups) {
+        _fdb_sync_dirty_root(handle);
+        for (i = 0, j = 0; i < n; ++i) {
+            if (items[i].rs == FDB_RESULT_SUCCESS) {
+                continue;
+            }
+            hr = _fdb_index_find(handle, items[i].key, items[i].keylen,
+                                 &offset);
+            if (hr == HBTRIE_RESULT_SUCCESS) {
+                items[i].offset = _endian_decode(offset);
+            }
+            if (++j % FDB_GET_MULTI_DESCENT_BATCH == 0) {
+                btreeblk_end(handle->bhandle);
+            }
+        }
+        btreeblk_end(handle->bhandle);
+        _fdb_release_dirty_root(handle);
+    }
+
+    // 3) read all the docs in file offset order at once
+    offset_array = (uint64_t *)malloc(sizeof(uint64_t) * n);
+    for (i = 0, m = 0; i < n; ++i) {
+        items[i].rs = FDB_RESULT_KEY_NOT_FOUND;
+        if (items[i].offset != BLK_NOT_FOUND) {
+            offset_array[m++] = items[i].offset;
+        }
+    }
+    std::sort(offset_array, offset_array + m);
+    m = std::unique(offset_array, offset_array + m) - offset_array;
+
+    if (m) {
+        aio_handle.queue_depth = ASYNC_IO_QUEUE_DEPTH;
+        aio_handle.block_size = handle->file->config->blocksize;
+        aio_handle.fd = handle->file->fd;
+        if (handle->file->ops->aio_init(&aio_handle) == FDB_RESULT_SUCCESS) {
+            aio_handle_ptr = &aio_handle;
+        }
+
+        doc_array = (struct docio_object *)
+                    calloc(m, sizeof(struct docio_object));
+        size_t nreads = docio_batch_read_docs(handle->dhandle, offset_array,
+                                              doc_array, m, (size_t)-1, m,
+                                              aio_handle_ptr, false);
+        if (nreads == (size_t)-1) {
+            // docio has already released the partially read docs
+            for (i = 0; i < n; ++i) {
+                if (items[i].offset != BLK_NOT_FOUND) {
+                    items[i].rs = FDB_RESULT_READ_FAIL;
+                }
+            }
+            nreads = 0;
+        }
+
+        // async reads complete out of order, so the docs are matched
+        // with the requests by key.
+        for (j = 0; j < nreads; ++j) {
+            struct _fdb_get_multi_item query, *found;
+            if (!doc_array[j].key) {
+                continue; // failed to read
+            }
+            query.key = doc_array[j].key;
+            query.keylen = doc_array[j].length.keylen;
+            found = (struct _fdb_get_multi_item *)
+                    bsearch(&query, items, n, sizeof(struct _fdb_get_multi_item),
+                            _fdb_get_multi_key_cmp);
+            if (!found) {
+                continue;
+            }
+            // the same key may be requested several times
+            while (found > items &&
+                   !_fdb_get_multi_key_cmp(found - 1, &query)) {
+                found--;
+            }
+            for (; found < items + n &&
+                   !_fdb_get_multi_key_cmp(found, &query); ++found) {
+                if (found->offset != BLK_NOT_FOUND) {
+                    found->rs = _fdb_get_multi_fill(found, &doc_array[j]);
+                }
+            }
+        }
+
+        for (j = 0; j < m; ++j) {
+            free_docio_object(&doc_array[j], 1, 1, 1);
+        }
+        free(doc_array);
+        if (aio_handle_ptr) {
+            handle->file->ops->aio_destroy(aio_handle_ptr);
+        }
+    }
+
+    for (i = 0; i < n; ++i) {
+        if (results) {
+            results[items[i].idx] = items[i].rs;
+        }
+        if (items[i].rs != FDB_RESULT_SUCCESS &&
+            fs != FDB_RESULT_READ_FAIL) {
+            fs = items[i].rs;
+        }
+    }
+
+    free(offset_array);
+    free(keybuf);
+    free(items);
+
+    LATENCY_STAT_END(handle->file, FDB_LATENCY_GETS);
+    atomic_cas_uint8_t(&handle->handle_busy, 1, 0);
+    return fs;
+}
+
 LIBFDB_API
 fdb_status fdb_get_nearest(fdb_kvs_handle *handle,
                            const void *key,
@@ -3532,11 +4044,9 @@ fdb_status fdb_get_metaonly(fdb_kvs_handle *handle, fdb_doc *doc)
         _fdb_sync_dirty_root(handle);
 
         if (handle->kvs) {
-            hr = hbtrie_find(handle->trie, doc_kv.key, doc_kv.keylen,
-                             (void *)&offset);
+            hr = _fdb_index_find(handle, doc_kv.key, doc_kv.keylen, &offset);
         } else {
-            hr = hbtrie_find(handle->trie, doc->key, doc->keylen,
-                             (void *)&offset);
+            hr = _fdb_index_find(handle, doc->key, doc->keylen, &offset);
         }
         btreeblk_end(handle->bhandle);
         offset = _endian_decode(offset);
@@ -4090,27 +4600,184 @@ fdb_status fdb_get_byoffset_raw(fdb_kvs_handle *handle, fdb_doc *doc)
         doc->size_ondisk += handle->config.chunksize;
     }
 
-    if (_doc.length.flag & DOCIO_DELETED) {
-        atomic_cas_uint8_t(&handle->handle_busy, 1, 0);
-        return FDB_RESULT_KEY_NOT_FOUND;
+    if (_doc.length.flag & DOCIO_DELETED) {
+        atomic_cas_uint8_t(&handle->handle_busy, 1, 0);
+        return FDB_RESULT_KEY_NOT_FOUND;
+    }
+
+    atomic_cas_uint8_t(&handle->handle_busy, 1, 0);
+    return FDB_RESULT_SUCCESS;
+}
+
+INLINE uint64_t _fdb_get_wal_threshold(fdb_kvs_handle *handle)
+{
+    return handle->config.wal_threshold;
+}
+
+// Number of flushable WAL entries beyond which writers flush the WAL
+// by themselves.
+INLINE uint64_t _fdb_get_wal_flush_limit(fdb_kvs_handle *handle)
+{
+    if (!handle->config.enable_background_wal_flush) {
+        return _fdb_get_wal_threshold(handle);
+    }
+    if (handle->config.wal_flush_hard_limit) {
+        return handle->config.wal_flush_hard_limit;
+    }
+    return _fdb_get_wal_threshold(handle) * FDB_WAL_FLUSH_HARD_LIMIT_RATIO;
+}
+
+// Check if the docs that would be restored into the WAL after a crash, i.e.
+// the ones appended after the last header with a clean WAL, span more
+// blocks than the WAL threshold. The background WAL flusher keeps the WAL
+// below its threshold, so that commits do not flush it by themselves and
+// the restore would otherwise grow without bound.
+INLINE bool _fdb_wal_restore_too_long(fdb_kvs_handle *handle)
+{
+    uint64_t start = 0;
+
+    if (!handle->config.enable_background_wal_flush) {
+        return false;
+    }
+    if (handle->last_wal_flush_hdr_bid != BLK_NOT_FOUND) {
+        start = (handle->last_wal_flush_hdr_bid + 1) * handle->config.blocksize;
+    }
+    return filemgr_get_pos(handle->file) >
+           start + _fdb_get_wal_threshold(handle) * handle->config.blocksize;
+}
+
+// Flush the committed non-transactional WAL entries into the indexes before
+// the next commit, up to MAX_ITEMS entries unless it is zero.
+// The caller should hold the file lock exclusively.
+static fdb_status _fdb_flush_wal_before_commit(fdb_kvs_handle *handle,
+                                               size_t max_items)
+{
+    struct filemgr *file = handle->file;
+    struct filemgr_dirty_update_node *prev_node = NULL, *new_node = NULL;
+    union wal_flush_items flush_items;
+    bid_t dirty_idtree_root = BLK_NOT_FOUND;
+    bid_t dirty_seqtree_root = BLK_NOT_FOUND;
+    fdb_status wr;
+
+    // commit only for non-transactional WAL entries
+    wr = wal_commit(&file->global_txn, file, NULL, &handle->log_callback);
+    if (wr != FDB_RESULT_SUCCESS) {
+        return wr;
+    }
+
+    _fdb_dirty_update_ready(handle, &prev_node, &new_node,
+                            &dirty_idtree_root, &dirty_seqtree_root, true);
+
+    wr = wal_flush_partial(file, (void *)handle,
+                           _fdb_wal_flush_func, _fdb_wal_get_old_offset,
+                           _fdb_wal_flush_seq_purge,
+                           _fdb_wal_flush_kvs_delta_stats,
+                           &flush_items, max_items);
+
+    if (wr != FDB_RESULT_SUCCESS) {
+        btreeblk_clear_dirty_update(handle->bhandle);
+        filemgr_dirty_update_close_node(handle->file, prev_node);
+        filemgr_dirty_update_remove_node(handle->file, new_node);
+        return wr;
+    }
+
+    _fdb_dirty_update_finalize(handle, prev_node, new_node,
+                               &dirty_idtree_root, &dirty_seqtree_root, false);
+
+    if (max_items) {
+        // A chunk of the background flush: the next commit flushes the rest
+        // only if it is still over the threshold. Until the WAL is clean,
+        // the flushed docs are restored into the WAL again after a crash.
+        wal_set_dirty_status(file, wal_get_size(file) ? FDB_WAL_DIRTY
+                                                      : FDB_WAL_CLEAN);
+    } else {
+        wal_set_dirty_status(file, FDB_WAL_PENDING);
+    }
+    // it is ok to release flushed items becuase
+    // these items are not actually committed yet.
+    // they become visible after fdb_commit is invoked.
+    wal_release_flushed_items(file, &flush_items);
+
+    btreeblk_reset_subblock_info(handle->bhandle);
+    return FDB_RESULT_SUCCESS;
+}
+
+fdb_status fdb_flush_wal_background(fdb_file_handle *fhandle)
+{
+    fdb_kvs_handle *handle = fhandle->root;
+    fdb_status fs = FDB_RESULT_SUCCESS;
+    size_t num_flushable;
+    // number of entries left to be flushed, out of those flushable at the
+    // beginning; the entries appended in the meantime are left to the next
+    // flush, so that writers cannot keep this flush going forever.
+    size_t num_left = 0;
+    bool first_chunk = true;
+
+    if (!atomic_cas_uint8_t(&handle->handle_busy, 0, 1)) {
+        return FDB_RESULT_HANDLE_BUSY;
+    }
+
+    // The WAL is flushed in chunks, and the file lock is released between
+    // them so that writers are not blocked for the whole flush.
+    while (fs == FDB_RESULT_SUCCESS) {
+        fdb_check_file_reopen(handle, NULL);
+        filemgr_mutex_lock(handle->file);
+        fdb_sync_db_header(handle);
+
+        num_flushable = wal_get_num_flushable(handle->file);
+        if (first_chunk) {
+            num_left = num_flushable;
+        }
+        // writers flush the WAL by themselves while the file is compacted
+        // or rolled back.
+        if (filemgr_is_rollback_on(handle->file) ||
+            filemgr_get_file_status(handle->file) != FILE_NORMAL ||
+            (first_chunk && num_flushable <= _fdb_get_wal_threshold(handle)) ||
+            num_flushable == 0 || num_left == 0) {
+            filemgr_mutex_unlock(handle->file);
+            break;
+        }
+        handle->dirty_updates = 1;
+        fs = _fdb_flush_wal_before_commit(handle, FDB_WALFLUSHER_CHUNK_SIZE);
+        if (wal_get_num_flushable(handle->file) >= num_flushable) {
+            // nothing could be flushed
+            num_left = 0;
+        }
+        filemgr_mutex_unlock(handle->file);
+
+        num_left -= MIN(num_left, FDB_WALFLUSHER_CHUNK_SIZE);
+        first_chunk = false;
     }
 
     atomic_cas_uint8_t(&handle->handle_busy, 1, 0);
-    return FDB_RESULT_SUCCESS;
+    return fs;
 }
 
-INLINE uint64_t _fdb_get_wal_threshold(fdb_kvs_handle *handle)
+INLINE void _fdb_set_unlock(fdb_kvs_handle *handle, struct filemgr *file,
+                            bool shared_lock)
 {
-    return handle->config.wal_threshold;
+    if (shared_lock) {
+        filemgr_mutex_unlock_shared(file, handle->kvs->id);
+    } else {
+        filemgr_mutex_unlock(file);
+    }
 }
 
-LIBFDB_API
-fdb_status fdb_set(fdb_kvs_handle *handle, fdb_doc *doc)
+INLINE bool _fdb_set_doc_is_valid(fdb_kvs_handle *handle, fdb_doc *doc)
 {
-    if (!handle) {
-        return FDB_RESULT_INVALID_HANDLE;
-    }
+    return !(!doc || doc->key == NULL ||
+             doc->keylen == 0 || doc->keylen > FDB_MAX_KEYLEN ||
+             (doc->metalen > 0 && doc->meta == NULL) ||
+             (doc->bodylen > 0 && doc->body == NULL) ||
+             (handle->kvs_config.custom_cmp &&
+                 doc->keylen > handle->config.blocksize - HBTRIE_HEADROOM));
+}
 
+// Append the given documents and insert them into the WAL under a single
+// acquisition of the file lock. The documents should be validated already.
+static fdb_status _fdb_set_docs(fdb_kvs_handle *handle, fdb_doc **docs,
+                                size_t n)
+{
     uint64_t offset;
     struct docio_object _doc;
     struct filemgr *file;
@@ -4119,50 +4786,32 @@ fdb_status fdb_set(fdb_kvs_handle *handle, fdb_doc *doc)
     bool txn_enabled = false;
     bool sub_handle = false;
     bool wal_flushed = false;
-    bool immediate_remove = false;
+    bool immediate_remove;
+    bool shared_lock = false;
     file_status_t fstatus;
     fdb_txn *txn = handle->fhandle->root->txn;
     struct _fdb_key_cmp_info cmp_info;
     fdb_status wr = FDB_RESULT_SUCCESS;
+    fdb_doc *doc;
+    uint8_t *keybuf = NULL;
+    size_t i, size_chunk = 0, max_keylen = 0;
+    uint64_t num_sets = 0;
     LATENCY_STAT_START();
 
-    if (handle->config.flags & FDB_OPEN_FLAG_RDONLY) {
-        return fdb_log(&handle->log_callback, FDB_LOG_WARNING,
-                       FDB_RESULT_RONLY_VIOLATION,
-                       "Warning: SET is not allowed on the read-only DB file '%s'.",
-                       handle->file->filename);
-    }
-
-    if (!doc || doc->key == NULL ||
-        doc->keylen == 0 || doc->keylen > FDB_MAX_KEYLEN ||
-        (doc->metalen > 0 && doc->meta == NULL) ||
-        (doc->bodylen > 0 && doc->body == NULL) ||
-        (handle->kvs_config.custom_cmp &&
-            doc->keylen > handle->config.blocksize - HBTRIE_HEADROOM)) {
-        return FDB_RESULT_INVALID_ARGS;
-    }
-
     if (!atomic_cas_uint8_t(&handle->handle_busy, 0, 1)) {
         return FDB_RESULT_HANDLE_BUSY;
     }
 
-    _doc.length.keylen = doc->keylen;
-    _doc.length.metalen = doc->metalen;
-    _doc.length.bodylen = doc->deleted ? 0 : doc->bodylen;
-    _doc.key = doc->key;
-    _doc.meta = doc->meta;
-    _doc.body = doc->deleted ? NULL : doc->body;
-
     if (handle->kvs) {
         // multi KV instance mode
         // allocate more (temporary) space for key, to store ID number
-        int size_chunk = handle->config.chunksize;
-        _doc.length.keylen = doc->keylen + size_chunk;
-        _doc.key = alca(uint8_t, _doc.length.keylen);
+        size_chunk = handle->config.chunksize;
+        for (i = 0; i < n; ++i) {
+            max_keylen = MAX(max_keylen, docs[i]->keylen);
+        }
+        keybuf = alca(uint8_t, max_keylen + size_chunk);
         // copy ID
-        kvid2buf(size_chunk, handle->kvs->id, _doc.key);
-        // copy key
-        memcpy((uint8_t*)_doc.key + size_chunk, doc->key, doc->keylen);
+        kvid2buf(size_chunk, handle->kvs->id, keybuf);
 
         if (handle->kvs->type == KVS_SUB) {
             sub_handle = true;
@@ -4171,6 +4820,10 @@ fdb_status fdb_set(fdb_kvs_handle *handle, fdb_doc *doc)
         }
     }
 
+    // Non-transactional writers of different KV stores only share the WAL
+    // and the block allocator, so they can hold the file lock in shared mode.
+    shared_lock = sub_handle && !txn && !handle->config.bottom_up_index_build;
+
 fdb_set_start:
     fdb_check_file_reopen(handle, NULL);
 
@@ -4182,11 +4835,15 @@ fdb_set_start:
     cmp_info.kvs_config = handle->kvs_config;
     cmp_info.kvs = handle->kvs;
 
-    filemgr_mutex_lock(handle->file);
+    if (shared_lock) {
+        filemgr_mutex_lock_shared(handle->file, handle->kvs->id);
+    } else {
+        filemgr_mutex_lock(handle->file);
+    }
     fdb_sync_db_header(handle);
 
     if (filemgr_is_rollback_on(handle->file)) {
-        filemgr_mutex_unlock(handle->file);
+        _fdb_set_unlock(handle, handle->file, shared_lock);
         atomic_cas_uint8_t(&handle->handle_busy, 1, 0);
         return FDB_RESULT_FAIL_BY_ROLLBACK;
     }
@@ -4198,118 +4855,146 @@ fdb_set_start:
     if (fstatus == FILE_REMOVED_PENDING) {
         // we must not write into this file
         // file status was changed by other thread .. start over
-        filemgr_mutex_unlock(file);
+        _fdb_set_unlock(handle, file, shared_lock);
         goto fdb_set_start;
     }
 
-    if (sub_handle) {
-        // multiple KV instance mode AND sub handle
-        fdb_seqnum_t kv_seqnum = fdb_kvs_get_seqnum(file,
-                                                    handle->kvs->id);
-        if (doc->seqnum != SEQNUM_NOT_USED &&
-            doc->flags & FDB_CUSTOM_SEQNUM) { // User specified own seqnum
-            if (kv_seqnum < doc->seqnum) { // track highest seqnum in handle,kv
-                handle->seqnum = doc->seqnum;
-                fdb_kvs_set_seqnum(file, handle->kvs->id,
-                                   handle->seqnum);
-            }
-            doc->flags &= ~FDB_CUSTOM_SEQNUM; // clear flag for fdb_doc reuse
-        } else { // normal monotonically increasing sequence numbers..
-            doc->seqnum = ++kv_seqnum;
-            handle->seqnum = doc->seqnum; // keep handle's seqnum the highest
-            fdb_kvs_set_seqnum(file, handle->kvs->id, handle->seqnum);
-        }
+    if (txn) {
+        txn_enabled = true;
     } else {
-        fdb_seqnum_t kv_seqnum = filemgr_get_seqnum(file);
-        // super handle OR single KV instance mode
-        if (doc->seqnum != SEQNUM_NOT_USED &&
-            doc->flags & FDB_CUSTOM_SEQNUM) { // User specified own seqnum
-            if (kv_seqnum < doc->seqnum) { // track highest seqnum in handle,kv
+        txn = &file->global_txn;
+    }
+
+    for (i = 0; i < n; ++i) {
+        doc = docs[i];
+
+        _doc.length.keylen = doc->keylen;
+        _doc.length.metalen = doc->metalen;
+        _doc.length.bodylen = doc->deleted ? 0 : doc->bodylen;
+        _doc.key = doc->key;
+        _doc.meta = doc->meta;
+        _doc.body = doc->deleted ? NULL : doc->body;
+
+        if (handle->kvs) {
+            _doc.length.keylen = doc->keylen + size_chunk;
+            _doc.key = keybuf;
+            // copy key
+            memcpy(keybuf + size_chunk, doc->key, doc->keylen);
+        }
+
+        if (sub_handle) {
+            // multiple KV instance mode AND sub handle
+            fdb_seqnum_t kv_seqnum = fdb_kvs_get_seqnum(file,
+                                                        handle->kvs->id);
+            if (doc->seqnum != SEQNUM_NOT_USED &&
+                doc->flags & FDB_CUSTOM_SEQNUM) { // User specified own seqnum
+                if (kv_seqnum < doc->seqnum) { // track highest seqnum in handle,kv
+                    handle->seqnum = doc->seqnum;
+                    fdb_kvs_set_seqnum(file, handle->kvs->id,
+                                       handle->seqnum);
+                }
+                doc->flags &= ~FDB_CUSTOM_SEQNUM; // clear flag for fdb_doc reuse
+            } else { // normal monotonically increasing sequence numbers..
+                doc->seqnum = ++kv_seqnum;
+                handle->seqnum = doc->seqnum; // keep handle's seqnum the highest
+                fdb_kvs_set_seqnum(file, handle->kvs->id, handle->seqnum);
+            }
+        } else {
+            fdb_seqnum_t kv_seqnum = filemgr_get_seqnum(file);
+            // super handle OR single KV instance mode
+            if (doc->seqnum != SEQNUM_NOT_USED &&
+                doc->flags & FDB_CUSTOM_SEQNUM) { // User specified own seqnum
+                if (kv_seqnum < doc->seqnum) { // track highest seqnum in handle,kv
+                    handle->seqnum = doc->seqnum;
+                    filemgr_set_seqnum(file, handle->seqnum);
+                }
+                doc->flags &= ~FDB_CUSTOM_SEQNUM; // clear flag for fdb_doc reuse
+            } else { // normal monotonically increasing sequence numbers..
+                doc->seqnum = ++kv_seqnum;
                 handle->seqnum = doc->seqnum;
                 filemgr_set_seqnum(file, handle->seqnum);
             }
-            doc->flags &= ~FDB_CUSTOM_SEQNUM; // clear flag for fdb_doc reuse
-        } else { // normal monotonically increasing sequence numbers..
-            doc->seqnum = ++kv_seqnum;
-            handle->seqnum = doc->seqnum;
-            filemgr_set_seqnum(file, handle->seqnum);
         }
-    }
-    _doc.seqnum = doc->seqnum;
-
-    if (doc->deleted) {
-        // set timestamp
-        gettimeofday(&tv, NULL);
-        _doc.timestamp = (timestamp_t)tv.tv_sec;
-    } else {
-        _doc.timestamp = 0;
-    }
+        _doc.seqnum = doc->seqnum;
 
-    if (txn) {
-        txn_enabled = true;
-    }
+        if (doc->deleted) {
+            // set timestamp
+            gettimeofday(&tv, NULL);
+            _doc.timestamp = (timestamp_t)tv.tv_sec;
+        } else {
+            _doc.timestamp = 0;
+        }
 
-    offset = docio_append_doc(dhandle, &_doc, doc->deleted, txn_enabled);
-    if (offset == BLK_NOT_FOUND) {
-        filemgr_mutex_unlock(file);
-        atomic_cas_uint8_t(&handle->handle_busy, 1, 0);
-        return FDB_RESULT_WRITE_FAIL;
-    }
+        offset = docio_append_doc(dhandle, &_doc, doc->deleted, txn_enabled);
+        if (offset == BLK_NOT_FOUND) {
+            // the docs before this one are already in the WAL
+            if (i && !handle->config.bottom_up_index_build &&
+                wal_get_dirty_status(file) == FDB_WAL_CLEAN) {
+                wal_set_dirty_status(file, FDB_WAL_DIRTY);
+            }
+            _fdb_set_unlock(handle, file, shared_lock);
+            atomic_add_uint64_t(&handle->op_stats->num_sets, num_sets,
+                                std::memory_order_relaxed);
+            atomic_cas_uint8_t(&handle->handle_busy, 1, 0);
+            return FDB_RESULT_WRITE_FAIL;
+        }
 
-    if (doc->deleted && !handle->config.purging_interval) {
         // immediately remove from hbtrie upon WAL flush
-        immediate_remove = true;
-    }
+        immediate_remove = doc->deleted && !handle->config.purging_interval;
 
-    doc->size_ondisk = _fdb_get_docsize(_doc.length);
-    doc->offset = offset;
-    if (!txn) {
-        txn = &file->global_txn;
-    }
+        doc->size_ondisk = _fdb_get_docsize(_doc.length);
+        doc->offset = offset;
 
-    if (handle->config.bottom_up_index_build) {
-        // Bottom-up build mode, bypass WAL.
-        struct bottom_up_build_entry* bub_entry =
-            (struct bottom_up_build_entry*)
-            malloc(sizeof(struct bottom_up_build_entry));
-        bub_entry->keylen = _doc.length.keylen;
-        bub_entry->key = (void*)malloc(_doc.length.keylen);
-        memcpy(bub_entry->key, _doc.key, _doc.length.keylen);
-        bub_entry->seqnum = doc->seqnum;
-        bub_entry->offset = doc->offset;
-
-        fdb_kvs_handle* root_handle = handle->fhandle->root;
-        list_push_back(root_handle->bub_ctx.entries, &bub_entry->le);
-        root_handle->bub_ctx.num_entries++;
-        root_handle->bub_ctx.space_used += doc->size_ondisk;
+        if (handle->config.bottom_up_index_build) {
+            // Bottom-up build mode, bypass WAL.
+            struct bottom_up_build_entry* bub_entry =
+                (struct bottom_up_build_entry*)
+                malloc(sizeof(struct bottom_up_build_entry));
+            bub_entry->keylen = _doc.length.keylen;
+            bub_entry->key = (void*)malloc(_doc.length.keylen);
+            memcpy(bub_entry->key, _doc.key, _doc.length.keylen);
+            bub_entry->seqnum = doc->seqnum;
+            bub_entry->offset = doc->offset;
+
+            fdb_kvs_handle* root_handle = handle->fhandle->root;
+            list_push_back(root_handle->bub_ctx.entries, &bub_entry->le);
+            root_handle->bub_ctx.num_entries++;
+            root_handle->bub_ctx.space_used += doc->size_ondisk;
 
-    } else {
-        if (handle->kvs) {
-            // multi KV instance mode
-            fdb_doc kv_ins_doc = *doc;
-            kv_ins_doc.key = _doc.key;
-            kv_ins_doc.keylen = _doc.length.keylen;
-            if (!immediate_remove) {
-                wal_insert(txn, file, &cmp_info, &kv_ins_doc, offset,
-                           WAL_INS_WRITER);
-            } else {
-                wal_immediate_remove(txn, file, &cmp_info, &kv_ins_doc, offset,
-                                     WAL_INS_WRITER);
-            }
         } else {
-            if (!immediate_remove) {
-                wal_insert(txn, file, &cmp_info, doc, offset, WAL_INS_WRITER);
+            if (handle->kvs) {
+                // multi KV instance mode
+                fdb_doc kv_ins_doc = *doc;
+                kv_ins_doc.key = _doc.key;
+                kv_ins_doc.keylen = _doc.length.keylen;
+                if (!immediate_remove) {
+                    wal_insert(txn, file, &cmp_info, &kv_ins_doc, offset,
+                               WAL_INS_WRITER);
+                } else {
+                    wal_immediate_remove(txn, file, &cmp_info, &kv_ins_doc,
+                                         offset, WAL_INS_WRITER);
+                }
             } else {
-                wal_immediate_remove(txn, file, &cmp_info, doc, offset,
-                                     WAL_INS_WRITER);
+                if (!immediate_remove) {
+                    wal_insert(txn, file, &cmp_info, doc, offset,
+                               WAL_INS_WRITER);
+                } else {
+                    wal_immediate_remove(txn, file, &cmp_info, doc, offset,
+                                         WAL_INS_WRITER);
+                }
             }
         }
 
-        if (wal_get_dirty_status(file)== FDB_WAL_CLEAN) {
-            wal_set_dirty_status(file, FDB_WAL_DIRTY);
+        if (!doc->deleted) {
+            num_sets++;
         }
     }
 
+    if (!handle->config.bottom_up_index_build &&
+        wal_get_dirty_status(file)== FDB_WAL_CLEAN) {
+        wal_set_dirty_status(file, FDB_WAL_DIRTY);
+    }
+
     if (handle->config.auto_commit &&
         wal_get_num_flushable(file) > _fdb_get_wal_threshold(handle)) {
         // we don't need dirty WAL flushing in auto commit mode
@@ -4318,63 +5003,52 @@ fdb_set_start:
 
     } else if (handle->config.wal_flush_before_commit) {
 
-        bid_t dirty_idtree_root = BLK_NOT_FOUND;
-        bid_t dirty_seqtree_root = BLK_NOT_FOUND;
+        uint64_t flush_limit = _fdb_get_wal_flush_limit(handle);
 
         if (!txn_enabled) {
             handle->dirty_updates = 1;
         }
 
-        if (wal_get_num_flushable(file) > _fdb_get_wal_threshold(handle)) {
-            union wal_flush_items flush_items;
+        if (handle->config.enable_background_wal_flush &&
+            wal_get_num_flushable(file) > _fdb_get_wal_threshold(handle)) {
+            // let the background WAL flusher catch up
+            walflusher_notify();
+        }
 
-            // commit only for non-transactional WAL entries
-            wr = wal_commit(&file->global_txn, file, NULL, &handle->log_callback);
-            if (wr != FDB_RESULT_SUCCESS) {
-                filemgr_mutex_unlock(file);
-                atomic_cas_uint8_t(&handle->handle_busy, 1, 0);
-                return wr;
+        if (shared_lock && wal_get_num_flushable(file) > flush_limit) {
+            // flushing the WAL needs the file exclusively; other writers
+            // may flush it in the meantime, so the threshold is checked again.
+            filemgr_mutex_unlock_shared(file, handle->kvs->id);
+            shared_lock = false;
+            filemgr_mutex_lock(file);
+            fdb_sync_db_header(handle);
+            if (filemgr_get_file_status(file) == FILE_REMOVED_PENDING ||
+                filemgr_is_rollback_on(file)) {
+                // the document is already in the WAL, which will be
+                // moved or rolled back as a whole.
+                goto fdb_set_done;
             }
+        }
 
-            struct filemgr_dirty_update_node *prev_node = NULL, *new_node = NULL;
-
-            _fdb_dirty_update_ready(handle, &prev_node, &new_node,
-                                    &dirty_idtree_root, &dirty_seqtree_root, true);
-
-            wr = wal_flush(file, (void *)handle,
-                           _fdb_wal_flush_func, _fdb_wal_get_old_offset,
-                           _fdb_wal_flush_seq_purge, _fdb_wal_flush_kvs_delta_stats,
-                           &flush_items);
-
+        if (wal_get_num_flushable(file) > flush_limit) {
+            wr = _fdb_flush_wal_before_commit(handle, 0);
             if (wr != FDB_RESULT_SUCCESS) {
-                btreeblk_clear_dirty_update(handle->bhandle);
-                filemgr_dirty_update_close_node(handle->file, prev_node);
-                filemgr_dirty_update_remove_node(handle->file, new_node);
                 filemgr_mutex_unlock(file);
                 atomic_cas_uint8_t(&handle->handle_busy, 1, 0);
                 return wr;
             }
-
-            _fdb_dirty_update_finalize(handle, prev_node, new_node,
-                                       &dirty_idtree_root, &dirty_seqtree_root, false);
-
-            wal_set_dirty_status(file, FDB_WAL_PENDING);
-            // it is ok to release flushed items becuase
-            // these items are not actually committed yet.
-            // they become visible after fdb_commit is invoked.
-            wal_release_flushed_items(file, &flush_items);
-
             wal_flushed = true;
-            btreeblk_reset_subblock_info(handle->bhandle);
         }
     }
 
-    filemgr_mutex_unlock(file);
+fdb_set_done:
+    _fdb_set_unlock(handle, file, shared_lock);
 
     LATENCY_STAT_END(file, FDB_LATENCY_SETS);
 
-    if (!doc->deleted) {
-        atomic_incr_uint64_t(&handle->op_stats->num_sets, std::memory_order_relaxed);
+    if (num_sets) {
+        atomic_add_uint64_t(&handle->op_stats->num_sets, num_sets,
+                            std::memory_order_relaxed);
     }
 
     if (wal_flushed && handle->config.auto_commit) {
@@ -4386,6 +5060,58 @@ fdb_set_start:
     return FDB_RESULT_SUCCESS;
 }
 
+LIBFDB_API
+fdb_status fdb_set(fdb_kvs_handle *handle, fdb_doc *doc)
+{
+    if (!handle) {
+        return FDB_RESULT_INVALID_HANDLE;
+    }
+
+    if (handle->config.flags & FDB_OPEN_FLAG_RDONLY) {
+        return fdb_log(&handle->log_callback, FDB_LOG_WARNING,
+                       FDB_RESULT_RONLY_VIOLATION,
+                       "Warning: SET is not allowed on the read-only DB file '%s'.",
+                       handle->file->filename);
+    }
+
+    if (!_fdb_set_doc_is_valid(handle, doc)) {
+        return FDB_RESULT_INVALID_ARGS;
+    }
+
+    return _fdb_set_docs(handle, &doc, 1);
+}
+
+LIBFDB_API
+fdb_status fdb_set_multi(fdb_kvs_handle *handle, fdb_doc **docs, size_t n)
+{
+    size_t i;
+
+    if (!handle) {
+        return FDB_RESULT_INVALID_HANDLE;
+    }
+
+    if (handle->config.flags & FDB_OPEN_FLAG_RDONLY) {
+        return fdb_log(&handle->log_callback, FDB_LOG_WARNING,
+                       FDB_RESULT_RONLY_VIOLATION,
+                       "Warning: SET is not allowed on the read-only DB file '%s'.",
+                       handle->file->filename);
+    }
+
+    if (n && !docs) {
+        return FDB_RESULT_INVALID_ARGS;
+    }
+    for (i = 0; i < n; ++i) {
+        if (!_fdb_set_doc_is_valid(handle, docs[i])) {
+            return FDB_RESULT_INVALID_ARGS;
+        }
+    }
+    if (n == 0) {
+        return FDB_RESULT_SUCCESS;
+    }
+
+    return _fdb_set_docs(handle, docs, n);
+}
+
 LIBFDB_API
 fdb_status fdb_del(fdb_kvs_handle *handle, fdb_doc *doc)
 {
@@ -4801,9 +5527,12 @@ fdb_status _fdb_bottom_up_index_build(fdb_kvs_handle *handle)
     return fs;
 }
 
-fdb_status _fdb_commit(fdb_kvs_handle *handle,
-                       fdb_commit_opt_t opt,
-                       bool sync)
+// If 'async_seq' is given, the group commit sequence number of a normal
+// durable commit is returned through it instead of waiting for the sync.
+static fdb_status _fdb_commit_internal(fdb_kvs_handle *handle,
+                                       fdb_commit_opt_t opt,
+                                       bool sync,
+                                       uint64_t *async_seq)
 {
     if (!handle) {
         return FDB_RESULT_INVALID_HANDLE;
@@ -4815,10 +5544,18 @@ fdb_status _fdb_commit(fdb_kvs_handle *handle,
     file_status_t fstatus;
     fdb_status fs = FDB_RESULT_SUCCESS;
     bool wal_flushed = false;
+    // true if the index is updated by WAL flushes since the last commit,
+    // including the background ones
+    bool index_updated = false;
     bid_t dirty_idtree_root = BLK_NOT_FOUND;
     bid_t dirty_seqtree_root = BLK_NOT_FOUND;
     union wal_flush_items flush_items;
     fdb_status wr = FDB_RESULT_SUCCESS;
+    // Normal durable commits share their sync with concurrent ones if it
+    // is enabled. Asynchronous commits always defer their sync this way.
+    bool group_commit = sync && opt == FDB_COMMIT_NORMAL &&
+                        (handle->config.group_commit || async_seq);
+    uint64_t group_seq = 0;
     LATENCY_STAT_START();
 
     if (handle->kvs) {
@@ -4840,10 +5577,16 @@ fdb_status _fdb_commit(fdb_kvs_handle *handle,
 
 fdb_commit_start:
     fdb_check_file_reopen(handle, NULL);
+    if (group_commit) {
+        filemgr_group_commit_enter(handle->file);
+    }
     filemgr_mutex_lock(handle->file);
     fdb_sync_db_header(handle);
 
     if (filemgr_is_rollback_on(handle->file)) {
+        if (group_commit) {
+            filemgr_group_commit_leave(handle->file);
+        }
         filemgr_mutex_unlock(handle->file);
         atomic_cas_uint8_t(&handle->handle_busy, 1, 0);
         return FDB_RESULT_FAIL_BY_ROLLBACK;
@@ -4853,12 +5596,18 @@ fdb_commit_start:
     if (fstatus == FILE_REMOVED_PENDING) {
         // we must not commit this file
         // file status was changed by other thread .. start over
+        if (group_commit) {
+            filemgr_group_commit_leave(handle->file);
+        }
         filemgr_mutex_unlock(handle->file);
         goto fdb_commit_start;
     }
 
     fs = btreeblk_end(handle->bhandle);
     if (fs != FDB_RESULT_SUCCESS) {
+        if (group_commit) {
+            filemgr_group_commit_leave(handle->file);
+        }
         filemgr_mutex_unlock(handle->file);
         atomic_cas_uint8_t(&handle->handle_busy, 1, 0);
         return fs;
@@ -4870,6 +5619,9 @@ fdb_commit_start:
         wr = wal_commit(txn, handle->file, _fdb_append_commit_mark,
                         &handle->log_callback);
         if (wr != FDB_RESULT_SUCCESS) {
+            if (group_commit) {
+                filemgr_group_commit_leave(handle->file);
+            }
             filemgr_mutex_unlock(handle->file);
             atomic_cas_uint8_t(&handle->handle_busy, 1, 0);
             return wr;
@@ -4885,12 +5637,15 @@ fdb_commit_start:
 
     if (wal_get_num_flushable(handle->file) > _fdb_get_wal_threshold(handle) ||
         wal_get_dirty_status(handle->file) == FDB_WAL_PENDING ||
-        opt & FDB_COMMIT_MANUAL_WAL_FLUSH) {
+        opt & FDB_COMMIT_MANUAL_WAL_FLUSH ||
+        (wal_get_dirty_status(handle->file) == FDB_WAL_DIRTY &&
+         _fdb_wal_restore_too_long(handle))) {
         // wal flush when
         // 1. wal size exceeds threshold
         // 2. wal is already flushed before commit
         //    (in this case, flush the rest of entries)
         // 3. user forces to manually flush wal
+        // 4. too many docs would be restored into the wal after a crash
 
         if (handle->config.bottom_up_index_build) {
             _fdb_bottom_up_index_build(handle);
@@ -4911,13 +5666,30 @@ fdb_commit_start:
                 btreeblk_clear_dirty_update(handle->bhandle);
                 filemgr_dirty_update_close_node(handle->file, prev_node);
                 filemgr_dirty_update_remove_node(handle->file, new_node);
+                if (group_commit) {
+                    filemgr_group_commit_leave(handle->file);
+                }
                 filemgr_mutex_unlock(handle->file);
                 atomic_cas_uint8_t(&handle->handle_busy, 1, 0);
                 return wr;
             }
             wal_set_dirty_status(handle->file, FDB_WAL_CLEAN);
-            wal_flushed = true;
+            wal_flushed = index_updated = true;
+
+            _fdb_dirty_update_finalize(handle, prev_node, new_node,
+                                       &dirty_idtree_root, &dirty_seqtree_root, true);
+        }
+    } else if (handle->config.enable_background_wal_flush) {
+        struct filemgr_dirty_update_node *prev_node, *new_node;
 
+        prev_node = filemgr_dirty_update_get_latest(handle->file);
+        if (prev_node) {
+            // the WAL is partially flushed in background since the last
+            // commit; write back the index updates of those flushes only.
+            filemgr_dirty_update_close_node(handle->file, prev_node);
+            _fdb_dirty_update_ready(handle, &prev_node, &new_node,
+                                    &dirty_idtree_root, &dirty_seqtree_root, false);
+            index_updated = true;
             _fdb_dirty_update_finalize(handle, prev_node, new_node,
                                        &dirty_idtree_root, &dirty_seqtree_root, true);
         }
@@ -4940,7 +5712,7 @@ fdb_commit_start:
         handle->rollback_revnum = 0;
     }
 
-    if (wal_flushed) {
+    if (index_updated) {
         fdb_gather_stale_blocks(handle,
                                 next_revnum,
                                 atomic_get_uint64_t(&handle->last_hdr_bid),
@@ -4986,7 +5758,7 @@ fdb_commit_start:
     if (handle->file->sb) {
         // sync superblock
         sb_update_header(handle);
-        if (sb_check_sync_period(handle) && wal_flushed) {
+        if (sb_check_sync_period(handle) && index_updated) {
             sb_decision_t decision;
             bool block_reclaimed = false;
 
@@ -5026,7 +5798,15 @@ fdb_commit_start:
 
     // file commit
     fs = filemgr_commit_bid(handle->file, handle->last_hdr_bid,
-                            cur_bmp_revnum, sync, &handle->log_callback);
+                            cur_bmp_revnum, sync && !group_commit,
+                            &handle->log_callback);
+    if (group_commit) {
+        if (fs == FDB_RESULT_SUCCESS) {
+            group_seq = filemgr_group_commit_written(handle->file);
+        } else {
+            filemgr_group_commit_leave(handle->file);
+        }
+    }
     if (wal_flushed) {
         wal_release_flushed_items(handle->file, &flush_items);
     }
@@ -5037,12 +5817,59 @@ fdb_commit_start:
     handle->dirty_updates = 0;
     filemgr_mutex_unlock(handle->file);
 
+    if (group_seq && async_seq) {
+        *async_seq = group_seq;
+    } else if (group_seq) {
+        // sync without the file mutex, so that concurrent committers can
+        // write their DB headers in the meantime and share this sync.
+        fs = filemgr_group_commit_sync(handle->file, group_seq,
+                                       handle->config.group_commit_window,
+                                       &handle->log_callback);
+    }
+
     LATENCY_STAT_END(handle->file, FDB_LATENCY_COMMITS);
     atomic_incr_uint64_t(&handle->op_stats->num_commits, std::memory_order_relaxed);
     atomic_cas_uint8_t(&handle->handle_busy, 1, 0);
     return fs;
 }
 
+fdb_status _fdb_commit(fdb_kvs_handle *handle,
+                       fdb_commit_opt_t opt,
+                       bool sync)
+{
+    return _fdb_commit_internal(handle, opt, sync, NULL);
+}
+
+LIBFDB_API
+fdb_status fdb_commit_async(fdb_file_handle *fhandle, fdb_commit_opt_t opt,
+                            fdb_commit_callback callback, void *ctx)
+{
+    if (!fhandle) {
+        return FDB_RESULT_INVALID_HANDLE;
+    }
+    if (!callback) {
+        return FDB_RESULT_INVALID_ARGS;
+    }
+
+    fdb_kvs_handle *handle = fhandle->root;
+    uint64_t seq = 0;
+    fdb_status fs;
+
+    // Only normal durable commits defer their sync to the daemon thread.
+    // The others are done as usual, while their callbacks are still queued
+    // behind the earlier ones to keep the order.
+    fs = _fdb_commit_internal(handle, opt,
+                              !(handle->config.durability_opt & FDB_DRB_ASYNC),
+                              &seq);
+    if (fs != FDB_RESULT_SUCCESS) {
+        return fs;
+    }
+
+    commitsyncer_enqueue(fhandle, handle->file, seq, fs,
+                         handle->config.group_commit_window, callback, ctx);
+    return FDB_RESULT_SUCCESS;
+}
+
 static fdb_status _fdb_commit_and_remove_pending(fdb_kvs_handle *handle,
                                            struct filemgr *old_file,
                                            struct filemgr *new_file)
@@ -5133,6 +5960,7 @@ static fdb_status _fdb_commit_and_remove_pending(fdb_kvs_handle *handle,
     }
 
     compactor_switch_file(old_file, new_file, &handle->log_callback);
+    walflusher_switch_file(old_file, new_file);
     do { // Find all files pointing to old_file and redirect them to new file..
         very_old_file = filemgr_search_stale_links(old_file);
         if (very_old_file) {
@@ -5177,6 +6005,9 @@ static fdb_status _fdb_commit_and_remove_pending(fdb_kvs_handle *handle,
 
     filemgr_mutex_unlock(new_file);
 
+    // the WAL flusher's handle still refers to the old file
+    walflusher_release_file(new_file, false);
+
     atomic_incr_uint64_t(&handle->op_stats->num_compacts, std::memory_order_relaxed);
 
     if (handle->config.compaction_cb &&
@@ -7261,6 +8092,7 @@ static void _fdb_cleanup_compact_err(fdb_kvs_handle *handle,
         filemgr_mutex_unlock(new_file);
     }
     filemgr_fhandle_remove(new_file, handle->fhandle);
+    docio_release_buffer(new_dhandle);
     filemgr_close(new_file, cleanup_cache, new_file->filename,
                   &handle->log_callback);
     // Free all the resources allocated in this function.
@@ -7343,6 +8175,8 @@ static fdb_status _fdb_reset(fdb_kvs_handle *handle, fdb_kvs_handle *handle_in)
                 (void*)new_dhandle, _fdb_readkey_wrap);
 
     hbtrie_set_leaf_cmp(new_trie, _fdb_custom_cmp_wrap);
+    hbtrie_set_leaf_prefix_compression(new_trie,
+                                       handle->config.btree_prefix_compression);
     // set aux
     new_trie->flag = handle->trie->flag;
     new_trie->leaf_height_limit = handle->trie->leaf_height_limit;
@@ -7370,6 +8204,7 @@ static fdb_status _fdb_reset(fdb_kvs_handle *handle, fdb_kvs_handle *handle_in)
                 (struct btree_kv_ops *)malloc(sizeof(struct btree_kv_ops));
             seq_kv_ops = btree_kv_get_kb64_vb64(seq_kv_ops);
             seq_kv_ops->cmp = _cmp_uint64_t_endian_safe;
+            seq_kv_ops->layout = _layout_uint64_t_endian_safe;
             if (!seq_kv_ops) { // LCOV_EXCL_START
                 free(handle->filename);
                 free(new_bhandle);
@@ -7413,6 +8248,7 @@ static fdb_status _fdb_reset(fdb_kvs_handle *handle, fdb_kvs_handle *handle_in)
 
         stale_kv_ops = btree_kv_get_kb64_vb64(stale_kv_ops);
         stale_kv_ops->cmp = _cmp_uint64_t_endian_safe;
+        stale_kv_ops->layout = _layout_uint64_t_endian_safe;
 
         old_staletree = handle->staletree;
         new_staletree = (struct btree*)calloc(1, sizeof(struct btree));
@@ -7564,6 +8400,8 @@ fdb_status fdb_compact_file(fdb_file_handle *fhandle,
                 (void*)new_dhandle, _fdb_readkey_wrap);
 
     hbtrie_set_leaf_cmp(new_trie, _fdb_custom_cmp_wrap);
+    hbtrie_set_leaf_prefix_compression(new_trie,
+                                       handle->config.btree_prefix_compression);
     // set aux
     new_trie->flag = handle->trie->flag;
     new_trie->leaf_height_limit = handle->trie->leaf_height_limit;
@@ -7599,6 +8437,7 @@ fdb_status fdb_compact_file(fdb_file_handle *fhandle,
             stale_kv_ops = (struct btree_kv_ops*)calloc(1, sizeof(struct btree_kv_ops));
             stale_kv_ops = btree_kv_get_kb64_vb64(stale_kv_ops);
             stale_kv_ops->cmp = _cmp_uint64_t_endian_safe;
+            stale_kv_ops->layout = _layout_uint64_t_endian_safe;
         }
 
         new_staletree = (struct btree*)calloc(1, sizeof(struct btree));
@@ -8075,6 +8914,10 @@ fdb_status fdb_switch_compaction_mode(fdb_file_handle *fhandle,
 
     config = handle->config;
     if (handle->config.compaction_mode != mode) {
+        if (handle->config.enable_background_wal_flush &&
+            handle->config.wal_flush_before_commit) {
+            walflusher_release_file(handle->file, true);
+        }
         if (filemgr_get_ref_count(handle->file) > 1) {
             // all the other handles referring this file should be closed
             return FDB_RESULT_FILE_IS_BUSY;
@@ -8168,6 +9011,22 @@ fdb_status fdb_close(fdb_file_handle *fhandle)
         return FDB_RESULT_INVALID_HANDLE;
     }
 
+    // The callbacks of asynchronous commits refer to the file handle, so
+    // they must be invoked before closing it. As the callback being invoked
+    // would never return, the handle cannot be closed from its own callback.
+    if (commitsyncer_in_callback(fhandle)) {
+        return FDB_RESULT_HANDLE_BUSY;
+    }
+    commitsyncer_wait(fhandle);
+
+    fdb_kvs_handle *root = fhandle->root;
+    if (!(root->config.flags & FDB_OPEN_FLAG_RDONLY) &&
+        root->config.enable_background_wal_flush &&
+        root->config.wal_flush_before_commit) {
+        // close the WAL flusher's handle if this is the last one on the file
+        walflusher_release_file(root->file, true);
+    }
+
     fdb_status fs;
     if (fhandle->root->config.auto_commit &&
         filemgr_get_ref_count(fhandle->root->file) == 1) {
@@ -8258,6 +9117,10 @@ fdb_status _fdb_close(fdb_kvs_handle *handle)
             compactor_deregister_file(handle->file);
         }
         bgflusher_deregister_file(handle->file);
+        if (handle->config.enable_background_wal_flush &&
+            handle->config.wal_flush_before_commit) {
+            walflusher_deregister_file(handle->file);
+        }
     }
 
     btreeblk_end(handle->bhandle);
@@ -8270,6 +9133,7 @@ fdb_status _fdb_close(fdb_kvs_handle *handle)
         btreeblk_clear_dirty_update(handle->bhandle);
     }
 
+    docio_release_buffer(handle->dhandle);
     fs = filemgr_close(handle->file, handle->config.cleanup_cache_onclose,
                                   handle->filename, &handle->log_callback);
     if (fs != FDB_RESULT_SUCCESS) {
@@ -8279,6 +9143,12 @@ fdb_status _fdb_close(fdb_kvs_handle *handle)
     hbtrie_free(handle->trie);
     free(handle->trie);
 
+    if (handle->keycache) {
+        keycache_free(handle->keycache);
+        free(handle->keycache);
+        handle->keycache = NULL;
+    }
+
     if (handle->config.seqtree_opt == FDB_SEQTREE_USE) {
         if (handle->kvs) {
             // multi KV instance mode
@@ -8374,7 +9244,7 @@ fdb_status fdb_get_latency_stats(fdb_file_handle *fhandle,
         return FDB_RESULT_INVALID_HANDLE;
     }
 
-    if (!stat || type >= FDB_LATENCY_NUM_STATS) {
+    if (!stat || type >= FDB_LATENCY_NUM_ALL_STATS) {
         return FDB_RESULT_INVALID_ARGS;
     }
 
@@ -8389,6 +9259,31 @@ fdb_status fdb_get_latency_stats(fdb_file_handle *fhandle,
     return FDB_RESULT_SUCCESS;
 }
 
+LIBFDB_API
+fdb_status fdb_get_latency_histogram(fdb_file_handle *fhandle,
+                                     fdb_latency_histogram *hist,
+                                     fdb_latency_stat_type type)
+{
+    if (!fhandle || !fhandle->root) {
+        return FDB_RESULT_INVALID_HANDLE;
+    }
+
+    if (!hist || type >= FDB_LATENCY_NUM_ALL_STATS) {
+        return FDB_RESULT_INVALID_ARGS;
+    }
+
+    if (!fhandle->root->file) {
+        return FDB_RESULT_FILE_NOT_OPEN;
+    }
+
+    memset(hist, 0, sizeof(fdb_latency_histogram));
+#ifdef _LATENCY_STATS
+    filemgr_get_latency_histogram(fhandle->root->file, type, hist);
+#endif // _LATENCY_STATS
+
+    return FDB_RESULT_SUCCESS;
+}
+
 LIBFDB_API
 const char *fdb_latency_stat_name(fdb_latency_stat_type type)
 {
@@ -8596,6 +9491,12 @@ fdb_status fdb_get_file_info(fdb_file_handle *fhandle, fdb_file_info *info)
     info->space_used = fdb_estimate_space_used(fhandle);
     info->file_size = filemgr_get_pos(handle->file);
     info->num_live_nodes = _kvs_stat_get_sum(handle->file, KVS_STAT_NLIVENODES);
+    info->num_group_commit_syncs =
+        atomic_get_uint64_t(&handle->file->group_commit.num_syncs);
+    info->num_group_commits =
+        atomic_get_uint64_t(&handle->file->group_commit.num_commits);
+    info->max_group_commit_batch =
+        atomic_get_uint64_t(&handle->file->group_commit.max_batch);
 
     // Get the number of KV store instances in a given ForestDB file.
     struct kvs_header *kv_header = handle->file->kv_header;
@@ -8786,6 +9687,21 @@ size_t fdb_get_buffer_cache_used() {
     return (size_t) filemgr_get_bcache_used_space();
 }
 
+LIBFDB_API
+fdb_status fdb_get_buffer_cache_stats(fdb_buffer_cache_stats *stats)
+{
+    if (!stats) {
+        return FDB_RESULT_INVALID_ARGS;
+    }
+    if (!fdb_initialized) {
+        memset(stats, 0x0, sizeof(fdb_buffer_cache_stats));
+        return FDB_RESULT_SUCCESS;
+    }
+
+    filemgr_get_bcache_stats(stats);
+    return FDB_RESULT_SUCCESS;
+}
+
 LIBFDB_API
 fdb_status fdb_cancel_compaction(fdb_file_handle *fhandle)
 {
@@ -8856,6 +9772,9 @@ fdb_status fdb_shutdown()
             return FDB_RESULT_FILE_IS_BUSY;
         }
         compactor_shutdown();
+        walflusher_shutdown();
+        commitsyncer_shutdown();
+        wal_prefetch_shutdown();
         //bgflusher_shutdown();
         ret = filemgr_shutdown();
         if (ret == FDB_RESULT_SUCCESS) {
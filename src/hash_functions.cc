@@ -4,6 +4,8 @@
  * (C) 2013  Jung-Sang Ahn <jungsang.ahn@gmail.com>
  */
 
+#include <string.h>
+
 #include "hash_functions.h"
 #include "common.h"
 
@@ -28,6 +30,30 @@ uint32_t hash_djb2_last8(uint8_t *value, int len)
     return hash;
 }
 
+// multiplicative hashing that consumes VALUE eight bytes at a time
+uint32_t hash_words(uint8_t *value, int len)
+{
+    uint64_t hash = UINT64_C(0x9e3779b97f4a7c15) ^ (uint64_t)len;
+    uint64_t word;
+
+    while (len >= 8) {
+        memcpy(&word, value, 8);
+        hash = (hash ^ word) * UINT64_C(0xff51afd7ed558ccd);
+        hash ^= hash >> 32;
+        value += 8;
+        len -= 8;
+    }
+    if (len > 0) {
+        word = 0;
+        memcpy(&word, value, len);
+        hash = (hash ^ word) * UINT64_C(0xff51afd7ed558ccd);
+    }
+    hash ^= hash >> 29;
+    hash *= UINT64_C(0xc4ceb9fe1a85ec53);
+    hash ^= hash >> 32;
+    return (uint32_t)hash;
+}
+
 // LCOV_EXCL_START
 uint32_t hash_uint_modular(uint64_t value, uint64_t mod)
 {
@@ -26,6 +26,7 @@ extern "C" {
 
 uint32_t hash_djb2(uint8_t *value, int len);
 uint32_t hash_djb2_last8(uint8_t *value, int len);
+uint32_t hash_words(uint8_t *value, int len);
 uint32_t hash_uint_modular(uint64_t value, uint64_t mod);
 uint32_t hash_shuffle_2uint(uint64_t a, uint64_t b);
 
@@ -26,6 +26,7 @@
 #include "list.h"
 #include "btree.h"
 #include "btree_kv.h"
+#include "hash_functions.h"
 #include "btree_fast_str_kv.h"
 #include "internal_types.h"
 #include "log_message.h"
@@ -205,9 +206,24 @@ void hbtrie_set_leaf_height_limit(struct hbtrie *trie, uint8_t limit)
     trie->leaf_height_limit = limit;
 }
 
+void hbtrie_set_leaf_prefix_compression(struct hbtrie *trie, bool enable)
+{
+    btree_fast_str_kv_set_prefix_compression(trie->btree_leaf_kv_ops, enable);
+}
+
+void hbtrie_set_key_fingerprint(struct hbtrie *trie, bool enable)
+{
+    if (enable) {
+        trie->flag |= HBTRIE_FLAG_KEY_FINGERPRINT;
+    } else {
+        trie->flag &= ~HBTRIE_FLAG_KEY_FINGERPRINT;
+    }
+}
+
 void hbtrie_set_leaf_cmp(struct hbtrie *trie, btree_cmp_func *cmp)
 {
     trie->btree_leaf_kv_ops->cmp = cmp;
+    trie->btree_leaf_kv_ops->layout = BTREE_KV_LAYOUT_ANY;
 }
 
 void hbtrie_set_map_function(struct hbtrie *trie,
@@ -353,6 +369,89 @@ INLINE int _hbtrie_is_msb_set(struct hbtrie *trie, void *value)
 }
 #endif
 
+// A doc offset may carry a fingerprint of its key in the bits below the MSB:
+// bit 62 marks that the fingerprint exists, and bits 48 ~ 61 hold it.
+// Plain offsets (including all offsets written by older versions) never set
+// bit 62, so that fingerprints are stripped only from tagged values.
+#define HBTRIE_FINGERPRINT_FLAG (0x40)
+#define HBTRIE_FINGERPRINT_MASK (0x3fff)
+
+#if defined(__ENDIAN_SAFE) || defined(_BIG_ENDIAN)
+INLINE uint8_t* _hbtrie_value_hi(struct hbtrie *trie, void *value)
+{
+    return (uint8_t*)value;
+}
+INLINE uint8_t* _hbtrie_value_lo(struct hbtrie *trie, void *value)
+{
+    return (uint8_t*)value + 1;
+}
+#else
+INLINE uint8_t* _hbtrie_value_hi(struct hbtrie *trie, void *value)
+{
+    return (uint8_t*)value + (trie->valuelen-1);
+}
+INLINE uint8_t* _hbtrie_value_lo(struct hbtrie *trie, void *value)
+{
+    return (uint8_t*)value + (trie->valuelen-2);
+}
+#endif
+
+INLINE uint16_t _hbtrie_key_fingerprint(void *rawkey, int rawkeylen)
+{
+    uint32_t hash = hash_djb2((uint8_t*)rawkey, rawkeylen);
+    return (hash ^ (hash >> 16)) & HBTRIE_FINGERPRINT_MASK;
+}
+
+// tag the doc offset in VALUE with FP, unless the offset needs the upper bits
+INLINE void _hbtrie_set_fingerprint(struct hbtrie *trie, void *value,
+                                    uint16_t fp)
+{
+    uint8_t *hi = _hbtrie_value_hi(trie, value);
+    uint8_t *lo = _hbtrie_value_lo(trie, value);
+    if (*hi || *lo) {
+        return;
+    }
+    *hi = HBTRIE_FINGERPRINT_FLAG | (uint8_t)(fp >> 8);
+    *lo = (uint8_t)fp;
+}
+
+// return 1 and set FP_OUT if VALUE is a doc offset tagged with a fingerprint
+INLINE int _hbtrie_get_fingerprint(struct hbtrie *trie, void *value,
+                                   uint16_t *fp_out)
+{
+    uint8_t hi = *_hbtrie_value_hi(trie, value);
+    if ((hi & 0x80) || !(hi & HBTRIE_FINGERPRINT_FLAG)) {
+        return 0;
+    }
+    *fp_out = ((uint16_t)(hi & (HBTRIE_FINGERPRINT_FLAG-1)) << 8) |
+              *_hbtrie_value_lo(trie, value);
+    return 1;
+}
+
+INLINE void _hbtrie_clear_fingerprint(struct hbtrie *trie, void *value)
+{
+    uint16_t fp;
+    if (_hbtrie_get_fingerprint(trie, value, &fp)) {
+        *_hbtrie_value_hi(trie, value) = 0x0;
+        *_hbtrie_value_lo(trie, value) = 0x0;
+    }
+}
+
+// copy a value out of the trie, without the fingerprint
+INLINE void _hbtrie_copy_value(struct hbtrie *trie, void *dst, void *src)
+{
+    memcpy(dst, src, trie->valuelen);
+    _hbtrie_clear_fingerprint(trie, dst);
+}
+
+// get the doc offset in VALUE, without the fingerprint
+INLINE uint64_t _hbtrie_value2offset(struct hbtrie *trie, void *value)
+{
+    uint64_t temp;
+    _hbtrie_copy_value(trie, &temp, value);
+    return trie->btree_kv_ops->value2bid(&temp);
+}
+
 struct btreelist_item {
     struct btree btree;
     chunkno_t chunkno;
@@ -699,7 +798,7 @@ static hbtrie_result _hbtrie_prev(struct hbtrie_iterator *it,
 
             if (hbmeta.value && chunk == NULL) {
                 // NULL key exists .. the smallest key in this tree .. return first
-                offset = trie->btree_kv_ops->value2bid(hbmeta.value);
+                offset = _hbtrie_value2offset(trie, hbmeta.value);
                 if (!(flag & HBTRIE_PREFIX_MATCH_ONLY)) {
                     *keylen = trie->readkey(trie->doc_handle, offset, key_buf);
                     int _len = _hbtrie_reform_key( trie, key_buf, *keylen,
@@ -740,7 +839,7 @@ static hbtrie_result _hbtrie_prev(struct hbtrie_iterator *it,
         } else {
             // MSB is not set -> doc
             // read entire key and return the doc offset
-            offset = trie->btree_kv_ops->value2bid(v);
+            offset = _hbtrie_value2offset(trie, v);
             if (!(flag & HBTRIE_PREFIX_MATCH_ONLY)) {
                 *keylen = trie->readkey(trie->doc_handle, offset, key_buf);
                 int _len = _hbtrie_reform_key(trie, key_buf, *keylen, it->curkey);
@@ -1077,7 +1176,7 @@ static hbtrie_result _hbtrie_next(struct hbtrie_iterator *it,
 
             if (hbmeta.value && chunk == NULL) {
                 // NULL key exists .. the smallest key in this tree .. return first
-                offset = trie->btree_kv_ops->value2bid(hbmeta.value);
+                offset = _hbtrie_value2offset(trie, hbmeta.value);
                 if (flag & HBTRIE_PARTIAL_MATCH) {
                     // return indexed key part only
                     *keylen = (item->chunkno+1) * trie->chunksize;
@@ -1121,7 +1220,7 @@ static hbtrie_result _hbtrie_next(struct hbtrie_iterator *it,
         } else {
             // MSB is not set -> doc
             // read entire key and return the doc offset
-            offset = trie->btree_kv_ops->value2bid(v);
+            offset = _hbtrie_value2offset(trie, v);
             if (flag & HBTRIE_PARTIAL_MATCH) {
                 // return indexed key part only
                 *keylen = (item->chunkno+1) * trie->chunksize;
@@ -1400,7 +1499,7 @@ static hbtrie_result _hbtrie_find(struct hbtrie *trie, void *key, int keylen,
             (!cpt_node && nchunk == curchunkno)) {
             // KEY is exactly same as tree's prefix .. return value in metasection
             if (hbmeta.value && trie->valuelen > 0) {
-                memcpy(valuebuf, hbmeta.value, trie->valuelen);
+                _hbtrie_copy_value(trie, valuebuf, hbmeta.value);
             }
             return HBTRIE_RESULT_SUCCESS;
         } else {
@@ -1428,7 +1527,7 @@ static hbtrie_result _hbtrie_find(struct hbtrie *trie, void *key, int keylen,
                 curchunkno + 1 == nchunk - 1) {
                 // partial match mode & the last meaningful chunk
                 // return btree value
-                memcpy(valuebuf, btree_value, trie->valuelen);
+                _hbtrie_copy_value(trie, valuebuf, btree_value);
                 return HBTRIE_RESULT_SUCCESS;
             }
 
@@ -1477,9 +1576,17 @@ static hbtrie_result _hbtrie_find(struct hbtrie *trie, void *key, int keylen,
 
                 hbtrie_result result = HBTRIE_RESULT_SUCCESS;
 
+                uint16_t fp;
+
                 // get offset value from btree_value
-                offset = trie->btree_kv_ops->value2bid(btree_value);
-                if (!(flag & HBTRIE_PREFIX_MATCH_ONLY)) {
+                offset = _hbtrie_value2offset(trie, btree_value);
+                if (!(flag & HBTRIE_PREFIX_MATCH_ONLY) &&
+                    _hbtrie_get_fingerprint(trie, btree_value, &fp) &&
+                    fp != _hbtrie_key_fingerprint(key, rawkeylen)) {
+                    // the fingerprint tells that the doc has a different key,
+                    // so we don't need to read it
+                    result = HBTRIE_RESULT_FAIL;
+                } else if (!(flag & HBTRIE_PREFIX_MATCH_ONLY)) {
                     // read entire key
                     docrawkeylen = trie->readkey(trie->doc_handle, offset, docrawkey);
                     dockeylen = _hbtrie_reform_key(trie, docrawkey, docrawkeylen, dockey);
@@ -1507,7 +1614,7 @@ static hbtrie_result _hbtrie_find(struct hbtrie *trie, void *key, int keylen,
                                             dockey, curchunkno, nchunk);
                         if (diffchunkno == nchunk) {
                             // success
-                            memcpy(valuebuf, btree_value, trie->valuelen);
+                            _hbtrie_copy_value(trie, valuebuf, btree_value);
                         } else {
                             result = HBTRIE_RESULT_FAIL;
                         }
@@ -1516,7 +1623,7 @@ static hbtrie_result _hbtrie_find(struct hbtrie *trie, void *key, int keylen,
                     }
                 } else {
                     // just return value
-                    memcpy(valuebuf, btree_value, trie->valuelen);
+                    _hbtrie_copy_value(trie, valuebuf, btree_value);
                 }
 
 #if defined(WIN32) || defined(_WIN32)
@@ -2105,7 +2212,7 @@ INLINE hbtrie_result _hbtrie_insert(struct hbtrie *trie,
             // partial update mode & the last meaningful chunk
             // update the local btree value
             if (oldvalue_out) {
-                memcpy(oldvalue_out, btree_value, trie->valuelen);
+                _hbtrie_copy_value(trie, oldvalue_out, btree_value);
             }
             // assume that always normal b-tree
             r = btree_insert(&btreeitem->btree, chunk, value);
@@ -2151,7 +2258,7 @@ INLINE hbtrie_result _hbtrie_insert(struct hbtrie *trie,
         int docnchunk, minchunkno, newchunkno, diffchunkno;
 
         // get offset value from btree_value
-        offset = trie->btree_kv_ops->value2bid(btree_value);
+        offset = _hbtrie_value2offset(trie, btree_value);
 
         // read entire key
         docrawkeylen = trie->readkey(trie->doc_handle, offset, docrawkey);
@@ -2221,7 +2328,7 @@ INLINE hbtrie_result _hbtrie_insert(struct hbtrie *trie,
         if (minchunkno == diffchunkno && docnchunk == nchunk) {
             //3 same key!! .. update the value
             if (oldvalue_out) {
-                memcpy(oldvalue_out, btree_value, trie->valuelen);
+                _hbtrie_copy_value(trie, oldvalue_out, btree_value);
             }
             if (cpt_node) {
                 // leaf b-tree
@@ -2461,6 +2568,15 @@ INLINE hbtrie_result _hbtrie_insert(struct hbtrie *trie,
 hbtrie_result hbtrie_insert(struct hbtrie *trie,
                             void *rawkey, int rawkeylen,
                             void *value, void *oldvalue_out) {
+    if (trie->flag & HBTRIE_FLAG_KEY_FINGERPRINT &&
+        !_hbtrie_is_msb_set(trie, value)) {
+        uint8_t *tagged_value = alca(uint8_t, trie->valuelen);
+        memcpy(tagged_value, value, trie->valuelen);
+        _hbtrie_set_fingerprint(trie, tagged_value,
+                                _hbtrie_key_fingerprint(rawkey, rawkeylen));
+        return _hbtrie_insert(trie, rawkey, rawkeylen,
+                              tagged_value, oldvalue_out, 0x0);
+    }
     return _hbtrie_insert(trie, rawkey, rawkeylen, value, oldvalue_out, 0x0);
 }
 
@@ -2471,6 +2587,239 @@ hbtrie_result hbtrie_insert_partial(struct hbtrie *trie,
                           value, oldvalue_out, HBTRIE_PARTIAL_UPDATE);
 }
 
+// Find the last-level B+tree of (reformed) KEY for hbtrie_insert_batch(),
+// and return 1 if KEY can be put into it as a single entry: its chunk is not
+// in the tree yet, or it points to the doc of the same key. BTREELIST is set
+// to the path from the root B+tree, and OLDVALUE_OUT to the current value
+// of KEY (0xff.. if none). Otherwise return 0; the key then needs
+// _hbtrie_insert() to restructure the trie.
+static int _hbtrie_find_batch_target(struct hbtrie *trie,
+                                     void *key, int keylen,
+                                     void *rawkey, int rawkeylen,
+                                     struct list *btreelist,
+                                     void *oldvalue_out)
+{
+    int nchunk = _get_nchunk(trie, key, keylen);
+    int prevchunkno, curchunkno = 0, docnchunk, ret = 0;
+    uint32_t docrawkeylen;
+    int dockeylen;
+    uint16_t fp;
+    struct btreelist_item *btreeitem;
+    struct hbtrie_meta hbmeta;
+    struct btree_meta meta;
+    btree_result r;
+    uint8_t *buf = alca(uint8_t, trie->btree_nodesize);
+    uint8_t *btree_value = alca(uint8_t, trie->valuelen);
+    uint8_t *chunk;
+    bid_t bid = trie->root_bid;
+
+    meta.data = buf;
+    list_init(btreelist);
+    memset(oldvalue_out, 0xff, trie->valuelen);
+
+    if (trie->root_bid == BLK_NOT_FOUND) {
+        return 0;
+    }
+
+    while (1) {
+        btreeitem = (struct btreelist_item *)
+                    mempool_alloc(sizeof(struct btreelist_item));
+        list_push_back(btreelist, &btreeitem->e);
+        r = btree_init_from_bid(&btreeitem->btree, trie->btreeblk_handle,
+                                trie->btree_blk_ops, trie->btree_kv_ops,
+                                trie->btree_nodesize, bid);
+        if (r != BTREE_RESULT_SUCCESS ||
+            btreeitem->btree.ksize != trie->chunksize ||
+            btreeitem->btree.vsize != trie->valuelen) {
+            return 0;
+        }
+        btreeitem->btree.aux = trie->aux;
+        btreeitem->child_rootbid = BLK_NOT_FOUND;
+        btreeitem->leaf = 0;
+
+        meta.size = btree_read_meta(&btreeitem->btree, meta.data);
+        _hbtrie_fetch_meta(trie, meta.size, &hbmeta, meta.data);
+        if (_is_leaf_btree(hbmeta.chunkno)) {
+            // keys in leaf B+trees are left to _hbtrie_insert()
+            return 0;
+        }
+        prevchunkno = curchunkno;
+        btreeitem->chunkno = curchunkno = hbmeta.chunkno;
+
+        if (curchunkno - prevchunkno > 1 &&
+            _hbtrie_find_diff_chunk(trie, hbmeta.prefix,
+                                    (uint8_t*)key +
+                                        trie->chunksize * (prevchunkno+1),
+                                    0, curchunkno - (prevchunkno+1)) <
+                curchunkno - (prevchunkno+1)) {
+            // the skipped prefix does not match
+            return 0;
+        }
+        if (curchunkno >= nchunk) {
+            // KEY is the prefix of the tree, stored in its meta section
+            return 0;
+        }
+
+        chunk = (uint8_t*)key + curchunkno * trie->chunksize;
+        r = btree_find(&btreeitem->btree, chunk, btree_value);
+        if (r == BTREE_RESULT_FAIL) {
+            // new chunk
+            return 1;
+        }
+        if (!_hbtrie_is_msb_set(trie, btree_value)) {
+            break;
+        }
+        // go down to the sub-tree
+        _hbtrie_clear_msb(trie, btree_value);
+        bid = trie->btree_kv_ops->value2bid(btree_value);
+        bid = _endian_decode(bid);
+        btreeitem->child_rootbid = bid;
+    }
+
+    // the chunk points to a doc .. check whether it has the same key
+    if (_hbtrie_get_fingerprint(trie, btree_value, &fp) &&
+        fp != _hbtrie_key_fingerprint(rawkey, rawkeylen)) {
+        return 0;
+    }
+
+#if defined(WIN32) || defined(_WIN32)
+    uint8_t *docrawkey = (uint8_t *) malloc(HBTRIE_MAX_KEYLEN);
+    uint8_t *dockey = (uint8_t *) malloc(HBTRIE_MAX_KEYLEN);
+#else
+    uint8_t *docrawkey = alca(uint8_t, HBTRIE_MAX_KEYLEN);
+    uint8_t *dockey = alca(uint8_t, HBTRIE_MAX_KEYLEN);
+#endif
+    docrawkeylen = trie->readkey(trie->doc_handle,
+                                 _hbtrie_value2offset(trie, btree_value),
+                                 docrawkey);
+    dockeylen = _hbtrie_reform_key(trie, docrawkey, docrawkeylen, dockey);
+    if (dockeylen >= 0) {
+        docnchunk = _get_nchunk(trie, dockey, dockeylen);
+        if (docnchunk == nchunk &&
+            _hbtrie_find_diff_chunk(trie, key, dockey,
+                                    curchunkno, nchunk) == nchunk) {
+            // same key .. update the value
+            _hbtrie_copy_value(trie, oldvalue_out, btree_value);
+            ret = 1;
+        }
+    }
+#if defined(WIN32) || defined(_WIN32)
+    // Free heap memory that was allocated only for windows
+    free(docrawkey);
+    free(dockey);
+#endif
+    return ret;
+}
+
+hbtrie_result hbtrie_insert_batch(struct hbtrie *trie, void **rawkeys,
+                                  int *rawkeylens, void **values,
+                                  void **oldvalues_out, size_t n)
+{
+    size_t i, begin = 0, nrun = 0;
+    int joined;
+    struct list path, run_path;
+    struct btreelist_item *btreeitem, *run_item = NULL;
+    hbtrie_result hr = HBTRIE_RESULT_SUCCESS;
+    btree_result br;
+    uint8_t *oldvalue = alca(uint8_t, trie->valuelen);
+    // reformed keys, and their chunks & values in the last-level B+tree
+    uint8_t **keys = (uint8_t **)malloc(sizeof(uint8_t *) * n);
+    int *keylens = (int *)malloc(sizeof(int) * n);
+    void **chunks = (void **)malloc(sizeof(void *) * n);
+    void **run_values = (void **)malloc(sizeof(void *) * n);
+    uint8_t *tagged_values = (uint8_t *)malloc(trie->valuelen * n);
+
+    for (i = 0; i < n; ++i) {
+        keys[i] = (uint8_t *)malloc(trie->chunksize *
+                      _get_nchunk_raw(trie, rawkeys[i], rawkeylens[i]));
+        keylens[i] = _hbtrie_reform_key(trie, rawkeys[i], rawkeylens[i],
+                                        keys[i]);
+        run_values[i] = tagged_values + trie->valuelen * i;
+        memcpy(run_values[i], values[i], trie->valuelen);
+        if (trie->flag & HBTRIE_FLAG_KEY_FINGERPRINT &&
+            !_hbtrie_is_msb_set(trie, values[i])) {
+            _hbtrie_set_fingerprint(trie, run_values[i],
+                _hbtrie_key_fingerprint(rawkeys[i], rawkeylens[i]));
+        }
+    }
+
+    list_init(&run_path);
+    i = 0;
+    while (i < n) {
+        joined = 0;
+        if (_hbtrie_find_batch_target(trie, keys[i], keylens[i],
+                                      rawkeys[i], rawkeylens[i],
+                                      &path, oldvalue)) {
+            btreeitem = _get_entry(list_end(&path), struct btreelist_item, e);
+            chunks[i] = keys[i] + btreeitem->chunkno * trie->chunksize;
+            if (nrun == 0) {
+                // start a new run with this key's path
+                run_path = path;
+                list_init(&path);
+                run_item = btreeitem;
+                begin = i;
+                joined = 1;
+            } else if (btreeitem->btree.root_bid == run_item->btree.root_bid &&
+                       run_item->btree.kv_ops->cmp(chunks[i - 1], chunks[i],
+                                                   run_item->btree.aux) < 0) {
+                // the same B+tree, and a chunk not taken by the run yet
+                joined = 1;
+            }
+        }
+        _hbtrie_free_btreelist(&path);
+
+        if (joined) {
+            if (oldvalues_out) {
+                memcpy(oldvalues_out[i], oldvalue, trie->valuelen);
+            }
+            ++nrun;
+            ++i;
+            continue;
+        }
+
+        if (nrun) {
+            // apply the run, and then look up this key again in the
+            // updated trie
+            br = btree_insert_batch(&run_item->btree, chunks + begin,
+                                    run_values + begin, nrun);
+            _hbtrie_btree_cascaded_update(trie, &run_path, keys[begin], 1);
+            nrun = 0;
+            if (br == BTREE_RESULT_FAIL) {
+                hr = HBTRIE_RESULT_FAIL;
+                break;
+            }
+            continue;
+        }
+
+        hr = hbtrie_insert(trie, rawkeys[i], rawkeylens[i], values[i],
+                           (oldvalues_out) ? (oldvalues_out[i]) : (NULL));
+        if (hr != HBTRIE_RESULT_SUCCESS) {
+            break;
+        }
+        ++i;
+    }
+
+    if (nrun) {
+        br = btree_insert_batch(&run_item->btree, chunks + begin,
+                                run_values + begin, nrun);
+        _hbtrie_btree_cascaded_update(trie, &run_path, keys[begin], 1);
+        if (br == BTREE_RESULT_FAIL) {
+            hr = HBTRIE_RESULT_FAIL;
+        }
+    }
+
+    for (i = 0; i < n; ++i) {
+        free(keys[i]);
+    }
+    free(keys);
+    free(keylens);
+    free(chunks);
+    free(run_values);
+    free(tagged_values);
+
+    return hr;
+}
+
 struct local_chunk_and_value {
     struct list_elem le;
     uint8_t chunk[8];
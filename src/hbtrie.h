@@ -67,6 +67,9 @@ typedef enum {
 } hbtrie_result;
 
 #define HBTRIE_FLAG_COMPACT (0x01)
+// tag the doc offsets of newly inserted keys with a fingerprint of the key,
+// so that most mismatching lookups don't have to read the key from the doc
+#define HBTRIE_FLAG_KEY_FINGERPRINT (0x02)
 struct btree_blk_ops;
 struct btree_kv_ops;
 struct hbtrie {
@@ -149,6 +152,8 @@ void hbtrie_init_and_load(struct hbtrie *trie, int chunksize, int valuelen,
 
 void hbtrie_set_flag(struct hbtrie *trie, uint8_t flag);
 void hbtrie_set_leaf_height_limit(struct hbtrie *trie, uint8_t limit);
+void hbtrie_set_leaf_prefix_compression(struct hbtrie *trie, bool enable);
+void hbtrie_set_key_fingerprint(struct hbtrie *trie, bool enable);
 void hbtrie_set_leaf_cmp(struct hbtrie *trie, btree_cmp_func *cmp);
 void hbtrie_set_map_function(struct hbtrie *trie,
                              hbtrie_cmp_map *map_func);
@@ -198,6 +203,19 @@ hbtrie_result hbtrie_insert(struct hbtrie *trie,
 hbtrie_result hbtrie_insert_partial(struct hbtrie *trie,
                                     void *rawkey, int rawkeylen,
                                     void *value, void *oldvalue_out);
+/**
+ * Insert (or update) N keys sorted in ascending order. Consecutive keys
+ * that belong to the same last-level B+tree, either as new chunks or as
+ * updates of the same keys, are put into it together by a single
+ * btree_insert_batch() call. The other keys (e.g., ones that need a new
+ * sub-tree or belong to a leaf B+tree) are inserted by hbtrie_insert().
+ * If OLDVALUES_OUT is given, each of its buffers receives the old value of
+ * the corresponding key as in hbtrie_insert(). The first failure stops the
+ * batch and is returned.
+ */
+hbtrie_result hbtrie_insert_batch(struct hbtrie *trie, void **rawkeys,
+                                  int *rawkeylens, void **values,
+                                  void **oldvalues_out, size_t n);
 
 #ifdef __cplusplus
 }
@@ -37,6 +37,7 @@ struct btreeblk_handle;
 struct docio_handle;
 struct btree_blk_ops;
 struct snap_handle;
+struct keycache;
 
 #define OFFSET_SIZE (sizeof(uint64_t))
 
@@ -253,6 +254,10 @@ struct _fdb_file_handle {
      * Spin lock for the file handle.
      */
     spin_t lock;
+    /**
+     * Number of asynchronous commits whose callbacks are not invoked yet.
+     */
+    atomic_uint32_t num_async_commits;
 };
 
 /**
@@ -327,6 +332,8 @@ struct _fdb_kvs_handle {
         node = kv_handle.node;
         num_iterators = kv_handle.num_iterators;
         bub_ctx = kv_handle.bub_ctx;
+        // the key cache is never shared between handles
+        keycache = NULL;
         return *this;
     }
 
@@ -456,6 +463,11 @@ struct _fdb_kvs_handle {
      * Used when `bottom_up_index_build` is `true`.
      */
     struct bottom_up_build_ctx bub_ctx;
+    /**
+     * Cache of the doc offsets of recently read keys, allocated on the first
+     * lookup if 'index_cache_size' is set.
+     */
+    struct keycache *keycache;
 };
 
 struct bottom_up_build_entry {
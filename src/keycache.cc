@@ -0,0 +1,175 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2010 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "keycache.h"
+#include "hash_functions.h"
+
+#include "memleak.h"
+
+// approximate memory budget per hash bucket
+#define KEYCACHE_BYTES_PER_BUCKET (512)
+#define KEYCACHE_MIN_BUCKETS (16)
+#define KEYCACHE_MAX_BUCKETS (1 << 20)
+
+struct keycache_item {
+    struct hash_elem he;
+    struct list_elem le;
+    void *key;
+    uint32_t keylen;
+    uint64_t offset;
+};
+
+static uint32_t _keycache_hash(struct hash *hash, struct hash_elem *e)
+{
+    struct keycache_item *item = _get_entry(e, struct keycache_item, he);
+    return hash_djb2((uint8_t*)item->key, item->keylen) % hash->nbuckets;
+}
+
+static int _keycache_cmp(struct hash_elem *a, struct hash_elem *b)
+{
+    struct keycache_item *aa, *bb;
+    aa = _get_entry(a, struct keycache_item, he);
+    bb = _get_entry(b, struct keycache_item, he);
+    if (aa->keylen != bb->keylen) {
+        return (aa->keylen < bb->keylen) ? -1 : 1;
+    }
+    return memcmp(aa->key, bb->key, aa->keylen);
+}
+
+INLINE size_t _keycache_item_size(size_t keylen)
+{
+    return sizeof(struct keycache_item) + keylen;
+}
+
+static void _keycache_evict(struct keycache *kc, struct keycache_item *item)
+{
+    hash_remove(&kc->hashtable, &item->he);
+    list_remove(&kc->lru, &item->le);
+    kc->size -= _keycache_item_size(item->keylen);
+    free(item);
+}
+
+void keycache_init(struct keycache *kc, size_t budget)
+{
+    size_t nbuckets = budget / KEYCACHE_BYTES_PER_BUCKET;
+    nbuckets = MAX(nbuckets, KEYCACHE_MIN_BUCKETS);
+    nbuckets = MIN(nbuckets, KEYCACHE_MAX_BUCKETS);
+
+    hash_init(&kc->hashtable, nbuckets, _keycache_hash, _keycache_cmp);
+    list_init(&kc->lru);
+    kc->budget = budget;
+    kc->size = 0;
+    memset(&kc->version, 0, sizeof(kc->version));
+    kc->num_hits = kc->num_misses = 0;
+}
+
+void keycache_clear(struct keycache *kc)
+{
+    struct list_elem *e;
+    struct keycache_item *item;
+
+    e = list_begin(&kc->lru);
+    while (e) {
+        item = _get_entry(e, struct keycache_item, le);
+        e = list_next(e);
+        _keycache_evict(kc, item);
+    }
+}
+
+void keycache_free(struct keycache *kc)
+{
+    keycache_clear(kc);
+    hash_free(&kc->hashtable);
+}
+
+void keycache_validate(struct keycache *kc, struct keycache_version *version)
+{
+    if (kc->version.file != version->file ||
+        kc->version.root_bid != version->root_bid ||
+        kc->version.header_revnum != version->header_revnum ||
+        kc->version.num_index_updates != version->num_index_updates) {
+        keycache_clear(kc);
+        kc->version = *version;
+    }
+}
+
+bool keycache_find(struct keycache *kc, void *key, size_t keylen,
+                   uint64_t *offset_out)
+{
+    struct keycache_item query, *item;
+    struct hash_elem *e;
+
+    query.key = key;
+    query.keylen = keylen;
+    e = hash_find(&kc->hashtable, &query.he);
+    if (!e) {
+        kc->num_misses++;
+        return false;
+    }
+
+    item = _get_entry(e, struct keycache_item, he);
+    // move to the front of the LRU list
+    list_remove(&kc->lru, &item->le);
+    list_push_front(&kc->lru, &item->le);
+    *offset_out = item->offset;
+    kc->num_hits++;
+    return true;
+}
+
+void keycache_insert(struct keycache *kc, void *key, size_t keylen,
+                     uint64_t offset)
+{
+    struct keycache_item query, *item;
+    struct hash_elem *e;
+    struct list_elem *le;
+    size_t item_size = _keycache_item_size(keylen);
+
+    if (item_size > kc->budget) {
+        return;
+    }
+
+    query.key = key;
+    query.keylen = keylen;
+    e = hash_find(&kc->hashtable, &query.he);
+    if (e) {
+        item = _get_entry(e, struct keycache_item, he);
+        item->offset = offset;
+        list_remove(&kc->lru, &item->le);
+        list_push_front(&kc->lru, &item->le);
+        return;
+    }
+
+    // evict the least recently used entries to make room
+    while (kc->size + item_size > kc->budget) {
+        le = list_end(&kc->lru);
+        _keycache_evict(kc, _get_entry(le, struct keycache_item, le));
+    }
+
+    // the key is stored right after the item
+    item = (struct keycache_item *)malloc(item_size);
+    item->key = (void *)(item + 1);
+    item->keylen = keylen;
+    item->offset = offset;
+    memcpy(item->key, key, keylen);
+    hash_insert(&kc->hashtable, &item->he);
+    list_push_front(&kc->lru, &item->le);
+    kc->size += item_size;
+}
@@ -0,0 +1,74 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2010 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#ifndef _FDB_KEYCACHE_H
+#define _FDB_KEYCACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "hash.h"
+#include "list.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * State of the index that the entries of a key cache were read from.
+ */
+struct keycache_version {
+    void *file;
+    uint64_t root_bid;
+    uint64_t header_revnum;
+    uint64_t num_index_updates;
+};
+
+/**
+ * In-memory cache that maps recently looked up keys to their doc offsets,
+ * so that lookups of hot keys do not have to traverse the index. Entries are
+ * evicted in LRU order once their total size exceeds the memory budget.
+ * A key cache is not thread-safe; each KV store handle has its own.
+ */
+struct keycache {
+    struct hash hashtable;
+    struct list lru; // the most recently used entry comes first
+    size_t budget;
+    size_t size;
+    struct keycache_version version;
+    uint64_t num_hits;
+    uint64_t num_misses;
+};
+
+void keycache_init(struct keycache *kc, size_t budget);
+void keycache_free(struct keycache *kc);
+/**
+ * Drop all the entries if VERSION differs from the state of the index that
+ * they were read from.
+ */
+void keycache_validate(struct keycache *kc, struct keycache_version *version);
+bool keycache_find(struct keycache *kc, void *key, size_t keylen,
+                   uint64_t *offset_out);
+void keycache_insert(struct keycache *kc, void *key, size_t keylen,
+                     uint64_t offset);
+void keycache_clear(struct keycache *kc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _FDB_KEYCACHE_H
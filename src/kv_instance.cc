@@ -137,6 +137,7 @@ void fdb_file_handle_init(fdb_file_handle *fhandle,
     fhandle->handles = (struct list*)calloc(1, sizeof(struct list));
     fhandle->cmp_func_list = NULL;
     spin_init(&fhandle->lock);
+    atomic_init_uint32_t(&fhandle->num_async_commits, 0);
 }
 
 void fdb_file_handle_close_all(fdb_file_handle *fhandle)
@@ -26,6 +26,7 @@
 #include "wal.h"
 #include "hash_functions.h"
 #include "fdb_internal.h"
+#include "timing.h"
 
 #include "memleak.h"
 
@@ -99,6 +100,14 @@ INLINE int __wal_cmp_bykey(struct wal_item_header *aa,
     }
 }
 
+// Pick the key shard of a WAL entry. Shards only exist in memory, so a
+// cheap word-at-a-time hash is used instead of the on-disk CRC. Only the
+// hash is cheaper; the shard is still locked and scanned as before.
+INLINE size_t _wal_key_shard(struct wal *_wal, void *key, size_t keylen)
+{
+    return hash_words((uint8_t*)key, keylen) % _wal->num_shards;
+}
+
 INLINE int _wal_cmp_bykey(struct avl_node *a, struct avl_node *b, void *aux)
 {
     struct wal_item_header *aa, *bb;
@@ -178,6 +187,230 @@ INLINE int _wal_snap_cmp(struct avl_node *a, struct avl_node *b, void *aux)
     return 0;
 }
 
+// Header at the beginning of each WAL arena chunk. Chunks are aligned to
+// their size, so that the chunk of an object is found from its address.
+struct wal_arena_chunk {
+    struct wal_arena *arena;
+    // slab that the chunk belongs to, or NULL for a key chunk
+    struct wal_slab *slab;
+    struct list_elem le;
+    // singly-linked list of freed objects (slab chunks only)
+    void *free_objs;
+    // bytes used from the beginning of the chunk
+    uint32_t used;
+    // number of objects or keys in use
+    uint32_t nlive;
+};
+
+#define WAL_ARENA_CHUNK_HDR_SIZE \
+    ((sizeof(struct wal_arena_chunk) + 15) & ~((size_t)15))
+// Keys larger than this get a chunk of their own.
+#define WAL_ARENA_MAX_SHARED_KEYLEN (WAL_ARENA_CHUNK_SIZE / 4)
+
+INLINE struct wal_arena_chunk *_wal_arena_chunk_of(void *ptr)
+{
+    return (struct wal_arena_chunk *)
+           ((uintptr_t)ptr & ~((uintptr_t)WAL_ARENA_CHUNK_SIZE - 1));
+}
+
+static struct wal_arena_chunk *_wal_arena_new_chunk(struct wal_arena *arena,
+                                                    struct wal_slab *slab,
+                                                    size_t size)
+{
+    void *addr = NULL;
+    malloc_align(addr, WAL_ARENA_CHUNK_SIZE, size);
+    if (!addr) {
+        return NULL;
+    }
+    struct wal_arena_chunk *chunk = (struct wal_arena_chunk *)addr;
+    chunk->arena = arena;
+    chunk->slab = slab;
+    chunk->free_objs = NULL;
+    chunk->used = WAL_ARENA_CHUNK_HDR_SIZE;
+    chunk->nlive = 0;
+    return chunk;
+}
+
+INLINE bool _wal_slab_chunk_full(struct wal_slab *slab,
+                                 struct wal_arena_chunk *chunk)
+{
+    return !chunk->free_objs &&
+           chunk->used + slab->objsize > WAL_ARENA_CHUNK_SIZE;
+}
+
+static void _wal_slab_init(struct wal_slab *slab, size_t objsize)
+{
+    slab->objsize = (objsize + 7) & ~((size_t)7);
+    list_init(&slab->partial);
+    list_init(&slab->full);
+}
+
+static void _wal_slab_destroy(struct wal_slab *slab)
+{
+    struct list *lists[2] = {&slab->partial, &slab->full};
+    for (int i = 0; i < 2; ++i) {
+        struct list_elem *le = list_begin(lists[i]);
+        while (le) {
+            struct wal_arena_chunk *chunk = _get_entry(le,
+                                            struct wal_arena_chunk, le);
+            le = list_remove(lists[i], le);
+            free_align(chunk);
+        }
+    }
+}
+
+static void *_wal_slab_alloc(struct wal_arena *arena, struct wal_slab *slab)
+{
+    struct wal_arena_chunk *chunk;
+    struct list_elem *le;
+    void *obj;
+
+    spin_lock(&arena->lock);
+    le = list_begin(&slab->partial);
+    if (le) {
+        chunk = _get_entry(le, struct wal_arena_chunk, le);
+    } else {
+        chunk = _wal_arena_new_chunk(arena, slab, WAL_ARENA_CHUNK_SIZE);
+        if (!chunk) {
+            spin_unlock(&arena->lock);
+            return NULL;
+        }
+        list_push_front(&slab->partial, &chunk->le);
+    }
+    if (chunk->free_objs) {
+        obj = chunk->free_objs;
+        chunk->free_objs = *(void **)obj;
+    } else {
+        obj = (uint8_t *)chunk + chunk->used;
+        chunk->used += slab->objsize;
+    }
+    chunk->nlive++;
+    if (_wal_slab_chunk_full(slab, chunk)) {
+        list_remove(&slab->partial, &chunk->le);
+        list_push_front(&slab->full, &chunk->le);
+    }
+    spin_unlock(&arena->lock);
+    return obj;
+}
+
+static void _wal_slab_free(void *obj)
+{
+    struct wal_arena_chunk *chunk = _wal_arena_chunk_of(obj);
+    struct wal_arena *arena = chunk->arena;
+    struct wal_slab *slab = chunk->slab;
+
+    spin_lock(&arena->lock);
+    if (_wal_slab_chunk_full(slab, chunk)) {
+        list_remove(&slab->full, &chunk->le);
+        list_push_front(&slab->partial, &chunk->le);
+    }
+    *(void **)obj = chunk->free_objs;
+    chunk->free_objs = obj;
+    if (--chunk->nlive == 0 &&
+        (list_begin(&slab->partial) != &chunk->le || list_next(&chunk->le) ||
+         list_begin(&slab->full))) {
+        // release the empty chunk, unless it is the last one of the slab.
+        list_remove(&slab->partial, &chunk->le);
+        free_align(chunk);
+    }
+    spin_unlock(&arena->lock);
+}
+
+static void *_wal_arena_alloc_key(struct wal_arena *arena, size_t keylen)
+{
+    struct wal_arena_chunk *chunk;
+    void *key;
+
+    if (!keylen) {
+        keylen = 1;
+    }
+    spin_lock(&arena->lock);
+    if (keylen > WAL_ARENA_MAX_SHARED_KEYLEN) {
+        chunk = _wal_arena_new_chunk(arena, NULL,
+                                     WAL_ARENA_CHUNK_HDR_SIZE + keylen);
+        if (!chunk) {
+            spin_unlock(&arena->lock);
+            return NULL;
+        }
+        list_push_front(&arena->key_chunks, &chunk->le);
+    } else {
+        chunk = arena->key_chunk;
+        if (!chunk || chunk->used + keylen > WAL_ARENA_CHUNK_SIZE) {
+            // retire the current chunk; it is released when its last key
+            // is freed.
+            if (chunk) {
+                if (chunk->nlive) {
+                    list_push_front(&arena->key_chunks, &chunk->le);
+                } else {
+                    free_align(chunk);
+                }
+            }
+            chunk = _wal_arena_new_chunk(arena, NULL, WAL_ARENA_CHUNK_SIZE);
+            arena->key_chunk = chunk;
+            if (!chunk) {
+                spin_unlock(&arena->lock);
+                return NULL;
+            }
+        }
+    }
+    key = (uint8_t *)chunk + chunk->used;
+    chunk->used += keylen;
+    chunk->nlive++;
+    spin_unlock(&arena->lock);
+    return key;
+}
+
+static void _wal_arena_free_key(void *key)
+{
+    struct wal_arena_chunk *chunk = _wal_arena_chunk_of(key);
+    struct wal_arena *arena = chunk->arena;
+
+    spin_lock(&arena->lock);
+    if (--chunk->nlive == 0) {
+        if (chunk == arena->key_chunk) {
+            // all keys of the current chunk are gone; start over.
+            chunk->used = WAL_ARENA_CHUNK_HDR_SIZE;
+        } else {
+            list_remove(&arena->key_chunks, &chunk->le);
+            free_align(chunk);
+        }
+    }
+    spin_unlock(&arena->lock);
+}
+
+static void _wal_arena_init(struct wal_arena *arena)
+{
+    _wal_slab_init(&arena->item_slab, sizeof(struct wal_item));
+    _wal_slab_init(&arena->header_slab, sizeof(struct wal_item_header));
+    arena->key_chunk = NULL;
+    list_init(&arena->key_chunks);
+    spin_init(&arena->lock);
+}
+
+static void _wal_arena_destroy(struct wal_arena *arena)
+{
+    _wal_slab_destroy(&arena->item_slab);
+    _wal_slab_destroy(&arena->header_slab);
+    if (arena->key_chunk) {
+        free_align(arena->key_chunk);
+    }
+    struct list_elem *le = list_begin(&arena->key_chunks);
+    while (le) {
+        struct wal_arena_chunk *chunk = _get_entry(le,
+                                        struct wal_arena_chunk, le);
+        le = list_remove(&arena->key_chunks, le);
+        free_align(chunk);
+    }
+    spin_destroy(&arena->lock);
+}
+
+// Free a WAL item header and its key.
+INLINE void _wal_free_header(struct wal_item_header *header)
+{
+    _wal_arena_free_key(header->key);
+    _wal_slab_free(header);
+}
+
 fdb_status wal_init(struct filemgr *file, int nbucket)
 {
     size_t num_shards;
@@ -191,6 +424,7 @@ fdb_status wal_init(struct filemgr *file, int nbucket)
 
     list_init(&file->wal->txn_list);
     spin_init(&file->wal->lock);
+    spin_init(&file->wal->txn_lock);
 
     if (file->config->num_wal_shards) {
         file->wal->num_shards = file->config->num_wal_shards;
@@ -201,6 +435,8 @@ fdb_status wal_init(struct filemgr *file, int nbucket)
     num_shards = wal_get_num_shards(file);
     file->wal->key_shards = (wal_shard *)
         malloc(sizeof(struct wal_shard) * num_shards);
+    file->wal->arenas = (wal_arena *)
+        malloc(sizeof(struct wal_arena) * num_shards);
 
     if (file->config->seqtree_opt == FDB_SEQTREE_USE) {
         file->wal->seq_shards = (wal_shard *)
@@ -212,6 +448,7 @@ fdb_status wal_init(struct filemgr *file, int nbucket)
     for (int i = num_shards - 1; i >= 0; --i) {
         avl_init(&file->wal->key_shards[i]._map, NULL);
         spin_init(&file->wal->key_shards[i].lock);
+        _wal_arena_init(&file->wal->arenas[i]);
         if (file->config->seqtree_opt == FDB_SEQTREE_USE) {
             avl_init(&file->wal->seq_shards[i]._map, NULL);
             spin_init(&file->wal->seq_shards[i].lock);
@@ -231,12 +468,15 @@ fdb_status wal_destroy(struct filemgr *file)
     // Free all WAL shards
     for (; i < num_shards; ++i) {
         spin_destroy(&file->wal->key_shards[i].lock);
+        _wal_arena_destroy(&file->wal->arenas[i]);
         if (file->config->seqtree_opt == FDB_SEQTREE_USE) {
             spin_destroy(&file->wal->seq_shards[i].lock);
         }
     }
     spin_destroy(&file->wal->lock);
+    spin_destroy(&file->wal->txn_lock);
     free(file->wal->key_shards);
+    free(file->wal->arenas);
     if (file->config->seqtree_opt == FDB_SEQTREE_USE) {
         free(file->wal->seq_shards);
     }
@@ -525,7 +765,6 @@ INLINE fdb_status _wal_insert(fdb_txn *txn,
     struct avl_node *node;
     void *key = doc->key;
     size_t keylen = doc->keylen;
-    size_t chk_sum;
     size_t shard_num;
     wal_snapid_t snap_tag;
     fdb_kvs_id_t kv_id;
@@ -539,8 +778,7 @@ INLINE fdb_status _wal_insert(fdb_txn *txn,
     snap_tag = shandle->snap_tag_idx;
     query.key = key;
     query.keylen = keylen;
-    chk_sum = get_checksum((uint8_t*)key, keylen);
-    shard_num = chk_sum % file->wal->num_shards;
+    shard_num = _wal_key_shard(file->wal, key, keylen);
     if (caller == WAL_INS_WRITER) {
         spin_lock(&file->wal->key_shards[shard_num].lock);
     }
@@ -649,7 +887,10 @@ INLINE fdb_status _wal_insert(fdb_txn *txn,
         if (le == NULL) {
             // not exist
             // create new item
-            item = (struct wal_item *)calloc(1, sizeof(struct wal_item));
+            item = (struct wal_item *)
+                   _wal_slab_alloc(&file->wal->arenas[shard_num],
+                                   &file->wal->arenas[shard_num].item_slab);
+            memset(item, 0, sizeof(struct wal_item));
 
             if (file->kv_header) { // multi KV instance mode
                 item->flag |= WAL_ITEM_MULTI_KV_INS_MODE;
@@ -707,7 +948,9 @@ INLINE fdb_status _wal_insert(fdb_txn *txn,
             // insert into header's list
             list_push_front(&header->items, &item->list_elem);
             // also insert into transaction's list
+            spin_lock(&file->wal->txn_lock);
             list_push_back(txn->items, &item->list_elem_txn);
+            spin_unlock(&file->wal->txn_lock);
 
             atomic_incr_uint32_t(&file->wal->size);
             atomic_add_uint64_t(&file->wal->mem_overhead,
@@ -716,17 +959,20 @@ INLINE fdb_status _wal_insert(fdb_txn *txn,
     } else {
         // not exist .. create new one
         // create new header and new item
-        header = (struct wal_item_header*)malloc(sizeof(struct wal_item_header));
+        struct wal_arena *arena = &file->wal->arenas[shard_num];
+        header = (struct wal_item_header*)
+                 _wal_slab_alloc(arena, &arena->header_slab);
         list_init(&header->items);
         header->chunksize = file->config->chunksize;
         header->keylen = keylen;
-        header->key = (void *)malloc(header->keylen);
+        header->shard_num = shard_num;
+        header->key = _wal_arena_alloc_key(arena, header->keylen);
         memcpy(header->key, key, header->keylen);
 
         avl_insert(&file->wal->key_shards[shard_num]._map,
                    &header->avl_key, _wal_cmp_bykey);
 
-        item = (struct wal_item *)malloc(sizeof(struct wal_item));
+        item = (struct wal_item *)_wal_slab_alloc(arena, &arena->item_slab);
         // entries inserted by compactor is already committed
         if (caller == WAL_INS_COMPACT_PHASE1) {
             item->flag = WAL_ITEM_COMMITTED;
@@ -791,7 +1037,9 @@ INLINE fdb_status _wal_insert(fdb_txn *txn,
         list_push_front(&header->items, &item->list_elem);
         if (caller == WAL_INS_WRITER || caller == WAL_INS_COMPACT_PHASE2) {
             // also insert into transaction's list
+            spin_lock(&file->wal->txn_lock);
             list_push_back(txn->items, &item->list_elem_txn);
+            spin_unlock(&file->wal->txn_lock);
         }
 
         atomic_incr_uint32_t(&file->wal->size);
@@ -925,8 +1173,7 @@ static fdb_status _wal_find(fdb_txn *txn,
     size_t keylen = doc->keylen;
 
     if (doc->seqnum == SEQNUM_NOT_USED || (key && keylen>0)) {
-        size_t chk_sum = get_checksum((uint8_t*)key, keylen);
-        size_t shard_num = chk_sum % file->wal->num_shards;
+        size_t shard_num = _wal_key_shard(file->wal, key, keylen);
         spin_lock(&file->wal->key_shards[shard_num].lock);
         // search by key
         query.key = key;
@@ -1112,7 +1359,7 @@ INLINE void _wal_free_item(struct wal_item *item, struct wal *_wal) {
         spin_unlock(&_wal->lock);
     }
     memset(item, 0, sizeof(struct wal_item));
-    free(item);
+    _wal_slab_free(item);
 }
 
 // move all uncommitted items into 'new_file'
@@ -1189,7 +1436,7 @@ fdb_status wal_txn_migration(void *dbhandle,
                                             std::memory_order_relaxed);
                     }
                     // free item
-                    free(item);
+                    _wal_slab_free(item);
                     // free doc
                     free(doc.key);
                     free(doc.meta);
@@ -1209,8 +1456,7 @@ fdb_status wal_txn_migration(void *dbhandle,
                            &header->avl_key);
                 mem_overhead += header->keylen + sizeof(struct wal_item_header);
                 // free key & header
-                free(header->key);
-                free(header);
+                _wal_free_header(header);
             } else {
                 node = avl_next(node);
             }
@@ -1261,9 +1507,7 @@ fdb_status wal_commit(fdb_txn *txn, struct filemgr *file,
         item = _get_entry(e1, struct wal_item, list_elem_txn);
         fdb_assert(item->txn_id == txn->txn_id, item->txn_id, txn->txn_id);
         // Grab the WAL key shard lock.
-        shard_num = get_checksum((uint8_t*)item->header->key,
-                                 item->header->keylen) %
-                                 file->wal->num_shards;
+        shard_num = item->header->shard_num;
         spin_lock(&file->wal->key_shards[shard_num].lock);
 
         if (!(item->flag & WAL_ITEM_COMMITTED)) {
@@ -1486,8 +1730,7 @@ INLINE list_elem *_wal_release_items(struct filemgr *file, size_t shard_num,
         avl_remove(&file->wal->key_shards[shard_num]._map,
                 &header->avl_key);
         mem_overhead = sizeof(wal_item_header) + header->keylen;
-        free(header->key);
-        free(header);
+        _wal_free_header(header);
         le = NULL;
     }
     atomic_sub_uint64_t(&file->wal->mem_overhead,
@@ -1537,9 +1780,7 @@ fdb_status wal_release_flushed_items(struct filemgr *file,
             avl_remove(tree, &item->avl_flush);
 
             // Grab the WAL key shard lock.
-            shard_num = get_checksum((uint8_t*)item->header->key,
-                                     item->header->keylen)
-                                     % file->wal->num_shards;
+            shard_num = item->header->shard_num;
             spin_lock(&file->wal->key_shards[shard_num].lock);
 
             _wal_release_items(file, shard_num, item);
@@ -1558,9 +1799,7 @@ fdb_status wal_release_flushed_items(struct filemgr *file,
             list_remove(list_head, &item->list_elem_flush);
 
             // Grab the WAL key shard lock.
-            shard_num = get_checksum((uint8_t*)item->header->key,
-                                     item->header->keylen)
-                                     % file->wal->num_shards;
+            shard_num = item->header->shard_num;
             spin_lock(&file->wal->key_shards[shard_num].lock);
             _wal_release_items(file, shard_num, item);
             spin_unlock(&file->wal->key_shards[shard_num].lock);
@@ -1574,11 +1813,13 @@ INLINE fdb_status _wal_do_flush(struct wal_item *item,
                                 wal_flush_func *flush_func,
                                 void *dbhandle,
                                 struct avl_tree *stale_seqnum_list,
+                                struct avl_tree *seqnum_list,
                                 struct avl_tree *kvs_delta_stats)
 {
     // check weather this item is updated after insertion into tree
     if (item->flag & WAL_ITEM_FLUSH_READY) {
-        fdb_status fs = flush_func(dbhandle, item, stale_seqnum_list, kvs_delta_stats);
+        fdb_status fs = flush_func(dbhandle, item, stale_seqnum_list,
+                                   seqnum_list, kvs_delta_stats);
         if (fs != FDB_RESULT_SUCCESS) {
             fdb_kvs_handle *handle = (fdb_kvs_handle *) dbhandle;
             fdb_log(&handle->log_callback, FDB_LOG_ERROR, fs,
@@ -1644,6 +1885,231 @@ INLINE bool _wal_check_bottom_up_build(void* voidhandle) {
     return false;
 }
 
+// Minimum number of old document blocks to be read by a WAL flush, and by
+// each of its prefetch threads.
+#define WAL_FLUSH_PREFETCH_MIN_BLOCKS (64)
+#define WAL_FLUSH_PREFETCH_BLOCKS_PER_THREAD (16)
+
+struct wal_flush_prefetch_args {
+    struct filemgr *file;
+    bid_t *blocks;
+    size_t num;
+    // number of the ranges of the same flush that are not read yet
+    size_t *num_pending;
+    struct list_elem le;
+};
+
+// The prefetch ranges of WAL flushes are read by a pool of worker threads,
+// which are created when a flush first needs them. 'prefetch_lock' protects
+// the queue and the terminate signal.
+static volatile uint8_t wal_prefetch_initialized = 0;
+static mutex_t prefetch_lock = MUTEX_INITIALIZER;
+static thread_cond_t prefetch_queue_cond;
+// signaled whenever a range is read
+static thread_cond_t prefetch_done_cond;
+static struct list prefetch_queue;
+static thread_t prefetch_tids[MAX_NUM_WAL_PREFETCH_THREADS];
+static size_t prefetch_num_threads = 0;
+static volatile uint8_t prefetch_terminate_signal = 0;
+
+static int _wal_flush_prefetch_cmp(const void *a, const void *b)
+{
+    bid_t aa = *(const bid_t *)a;
+    bid_t bb = *(const bid_t *)b;
+
+    if (aa != bb) {
+        return (aa < bb) ? -1 : 1;
+    }
+    return 0;
+}
+
+static void *_wal_flush_prefetch_thread(void *voidargs)
+{
+    struct wal_flush_prefetch_args *args =
+        (struct wal_flush_prefetch_args *)voidargs;
+    struct filemgr *file = args->file;
+    void *buf;
+    size_t i;
+
+    malloc_align(buf, FDB_SECTOR_SIZE, file->blocksize);
+    if (!buf) {
+        return NULL;
+    }
+    for (i = 0; i < args->num; ++i) {
+        // best-effort: the flush reads the block again anyway
+        filemgr_read(file, args->blocks[i], buf, NULL, true);
+    }
+    free_align(buf);
+    return NULL;
+}
+
+static void *_wal_flush_prefetch_worker(void *voidargs)
+{
+    struct list_elem *e;
+    struct wal_flush_prefetch_args *args;
+
+    while (1) {
+        mutex_lock(&prefetch_lock);
+        while (!list_begin(&prefetch_queue) && !prefetch_terminate_signal) {
+            thread_cond_wait(&prefetch_queue_cond, &prefetch_lock);
+        }
+        e = list_pop_front(&prefetch_queue);
+        mutex_unlock(&prefetch_lock);
+        if (!e) {
+            break;
+        }
+
+        args = _get_entry(e, struct wal_flush_prefetch_args, le);
+        _wal_flush_prefetch_thread(args);
+
+        mutex_lock(&prefetch_lock);
+        (*args->num_pending)--;
+        thread_cond_broadcast(&prefetch_done_cond);
+        mutex_unlock(&prefetch_lock);
+    }
+    return NULL;
+}
+
+void wal_prefetch_init(void)
+{
+    if (!wal_prefetch_initialized) {
+        // Note that this function is synchronized by spin lock in fdb_init API.
+        mutex_init(&prefetch_lock);
+
+        mutex_lock(&prefetch_lock);
+        if (!wal_prefetch_initialized) {
+            list_init(&prefetch_queue);
+            prefetch_num_threads = 0;
+            prefetch_terminate_signal = 0;
+            thread_cond_init(&prefetch_queue_cond);
+            thread_cond_init(&prefetch_done_cond);
+            wal_prefetch_initialized = 1;
+        }
+        mutex_unlock(&prefetch_lock);
+    }
+}
+
+void wal_prefetch_shutdown(void)
+{
+    void *ret;
+    size_t i;
+
+    if (!wal_prefetch_initialized) {
+        return;
+    }
+
+    mutex_lock(&prefetch_lock);
+    prefetch_terminate_signal = 1;
+    thread_cond_broadcast(&prefetch_queue_cond);
+    mutex_unlock(&prefetch_lock);
+
+    for (i = 0; i < prefetch_num_threads; ++i) {
+        thread_join(prefetch_tids[i], &ret);
+    }
+
+    mutex_lock(&prefetch_lock);
+    prefetch_num_threads = 0;
+    wal_prefetch_initialized = 0;
+    thread_cond_destroy(&prefetch_queue_cond);
+    thread_cond_destroy(&prefetch_done_cond);
+    mutex_unlock(&prefetch_lock);
+
+    mutex_destroy(&prefetch_lock);
+}
+
+/**
+ * Read the blocks of the previous versions of the documents to be flushed
+ * into the buffer cache with multiple threads, as the flush reads them one
+ * by one while updating the indexes. Only the blocks that are not cached
+ * yet are read; they are split into ascending ranges of block IDs, each of
+ * which is read by a worker of the prefetch pool, except for the last one
+ * read by the calling thread. The index updates themselves are still
+ * applied by the calling thread.
+ */
+static void _wal_flush_prefetch(struct filemgr *file, struct avl_tree *tree)
+{
+    bid_t *blocks;
+    struct wal_flush_prefetch_args *args;
+    struct wal_item *item;
+    struct avl_node *a;
+    size_t nthreads = file->config->num_wal_prefetch_threads;
+    size_t nblocks = 0, nitems = 0, i, begin, num_pending;
+    bid_t bid, last_bid = BLK_NOT_FOUND;
+    struct bcache_item *pinned;
+
+    if (!wal_prefetch_initialized ||
+        nthreads < 2 || file->config->ncacheblock <= 0 ||
+        file->config->do_not_cache_doc_blocks) {
+        return;
+    }
+
+    for (a = avl_first(tree); a; a = avl_next(a)) {
+        ++nitems;
+    }
+    if (nitems < WAL_FLUSH_PREFETCH_MIN_BLOCKS) {
+        return;
+    }
+
+    blocks = (bid_t *)malloc(sizeof(bid_t) * nitems);
+    for (a = avl_first(tree); a; a = avl_next(a)) {
+        item = _get_entry(a, struct wal_item, avl_flush);
+        if ((item->flag & WAL_ITEM_FLUSHED_OUT) ||
+            item->old_offset == 0 || item->old_offset == BLK_NOT_FOUND) {
+            continue;
+        }
+        bid = item->old_offset / file->blocksize;
+        if (bid == last_bid) {
+            continue;
+        }
+        last_bid = bid;
+        // skip the blocks already in the buffer cache, so that nothing is
+        // handed to the pool when the file is fully cached.
+        if (filemgr_read_pinned(file, bid, &pinned)) {
+            filemgr_unpin(pinned);
+            continue;
+        }
+        blocks[nblocks++] = bid;
+    }
+    if (nblocks < WAL_FLUSH_PREFETCH_MIN_BLOCKS) {
+        free(blocks);
+        return;
+    }
+    qsort(blocks, nblocks, sizeof(bid_t), _wal_flush_prefetch_cmp);
+
+    nthreads = MIN(nthreads, nblocks / WAL_FLUSH_PREFETCH_BLOCKS_PER_THREAD);
+    args = alca(struct wal_flush_prefetch_args, nthreads);
+    num_pending = nthreads - 1;
+
+    mutex_lock(&prefetch_lock);
+    // grow the pool up to the number of ranges read by the workers
+    while (prefetch_num_threads < nthreads - 1) {
+        thread_create(&prefetch_tids[prefetch_num_threads++],
+                      _wal_flush_prefetch_worker, NULL);
+    }
+    for (i = 0, begin = 0; i < nthreads; ++i) {
+        args[i].file = file;
+        args[i].blocks = blocks + begin;
+        args[i].num = nblocks * (i + 1) / nthreads - begin;
+        args[i].num_pending = &num_pending;
+        begin += args[i].num;
+        if (i + 1 < nthreads) {
+            list_push_back(&prefetch_queue, &args[i].le);
+        }
+    }
+    thread_cond_broadcast(&prefetch_queue_cond);
+    mutex_unlock(&prefetch_lock);
+
+    // the calling thread reads the last range
+    _wal_flush_prefetch_thread(&args[nthreads - 1]);
+
+    mutex_lock(&prefetch_lock);
+    while (num_pending) {
+        thread_cond_wait(&prefetch_done_cond, &prefetch_lock);
+    }
+    mutex_unlock(&prefetch_lock);
+    free(blocks);
+}
+
 static fdb_status _wal_flush(struct filemgr *file,
                              void *dbhandle,
                              wal_flush_func *flush_func,
@@ -1651,7 +2117,8 @@ static fdb_status _wal_flush(struct filemgr *file,
                              wal_flush_seq_purge_func *seq_purge_func,
                              wal_flush_kvs_delta_stats_func *delta_stats_func,
                              union wal_flush_items *flush_items,
-                             bool by_compactor)
+                             bool by_compactor,
+                             size_t max_items)
 {
     struct avl_tree *tree = &flush_items->tree;
     struct list *list_head = &flush_items->list;
@@ -1662,6 +2129,7 @@ static fdb_status _wal_flush(struct filemgr *file,
     struct fdb_root_info root_info;
     size_t i = 0;
     size_t num_shards = file->wal->num_shards;
+    size_t num_items = 0;
     bool do_sort = !filemgr_is_fully_resident(file);
 
     if (do_sort) {
@@ -1678,10 +2146,10 @@ static fdb_status _wal_flush(struct filemgr *file,
     memset(&root_info, 0xff, sizeof(root_info));
     _wal_backup_root_info(dbhandle, &root_info);
 
-    for (; i < num_shards; ++i) {
+    for (; i < num_shards && (!max_items || num_items < max_items); ++i) {
         spin_lock(&file->wal->key_shards[i].lock);
         a = avl_first(&file->wal->key_shards[i]._map);
-        while (a) {
+        while (a && (!max_items || num_items < max_items)) {
             a_next = avl_next(a);
             header = _get_entry(a, struct wal_item_header, avl_key);
             ee = list_end(&header->items);
@@ -1735,6 +2203,7 @@ static fdb_status _wal_flush(struct filemgr *file,
                         } else {
                             list_push_back(list_head, &item->list_elem_flush);
                         }
+                        num_items++;
                         break; // only pick one item per key
                     }
                 }
@@ -1745,11 +2214,17 @@ static fdb_status _wal_flush(struct filemgr *file,
         spin_unlock(&file->wal->key_shards[i].lock);
     }
 
+    if (do_sort) {
+        _wal_flush_prefetch(file, tree);
+    }
+
     filemgr_set_io_inprog(file); // MB-16622:prevent parallel writes by flusher
     fdb_status fs = FDB_RESULT_SUCCESS;
     struct avl_tree stale_seqnum_list;
+    struct avl_tree seqnum_list;
     struct avl_tree kvs_delta_stats;
     avl_init(&stale_seqnum_list, NULL);
+    avl_init(&seqnum_list, NULL);
     avl_init(&kvs_delta_stats, NULL);
 
     // scan and flush entries in the avl-tree or list
@@ -1762,7 +2237,8 @@ static fdb_status _wal_flush(struct filemgr *file,
                 continue; // need not flush this item into main index..
             } // item exists solely for in-memory snapshots
             fs = _wal_do_flush(item, flush_func, dbhandle,
-                               &stale_seqnum_list, &kvs_delta_stats);
+                               &stale_seqnum_list, &seqnum_list,
+                               &kvs_delta_stats);
             if (fs != FDB_RESULT_SUCCESS) {
                 _wal_restore_root_info(dbhandle, &root_info);
                 break;
@@ -1777,7 +2253,8 @@ static fdb_status _wal_flush(struct filemgr *file,
                 continue; // need not flush this item into main index..
             } // item exists solely for in-memory snapshots
             fs = _wal_do_flush(item, flush_func, dbhandle,
-                               &stale_seqnum_list, &kvs_delta_stats);
+                               &stale_seqnum_list, &seqnum_list,
+                               &kvs_delta_stats);
             if (fs != FDB_RESULT_SUCCESS) {
                 _wal_restore_root_info(dbhandle, &root_info);
                 break;
@@ -1786,10 +2263,17 @@ static fdb_status _wal_flush(struct filemgr *file,
     }
 
     // Remove all stale seq entries from the seq tree
-    seq_purge_func(dbhandle, &stale_seqnum_list, &kvs_delta_stats);
+    seq_purge_func(dbhandle, &stale_seqnum_list, &seqnum_list,
+                   &kvs_delta_stats);
     // Update each KV store stats after WAL flush
     delta_stats_func(file, &kvs_delta_stats);
 
+    if (num_items) {
+        // invalidate the key caches of all the handles on this file, once
+        // the indexes are updated
+        atomic_incr_uint64_t(&file->num_index_updates);
+    }
+
     filemgr_clear_io_inprog(file);
     return fs;
 }
@@ -1802,9 +2286,29 @@ fdb_status wal_flush(struct filemgr *file,
                      wal_flush_kvs_delta_stats_func *delta_stats_func,
                      union wal_flush_items *flush_items)
 {
-    return _wal_flush(file, dbhandle, flush_func, get_old_offset,
-                      seq_purge_func, delta_stats_func,
-                      flush_items, false);
+    LATENCY_STAT_START();
+    fdb_status fs = _wal_flush(file, dbhandle, flush_func, get_old_offset,
+                               seq_purge_func, delta_stats_func,
+                               flush_items, false, 0);
+    LATENCY_STAT_END(file, FDB_LATENCY_WAL_FLUSH);
+    return fs;
+}
+
+fdb_status wal_flush_partial(struct filemgr *file,
+                             void *dbhandle,
+                             wal_flush_func *flush_func,
+                             wal_get_old_offset_func *get_old_offset,
+                             wal_flush_seq_purge_func *seq_purge_func,
+                             wal_flush_kvs_delta_stats_func *delta_stats_func,
+                             union wal_flush_items *flush_items,
+                             size_t max_items)
+{
+    LATENCY_STAT_START();
+    fdb_status fs = _wal_flush(file, dbhandle, flush_func, get_old_offset,
+                               seq_purge_func, delta_stats_func,
+                               flush_items, false, max_items);
+    LATENCY_STAT_END(file, FDB_LATENCY_WAL_FLUSH);
+    return fs;
 }
 
 fdb_status wal_flush_by_compactor(struct filemgr *file,
@@ -1815,9 +2319,12 @@ fdb_status wal_flush_by_compactor(struct filemgr *file,
                                   wal_flush_kvs_delta_stats_func *delta_stats_func,
                                   union wal_flush_items *flush_items)
 {
-    return _wal_flush(file, dbhandle, flush_func, get_old_offset,
-                      seq_purge_func, delta_stats_func,
-                      flush_items, true);
+    LATENCY_STAT_START();
+    fdb_status fs = _wal_flush(file, dbhandle, flush_func, get_old_offset,
+                               seq_purge_func, delta_stats_func,
+                               flush_items, true, 0);
+    LATENCY_STAT_END(file, FDB_LATENCY_WAL_FLUSH);
+    return fs;
 }
 
 fdb_status wal_snapshot_clone(struct snap_handle *shandle_in,
@@ -2819,9 +3326,7 @@ fdb_status wal_discard(struct filemgr *file, fdb_txn *txn)
     e = list_begin(txn->items);
     while(e) {
         item = _get_entry(e, struct wal_item, list_elem_txn);
-        shard_num = get_checksum((uint8_t*)item->header->key,
-                                 item->header->keylen) %
-                                 file->wal->num_shards;
+        shard_num = item->header->shard_num;
         spin_lock(&file->wal->key_shards[shard_num].lock);
 
         if (file->config->seqtree_opt == FDB_SEQTREE_USE) {
@@ -2842,8 +3347,7 @@ fdb_status wal_discard(struct filemgr *file, fdb_txn *txn)
                        &item->header->avl_key);
             mem_overhead += sizeof(struct wal_item_header) + item->header->keylen;
             // free key and header
-            free(item->header->key);
-            free(item->header);
+            _wal_free_header(item->header);
         }
         // remove from txn's list
         e = list_remove(txn->items, e);
@@ -2859,7 +3363,7 @@ fdb_status wal_discard(struct filemgr *file, fdb_txn *txn)
         }
 
         // free
-        free(item);
+        _wal_slab_free(item);
         atomic_decr_uint32_t(&file->wal->size);
         mem_overhead += sizeof(struct wal_item);
         spin_unlock(&file->wal->key_shards[shard_num].lock);
@@ -3012,7 +3516,7 @@ static fdb_status _wal_close(struct filemgr *file,
                         }
                         atomic_decr_uint32_t(&file->wal->num_flushable);
                     }
-                    free(item);
+                    _wal_slab_free(item);
                     atomic_decr_uint32_t(&file->wal->size);
                     mem_overhead += sizeof(struct wal_item);
                 } else {
@@ -3027,8 +3531,7 @@ static fdb_status _wal_close(struct filemgr *file,
                 avl_remove(&file->wal->key_shards[i]._map,
                            &header->avl_key);
                 mem_overhead += sizeof(struct wal_item_header) + header->keylen;
-                free(header->key);
-                free(header);
+                _wal_free_header(header);
             }
         }
         spin_unlock(&file->wal->key_shards[i].lock);
@@ -48,6 +48,8 @@ struct wal_item_header{
     void *key;
     uint16_t keylen;
     uint8_t chunksize;
+    // index of the key shard that owns this header
+    uint16_t shard_num;
     struct list items;
 };
 
@@ -150,16 +152,23 @@ struct wal_item{
     };
 };
 
+/**
+ * Pointer of function that flushes a WAL item into the main indexes.
+ * SEQNUM_LIST is a per-flush list where the function may defer the sequence
+ * tree updates of the item, which are then applied by the seq purge function.
+ */
 typedef fdb_status wal_flush_func(void *dbhandle, struct wal_item *item,
                                   struct avl_tree *stale_seqnum_list,
+                                  struct avl_tree *seqnum_list,
                                   struct avl_tree *kvs_delta_stats);
 
 /**
  * Pointer of function that purges stale entries from the sequence tree
- * as part of WAL flush.
+ * and applies the deferred sequence tree updates as part of WAL flush.
  */
 typedef void wal_flush_seq_purge_func(void *dbhandle,
                                       struct avl_tree *stale_seqnum_list,
+                                      struct avl_tree *seqnum_list,
                                       struct avl_tree *kvs_delta_stats);
 
 /**
@@ -189,11 +198,44 @@ enum {
     FDB_WAL_PENDING = 2
 };
 
+// A key or seqnum shard of the WAL index. Both lookups and updates of
+// '_map' are done under 'lock', and ordered WAL iterators merge the maps
+// of all shards through 'merge_tree' of struct wal_iterator.
 struct wal_shard {
     struct avl_tree _map;
     spin_t lock;
 };
 
+// Size of the chunks that WAL items, headers, and keys are carved from.
+#define WAL_ARENA_CHUNK_SIZE (16384)
+
+struct wal_arena_chunk;
+
+// Slab of fixed-size objects
+struct wal_slab {
+    size_t objsize;
+    // chunks that have free objects
+    struct list partial;
+    // chunks whose objects are all in use
+    struct list full;
+};
+
+/**
+ * Per-shard allocator of WAL entries. Items and headers come from slabs,
+ * and key bytes are bump-allocated from the current key chunk. A chunk is
+ * released as a whole once all of its objects are freed, which usually
+ * happens when the items are released after a WAL flush.
+ */
+struct wal_arena {
+    struct wal_slab item_slab;
+    struct wal_slab header_slab;
+    // chunk that new keys are appended to
+    struct wal_arena_chunk *key_chunk;
+    // older key chunks that still have live keys
+    struct list key_chunks;
+    spin_t lock;
+};
+
 struct wal {
     uint8_t flag;
     atomic_uint8_t isPopulated; // Set when WAL is first populated OR restored
@@ -207,10 +249,14 @@ struct wal {
     struct wal_shard *key_shards;
     // indexes 'wal_item's seq num in WAL shard
     struct wal_shard *seq_shards;
+    // allocator of 'wal_item's, headers and keys for each key shard
+    struct wal_arena *arenas;
     size_t num_shards;
     // Global shared WAL Snapshot Data
     struct avl_tree wal_snapshot_tree;
     spin_t lock;
+    // protects the item lists of transactions against parallel writers
+    spin_t txn_lock;
 };
 
 struct wal_cursor {
@@ -309,6 +355,36 @@ fdb_status wal_flush(struct filemgr *file,
                      wal_flush_kvs_delta_stats_func *delta_stats_func,
                      union wal_flush_items *flush_items);
 
+/**
+ * Flush up to the given number of committed WAL entries into the main indexes
+ * (i.e., hbtrie and sequence tree), so that a large flush can be done in
+ * chunks and the file lock can be released between them. The entries that
+ * are not flushed stay in the WAL.
+ *
+ * @param file Pointer to the file manager
+ * @param dbhandle Pointer to the KV store handle
+ * @param flush_func Pointer of function that flushes each WAL entry into the
+ *                   main indexes
+ * @param get_old_offset Pointer of function that retrieves an offset of the
+ *                       old KV item from the hbtrie
+ * @param seq_purge_func Pointer of function that purges an old entry with the
+ *                       same key from the sequence tree
+ * @param delta_stats_func Pointer of function that updates each KV store's stats
+ * @param flush_items Pointer to the list that contains the list of all WAL entries
+ *                    that are flushed into the main indexes
+ * @param max_items Maximum number of WAL entries to be flushed, or zero to
+ *                  flush all of them as wal_flush() does
+ * @return FDB_RESULT upon successful WAL flush
+ */
+fdb_status wal_flush_partial(struct filemgr *file,
+                             void *dbhandle,
+                             wal_flush_func *flush_func,
+                             wal_get_old_offset_func *get_old_offset,
+                             wal_flush_seq_purge_func *seq_purge_func,
+                             wal_flush_kvs_delta_stats_func *delta_stats_func,
+                             union wal_flush_items *flush_items,
+                             size_t max_items);
+
 /**
  * Flush WAL entries into the main indexes (i.e., hbtrie and sequence tree)
  * by the compactor
@@ -521,6 +597,15 @@ bool wal_txn_exists(struct filemgr *file);
  */
 size_t wal_get_mem_overhead(struct filemgr *file);
 
+/**
+ * Initialize the pool of threads that read the old document blocks of large
+ * WAL flushes into the buffer cache in parallel. The threads are created
+ * when a WAL flush first needs them, up to 'num_wal_prefetch_threads' - 1.
+ * The index updates of a flush are still applied by its calling thread.
+ */
+void wal_prefetch_init(void);
+void wal_prefetch_shutdown(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,436 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2010 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "arch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libforestdb/forestdb.h"
+#include "fdb_internal.h"
+#include "filemgr.h"
+#include "avltree.h"
+#include "common.h"
+#include "list.h"
+#include "wal.h"
+#include "walflusher.h"
+#include "memleak.h"
+#include "time_utils.h"
+
+#ifdef __DEBUG
+#ifndef __DEBUG_WALFLUSHER
+    #undef DBG
+    #undef DBGCMD
+    #undef DBGSW
+    #define DBG(...)
+    #define DBGCMD(...)
+    #define DBGSW(n, ...)
+#endif
+#endif
+
+// variables for initialization
+volatile uint8_t walflusher_initialized = 0;
+static mutex_t wf_lock = MUTEX_INITIALIZER;
+
+// the daemon thread is created when the first file is registered
+static bool walflusher_running = false;
+static thread_t walflusher_tid;
+
+static mutex_t sync_mutex = MUTEX_INITIALIZER;
+static thread_cond_t sync_cond;
+// signaled with 'wf_lock' whenever a flush is done
+static thread_cond_t flush_cond;
+// set by walflusher_notify(), and cleared when the files are scanned
+static atomic_uint8_t wakeup_pending(0);
+
+static volatile uint8_t walflusher_terminate_signal = 0;
+
+static struct avl_tree openfiles;
+
+struct openfiles_elem {
+    char filename[FDB_MAX_FILENAME_LEN];
+    struct filemgr *file;
+    fdb_config config;
+    // the handle used to flush the WAL, which is opened on the first flush
+    // and kept open until the last user handle on the file is closed
+    fdb_file_handle *fhandle;
+    uint32_t register_count;
+    bool flush_in_progress;
+    struct avl_node avl;
+};
+
+// compares file names
+static int _walflusher_cmp(struct avl_node *a, struct avl_node *b, void *aux)
+{
+    struct openfiles_elem *aa, *bb;
+    aa = _get_entry(a, struct openfiles_elem, avl);
+    bb = _get_entry(b, struct openfiles_elem, avl);
+    return strncmp(aa->filename, bb->filename, FDB_MAX_FILENAME_LEN);
+}
+
+INLINE bool _walflusher_need_flush(struct openfiles_elem *elem)
+{
+    return !elem->flush_in_progress &&
+           filemgr_get_file_status(elem->file) == FILE_NORMAL &&
+           wal_get_num_flushable(elem->file) > elem->config.wal_threshold;
+}
+
+// Flush the WAL of the given file through FHANDLE, which is opened first if
+// it is NULL. Returns the handle to be kept for the next flush, and sets
+// FLUSHED to true if any WAL entry has been flushed.
+static fdb_file_handle *_walflusher_flush_file(fdb_file_handle *fhandle,
+                                               struct filemgr *file,
+                                               const char *filename,
+                                               fdb_config *config,
+                                               bool *flushed)
+{
+    fdb_status fs;
+    fdb_config fconfig;
+    struct list cmp_func_list;
+    size_t num_flushable = wal_get_num_flushable(file);
+
+    if (!fhandle) {
+        fconfig = *config;
+        // the handle is not registered, so that it does not keep the file
+        // registered after all the user handles are closed.
+        fconfig.enable_background_wal_flush = false;
+        fconfig.auto_commit = false;
+
+        list_init(&cmp_func_list);
+        fdb_cmp_func_list_from_filemgr(file, &cmp_func_list);
+        fs = fdb_open_for_wal_flusher(&fhandle, filename, &fconfig,
+                                      &cmp_func_list);
+        fdb_free_cmp_func_list(&cmp_func_list);
+        if (fs != FDB_RESULT_SUCCESS) {
+            fdb_log(NULL, FDB_LOG_ERROR, fs,
+                    "Failed to open the file '%s' for background WAL flushing.",
+                    filename);
+            return NULL;
+        }
+    }
+
+    fs = fdb_flush_wal_background(fhandle);
+    if (fs != FDB_RESULT_SUCCESS) {
+        fdb_log(&fhandle->root->log_callback, FDB_LOG_ERROR, fs,
+                "Failed to flush the WAL of the file '%s' in background.",
+                filename);
+    }
+
+    *flushed = wal_get_num_flushable(file) < num_flushable;
+    return fhandle;
+}
+
+static void * walflusher_thread(void *voidargs)
+{
+    char filename[FDB_MAX_FILENAME_LEN];
+    fdb_config config;
+    filemgr_open_result ffs;
+    fdb_file_handle *fhandle;
+    bool flushed;
+    struct avl_node *a;
+    struct filemgr *file;
+    struct openfiles_elem *elem;
+
+    while (1) {
+        size_t num_flushes = 0;
+
+        atomic_store_uint8_t(&wakeup_pending, 0);
+        mutex_lock(&wf_lock);
+        a = avl_first(&openfiles);
+        while (a) {
+            elem = _get_entry(a, struct openfiles_elem, avl);
+            file = elem->file;
+            if (!file) {
+                a = avl_next(a);
+                avl_remove(&openfiles, &elem->avl);
+                free(elem);
+                continue;
+            }
+
+            if (!_walflusher_need_flush(elem)) {
+                a = avl_next(a);
+                continue;
+            }
+
+            elem->flush_in_progress = true;
+            fhandle = elem->fhandle;
+            strcpy(filename, file->filename);
+            config = elem->config;
+            // keep the file open while 'wf_lock' is released, as the last
+            // handle on it may be closed in the meantime.
+            ffs = filemgr_open(filename, file->ops, file->config, NULL);
+            mutex_unlock(&wf_lock);
+
+            if (ffs.rv == FDB_RESULT_SUCCESS) {
+                flushed = false;
+                fhandle = _walflusher_flush_file(fhandle, ffs.file, filename,
+                                                 &config, &flushed);
+                if (flushed) {
+                    num_flushes++;
+                }
+                filemgr_close(ffs.file, 0, filename, NULL);
+            }
+
+            mutex_lock(&wf_lock);
+            if (fhandle &&
+                (!elem->file || fhandle->root->file != elem->file)) {
+                // All the user handles have been closed, or the file has been
+                // compacted in the meantime. 'elem' is not freed until the
+                // flush is marked as done.
+                mutex_unlock(&wf_lock);
+                fdb_close(fhandle);
+                fhandle = NULL;
+                mutex_lock(&wf_lock);
+            }
+            elem->fhandle = fhandle;
+            elem->flush_in_progress = false;
+            thread_cond_broadcast(&flush_cond);
+            a = avl_next(&elem->avl);
+            if (walflusher_terminate_signal) {
+                mutex_unlock(&wf_lock);
+                return NULL;
+            }
+        }
+        mutex_unlock(&wf_lock);
+
+        mutex_lock(&sync_mutex);
+        if (walflusher_terminate_signal) {
+            mutex_unlock(&sync_mutex);
+            break;
+        }
+        if (!num_flushes && !atomic_get_uint8_t(&wakeup_pending)) {
+            thread_cond_timedwait(&sync_cond, &sync_mutex,
+                                  FDB_WALFLUSHER_SLEEP_DURATION * 1000);
+        }
+        if (walflusher_terminate_signal) {
+            mutex_unlock(&sync_mutex);
+            break;
+        }
+        mutex_unlock(&sync_mutex);
+    }
+    return NULL;
+}
+
+void walflusher_init(void)
+{
+    if (!walflusher_initialized) {
+        // Note that this function is synchronized by spin lock in fdb_init API.
+        mutex_init(&wf_lock);
+
+        mutex_lock(&wf_lock);
+        if (!walflusher_initialized) {
+            avl_init(&openfiles, NULL);
+
+            walflusher_terminate_signal = 0;
+            walflusher_running = false;
+            atomic_store_uint8_t(&wakeup_pending, 0);
+
+            mutex_init(&sync_mutex);
+            thread_cond_init(&sync_cond);
+            thread_cond_init(&flush_cond);
+
+            walflusher_initialized = 1;
+        }
+        mutex_unlock(&wf_lock);
+    }
+}
+
+void walflusher_shutdown(void)
+{
+    void *ret;
+    struct avl_node *a = NULL;
+    struct openfiles_elem *elem;
+
+    if (!walflusher_initialized) {
+        return;
+    }
+
+    if (walflusher_running) {
+        // set terminate signal
+        mutex_lock(&sync_mutex);
+        walflusher_terminate_signal = 1;
+        thread_cond_broadcast(&sync_cond);
+        mutex_unlock(&sync_mutex);
+
+        thread_join(walflusher_tid, &ret);
+        walflusher_running = false;
+    }
+
+    mutex_lock(&wf_lock);
+    // free all elems in the tree
+    a = avl_first(&openfiles);
+    while (a) {
+        elem = _get_entry(a, struct openfiles_elem, avl);
+        a = avl_next(a);
+
+        avl_remove(&openfiles, &elem->avl);
+        if (elem->fhandle) {
+            // the handle is not registered, so closing it does not refer to
+            // 'wf_lock'.
+            fdb_close(elem->fhandle);
+        }
+        free(elem);
+    }
+
+    walflusher_initialized = 0;
+    mutex_destroy(&sync_mutex);
+    thread_cond_destroy(&sync_cond);
+    thread_cond_destroy(&flush_cond);
+    mutex_unlock(&wf_lock);
+
+    mutex_destroy(&wf_lock);
+}
+
+fdb_status walflusher_register_file(struct filemgr *file,
+                                    fdb_config *config)
+{
+    if (!walflusher_initialized) return FDB_RESULT_SUCCESS;
+
+    file_status_t fstatus;
+    struct avl_node *a = NULL;
+    struct openfiles_elem query, *elem;
+
+    // Ignore files being compacted or removed, as bgflusher does.
+    fstatus = filemgr_get_file_status(file);
+    if (fstatus == FILE_COMPACT_OLD ||
+        fstatus == FILE_REMOVED_PENDING) {
+        return FDB_RESULT_SUCCESS;
+    }
+
+    strcpy(query.filename, file->filename);
+    mutex_lock(&wf_lock);
+    a = avl_search(&openfiles, &query.avl, _walflusher_cmp);
+    if (a == NULL) {
+        elem = (struct openfiles_elem *)calloc(1, sizeof(struct openfiles_elem));
+        elem->file = file;
+        strcpy(elem->filename, file->filename);
+        elem->config = *config;
+        elem->fhandle = NULL;
+        elem->register_count = 1;
+        elem->flush_in_progress = false;
+        avl_insert(&openfiles, &elem->avl, _walflusher_cmp);
+    } else {
+        elem = _get_entry(a, struct openfiles_elem, avl);
+        if (!elem->file) {
+            elem->file = file;
+        }
+        elem->register_count++;
+    }
+
+    if (!walflusher_running) {
+        walflusher_terminate_signal = 0;
+        thread_create(&walflusher_tid, walflusher_thread, NULL);
+        walflusher_running = true;
+    }
+    mutex_unlock(&wf_lock);
+    return FDB_RESULT_SUCCESS;
+}
+
+void walflusher_switch_file(struct filemgr *old_file, struct filemgr *new_file)
+{
+    if (!walflusher_initialized) return;
+
+    struct avl_node *a = NULL;
+    struct openfiles_elem query, *elem;
+
+    strcpy(query.filename, old_file->filename);
+    mutex_lock(&wf_lock);
+    a = avl_search(&openfiles, &query.avl, _walflusher_cmp);
+    if (a) {
+        elem = _get_entry(a, struct openfiles_elem, avl);
+        avl_remove(&openfiles, a);
+        strcpy(elem->filename, new_file->filename);
+        elem->file = new_file;
+        elem->register_count = 1;
+        avl_insert(&openfiles, &elem->avl, _walflusher_cmp);
+    }
+    mutex_unlock(&wf_lock);
+}
+
+void walflusher_deregister_file(struct filemgr *file)
+{
+    if (!walflusher_initialized) return;
+
+    struct avl_node *a = NULL;
+    struct openfiles_elem query, *elem;
+    fdb_file_handle *fhandle = NULL;
+
+    strcpy(query.filename, file->filename);
+    mutex_lock(&wf_lock);
+    a = avl_search(&openfiles, &query.avl, _walflusher_cmp);
+    if (a) {
+        elem = _get_entry(a, struct openfiles_elem, avl);
+        if ((--elem->register_count) == 0) {
+            if (elem->flush_in_progress) {
+                // The daemon thread still refers to 'elem'; it will close the
+                // handle and remove 'elem' once the flush is done.
+                elem->file = NULL;
+            } else {
+                fhandle = elem->fhandle;
+                avl_remove(&openfiles, &elem->avl);
+                free(elem);
+            }
+        }
+    }
+    mutex_unlock(&wf_lock);
+
+    if (fhandle) {
+        fdb_close(fhandle);
+    }
+}
+
+void walflusher_release_file(struct filemgr *file, bool wait)
+{
+    if (!walflusher_initialized) return;
+
+    struct avl_node *a = NULL;
+    struct openfiles_elem query, *elem;
+    fdb_file_handle *fhandle = NULL;
+
+    strcpy(query.filename, file->filename);
+    mutex_lock(&wf_lock);
+    a = avl_search(&openfiles, &query.avl, _walflusher_cmp);
+    if (a) {
+        elem = _get_entry(a, struct openfiles_elem, avl);
+        // 'elem' is not freed while the caller's handle is registered.
+        while (wait && elem->flush_in_progress) {
+            thread_cond_wait(&flush_cond, &wf_lock);
+        }
+        if (!elem->flush_in_progress && elem->fhandle &&
+            (elem->register_count <= 1 ||
+             elem->fhandle->root->file != elem->file)) {
+            fhandle = elem->fhandle;
+            elem->fhandle = NULL;
+        }
+    }
+    mutex_unlock(&wf_lock);
+
+    if (fhandle) {
+        fdb_close(fhandle);
+    }
+}
+
+void walflusher_notify(void)
+{
+    if (!walflusher_initialized) return;
+
+    if (atomic_cas_uint8_t(&wakeup_pending, 0, 1)) {
+        mutex_lock(&sync_mutex);
+        thread_cond_signal(&sync_cond);
+        mutex_unlock(&sync_mutex);
+    }
+}
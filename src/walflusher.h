@@ -0,0 +1,58 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2010 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#ifndef _FDB_WALFLUSHER_H
+#define _FDB_WALFLUSHER_H
+
+#include "internal_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Initialize the daemon that flushes the WAL of the registered files into
+ * their indexes, so that writers do not have to wait for the flushes. Its
+ * thread is started when the first file is registered.
+ */
+void walflusher_init(void);
+void walflusher_shutdown(void);
+fdb_status walflusher_register_file(struct filemgr *file,
+                                    fdb_config *config);
+void walflusher_switch_file(struct filemgr *old_file, struct filemgr *new_file);
+void walflusher_deregister_file(struct filemgr *file);
+/**
+ * Close the handle that the daemon keeps open on the given file to flush its
+ * WAL, if at most one user handle is registered for the file, or if the file
+ * has been compacted. It is called before the last user handle is closed, so
+ * that the file is not left referred to by the daemon. If WAIT is true, an
+ * ongoing flush of the file is waited for; otherwise the daemon closes the
+ * handle once the flush is done. The daemon opens the handle again on the
+ * next flush.
+ */
+void walflusher_release_file(struct filemgr *file, bool wait);
+/**
+ * Wake up the daemon thread, as the WAL of a registered file has more
+ * flushable entries than its threshold.
+ */
+void walflusher_notify(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _FDB_WALFLUSHER_H
@@ -30,6 +30,7 @@
 #include "filemgr_anomalous_ops.h"
 #include "filemgr.h"
 #include "internal_types.h"
+#include "wal.h"
 
 void logCallbackFunc(int err_code,
                      const char *err_msg,
@@ -180,6 +181,188 @@ void write_failure_test()
     TEST_RESULT(temp);
 }
 
+void set_multi_write_failure_test()
+{
+    TEST_INIT();
+
+    memleak_start();
+
+    int i, r, num_ops;
+    int n = 8;
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db;
+    fdb_doc *doc[8];
+    fdb_status status;
+    char keybuf[256], bodybuf[2048];
+    struct anomalous_callbacks *write_fail_cb = get_default_anon_cbs();
+    fail_ctx_t fail_ctx;
+    memset(&fail_ctx, 0, sizeof(fail_ctx_t));
+    write_fail_cb->pwrite_cb = &pwrite_failure_cb;
+
+    r = system(SHELL_DEL" anomaly_test* > errorlog.txt");
+    (void)r;
+
+    filemgr_ops_anomalous_init(write_fail_cb, &fail_ctx);
+    fail_ctx.start_failing_after = 0x7fffffff;
+
+    fdb_config fconfig = fdb_get_default_config();
+    fdb_kvs_config kvs_config = fdb_get_default_kvs_config();
+    fconfig.buffercache_size = 0;
+    fconfig.compaction_threshold = 0;
+
+    status = fdb_open(&dbfile, "anomaly_test1", &fconfig);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_kvs_open(dbfile, &db, "kv1", &kvs_config);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    memset(bodybuf, 'x', sizeof(bodybuf));
+    for (i = 0; i < n; ++i) {
+        sprintf(keybuf, "key%d", i);
+        fdb_doc_create(&doc[i], keybuf, strlen(keybuf), NULL, 0,
+                       bodybuf, sizeof(bodybuf));
+    }
+
+    // count the writes needed to append a doc
+    num_ops = fail_ctx.num_ops;
+    status = fdb_set(db, doc[0]);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    num_ops = fail_ctx.num_ops - num_ops;
+    status = fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    TEST_CHK(wal_get_dirty_status(dbfile->root->file) == FDB_WAL_CLEAN);
+
+    // writes start failing in the middle of the batch; the docs appended
+    // before the failure are still in the WAL
+    fail_ctx.start_failing_after = fail_ctx.num_ops + 2 * num_ops;
+    status = fdb_set_multi(db, doc, n);
+    TEST_CHK(status == FDB_RESULT_WRITE_FAIL);
+    TEST_CHK(fail_ctx.num_fails > 0);
+    TEST_CHK(wal_get_size(dbfile->root->file) > 0);
+    TEST_CHK(wal_get_size(dbfile->root->file) < (size_t)n);
+    TEST_CHK(wal_get_dirty_status(dbfile->root->file) == FDB_WAL_DIRTY);
+    fail_ctx.start_failing_after = 0x7fffffff;
+
+    for (i = 0; i < n; ++i) {
+        fdb_doc_free(doc[i]);
+    }
+    status = fdb_close(dbfile);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    fdb_shutdown();
+
+    memleak_end();
+    TEST_RESULT("set multi write failure test");
+}
+
+// callback context for failing DB header writes
+typedef struct header_fail_ctx_t {
+    bool fail;
+    int num_fails;
+    cs_off_t offset;
+} header_fail_ctx_t;
+
+ssize_t pwrite_header_failure_cb(void *ctx, struct filemgr_ops *normal_ops,
+                                 int fd, void *buf, size_t count,
+                                 cs_off_t offset)
+{
+    header_fail_ctx_t *hctx = (header_fail_ctx_t *)ctx;
+    if (hctx->fail && count == 4096 &&
+        ((uint8_t *)buf)[count - 1] == BLK_MARKER_DBHEADER) {
+        hctx->num_fails++;
+        hctx->offset = offset;
+        errno = -2;
+        return (ssize_t)FDB_RESULT_WRITE_FAIL;
+    }
+    return normal_ops->pwrite(fd, buf, count, offset);
+}
+
+void header_write_failure_test()
+{
+    TEST_INIT();
+
+    memleak_start();
+
+    int r;
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db;
+    fdb_status status;
+    void *value;
+    size_t valuelen;
+    uint64_t last_commit, pos;
+    bid_t last_hdr_bid;
+    struct filemgr *file;
+    struct anomalous_callbacks *header_fail_cb = get_default_anon_cbs();
+    header_fail_ctx_t fail_ctx;
+    memset(&fail_ctx, 0, sizeof(fail_ctx));
+    header_fail_cb->pwrite_cb = &pwrite_header_failure_cb;
+
+    r = system(SHELL_DEL" anomaly_test* > errorlog.txt");
+    (void)r;
+
+    filemgr_ops_anomalous_init(header_fail_cb, &fail_ctx);
+
+    fdb_config fconfig = fdb_get_default_config();
+    fdb_kvs_config kvs_config = fdb_get_default_kvs_config();
+    fconfig.compaction_threshold = 0;
+
+    status = fdb_open(&dbfile, "anomaly_test1", &fconfig);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_set_kv(db, (void*)"key1", 4, (void*)"body1", 5);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_commit(dbfile, FDB_COMMIT_NORMAL);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    file = dbfile->root->file;
+    last_commit = atomic_get_uint64_t(&file->last_commit);
+    last_hdr_bid = atomic_get_uint64_t(&file->header.bid);
+
+    // a commit whose DB header cannot be written does not move the commit
+    // point
+    status = fdb_set_kv(db, (void*)"key2", 4, (void*)"body2", 5);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    fail_ctx.fail = true;
+    status = fdb_commit(dbfile, FDB_COMMIT_NORMAL);
+    TEST_CHK(status != FDB_RESULT_SUCCESS);
+    TEST_CHK(fail_ctx.num_fails == 1);
+    TEST_CHK(atomic_get_uint64_t(&file->last_commit) == last_commit);
+    TEST_CHK(atomic_get_uint64_t(&file->header.bid) == last_hdr_bid);
+
+    // the header block reserved at the end of the file is given back
+    pos = atomic_get_uint64_t(&file->pos);
+    filemgr_mutex_lock(file);
+    status = filemgr_commit(file, false, NULL);
+    filemgr_mutex_unlock(file);
+    TEST_CHK(status != FDB_RESULT_SUCCESS);
+    TEST_CHK(fail_ctx.num_fails == 2);
+    TEST_CHK(fail_ctx.offset == (cs_off_t)pos);
+    TEST_CHK(atomic_get_uint64_t(&file->pos) == pos);
+    TEST_CHK(atomic_get_uint64_t(&file->last_commit) == last_commit);
+
+    // the next commit succeeds
+    fail_ctx.fail = false;
+    status = fdb_commit(dbfile, FDB_COMMIT_NORMAL);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    TEST_CHK(atomic_get_uint64_t(&file->last_commit) > last_commit);
+    status = fdb_close(dbfile);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    status = fdb_open(&dbfile, "anomaly_test1", &fconfig);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_get_kv(db, (void*)"key2", 4, &value, &valuelen);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    TEST_CMP(value, "body2", valuelen);
+    fdb_free_block(value);
+    status = fdb_close(dbfile);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    fdb_shutdown();
+
+    memleak_end();
+    TEST_RESULT("header write failure test");
+}
+
 ssize_t pread_failure_cb(void *ctx, struct filemgr_ops *normal_ops,
                          int fd, void *buf, size_t count, cs_off_t offset)
 {
@@ -1000,6 +1183,8 @@ int main(){
      */
     //copy_file_range_test();
     write_failure_test();
+    set_multi_write_failure_test();
+    header_write_failure_test();
     read_failure_test();
     handle_busy_test();
     read_old_file();
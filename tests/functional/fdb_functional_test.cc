@@ -27,6 +27,8 @@
 #include "libforestdb/forestdb.h"
 #include "test.h"
 #include "internal_types.h"
+#include "wal.h"
+#include "keycache.h"
 #include "functional_util.h"
 
 void basic_test()
@@ -804,6 +806,1161 @@ void large_batch_write_no_commit_test()
     TEST_RESULT("large batch write test with no commits");
 }
 
+void io_uring_engine_test()
+{
+    TEST_INIT();
+    memleak_start();
+
+    int i, r;
+    int n = 20000;
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db;
+    fdb_doc *doc, *rdoc;
+    fdb_status status;
+    fdb_config fconfig;
+    fdb_kvs_config kvs_config;
+    char keybuf[256], bodybuf[256];
+
+    r = system(SHELL_DEL " dummy* > errorlog.txt");
+    (void)r;
+
+    // Small buffer cache so that dirty blocks are also flushed by evictions.
+    fconfig = fdb_get_default_config();
+    fconfig.buffercache_size = 1 * 1024 * 1024;
+    fconfig.durability_opt = FDB_DRB_NONE;
+    fconfig.io_engine = FDB_IO_ENGINE_IO_URING;
+    kvs_config = fdb_get_default_kvs_config();
+    status = fdb_open(&dbfile, "./dummy1", &fconfig);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_kvs_open(dbfile, &db, NULL, &kvs_config);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    for (i = 0; i < n; ++i) {
+        sprintf(keybuf, "key%08d", i);
+        sprintf(bodybuf, "body%128d", i);
+        fdb_doc_create(&doc, (void*)keybuf, strlen(keybuf), NULL, 0,
+                       (void*)bodybuf, strlen(bodybuf));
+        status = fdb_set(db, doc);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        fdb_doc_free(doc);
+        if (i % 5000 == 4999) {
+            status = fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+            TEST_CHK(status == FDB_RESULT_SUCCESS);
+        }
+    }
+    status = fdb_close(dbfile);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    fdb_shutdown();
+
+    // Read everything back with the POSIX engine.
+    fconfig.io_engine = FDB_IO_ENGINE_POSIX;
+    status = fdb_open(&dbfile, "./dummy1", &fconfig);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_kvs_open(dbfile, &db, NULL, &kvs_config);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    for (i = 0; i < n; ++i) {
+        sprintf(keybuf, "key%08d", i);
+        sprintf(bodybuf, "body%128d", i);
+        fdb_doc_create(&rdoc, (void*)keybuf, strlen(keybuf), NULL, 0,
+                       NULL, 0);
+        status = fdb_get(db, rdoc);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        TEST_CMP(rdoc->body, bodybuf, rdoc->bodylen);
+        fdb_doc_free(rdoc);
+    }
+    status = fdb_close(dbfile);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    fdb_shutdown();
+    memleak_end();
+    TEST_RESULT("io_uring I/O engine test");
+}
+
+void direct_io_test()
+{
+    TEST_INIT();
+    memleak_start();
+
+    int i, r;
+    int n = 20000;
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db;
+    fdb_doc *doc, *rdoc;
+    fdb_status status;
+    fdb_config fconfig;
+    fdb_kvs_config kvs_config;
+    char keybuf[256], bodybuf[256];
+
+    r = system(SHELL_DEL " dummy* > errorlog.txt");
+    (void)r;
+
+    // Small buffer cache so that both flushes and cache misses go through
+    // the O_DIRECT path.
+    fconfig = fdb_get_default_config();
+    fconfig.buffercache_size = 1 * 1024 * 1024;
+    fconfig.durability_opt = FDB_DRB_ODIRECT;
+    kvs_config = fdb_get_default_kvs_config();
+    status = fdb_open(&dbfile, "./dummy1", &fconfig);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_kvs_open(dbfile, &db, NULL, &kvs_config);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    for (i = 0; i < n; ++i) {
+        sprintf(keybuf, "key%08d", i);
+        sprintf(bodybuf, "body%128d", i);
+        fdb_doc_create(&doc, (void*)keybuf, strlen(keybuf), NULL, 0,
+                       (void*)bodybuf, strlen(bodybuf));
+        status = fdb_set(db, doc);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        fdb_doc_free(doc);
+        if (i % 5000 == 4999) {
+            status = fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+            TEST_CHK(status == FDB_RESULT_SUCCESS);
+        }
+    }
+    status = fdb_close(dbfile);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    fdb_shutdown();
+
+    // Read back in a strided order, so that some blocks were already
+    // cached by the extent read of their neighbours.
+    status = fdb_open(&dbfile, "./dummy1", &fconfig);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_kvs_open(dbfile, &db, NULL, &kvs_config);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    for (i = 0; i < n; ++i) {
+        int idx = (i * 7919) % n;
+        sprintf(keybuf, "key%08d", idx);
+        sprintf(bodybuf, "body%128d", idx);
+        fdb_doc_create(&rdoc, (void*)keybuf, strlen(keybuf), NULL, 0,
+                       NULL, 0);
+        status = fdb_get(db, rdoc);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        TEST_CMP(rdoc->body, bodybuf, rdoc->bodylen);
+        fdb_doc_free(rdoc);
+    }
+    status = fdb_close(dbfile);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    fdb_shutdown();
+    memleak_end();
+    TEST_RESULT("direct I/O test");
+}
+
+struct group_commit_args {
+    int id;
+    int ndocs;
+};
+
+static void *_group_commit_thread(void *voidargs)
+{
+    TEST_INIT();
+
+    struct group_commit_args *args = (struct group_commit_args *)voidargs;
+    int i;
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db;
+    fdb_doc *doc;
+    fdb_status status;
+    fdb_config fconfig = fdb_get_default_config();
+    fdb_kvs_config kvs_config = fdb_get_default_kvs_config();
+    char keybuf[256], bodybuf[256];
+
+    fconfig.group_commit = true;
+    status = fdb_open(&dbfile, "./dummy1", &fconfig);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_kvs_open(dbfile, &db, NULL, &kvs_config);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    // every document is committed durably on its own
+    for (i = 0; i < args->ndocs; ++i) {
+        sprintf(keybuf, "t%d_key%d", args->id, i);
+        sprintf(bodybuf, "t%d_body%d", args->id, i);
+        fdb_doc_create(&doc, (void*)keybuf, strlen(keybuf), NULL, 0,
+                       (void*)bodybuf, strlen(bodybuf));
+        status = fdb_set(db, doc);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        fdb_doc_free(doc);
+        status = fdb_commit(dbfile, FDB_COMMIT_NORMAL);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+    }
+
+    status = fdb_close(dbfile);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    thread_exit(0);
+    return NULL;
+}
+
+void group_commit_test()
+{
+    TEST_INIT();
+    memleak_start();
+
+    int i, j, r;
+    int nthreads = 8;
+    int n = 50;
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db;
+    fdb_doc *rdoc;
+    fdb_status status;
+    fdb_file_info info;
+    fdb_config fconfig = fdb_get_default_config();
+    fdb_kvs_config kvs_config = fdb_get_default_kvs_config();
+    char keybuf[256], bodybuf[256];
+    thread_t *tid = alca(thread_t, nthreads);
+    void **thread_ret = alca(void *, nthreads);
+    struct group_commit_args *args = alca(struct group_commit_args, nthreads);
+
+    r = system(SHELL_DEL " dummy* > errorlog.txt");
+    (void)r;
+
+    // keep the file open so that the group commit stats are retained
+    status = fdb_open(&dbfile, "./dummy1", &fconfig);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_kvs_open(dbfile, &db, NULL, &kvs_config);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    // group commit is disabled by default
+    status = fdb_set_kv(db, (void*)"key", 3, (void*)"body", 4);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_commit(dbfile, FDB_COMMIT_NORMAL);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_get_file_info(dbfile, &info);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    TEST_CHK(info.num_group_commits == 0);
+
+    for (i = 0; i < nthreads; ++i) {
+        args[i].id = i;
+        args[i].ndocs = n;
+        thread_create(&tid[i], _group_commit_thread, &args[i]);
+    }
+    for (i = 0; i < nthreads; ++i) {
+        thread_join(tid[i], &thread_ret[i]);
+    }
+
+    status = fdb_get_file_info(dbfile, &info);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    TEST_CHK(info.num_group_commits == (uint64_t)nthreads * n);
+    TEST_CHK(info.num_group_commit_syncs > 0);
+    TEST_CHK(info.num_group_commit_syncs <= info.num_group_commits);
+    TEST_CHK(info.max_group_commit_batch >= 1);
+    TEST_CHK(info.max_group_commit_batch <= (uint64_t)nthreads);
+    status = fdb_close(dbfile);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    // every committed document should be found after reopening the file
+    status = fdb_open(&dbfile, "./dummy1", &fconfig);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_kvs_open(dbfile, &db, NULL, &kvs_config);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    for (i = 0; i < nthreads; ++i) {
+        for (j = 0; j < n; ++j) {
+            sprintf(keybuf, "t%d_key%d", i, j);
+            sprintf(bodybuf, "t%d_body%d", i, j);
+            fdb_doc_create(&rdoc, (void*)keybuf, strlen(keybuf), NULL, 0,
+                           NULL, 0);
+            status = fdb_get(db, rdoc);
+            TEST_CHK(status == FDB_RESULT_SUCCESS);
+            TEST_CMP(rdoc->body, bodybuf, rdoc->bodylen);
+            fdb_doc_free(rdoc);
+        }
+    }
+    status = fdb_close(dbfile);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    fdb_shutdown();
+    memleak_end();
+    TEST_RESULT("group commit test");
+}
+
+void wal_arena_test()
+{
+    TEST_INIT();
+    memleak_start();
+
+    int i, r;
+    int n = 20000;
+    size_t keylen;
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db;
+    fdb_doc *doc, *rdoc;
+    fdb_status status;
+    fdb_config fconfig;
+    fdb_kvs_config kvs_config;
+    char *keybuf = (char *)malloc(8192);
+    char bodybuf[256];
+
+    r = system(SHELL_DEL " dummy* > errorlog.txt");
+    (void)r;
+
+    // Keep everything in WAL until the manual flush, and mix small keys
+    // with keys that do not fit in a shared key chunk.
+    fconfig = fdb_get_default_config();
+    fconfig.wal_threshold = 4 * n;
+    kvs_config = fdb_get_default_kvs_config();
+    status = fdb_open(&dbfile, "./dummy1", &fconfig);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_kvs_open(dbfile, &db, NULL, &kvs_config);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    for (int round = 0; round < 2; ++round) {
+        for (i = 0; i < n; ++i) {
+            keylen = (i % 1000 == 0) ? 6000 : 16 + i % 64;
+            memset(keybuf, 'a' + i % 26, keylen);
+            sprintf(keybuf, "key%08d", i);
+            keybuf[strlen(keybuf)] = '_';
+            sprintf(bodybuf, "body%d_%d", round, i);
+            fdb_doc_create(&doc, keybuf, keylen, NULL, 0,
+                           bodybuf, strlen(bodybuf));
+            status = fdb_set(db, doc);
+            TEST_CHK(status == FDB_RESULT_SUCCESS);
+            fdb_doc_free(doc);
+        }
+        // items of aborted transactions are freed without being flushed
+        status = fdb_begin_transaction(dbfile, FDB_ISOLATION_READ_COMMITTED);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        for (i = 0; i < n; i += 7) {
+            keylen = (i % 1000 == 0) ? 6000 : 16 + i % 64;
+            memset(keybuf, 'a' + i % 26, keylen);
+            sprintf(keybuf, "key%08d", i);
+            keybuf[strlen(keybuf)] = '_';
+            fdb_doc_create(&doc, keybuf, keylen, NULL, 0, "x", 1);
+            status = fdb_set(db, doc);
+            TEST_CHK(status == FDB_RESULT_SUCCESS);
+            fdb_doc_free(doc);
+        }
+        status = fdb_abort_transaction(dbfile);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+        status = fdb_commit(dbfile, round ? FDB_COMMIT_MANUAL_WAL_FLUSH
+                                          : FDB_COMMIT_NORMAL);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+        for (i = 0; i < n; ++i) {
+            keylen = (i % 1000 == 0) ? 6000 : 16 + i % 64;
+            memset(keybuf, 'a' + i % 26, keylen);
+            sprintf(keybuf, "key%08d", i);
+            keybuf[strlen(keybuf)] = '_';
+            sprintf(bodybuf, "body%d_%d", round, i);
+            fdb_doc_create(&rdoc, keybuf, keylen, NULL, 0, NULL, 0);
+            status = fdb_get(db, rdoc);
+            TEST_CHK(status == FDB_RESULT_SUCCESS);
+            TEST_CMP(rdoc->body, bodybuf, rdoc->bodylen);
+            fdb_doc_free(rdoc);
+        }
+    }
+
+    status = fdb_close(dbfile);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    free(keybuf);
+
+    fdb_shutdown();
+    memleak_end();
+    TEST_RESULT("WAL arena test");
+}
+
+void wal_flush_prefetch_test()
+{
+    TEST_INIT();
+    memleak_start();
+
+    int i, j, r, pass;
+    int n = 10000, nkvs = 3;
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db[3];
+    fdb_doc *doc, *rdoc;
+    fdb_status status;
+    fdb_config fconfig;
+    fdb_kvs_config kvs_config;
+    fdb_kvs_info info;
+    char kvsname[16], keybuf[64], bodybuf[512];
+
+    for (pass = 0; pass < 2; ++pass) {
+        r = system(SHELL_DEL " dummy* > errorlog.txt");
+        (void)r;
+
+        fconfig = fdb_get_default_config();
+        fconfig.wal_threshold = 4 * n;
+        fconfig.num_wal_prefetch_threads = pass ? 4 : 0;
+        kvs_config = fdb_get_default_kvs_config();
+        memset(bodybuf, 'b', sizeof(bodybuf));
+
+        // load all KV stores and flush them into the main index
+        status = fdb_open(&dbfile, "./dummy1", &fconfig);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        for (j = 0; j < nkvs; ++j) {
+            sprintf(kvsname, "kvs%d", j);
+            status = fdb_kvs_open(dbfile, &db[j], kvsname, &kvs_config);
+            TEST_CHK(status == FDB_RESULT_SUCCESS);
+            for (i = 0; i < n; ++i) {
+                sprintf(keybuf, "key%08d", i);
+                sprintf(bodybuf, "body%d_%d_0", j, i);
+                fdb_doc_create(&doc, keybuf, strlen(keybuf), NULL, 0,
+                               bodybuf, sizeof(bodybuf));
+                status = fdb_set(db[j], doc);
+                TEST_CHK(status == FDB_RESULT_SUCCESS);
+                fdb_doc_free(doc);
+            }
+        }
+        status = fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        status = fdb_close(dbfile);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        fdb_shutdown();
+
+        // reopen with a cold cache, and then update or delete the documents
+        // spread across the file, so that the flush reads their old versions
+        status = fdb_open(&dbfile, "./dummy1", &fconfig);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        for (j = 0; j < nkvs; ++j) {
+            sprintf(kvsname, "kvs%d", j);
+            status = fdb_kvs_open(dbfile, &db[j], kvsname, &kvs_config);
+            TEST_CHK(status == FDB_RESULT_SUCCESS);
+            for (i = 0; i < n; i += 3) {
+                sprintf(keybuf, "key%08d", i);
+                if (i % 2) {
+                    fdb_doc_create(&doc, keybuf, strlen(keybuf), NULL, 0,
+                                   NULL, 0);
+                    status = fdb_del(db[j], doc);
+                } else {
+                    sprintf(bodybuf, "body%d_%d_1", j, i);
+                    fdb_doc_create(&doc, keybuf, strlen(keybuf), NULL, 0,
+                                   bodybuf, sizeof(bodybuf));
+                    status = fdb_set(db[j], doc);
+                }
+                TEST_CHK(status == FDB_RESULT_SUCCESS);
+                fdb_doc_free(doc);
+            }
+        }
+        status = fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+        for (j = 0; j < nkvs; ++j) {
+            for (i = 0; i < n; ++i) {
+                sprintf(keybuf, "key%08d", i);
+                sprintf(bodybuf, "body%d_%d_%d", j, i, (i % 3) ? 0 : 1);
+                fdb_doc_create(&rdoc, keybuf, strlen(keybuf), NULL, 0,
+                               NULL, 0);
+                status = fdb_get(db[j], rdoc);
+                if (i % 3 == 0 && i % 2) {
+                    TEST_CHK(status == FDB_RESULT_KEY_NOT_FOUND);
+                } else {
+                    TEST_CHK(status == FDB_RESULT_SUCCESS);
+                    TEST_CMP(rdoc->body, bodybuf, strlen(bodybuf) + 1);
+                }
+                fdb_doc_free(rdoc);
+            }
+            status = fdb_get_kvs_info(db[j], &info);
+            TEST_CHK(status == FDB_RESULT_SUCCESS);
+            TEST_CHK(info.doc_count == (size_t)(n - (n / 3 + 1) / 2));
+        }
+
+        status = fdb_close(dbfile);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        fdb_shutdown();
+    }
+
+    memleak_end();
+    TEST_RESULT("WAL flush prefetch test");
+}
+
+void set_multi_test()
+{
+    TEST_INIT();
+    memleak_start();
+
+    int i, r;
+    int n = 3000, batch = 1000;
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db, *kv1;
+    fdb_doc **doc = alca(fdb_doc*, n);
+    fdb_doc *rdoc;
+    fdb_status status;
+    fdb_config fconfig;
+    fdb_kvs_config kvs_config;
+    fdb_kvs_info info;
+    fdb_kvs_ops_info ops_info;
+    char keybuf[64], bodybuf[64];
+
+    r = system(SHELL_DEL " dummy* > errorlog.txt");
+    (void)r;
+
+    fconfig = fdb_get_default_config();
+    // let a batch cross the WAL flush threshold
+    fconfig.wal_threshold = 1500;
+    kvs_config = fdb_get_default_kvs_config();
+
+    status = fdb_open(&dbfile, "./dummy1", &fconfig);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_kvs_open(dbfile, &kv1, "kv1", &kvs_config);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    for (i = 0; i < n; ++i) {
+        sprintf(keybuf, "key%d", i);
+        sprintf(bodybuf, "body%d", i);
+        fdb_doc_create(&doc[i], keybuf, strlen(keybuf), NULL, 0,
+                       bodybuf, strlen(bodybuf));
+    }
+
+    // invalid arguments reject the whole batch
+    status = fdb_set_multi(NULL, doc, n);
+    TEST_CHK(status == FDB_RESULT_INVALID_HANDLE);
+    status = fdb_set_multi(db, NULL, n);
+    TEST_CHK(status == FDB_RESULT_INVALID_ARGS);
+    doc[1]->keylen = 0;
+    status = fdb_set_multi(db, doc, 2);
+    TEST_CHK(status == FDB_RESULT_INVALID_ARGS);
+    doc[1]->keylen = strlen("key1");
+    status = fdb_set_multi(db, doc, 0);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_get_kvs_info(db, &info);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    TEST_CHK(info.last_seqnum == 0);
+
+    // write the docs in batches into both the default and a sub KV store
+    for (i = 0; i < n; i += batch) {
+        status = fdb_set_multi(db, doc + i, batch);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        TEST_CHK(doc[i + batch - 1]->seqnum == (fdb_seqnum_t)(i + batch));
+        status = fdb_set_multi(kv1, doc + i, batch);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        TEST_CHK(doc[i + batch - 1]->seqnum == (fdb_seqnum_t)(i + batch));
+    }
+
+    // delete every other doc of the sub KV store in a single batch
+    for (i = 0; i < n; i += 2) {
+        doc[i]->deleted = true;
+    }
+    status = fdb_set_multi(kv1, doc, n);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_commit(dbfile, FDB_COMMIT_NORMAL);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    status = fdb_get_kvs_info(db, &info);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    TEST_CHK(info.doc_count == (size_t)n);
+    TEST_CHK(info.last_seqnum == (fdb_seqnum_t)n);
+    status = fdb_get_kvs_info(kv1, &info);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    TEST_CHK(info.doc_count == (size_t)(n / 2));
+    TEST_CHK(info.last_seqnum == (fdb_seqnum_t)(2 * n));
+
+    for (i = 0; i < n; ++i) {
+        sprintf(keybuf, "key%d", i);
+        sprintf(bodybuf, "body%d", i);
+        fdb_doc_create(&rdoc, keybuf, strlen(keybuf), NULL, 0, NULL, 0);
+        status = fdb_get(db, rdoc);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        TEST_CMP(rdoc->body, bodybuf, rdoc->bodylen);
+        TEST_CHK(rdoc->seqnum == (fdb_seqnum_t)(i + 1));
+        fdb_doc_free(rdoc);
+
+        fdb_doc_create(&rdoc, keybuf, strlen(keybuf), NULL, 0, NULL, 0);
+        status = fdb_get(kv1, rdoc);
+        if (i % 2 == 0) {
+            TEST_CHK(status == FDB_RESULT_KEY_NOT_FOUND);
+        } else {
+            TEST_CHK(status == FDB_RESULT_SUCCESS);
+            TEST_CMP(rdoc->body, bodybuf, rdoc->bodylen);
+            TEST_CHK(rdoc->seqnum == (fdb_seqnum_t)(n + i + 1));
+        }
+        fdb_doc_free(rdoc);
+    }
+
+    status = fdb_get_kvs_ops_info(kv1, &ops_info);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    TEST_CHK(ops_info.num_sets == (uint64_t)(n + n / 2));
+
+    for (i = 0; i < n; ++i) {
+        fdb_doc_free(doc[i]);
+    }
+    status = fdb_close(dbfile);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    fdb_shutdown();
+
+    memleak_end();
+    TEST_RESULT("set multi test");
+}
+
+void get_multi_test()
+{
+    TEST_INIT();
+    memleak_start();
+
+    int i, r;
+    int n = 2000, nget = 600;
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db, *kv1;
+    fdb_kvs_handle *dbs[2];
+    fdb_doc *doc;
+    fdb_doc **rdoc = alca(fdb_doc*, nget);
+    fdb_status *results = alca(fdb_status, nget);
+    fdb_status status;
+    fdb_config fconfig;
+    fdb_kvs_config kvs_config;
+    char keybuf[64], bodybuf[64], userbody[64];
+
+    r = system(SHELL_DEL " dummy* > errorlog.txt");
+    (void)r;
+
+    fconfig = fdb_get_default_config();
+    fconfig.wal_threshold = 512;
+    kvs_config = fdb_get_default_kvs_config();
+
+    status = fdb_open(&dbfile, "./dummy1", &fconfig);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_kvs_open(dbfile, &kv1, "kv1", &kvs_config);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    dbs[0] = db;
+    dbs[1] = kv1;
+
+    // most of the docs are flushed into the main index, and
+    // the last ones remain in the WAL
+    for (i = 0; i < n; ++i) {
+        sprintf(keybuf, "key%06d", i);
+        sprintf(bodybuf, "body%d", i);
+        fdb_doc_create(&doc, keybuf, strlen(keybuf), NULL, 0,
+                       bodybuf, strlen(bodybuf));
+        status = fdb_set(db, doc);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        status = fdb_set(kv1, doc);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        fdb_doc_free(doc);
+    }
+    status = fdb_commit(dbfile, FDB_COMMIT_NORMAL);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    // delete every tenth doc, partially without commit
+    for (i = 0; i < n; i += 10) {
+        sprintf(keybuf, "key%06d", i);
+        fdb_doc_create(&doc, keybuf, strlen(keybuf), NULL, 0, NULL, 0);
+        status = fdb_del(db, doc);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        status = fdb_del(kv1, doc);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        fdb_doc_free(doc);
+        if (i == n / 2) {
+            status = fdb_commit(dbfile, FDB_COMMIT_NORMAL);
+            TEST_CHK(status == FDB_RESULT_SUCCESS);
+        }
+    }
+
+    for (int k = 0; k < 2; ++k) {
+        // request keys in a scattered order, including missing ones
+        // and a key requested twice
+        for (i = 0; i < nget; ++i) {
+            int key = (i * 7919) % (n + n / 4);
+            if (i == nget - 1) {
+                key = (1 * 7919) % (n + n / 4);
+            }
+            sprintf(keybuf, "key%06d", key);
+            fdb_doc_create(&rdoc[i], keybuf, strlen(keybuf), NULL, 0, NULL, 0);
+        }
+        // a caller-provided body buffer is filled in place
+        rdoc[1]->body = userbody;
+
+        status = fdb_get_multi(dbs[k], rdoc, nget, results);
+        TEST_CHK(status == FDB_RESULT_KEY_NOT_FOUND);
+        TEST_CHK(rdoc[1]->body == userbody);
+
+        for (i = 0; i < nget; ++i) {
+            int key = (i * 7919) % (n + n / 4);
+            if (i == nget - 1) {
+                key = (1 * 7919) % (n + n / 4);
+            }
+            if (key >= n || key % 10 == 0) {
+                TEST_CHK(results[i] == FDB_RESULT_KEY_NOT_FOUND);
+            } else {
+                TEST_CHK(results[i] == FDB_RESULT_SUCCESS);
+                sprintf(bodybuf, "body%d", key);
+                TEST_CHK(rdoc[i]->bodylen == strlen(bodybuf));
+                TEST_CMP(rdoc[i]->body, bodybuf, rdoc[i]->bodylen);
+                TEST_CHK(rdoc[i]->seqnum == (fdb_seqnum_t)key + 1);
+            }
+        }
+        rdoc[1]->body = NULL;
+        for (i = 0; i < nget; ++i) {
+            fdb_doc_free(rdoc[i]);
+        }
+    }
+
+    // invalid arguments
+    status = fdb_get_multi(db, NULL, 1, NULL);
+    TEST_CHK(status == FDB_RESULT_INVALID_ARGS);
+    status = fdb_get_multi(db, rdoc, 0, NULL);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    status = fdb_close(dbfile);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    fdb_shutdown();
+
+    memleak_end();
+    TEST_RESULT("get multi test");
+}
+
+void background_wal_flush_test()
+{
+    TEST_INIT();
+    memleak_start();
+
+    int i, r;
+    int n = 3000, nmore = 6000;
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db;
+    fdb_doc *doc, *rdoc;
+    fdb_status status;
+    fdb_config fconfig;
+    fdb_kvs_config kvs_config;
+    fdb_file_info file_info;
+    char keybuf[64], bodybuf[64];
+
+    r = system(SHELL_DEL " dummy* > errorlog.txt");
+    (void)r;
+
+    fconfig = fdb_get_default_config();
+    fconfig.wal_threshold = 1024;
+    fconfig.enable_background_wal_flush = true;
+    kvs_config = fdb_get_default_kvs_config();
+
+    // the hard limit cannot be smaller than the WAL threshold
+    fconfig.wal_flush_hard_limit = 512;
+    status = fdb_open(&dbfile, "./dummy1", &fconfig);
+    TEST_CHK(status == FDB_RESULT_INVALID_CONFIG);
+
+    fconfig.wal_flush_hard_limit = 4096;
+    status = fdb_open(&dbfile, "./dummy1", &fconfig);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    // exceed the WAL threshold but stay below the hard limit,
+    // so that the writer never flushes the WAL by itself
+    for (i = 0; i < n; ++i) {
+        sprintf(keybuf, "key%06d", i);
+        sprintf(bodybuf, "body%d", i);
+        fdb_doc_create(&doc, keybuf, strlen(keybuf), NULL, 0,
+                       bodybuf, strlen(bodybuf));
+        status = fdb_set(db, doc);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        fdb_doc_free(doc);
+    }
+
+    // the WAL is flushed in background while the writer is idle
+    for (i = 0; i < 100; ++i) {
+        if (wal_get_num_flushable(dbfile->root->file) <=
+            fconfig.wal_threshold) {
+            break;
+        }
+        usleep(100000);
+    }
+    TEST_CHK(wal_get_num_flushable(dbfile->root->file) <=
+             fconfig.wal_threshold);
+
+    // writes beyond the hard limit are flushed inline if the daemon lags
+    for (i = n; i < n + nmore; ++i) {
+        sprintf(keybuf, "key%06d", i);
+        sprintf(bodybuf, "body%d", i);
+        fdb_doc_create(&doc, keybuf, strlen(keybuf), NULL, 0,
+                       bodybuf, strlen(bodybuf));
+        status = fdb_set(db, doc);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        fdb_doc_free(doc);
+    }
+    status = fdb_commit(dbfile, FDB_COMMIT_NORMAL);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    for (i = 0; i < n + nmore; ++i) {
+        sprintf(keybuf, "key%06d", i);
+        sprintf(bodybuf, "body%d", i);
+        fdb_doc_create(&rdoc, keybuf, strlen(keybuf), NULL, 0, NULL, 0);
+        status = fdb_get(db, rdoc);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        TEST_CMP(rdoc->body, bodybuf, rdoc->bodylen);
+        fdb_doc_free(rdoc);
+    }
+    status = fdb_close(dbfile);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    // every doc is still there after reopening the file
+    status = fdb_open(&dbfile, "./dummy1", &fconfig);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    fdb_get_file_info(dbfile, &file_info);
+    TEST_CHK(file_info.doc_count == (uint64_t)(n + nmore));
+    status = fdb_close(dbfile);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    fdb_shutdown();
+
+    memleak_end();
+    TEST_RESULT("background WAL flush test");
+}
+
+void background_wal_flush_chunk_test()
+{
+    TEST_INIT();
+    memleak_start();
+
+    int i, r;
+    int n = 200000;
+    int num_partial_flushes = 0;
+    size_t prev, cur;
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db;
+    fdb_doc *doc;
+    fdb_status status;
+    fdb_config fconfig;
+    fdb_kvs_config kvs_config;
+    char keybuf[64], bodybuf[64];
+
+    r = system(SHELL_DEL " dummy* > errorlog.txt");
+    (void)r;
+
+    fconfig = fdb_get_default_config();
+    fconfig.wal_threshold = 4 * FDB_WALFLUSHER_CHUNK_SIZE;
+    fconfig.wal_flush_hard_limit = n * 2;
+    fconfig.enable_background_wal_flush = true;
+    kvs_config = fdb_get_default_kvs_config();
+
+    status = fdb_open(&dbfile, "./dummy1", &fconfig);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    // The daemon flushes the WAL while the writer keeps appending to it.
+    // If the writer sees the WAL shrink but some chunks of the flush are
+    // still left, it has made progress in the middle of the flush.
+    prev = wal_get_num_flushable(dbfile->root->file);
+    for (i = 0; i < n && num_partial_flushes < 3; ++i) {
+        sprintf(keybuf, "key%08d", i);
+        sprintf(bodybuf, "body%d", i);
+        fdb_doc_create(&doc, keybuf, strlen(keybuf), NULL, 0,
+                       bodybuf, strlen(bodybuf));
+        status = fdb_set(db, doc);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        fdb_doc_free(doc);
+
+        cur = wal_get_num_flushable(dbfile->root->file);
+        if (cur <= prev && cur >= FDB_WALFLUSHER_CHUNK_SIZE) {
+            num_partial_flushes++;
+        }
+        prev = cur;
+    }
+    TEST_CHK(num_partial_flushes == 3);
+
+    status = fdb_commit(dbfile, FDB_COMMIT_NORMAL);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_close(dbfile);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    // the daemon's handle is closed together with the last user handle
+    status = fdb_destroy("./dummy1", &fconfig);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    fdb_shutdown();
+
+    memleak_end();
+    TEST_RESULT("background WAL flush chunk test");
+}
+
+void background_wal_flush_commit_test()
+{
+    TEST_INIT();
+    memleak_start();
+
+    int i, r;
+    int n = 3000, nmore;
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db;
+    fdb_doc *doc, *rdoc;
+    fdb_status status;
+    fdb_config fconfig;
+    fdb_kvs_config kvs_config;
+    fdb_file_info file_info;
+    char keybuf[64], bodybuf[64];
+
+    r = system(SHELL_DEL " dummy* > errorlog.txt");
+    (void)r;
+
+    fconfig = fdb_get_default_config();
+    fconfig.wal_threshold = 1024;
+    fconfig.wal_flush_hard_limit = 8192;
+    fconfig.enable_background_wal_flush = true;
+    kvs_config = fdb_get_default_kvs_config();
+
+    status = fdb_open(&dbfile, "./dummy1", &fconfig);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    for (i = 0; i < n; ++i) {
+        sprintf(keybuf, "key%06d", i);
+        sprintf(bodybuf, "body%d", i);
+        fdb_doc_create(&doc, keybuf, strlen(keybuf), NULL, 0,
+                       bodybuf, strlen(bodybuf));
+        status = fdb_set(db, doc);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        fdb_doc_free(doc);
+    }
+    // wait for the background flush
+    for (i = 0; i < 100; ++i) {
+        if (wal_get_num_flushable(dbfile->root->file) <=
+            fconfig.wal_threshold) {
+            break;
+        }
+        usleep(100000);
+    }
+    TEST_CHK(wal_get_num_flushable(dbfile->root->file) <=
+             fconfig.wal_threshold);
+    TEST_CHK(wal_get_dirty_status(dbfile->root->file) != FDB_WAL_PENDING);
+
+    // the commit after the background flush does not flush the WAL,
+    // as it is not over the threshold
+    for (i = n; wal_get_size(dbfile->root->file) < fconfig.wal_threshold;
+         ++i) {
+        sprintf(keybuf, "key%06d", i);
+        sprintf(bodybuf, "body%d", i);
+        fdb_doc_create(&doc, keybuf, strlen(keybuf), NULL, 0,
+                       bodybuf, strlen(bodybuf));
+        status = fdb_set(db, doc);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        fdb_doc_free(doc);
+    }
+    nmore = i - n;
+    status = fdb_commit(dbfile, FDB_COMMIT_NORMAL);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    TEST_CHK(wal_get_num_flushable(dbfile->root->file) ==
+             fconfig.wal_threshold);
+    status = fdb_close(dbfile);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    // the docs flushed in background are restored into the WAL again,
+    // and flushing them once more does not count them twice
+    status = fdb_open(&dbfile, "./dummy1", &fconfig);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    TEST_CHK(wal_get_size(dbfile->root->file) == 0);
+    fdb_get_file_info(dbfile, &file_info);
+    TEST_CHK(file_info.doc_count == (uint64_t)(n + nmore));
+    for (i = 0; i < n + nmore; ++i) {
+        sprintf(keybuf, "key%06d", i);
+        sprintf(bodybuf, "body%d", i);
+        fdb_doc_create(&rdoc, keybuf, strlen(keybuf), NULL, 0, NULL, 0);
+        status = fdb_get(db, rdoc);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        TEST_CMP(rdoc->body, bodybuf, rdoc->bodylen);
+        fdb_doc_free(rdoc);
+    }
+    status = fdb_close(dbfile);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    fdb_shutdown();
+
+    memleak_end();
+    TEST_RESULT("background WAL flush commit test");
+}
+
+struct async_commit_ctx {
+    int num_callbacks;
+    int num_out_of_order;
+    int num_failures;
+    fdb_file_handle *fhandle;
+};
+
+struct async_commit_arg {
+    struct async_commit_ctx *ctx;
+    int idx;
+};
+
+static void _async_commit_cb(fdb_file_handle *fhandle, fdb_status status,
+                             void *ctx)
+{
+    struct async_commit_arg *arg = (struct async_commit_arg *)ctx;
+    // callbacks are invoked one by one, in the order of the commits
+    if (arg->idx != arg->ctx->num_callbacks) {
+        arg->ctx->num_out_of_order++;
+    }
+    if (status != FDB_RESULT_SUCCESS || fhandle != arg->ctx->fhandle) {
+        arg->ctx->num_failures++;
+    }
+    arg->ctx->num_callbacks++;
+}
+
+void async_commit_test()
+{
+    TEST_INIT();
+    memleak_start();
+
+    int i, j, r;
+    int ncommits = 20, n = 100;
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db;
+    fdb_doc *doc, *rdoc;
+    fdb_status status;
+    fdb_config fconfig;
+    fdb_kvs_config kvs_config;
+    struct async_commit_ctx ctx;
+    struct async_commit_arg *args = alca(struct async_commit_arg, ncommits);
+    char keybuf[64], bodybuf[64];
+
+    r = system(SHELL_DEL " dummy* > errorlog.txt");
+    (void)r;
+
+    fconfig = fdb_get_default_config();
+    fconfig.wal_threshold = 1024;
+    kvs_config = fdb_get_default_kvs_config();
+
+    status = fdb_open(&dbfile, "./dummy1", &fconfig);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.fhandle = dbfile;
+    for (i = 0; i < ncommits; ++i) {
+        for (j = 0; j < n; ++j) {
+            sprintf(keybuf, "key%06d", i * n + j);
+            sprintf(bodybuf, "body%d", i * n + j);
+            fdb_doc_create(&doc, keybuf, strlen(keybuf), NULL, 0,
+                           bodybuf, strlen(bodybuf));
+            status = fdb_set(db, doc);
+            TEST_CHK(status == FDB_RESULT_SUCCESS);
+            fdb_doc_free(doc);
+        }
+        args[i].ctx = &ctx;
+        args[i].idx = i;
+        // a commit flushing the WAL is synced in place, but its callback
+        // is still invoked after the earlier ones
+        status = fdb_commit_async(dbfile,
+                                  (i == ncommits / 2) ?
+                                  FDB_COMMIT_MANUAL_WAL_FLUSH :
+                                  FDB_COMMIT_NORMAL,
+                                  _async_commit_cb, &args[i]);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+    }
+
+    // invalid arguments
+    status = fdb_commit_async(dbfile, FDB_COMMIT_NORMAL, NULL, NULL);
+    TEST_CHK(status == FDB_RESULT_INVALID_ARGS);
+    status = fdb_commit_async(NULL, FDB_COMMIT_NORMAL, _async_commit_cb, NULL);
+    TEST_CHK(status == FDB_RESULT_INVALID_HANDLE);
+
+    // closing the file waits for all the callbacks
+    status = fdb_close(dbfile);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    TEST_CHK(ctx.num_callbacks == ncommits);
+    TEST_CHK(ctx.num_out_of_order == 0);
+    TEST_CHK(ctx.num_failures == 0);
+
+    // every committed doc is durable
+    status = fdb_open(&dbfile, "./dummy1", &fconfig);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    for (i = 0; i < ncommits * n; ++i) {
+        sprintf(keybuf, "key%06d", i);
+        sprintf(bodybuf, "body%d", i);
+        fdb_doc_create(&rdoc, keybuf, strlen(keybuf), NULL, 0, NULL, 0);
+        status = fdb_get(db, rdoc);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        TEST_CMP(rdoc->body, bodybuf, rdoc->bodylen);
+        fdb_doc_free(rdoc);
+    }
+    status = fdb_close(dbfile);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    fdb_shutdown();
+
+    memleak_end();
+    TEST_RESULT("async commit test");
+}
+
+struct slow_commit_ctx {
+    std::atomic<int> num_callbacks;
+    fdb_status close_status;
+};
+
+static void _slow_commit_cb(fdb_file_handle *fhandle, fdb_status status,
+                            void *ctx)
+{
+    struct slow_commit_ctx *slow = (struct slow_commit_ctx *)ctx;
+    // a file handle cannot be closed from its own callback
+    slow->close_status = fdb_close(fhandle);
+    sleep(2);
+    slow->num_callbacks++;
+}
+
+void async_commit_multi_handle_test()
+{
+    TEST_INIT();
+    memleak_start();
+
+    int i, r;
+    fdb_file_handle *dbfile, *dbfile_slow;
+    fdb_kvs_handle *db, *db_slow;
+    fdb_status status;
+    fdb_config fconfig;
+    fdb_kvs_config kvs_config;
+    struct async_commit_ctx ctx;
+    struct async_commit_arg args[4];
+    struct slow_commit_ctx slow;
+    char keybuf[64];
+
+    r = system(SHELL_DEL " dummy* > errorlog.txt");
+    (void)r;
+
+    fconfig = fdb_get_default_config();
+    kvs_config = fdb_get_default_kvs_config();
+
+    status = fdb_open(&dbfile_slow, "./dummy1", &fconfig);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_kvs_open_default(dbfile_slow, &db_slow, &kvs_config);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_open(&dbfile, "./dummy2", &fconfig);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    // the commit with a slow callback is queued first
+    slow.num_callbacks = 0;
+    slow.close_status = FDB_RESULT_SUCCESS;
+    status = fdb_set_kv(db_slow, (void*)"key", 3, (void*)"body", 4);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_commit_async(dbfile_slow, FDB_COMMIT_NORMAL,
+                              _slow_commit_cb, &slow);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.fhandle = dbfile;
+    for (i = 0; i < 4; ++i) {
+        sprintf(keybuf, "key%d", i);
+        status = fdb_set_kv(db, keybuf, strlen(keybuf), (void*)"body", 4);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        args[i].ctx = &ctx;
+        args[i].idx = i;
+        status = fdb_commit_async(dbfile, FDB_COMMIT_NORMAL,
+                                  _async_commit_cb, &args[i]);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+    }
+
+    // the commits of the other file are not held up by the slow callback
+    status = fdb_close(dbfile);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    TEST_CHK(ctx.num_callbacks == 4);
+    TEST_CHK(ctx.num_out_of_order == 0);
+    TEST_CHK(ctx.num_failures == 0);
+    TEST_CHK(slow.num_callbacks == 0);
+
+    status = fdb_close(dbfile_slow);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    TEST_CHK(slow.num_callbacks == 1);
+    TEST_CHK(slow.close_status == FDB_RESULT_HANDLE_BUSY);
+    fdb_shutdown();
+
+    memleak_end();
+    TEST_RESULT("async commit multi handle test");
+}
+
 void set_get_meta_test()
 {
     TEST_INIT();
@@ -1664,6 +2821,24 @@ void operational_stats_test(bool multi_kv)
         fprintf(stderr, "%d:\t%u\t%u\t%u\t%" _F64 "\n", i,
                 stat.lat_max, stat.lat_avg, stat.lat_max, stat.lat_count);
     }
+    // .. and their percentiles, including the internal phases
+    for (int i = 0; i < FDB_LATENCY_NUM_ALL_STATS; ++i) {
+        fdb_latency_stat stat;
+        fdb_latency_histogram hist;
+        memset(&stat, 0, sizeof(fdb_latency_stat));
+        status = fdb_get_latency_stats(dbfile, &stat, i);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        status = fdb_get_latency_histogram(dbfile, &hist, i);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        TEST_CHK(hist.lat_count == stat.lat_count);
+        if (hist.lat_count) {
+            TEST_CHK(hist.lat_min <= hist.lat_p50);
+        }
+        TEST_CHK(hist.lat_p50 <= hist.lat_p90);
+        TEST_CHK(hist.lat_p90 <= hist.lat_p99);
+        TEST_CHK(hist.lat_p99 <= hist.lat_p999);
+        TEST_CHK(hist.lat_p999 <= hist.lat_max);
+    }
 
     fdb_close(dbfile);
 
@@ -5420,6 +6595,435 @@ void bottom_up_build_test()
     TEST_RESULT("bottom-up build test");
 }
 
+static int _cmp_binary_keys(void *key1, size_t keylen1,
+                            void *key2, size_t keylen2,
+                            void *user_param)
+{
+    int cmp = memcmp(key1, key2, MIN(keylen1, keylen2));
+    if (cmp) {
+        return cmp;
+    }
+    return (int)keylen1 - (int)keylen2;
+}
+
+void btree_prefix_compression_test()
+{
+    TEST_INIT();
+    memleak_start();
+
+    int i, j, r, n = 20000;
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db;
+    fdb_iterator *it;
+    fdb_doc *doc, *rdoc;
+    fdb_status status;
+    fdb_config fconfig;
+    fdb_kvs_config kvs_config;
+    fdb_file_info info;
+    uint64_t file_size[2];
+    char keybuf[64], bodybuf[64], fname[16];
+    char *kvs_names[1] = {NULL};
+    fdb_custom_cmp_variable functions[1] = {_cmp_binary_keys};
+
+    r = system(SHELL_DEL " dummy* > errorlog.txt");
+    (void)r;
+
+    fconfig = fdb_get_default_config();
+    fconfig.wal_threshold = 1024;
+    fconfig.compaction_threshold = 0;
+    kvs_config = fdb_get_default_kvs_config();
+    kvs_config.custom_cmp = _cmp_binary_keys;
+
+    // the same docs without and with prefix compression
+    for (j = 0; j < 2; ++j) {
+        fconfig.btree_prefix_compression = (j == 1);
+        sprintf(fname, "./dummy%d", j + 1);
+        status = fdb_open(&dbfile, fname, &fconfig);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        status = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        for (i = 0; i < n; ++i) {
+            sprintf(keybuf, "com.example.users/profile/%08d", (i * 7919) % n);
+            sprintf(bodybuf, "body%d", (i * 7919) % n);
+            fdb_doc_create(&doc, keybuf, strlen(keybuf), NULL, 0,
+                           bodybuf, strlen(bodybuf));
+            status = fdb_set(db, doc);
+            TEST_CHK(status == FDB_RESULT_SUCCESS);
+            fdb_doc_free(doc);
+        }
+        status = fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        // compare the files without stale blocks
+        sprintf(fname, "./dummy%d", j + 3);
+        status = fdb_compact(dbfile, fname);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        status = fdb_get_file_info(dbfile, &info);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        file_size[j] = info.file_size;
+        status = fdb_close(dbfile);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+    }
+    // the index of the compressed file is smaller
+    TEST_CHK(file_size[1] < file_size[0]);
+
+    // the compressed file is still readable and writable without the option
+    fconfig.btree_prefix_compression = false;
+    status = fdb_open_custom_cmp(&dbfile, "./dummy4", &fconfig,
+                                 1, kvs_names, functions, NULL);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    for (i = 0; i < n; i += 2) {
+        sprintf(keybuf, "com.example.users/profile/%08d", i);
+        status = fdb_del_kv(db, keybuf, strlen(keybuf));
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        sprintf(keybuf, "org.example/%d", i);
+        status = fdb_set_kv(db, keybuf, strlen(keybuf), keybuf, strlen(keybuf));
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+    }
+    status = fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    for (i = 0; i < n; ++i) {
+        sprintf(keybuf, "com.example.users/profile/%08d", i);
+        fdb_doc_create(&rdoc, keybuf, strlen(keybuf), NULL, 0, NULL, 0);
+        status = fdb_get(db, rdoc);
+        if (i % 2) {
+            sprintf(bodybuf, "body%d", i);
+            TEST_CHK(status == FDB_RESULT_SUCCESS);
+            TEST_CMP(rdoc->body, bodybuf, rdoc->bodylen);
+        } else {
+            TEST_CHK(status == FDB_RESULT_KEY_NOT_FOUND);
+        }
+        fdb_doc_free(rdoc);
+    }
+
+    // all the keys are iterated in order
+    status = fdb_iterator_init(db, &it, NULL, 0, NULL, 0, FDB_ITR_NONE);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    i = 0;
+    keybuf[0] = 0;
+    do {
+        rdoc = NULL;
+        status = fdb_iterator_get(it, &rdoc);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        TEST_CHK(i == 0 || _cmp_binary_keys(keybuf, strlen(keybuf),
+                                            rdoc->key, rdoc->keylen,
+                                            NULL) < 0);
+        memcpy(keybuf, rdoc->key, rdoc->keylen);
+        keybuf[rdoc->keylen] = 0;
+        fdb_doc_free(rdoc);
+        i++;
+    } while (fdb_iterator_next(it) == FDB_RESULT_SUCCESS);
+    TEST_CHK(i == n);
+    fdb_iterator_close(it);
+
+    status = fdb_close(dbfile);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    fdb_shutdown();
+
+    memleak_end();
+    TEST_RESULT("btree prefix compression test");
+}
+
+void key_fingerprint_test()
+{
+    TEST_INIT();
+    memleak_start();
+
+    int i, j, r, n = 10000;
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db[2];
+    fdb_iterator *it;
+    fdb_doc *rdoc;
+    fdb_status status;
+    fdb_config fconfig;
+    fdb_kvs_config kvs_config;
+    fdb_kvs_info kvs_info;
+    char keybuf[64], bodybuf[64];
+
+    r = system(SHELL_DEL " dummy* > errorlog.txt");
+    (void)r;
+
+    fconfig = fdb_get_default_config();
+    fconfig.wal_threshold = 1024;
+    fconfig.compaction_threshold = 0;
+    fconfig.key_fingerprint = true;
+    kvs_config = fdb_get_default_kvs_config();
+
+    status = fdb_open(&dbfile, "./dummy1", &fconfig);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_kvs_open_default(dbfile, &db[0], &kvs_config);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_kvs_open(dbfile, &db[1], "kv1", &kvs_config);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    for (j = 0; j < 2; ++j) {
+        for (i = 0; i < n; ++i) {
+            sprintf(keybuf, "user%08d/profile", i);
+            sprintf(bodybuf, "body%d_%d", j, i);
+            status = fdb_set_kv(db[j], keybuf, strlen(keybuf),
+                                bodybuf, strlen(bodybuf));
+            TEST_CHK(status == FDB_RESULT_SUCCESS);
+        }
+    }
+    status = fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    // update and remove some of the indexed docs
+    for (j = 0; j < 2; ++j) {
+        for (i = 0; i < n; i += 3) {
+            sprintf(keybuf, "user%08d/profile", i);
+            sprintf(bodybuf, "new_body%d_%d", j, i);
+            status = fdb_set_kv(db[j], keybuf, strlen(keybuf),
+                                bodybuf, strlen(bodybuf));
+            TEST_CHK(status == FDB_RESULT_SUCCESS);
+        }
+        for (i = 1; i < n; i += 5) {
+            sprintf(keybuf, "user%08d/profile", i);
+            status = fdb_del_kv(db[j], keybuf, strlen(keybuf));
+            TEST_CHK(status == FDB_RESULT_SUCCESS);
+        }
+    }
+    status = fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_compact(dbfile, "./dummy2");
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_close(dbfile);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    // the docs are found without the option as well
+    fconfig.key_fingerprint = false;
+    status = fdb_open(&dbfile, "./dummy2", &fconfig);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_kvs_open_default(dbfile, &db[0], &kvs_config);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_kvs_open(dbfile, &db[1], "kv1", &kvs_config);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    for (j = 0; j < 2; ++j) {
+        for (i = 0; i < n; ++i) {
+            sprintf(keybuf, "user%08d/profile", i);
+            fdb_doc_create(&rdoc, keybuf, strlen(keybuf), NULL, 0, NULL, 0);
+            status = fdb_get(db[j], rdoc);
+            if (i % 5 == 1) {
+                TEST_CHK(status == FDB_RESULT_KEY_NOT_FOUND);
+            } else {
+                if (i % 3 == 0) {
+                    sprintf(bodybuf, "new_body%d_%d", j, i);
+                } else {
+                    sprintf(bodybuf, "body%d_%d", j, i);
+                }
+                TEST_CHK(status == FDB_RESULT_SUCCESS);
+                TEST_CMP(rdoc->body, bodybuf, rdoc->bodylen);
+            }
+            fdb_doc_free(rdoc);
+
+            // keys that share the prefix of an indexed key
+            sprintf(keybuf, "user%08d/settings", i);
+            fdb_doc_create(&rdoc, keybuf, strlen(keybuf), NULL, 0, NULL, 0);
+            status = fdb_get(db[j], rdoc);
+            TEST_CHK(status == FDB_RESULT_KEY_NOT_FOUND);
+            fdb_doc_free(rdoc);
+        }
+
+        status = fdb_get_kvs_info(db[j], &kvs_info);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        TEST_CHK(kvs_info.doc_count == (size_t)(n - n / 5));
+
+        status = fdb_iterator_init(db[j], &it, NULL, 0, NULL, 0,
+                                   FDB_ITR_NO_DELETES);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        i = 0;
+        do {
+            rdoc = NULL;
+            status = fdb_iterator_get(it, &rdoc);
+            TEST_CHK(status == FDB_RESULT_SUCCESS);
+            fdb_doc_free(rdoc);
+            i++;
+        } while (fdb_iterator_next(it) == FDB_RESULT_SUCCESS);
+        TEST_CHK(i == n - n / 5);
+        fdb_iterator_close(it);
+    }
+
+    status = fdb_close(dbfile);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    fdb_shutdown();
+
+    memleak_end();
+    TEST_RESULT("key fingerprint test");
+}
+
+void index_cache_test()
+{
+    TEST_INIT();
+    memleak_start();
+
+    int i, j, r, n = 5000;
+    fdb_file_handle *dbfile[2];
+    fdb_kvs_handle *db[2], *snap;
+    fdb_doc *rdoc;
+    fdb_status status;
+    fdb_config fconfig;
+    fdb_kvs_config kvs_config;
+    fdb_kvs_info kvs_info;
+    fdb_seqnum_t seqnum;
+    char keybuf[64], bodybuf[64];
+
+    r = system(SHELL_DEL " dummy* > errorlog.txt");
+    (void)r;
+
+    fconfig = fdb_get_default_config();
+    fconfig.wal_threshold = 1024;
+    fconfig.compaction_threshold = 0;
+    fconfig.index_cache_size = 256 * 1024;
+    kvs_config = fdb_get_default_kvs_config();
+
+    // two handles on the same file
+    for (j = 0; j < 2; ++j) {
+        status = fdb_open(&dbfile[j], "./dummy1", &fconfig);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        status = fdb_kvs_open(dbfile[j], &db[j], "kv1", &kvs_config);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+    }
+
+    for (i = 0; i < n; ++i) {
+        sprintf(keybuf, "key%06d", i);
+        sprintf(bodybuf, "body%d", i);
+        status = fdb_set_kv(db[0], keybuf, strlen(keybuf),
+                            bodybuf, strlen(bodybuf));
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+    }
+    status = fdb_commit(dbfile[0], FDB_COMMIT_MANUAL_WAL_FLUSH);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    status = fdb_get_kvs_seqnum(db[0], &seqnum);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    // read the hot keys repeatedly through both handles
+    for (r = 0; r < 3; ++r) {
+        for (j = 0; j < 2; ++j) {
+            for (i = 0; i < n; i += 10) {
+                sprintf(keybuf, "key%06d", i);
+                sprintf(bodybuf, "body%d", i);
+                fdb_doc_create(&rdoc, keybuf, strlen(keybuf), NULL, 0, NULL, 0);
+                status = fdb_get(db[j], rdoc);
+                TEST_CHK(status == FDB_RESULT_SUCCESS);
+                TEST_CMP(rdoc->body, bodybuf, rdoc->bodylen);
+                fdb_doc_free(rdoc);
+            }
+        }
+    }
+
+    // update and remove the hot keys through the first handle
+    for (i = 0; i < n; i += 10) {
+        sprintf(keybuf, "key%06d", i);
+        if (i % 20) {
+            sprintf(bodybuf, "new_body%d", i);
+            status = fdb_set_kv(db[0], keybuf, strlen(keybuf),
+                                bodybuf, strlen(bodybuf));
+        } else {
+            status = fdb_del_kv(db[0], keybuf, strlen(keybuf));
+        }
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+    }
+    status = fdb_commit(dbfile[0], FDB_COMMIT_MANUAL_WAL_FLUSH);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    // both handles see the changes
+    for (j = 0; j < 2; ++j) {
+        for (i = 0; i < n; i += 10) {
+            sprintf(keybuf, "key%06d", i);
+            fdb_doc_create(&rdoc, keybuf, strlen(keybuf), NULL, 0, NULL, 0);
+            status = fdb_get(db[j], rdoc);
+            if (i % 20) {
+                sprintf(bodybuf, "new_body%d", i);
+                TEST_CHK(status == FDB_RESULT_SUCCESS);
+                TEST_CMP(rdoc->body, bodybuf, rdoc->bodylen);
+            } else {
+                TEST_CHK(status == FDB_RESULT_KEY_NOT_FOUND);
+            }
+            fdb_doc_free(rdoc);
+        }
+    }
+
+    // fdb_get_multi() looks up the same cache as fdb_get()
+    {
+        fdb_doc *docs[10];
+        fdb_status results[10];
+        uint64_t num_hits = db[1]->keycache->num_hits;
+
+        for (i = 0; i < 10; ++i) {
+            sprintf(keybuf, "key%06d", i * 10);
+            fdb_doc_create(&docs[i], keybuf, strlen(keybuf), NULL, 0, NULL, 0);
+        }
+        status = fdb_get_multi(db[1], docs, 10, results);
+        TEST_CHK(status == FDB_RESULT_KEY_NOT_FOUND);
+        for (i = 0; i < 10; ++i) {
+            if (i % 2) {
+                sprintf(bodybuf, "new_body%d", i * 10);
+                TEST_CHK(results[i] == FDB_RESULT_SUCCESS);
+                TEST_CMP(docs[i]->body, bodybuf, docs[i]->bodylen);
+            } else {
+                TEST_CHK(results[i] == FDB_RESULT_KEY_NOT_FOUND);
+            }
+            fdb_doc_free(docs[i]);
+        }
+        TEST_CHK(db[1]->keycache->num_hits > num_hits);
+    }
+
+    // a snapshot keeps the old docs, and so does its cache
+    status = fdb_snapshot_open(db[1], &snap, seqnum);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    for (r = 0; r < 2; ++r) {
+        for (i = 0; i < n; i += 10) {
+            sprintf(keybuf, "key%06d", i);
+            sprintf(bodybuf, "body%d", i);
+            fdb_doc_create(&rdoc, keybuf, strlen(keybuf), NULL, 0, NULL, 0);
+            status = fdb_get(snap, rdoc);
+            TEST_CHK(status == FDB_RESULT_SUCCESS);
+            TEST_CMP(rdoc->body, bodybuf, rdoc->bodylen);
+            fdb_doc_free(rdoc);
+        }
+    }
+    status = fdb_kvs_close(snap);
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+
+    // the docs move to a new file by compaction
+    status = fdb_compact(dbfile[0], "./dummy2");
+    TEST_CHK(status == FDB_RESULT_SUCCESS);
+    for (j = 0; j < 2; ++j) {
+        for (i = 0; i < n; ++i) {
+            sprintf(keybuf, "key%06d", i);
+            fdb_doc_create(&rdoc, keybuf, strlen(keybuf), NULL, 0, NULL, 0);
+            status = fdb_get(db[j], rdoc);
+            if (i % 20 == 0) {
+                TEST_CHK(status == FDB_RESULT_KEY_NOT_FOUND);
+            } else {
+                if (i % 10 == 0) {
+                    sprintf(bodybuf, "new_body%d", i);
+                } else {
+                    sprintf(bodybuf, "body%d", i);
+                }
+                TEST_CHK(status == FDB_RESULT_SUCCESS);
+                TEST_CMP(rdoc->body, bodybuf, rdoc->bodylen);
+            }
+            fdb_doc_free(rdoc);
+        }
+        status = fdb_get_kvs_info(db[j], &kvs_info);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+        TEST_CHK(kvs_info.doc_count == (size_t)(n - n / 20));
+    }
+
+    for (j = 0; j < 2; ++j) {
+        status = fdb_close(dbfile[j]);
+        TEST_CHK(status == FDB_RESULT_SUCCESS);
+    }
+    fdb_shutdown();
+
+    memleak_end();
+    TEST_RESULT("index cache test");
+}
+
 int main(){
     basic_test();
     init_test();
@@ -5475,6 +7079,21 @@ int main(){
     kvs_deletion_without_commit();
     purge_logically_deleted_doc_test();
     large_batch_write_no_commit_test();
+    io_uring_engine_test();
+    direct_io_test();
+    group_commit_test();
+    wal_arena_test();
+    wal_flush_prefetch_test();
+    set_multi_test();
+    get_multi_test();
+    background_wal_flush_test();
+    background_wal_flush_chunk_test();
+    background_wal_flush_commit_test();
+    async_commit_test();
+    async_commit_multi_handle_test();
+    btree_prefix_compression_test();
+    key_fingerprint_test();
+    index_cache_test();
     multi_thread_test(40*1024, 1024, 20, 1, 100, 2, 6);
     apis_with_invalid_handles_test();
     get_nearest_test();
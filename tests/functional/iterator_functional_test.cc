@@ -4260,6 +4260,115 @@ void iterator_seek_to_min_key_with_deletes_test() {
 
     TEST_RESULT("iterator seek to min test");
 }
+void iterator_readahead_test()
+{
+    TEST_INIT();
+    memleak_start();
+
+    int i, r, pass;
+    int n = 4000;
+    char keybuf[256], bodybuf[512];
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db;
+    fdb_doc *rdoc = NULL;
+    fdb_status s;
+    fdb_iterator *it;
+    fdb_buffer_cache_stats before, after;
+    uint64_t num_misses[2][2];
+
+    r = system(SHELL_DEL" iterator_test* > errorlog.txt");
+    (void)r;
+
+    fdb_config fconfig = fdb_get_default_config();
+    fdb_kvs_config kvs_config = fdb_get_default_kvs_config();
+    fconfig.buffercache_size = 16 * 1024 * 1024;
+    fconfig.seqtree_opt = FDB_SEQTREE_USE;
+    fconfig.wal_threshold = 1024;
+    fconfig.compaction_mode = FDB_COMPACTION_MANUAL;
+
+    s = fdb_open(&dbfile, "./iterator_test1", &fconfig);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+    s = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+    memset(bodybuf, 'x', sizeof(bodybuf));
+    for (i = 0; i < n; ++i) {
+        sprintf(keybuf, "key%06d", i);
+        sprintf(bodybuf, "body%06d", i);
+        s = fdb_set_kv(db, keybuf, strlen(keybuf), bodybuf, sizeof(bodybuf));
+        TEST_CHK(s == FDB_RESULT_SUCCESS);
+    }
+    s = fdb_commit(dbfile, FDB_COMMIT_MANUAL_WAL_FLUSH);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+    fdb_close(dbfile);
+    fdb_shutdown();
+
+    // scan the cold file forward and backward,
+    // without (pass 0) and with (pass 1) adaptive read-ahead.
+    for (pass = 0; pass < 2; ++pass) {
+        fconfig.adaptive_readahead_max_blocks = pass ? 64 : 0;
+        s = fdb_open(&dbfile, "./iterator_test1", &fconfig);
+        TEST_CHK(s == FDB_RESULT_SUCCESS);
+        s = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+        TEST_CHK(s == FDB_RESULT_SUCCESS);
+
+        fdb_get_buffer_cache_stats(&before);
+        s = fdb_iterator_sequence_init(db, &it, 0, 0, FDB_ITR_NONE);
+        TEST_CHK(s == FDB_RESULT_SUCCESS);
+        i = 0;
+        do {
+            s = fdb_iterator_get(it, &rdoc);
+            TEST_CHK(s == FDB_RESULT_SUCCESS);
+            sprintf(keybuf, "key%06d", i);
+            sprintf(bodybuf, "body%06d", i);
+            TEST_CMP(rdoc->key, keybuf, rdoc->keylen);
+            TEST_CMP(rdoc->body, bodybuf, strlen(bodybuf));
+            fdb_doc_free(rdoc);
+            rdoc = NULL;
+            ++i;
+        } while (fdb_iterator_next(it) == FDB_RESULT_SUCCESS);
+        TEST_CHK(i == n);
+        fdb_iterator_close(it);
+        fdb_get_buffer_cache_stats(&after);
+        num_misses[pass][0] = after.num_misses - before.num_misses;
+        fdb_close(dbfile);
+        fdb_shutdown();
+
+        s = fdb_open(&dbfile, "./iterator_test1", &fconfig);
+        TEST_CHK(s == FDB_RESULT_SUCCESS);
+        s = fdb_kvs_open_default(dbfile, &db, &kvs_config);
+        TEST_CHK(s == FDB_RESULT_SUCCESS);
+
+        fdb_get_buffer_cache_stats(&before);
+        s = fdb_iterator_sequence_init(db, &it, 0, 0, FDB_ITR_NONE);
+        TEST_CHK(s == FDB_RESULT_SUCCESS);
+        s = fdb_iterator_seek_to_max(it);
+        TEST_CHK(s == FDB_RESULT_SUCCESS);
+        i = n;
+        do {
+            --i;
+            s = fdb_iterator_get(it, &rdoc);
+            TEST_CHK(s == FDB_RESULT_SUCCESS);
+            sprintf(keybuf, "key%06d", i);
+            TEST_CMP(rdoc->key, keybuf, rdoc->keylen);
+            fdb_doc_free(rdoc);
+            rdoc = NULL;
+        } while (fdb_iterator_prev(it) == FDB_RESULT_SUCCESS);
+        TEST_CHK(i == 0);
+        fdb_iterator_close(it);
+        fdb_get_buffer_cache_stats(&after);
+        num_misses[pass][1] = after.num_misses - before.num_misses;
+        fdb_close(dbfile);
+        fdb_shutdown();
+    }
+
+    // most document blocks should have been read ahead.
+    TEST_CHK(num_misses[1][0] * 4 < num_misses[0][0]);
+    TEST_CHK(num_misses[1][1] * 4 < num_misses[0][1]);
+
+    memleak_end();
+    TEST_RESULT("iterator read-ahead test");
+}
+
 int main(){
     iterator_test();
     iterator_with_concurrent_updates_test();
@@ -4295,5 +4404,6 @@ int main(){
     iterator_init_using_substring_test();
     iterator_seek_to_max_key_with_deletes_test();
     iterator_seek_to_min_key_with_deletes_test();
+    iterator_readahead_test();
     return 0;
 }
@@ -2510,6 +2510,125 @@ void multi_kv_close_test()
     TEST_RESULT("multi KV close");
 }
 
+struct parallel_writer_args {
+    int id;
+    int n;
+    fdb_config *fconfig;
+};
+
+void *_parallel_writer_thread(void *voidargs)
+{
+    TEST_INIT();
+    struct parallel_writer_args *args = (struct parallel_writer_args *)voidargs;
+    int i;
+    char keybuf[64], bodybuf[64], kvname[16];
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db;
+    fdb_doc *doc;
+    fdb_status s;
+    fdb_kvs_config kvs_config = fdb_get_default_kvs_config();
+
+    s = fdb_open(&dbfile, "multi_kv_test", args->fconfig);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+    sprintf(kvname, "kv%d", args->id);
+    s = fdb_kvs_open(dbfile, &db, kvname, &kvs_config);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+
+    for (i=0;i<args->n;++i){
+        sprintf(keybuf, "key%d", i);
+        sprintf(bodybuf, "body%d_%d", args->id, i);
+        fdb_doc_create(&doc, (void*)keybuf, strlen(keybuf)+1,
+                       NULL, 0, (void*)bodybuf, strlen(bodybuf)+1);
+        s = fdb_set(db, doc);
+        TEST_CHK(s == FDB_RESULT_SUCCESS);
+        // sequence numbers of a KV store stay dense under parallel writers
+        TEST_CHK(doc->seqnum == (fdb_seqnum_t)i+1);
+        fdb_doc_free(doc);
+    }
+
+    s = fdb_close(dbfile);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+    thread_exit(0);
+    return NULL;
+}
+
+void multi_kv_parallel_writer_test()
+{
+    TEST_INIT();
+    memleak_start();
+
+    int i, j, r;
+    int n = 5000;
+    int nthreads = 4;
+    char keybuf[64], bodybuf[64], kvname[16];
+    thread_t *tid = alca(thread_t, nthreads);
+    struct parallel_writer_args *args =
+        alca(struct parallel_writer_args, nthreads);
+    fdb_file_handle *dbfile;
+    fdb_kvs_handle *db;
+    fdb_kvs_info info;
+    fdb_doc *rdoc;
+    fdb_status s;
+    fdb_config fconfig;
+    fdb_kvs_config kvs_config;
+
+    // remove previous multi_kv_test files
+    r = system(SHELL_DEL" multi_kv_test* > errorlog.txt");
+    (void)r;
+
+    fconfig = fdb_get_default_config();
+    kvs_config = fdb_get_default_kvs_config();
+    fconfig.wal_threshold = 1024;
+    fconfig.buffercache_size = 0;
+
+    s = fdb_open(&dbfile, "multi_kv_test", &fconfig);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+
+    // writers of different KV stores append and flush the WAL in parallel
+    for (i=0;i<nthreads;++i){
+        args[i].id = i;
+        args[i].n = n;
+        args[i].fconfig = &fconfig;
+        thread_create(&tid[i], _parallel_writer_thread, &args[i]);
+    }
+    for (i=0;i<nthreads;++i){
+        void *thread_ret;
+        thread_join(tid[i], &thread_ret);
+    }
+    s = fdb_commit(dbfile, FDB_COMMIT_NORMAL);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+
+    for (i=0;i<nthreads;++i){
+        sprintf(kvname, "kv%d", i);
+        s = fdb_kvs_open(dbfile, &db, kvname, &kvs_config);
+        TEST_CHK(s == FDB_RESULT_SUCCESS);
+        s = fdb_get_kvs_info(db, &info);
+        TEST_CHK(s == FDB_RESULT_SUCCESS);
+        TEST_CHK(info.doc_count == (size_t)n);
+        TEST_CHK(info.last_seqnum == (fdb_seqnum_t)n);
+        for (j=0;j<n;++j){
+            sprintf(keybuf, "key%d", j);
+            sprintf(bodybuf, "body%d_%d", i, j);
+            fdb_doc_create(&rdoc, keybuf, strlen(keybuf)+1, NULL, 0, NULL, 0);
+            s = fdb_get(db, rdoc);
+            TEST_CHK(s == FDB_RESULT_SUCCESS);
+            TEST_CMP(rdoc->body, bodybuf, rdoc->bodylen);
+            TEST_CHK(rdoc->seqnum == (fdb_seqnum_t)j+1);
+            fdb_doc_free(rdoc);
+        }
+        s = fdb_kvs_close(db);
+        TEST_CHK(s == FDB_RESULT_SUCCESS);
+    }
+
+    s = fdb_close(dbfile);
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+    s = fdb_shutdown();
+    TEST_CHK(s == FDB_RESULT_SUCCESS);
+
+    memleak_end();
+    TEST_RESULT("multi KV parallel writers test");
+}
+
 int main(){
     int i, j;
     uint8_t opt;
@@ -2539,6 +2658,7 @@ int main(){
     multi_kv_fdb_open_custom_cmp_test();
     multi_kv_use_existing_mode_test();
     multi_kv_close_test();
+    multi_kv_parallel_writer_test();
 
     return 0;
 }
@@ -118,6 +118,275 @@ void basic_test2()
 
 }
 
+void pin_test()
+{
+    TEST_INIT();
+
+    struct filemgr *file;
+    struct filemgr_config config;
+    struct bcache_item *pinned, *pinned2;
+    int i, r;
+    uint8_t buf[4096];
+    uint8_t *addr, *addr2;
+    char *fname = (char *) "./bcache_testfile";
+    r = system(SHELL_DEL " bcache_testfile");
+    (void)r;
+
+    memset(&config, 0, sizeof(config));
+    config.blocksize = 4096;
+    config.ncacheblock = 5;
+    config.flag = 0x0;
+    config.options = FILEMGR_CREATE;
+    config.num_wal_shards = 8;
+    filemgr_open_result result = filemgr_open(fname, get_filemgr_ops(), &config, NULL);
+    file = result.file;
+
+    for (i=0;i<10;++i) {
+        memset(buf, i, 4096);
+        filemgr_alloc(file, NULL);
+        filemgr_write(file, i, buf, NULL);
+    }
+    filemgr_commit(file, true, NULL);
+    bcache_remove_clean_blocks(file);
+
+    // not cached .. pin should fail
+    addr = (uint8_t *)filemgr_read_pinned(file, 0, &pinned);
+    TEST_CHK(addr == NULL && pinned == NULL);
+
+    TEST_CHK(filemgr_read(file, 0, buf, NULL, true) == FDB_RESULT_SUCCESS);
+    addr = (uint8_t *)filemgr_read_pinned(file, 0, &pinned);
+    TEST_CHK(addr != NULL && pinned != NULL);
+    TEST_CHK(addr[0] == 0 && addr[100] == 0);
+
+    // other blocks cycle through the cache but the pinned one survives
+    for (i=1;i<10;++i) {
+        TEST_CHK(filemgr_read(file, i, buf, NULL, true) == FDB_RESULT_SUCCESS);
+        TEST_CHK(buf[0] == i);
+    }
+    addr2 = (uint8_t *)filemgr_read_pinned(file, 0, &pinned2);
+    TEST_CHK(addr2 == addr && pinned2 == pinned);
+    TEST_CHK(addr[0] == 0 && addr[100] == 0);
+    filemgr_unpin(pinned2);
+    filemgr_unpin(pinned);
+
+    // an invalidated block is no longer found even if it is pinned,
+    // and it is freed when the last pin is released
+    addr = (uint8_t *)filemgr_read_pinned(file, 0, &pinned);
+    TEST_CHK(addr != NULL && pinned != NULL);
+    uint64_t nfree = bcache_get_num_free_blocks();
+    TEST_CHK(bcache_invalidate_block(file, 0));
+    addr2 = (uint8_t *)filemgr_read_pinned(file, 0, &pinned2);
+    TEST_CHK(addr2 == NULL && pinned2 == NULL);
+    TEST_CHK(addr[0] == 0 && addr[100] == 0);
+    TEST_CHK(bcache_get_num_free_blocks() == nfree);
+    filemgr_unpin(pinned);
+    TEST_CHK(bcache_get_num_free_blocks() == nfree + 1);
+
+    // same for the clean blocks dropped when the file is closed
+    addr = (uint8_t *)filemgr_read_pinned(file, 9, &pinned);
+    TEST_CHK(addr != NULL && pinned != NULL);
+    bcache_remove_clean_blocks(file);
+    nfree = bcache_get_num_free_blocks();
+    addr2 = (uint8_t *)filemgr_read_pinned(file, 9, &pinned2);
+    TEST_CHK(addr2 == NULL && pinned2 == NULL);
+    TEST_CHK(addr[0] == 9 && addr[100] == 9);
+    filemgr_unpin(pinned);
+    TEST_CHK(bcache_get_num_free_blocks() == nfree + 1);
+
+    filemgr_close(file, true, NULL, NULL);
+    filemgr_shutdown();
+
+    TEST_RESULT("pin test");
+}
+
+void policy_test(fdb_bcache_policy_t policy)
+{
+    TEST_INIT();
+
+    struct filemgr *file;
+    struct filemgr_config config;
+    fdb_buffer_cache_stats stats;
+    int i, j, r;
+    uint8_t buf[4096];
+    char *fname = (char *) "./bcache_testfile";
+    r = system(SHELL_DEL " bcache_testfile");
+    (void)r;
+
+    memset(&config, 0, sizeof(config));
+    config.blocksize = 4096;
+    config.ncacheblock = 5;
+    config.flag = 0x0;
+    config.options = FILEMGR_CREATE;
+    config.num_wal_shards = 8;
+    config.bcache_policy = policy;
+    filemgr_open_result result = filemgr_open(fname, get_filemgr_ops(), &config, NULL);
+    file = result.file;
+
+    for (i=0;i<20;++i) {
+        memset(buf, i, 4096);
+        filemgr_alloc(file, NULL);
+        filemgr_write(file, i, buf, NULL);
+    }
+    filemgr_commit(file, true, NULL);
+
+    // scan all blocks a few times, while block 0 is repeatedly accessed
+    for (j=0;j<3;++j) {
+        for (i=0;i<20;++i) {
+            TEST_CHK(filemgr_read(file, i, buf, NULL, true) == FDB_RESULT_SUCCESS);
+            TEST_CHK(buf[0] == i && buf[4095] == i);
+            TEST_CHK(filemgr_read(file, 0, buf, NULL, true) == FDB_RESULT_SUCCESS);
+            TEST_CHK(buf[0] == 0 && buf[4095] == 0);
+        }
+    }
+
+    filemgr_get_bcache_stats(&stats);
+    TEST_CHK(stats.num_hits > 0);
+    TEST_CHK(stats.num_misses > 0);
+    TEST_CHK(stats.num_evictions > 0);
+    TEST_CHK(stats.num_hits + stats.num_misses <= 20 * 3 * 2);
+
+    filemgr_close(file, true, NULL, NULL);
+    filemgr_shutdown();
+
+    TEST_RESULT(policy == FDB_BCACHE_POLICY_2Q ?
+                "2Q policy test" : "LRU policy test");
+}
+
+void index_test()
+{
+    TEST_INIT();
+
+    struct filemgr *file;
+    struct filemgr_config config;
+    int i, r;
+    uint8_t buf[4096];
+    char *fname = (char *) "./bcache_testfile";
+    r = system(SHELL_DEL " bcache_testfile");
+    (void)r;
+
+    memset(&config, 0, sizeof(config));
+    config.blocksize = 4096;
+    config.ncacheblock = 2048;
+    config.flag = 0x0;
+    config.options = FILEMGR_CREATE;
+    config.num_wal_shards = 8;
+    filemgr_open_result result = filemgr_open(fname, get_filemgr_ops(), &config, NULL);
+    file = result.file;
+
+    // enough blocks to grow the index of each shard several times
+    for (i=0;i<2048;++i) {
+        memset(buf, i & 0xff, 4096);
+        filemgr_alloc(file, NULL);
+        filemgr_write(file, i, buf, NULL);
+    }
+    filemgr_commit(file, true, NULL);
+
+    for (i=0;i<2048;++i) {
+        TEST_CHK(bcache_read(file, i, buf) == 4096);
+        TEST_CHK(buf[0] == (i & 0xff) && buf[4095] == (i & 0xff));
+    }
+
+    // remove every other block, and check that the rest are still found
+    for (i=0;i<2048;i+=2) {
+        TEST_CHK(bcache_invalidate_block(file, i));
+    }
+    for (i=0;i<2048;++i) {
+        if (i % 2) {
+            TEST_CHK(bcache_read(file, i, buf) == 4096);
+            TEST_CHK(buf[0] == (i & 0xff));
+        } else {
+            TEST_CHK(bcache_read(file, i, buf) == 0);
+        }
+    }
+
+    filemgr_close(file, true, NULL, NULL);
+    filemgr_shutdown();
+
+    TEST_RESULT("index test");
+}
+
+struct arena_worker_args {
+    struct filemgr *file;
+    bid_t start;
+    size_t nblocks;
+};
+
+void * arena_worker(void *voidargs)
+{
+    struct arena_worker_args *args = (struct arena_worker_args *)voidargs;
+    uint8_t buf[4096];
+    size_t i, j;
+    TEST_INIT();
+
+    for (j=0;j<10;++j) {
+        for (i=0;i<args->nblocks;++i) {
+            memset(buf, (args->start + i) & 0xff, 4096);
+            TEST_CHK(bcache_write(args->file, args->start + i, buf,
+                                  BCACHE_REQ_CLEAN, false, false) == 4096);
+        }
+        for (i=0;i<args->nblocks;++i) {
+            TEST_CHK(bcache_read(args->file, args->start + i, buf) == 4096);
+            TEST_CHK(buf[0] == ((args->start + i) & 0xff));
+            TEST_CHK(bcache_invalidate_block(args->file, args->start + i));
+        }
+    }
+    thread_exit(0);
+    return NULL;
+}
+
+void arena_test()
+{
+    TEST_INIT();
+
+    struct filemgr *file;
+    struct filemgr_config config;
+    int i, r, n = 4;
+    uint8_t buf[4096];
+    char *fname = (char *) "./bcache_testfile";
+    thread_t tid[4];
+    struct arena_worker_args args[4];
+    void *ret;
+    r = system(SHELL_DEL " bcache_testfile");
+    (void)r;
+
+    // large enough to enable the per-CPU free block caches
+    memset(&config, 0, sizeof(config));
+    config.blocksize = 4096;
+    config.ncacheblock = 65536;
+    config.flag = 0x0;
+    config.options = FILEMGR_CREATE;
+    config.num_wal_shards = 8;
+    filemgr_open_result result = filemgr_open(fname, get_filemgr_ops(), &config, NULL);
+    file = result.file;
+
+    for (i=0;i<4096;++i) {
+        memset(buf, i & 0xff, 4096);
+        filemgr_alloc(file, NULL);
+        filemgr_write(file, i, buf, NULL);
+    }
+    filemgr_commit(file, true, NULL);
+    TEST_CHK(bcache_get_num_free_blocks() <= 65536 - 4096);
+
+    // allocate and release blocks concurrently
+    for (i=0;i<n;++i) {
+        args[i].file = file;
+        args[i].start = i * 1024;
+        args[i].nblocks = 1024;
+        thread_create(&tid[i], arena_worker, &args[i]);
+    }
+    for (i=0;i<n;++i) {
+        thread_join(tid[i], &ret);
+    }
+
+    bcache_remove_clean_blocks(file);
+    TEST_CHK(bcache_get_num_free_blocks() == 65536);
+
+    filemgr_close(file, true, NULL, NULL);
+    filemgr_shutdown();
+
+    TEST_RESULT("arena test");
+}
+
 struct worker_args{
     size_t n;
     struct filemgr *file;
@@ -256,6 +525,11 @@ void multi_thread_test(
 int main()
 {
     basic_test2();
+    pin_test();
+    policy_test(FDB_BCACHE_POLICY_LRU);
+    policy_test(FDB_BCACHE_POLICY_2Q);
+    index_test();
+    arena_test();
 #if !defined(THREAD_SANITIZER)
     /**
      * The following tests will be disabled when the code is run with
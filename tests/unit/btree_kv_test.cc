@@ -874,6 +874,91 @@ void kv_bid_to_value_to_bid_test(btree_kv_ops *kv_ops)
 }
 
 
+/*
+ * Test: kv_find_entry_test
+ *
+ * verifies the in-place node search for 8-byte keys against the
+ * search through the compare function, with node sizes around
+ * the SIMD window and keys having their most significant bit set
+ *
+ */
+void kv_find_entry_test(int i)
+{
+    TEST_INIT();
+    memleak_start();
+
+    bnoderef node;
+    btree_kv_ops *kv_ops;
+    idx_t (*find_entry)(struct bnode *node, void *key);
+    int nentries[] = {0, 1, 2, 3, 5, 15, 16, 17, 31, 64, 255};
+    int j, n, q;
+    idx_t idx, expected;
+    uint64_t v, value = 0;
+    uint8_t key[8], query[8];
+
+    if (i == 0) {
+        kv_ops = btree_kv_get_kb64_vb64(NULL);
+        find_entry = btree_kv_find_entry_kb64;
+        TEST_CHK(kv_ops->layout == BTREE_KV_LAYOUT_KB64_VB64);
+    } else {
+        kv_ops = btree_kv_get_ku64_vu64();
+        find_entry = btree_kv_find_entry_ku64;
+    }
+
+    node = dummy_node(8, 8, 1);
+    srand(0);
+    for (j = 0; j < (int)(sizeof(nentries) / sizeof(int)); ++j) {
+        n = nentries[j];
+        node->nentry = n;
+
+        // sorted keys spread over the whole 64-bit range
+        v = 0x100;
+        for (idx = 0; idx < n; ++idx) {
+            v += ((uint64_t)(rand() & 0x7f) << 49) + rand() + 1;
+            if (i == 0) {
+                for (q = 0; q < 8; ++q) {
+                    key[q] = (v >> (56 - q * 8)) & 0xff;
+                }
+            } else {
+                memcpy(key, &v, 8);
+            }
+            kv_ops->set_kv(node, idx, key, &value);
+        }
+
+        for (q = 0; q < 1000; ++q) {
+            if (q % 3 == 0 && n > 0) {
+                // existing key, or a key next to it
+                kv_ops->get_kv(node, rand() % n, query, NULL);
+                query[(i == 0) ? 7 : 0] += (q % 2) ? 1 : -1;
+            } else {
+                for (int b = 0; b < 8; ++b) {
+                    query[b] = rand() & 0xff;
+                }
+                if (q % 5 == 0) {
+                    memset(query, (q % 2) ? 0xff : 0x00, 8);
+                }
+            }
+
+            expected = BTREE_IDX_NOT_FOUND;
+            for (idx = 0; idx < n; ++idx) {
+                kv_ops->get_kv(node, idx, key, NULL);
+                if (kv_ops->cmp(key, query, NULL) > 0) {
+                    break;
+                }
+                expected = idx;
+            }
+            TEST_CHK(find_entry(node, query) == expected);
+        }
+    }
+
+    free(node);
+    if (i == 0) {
+        free(kv_ops);
+    }
+    memleak_end();
+    TEST_RESULT("kv_find_entry_test");
+}
+
 int main()
 {
     int i;
@@ -915,6 +1000,7 @@ int main()
 
         kv_cmp_key_str_test(ops[i], i);
         kv_bid_to_value_to_bid_test(ops[i]);
+        kv_find_entry_test(i);
     }
 
     return 0;
@@ -872,6 +872,216 @@ void btree_initial_load_test(uint64_t num_entries)
     TEST_RESULT("btree init and load test");
 }
 
+void batch_insert_test()
+{
+    TEST_INIT();
+
+    int ksize = 8;
+    int vsize = 8;
+    int nodesize = 256;
+    int blocksize = 4096;
+    struct filemgr *file;
+    struct btreeblk_handle btree_handle;
+    struct btree btree;
+    struct btree_iterator bi;
+    struct filemgr_config config;
+    btree_result br;
+    int i, r, round, n = 4000, nbatch;
+    uint64_t k, v;
+    uint64_t *keys = (uint64_t *)malloc(sizeof(uint64_t) * n * 2);
+    uint64_t *values = (uint64_t *)malloc(sizeof(uint64_t) * n * 2);
+    void **kptrs = (void **)malloc(sizeof(void *) * n * 2);
+    void **vptrs = (void **)malloc(sizeof(void *) * n * 2);
+    char *fname = (char *) "./btreeblock_testfile";
+
+    r = system(SHELL_DEL" btreeblock_testfile");
+    (void)r;
+    memset(&config, 0, sizeof(config));
+    config.blocksize = blocksize;
+    config.ncacheblock = 0;
+    config.options = FILEMGR_CREATE;
+    config.num_wal_shards = 8;
+    filemgr_open_result result = filemgr_open(fname, get_filemgr_ops(),
+                                              &config, NULL);
+    file = result.file;
+    btreeblk_init(&btree_handle, file, nodesize);
+    btree_init(&btree, (void*)&btree_handle, btreeblk_get_ops(),
+               btree_kv_get_ku64_vu64(), nodesize, ksize, vsize, 0x0, NULL);
+
+    // even keys from 100
+    for (i=0;i<n;++i) {
+        k = 100 + i*2; v = k;
+        btree_insert(&btree, (void*)&k, (void*)&v);
+        btreeblk_end(&btree_handle);
+    }
+    btreeblk_end(&btree_handle);
+    filemgr_commit(file, true, NULL);
+
+    for (round=0; round<2; ++round) {
+        // a new smallest key, odd keys in between, updates of existing keys,
+        // and appends after the largest key, all in ascending order
+        nbatch = 0;
+        keys[nbatch++] = 1 + round;
+        for (i=0;i<n;++i) {
+            if (i % 3 == round) {
+                keys[nbatch++] = 100 + i*2;
+            }
+            if (i % 2 == 0) {
+                keys[nbatch++] = 100 + i*2 + 1;
+            }
+        }
+        for (i=0;i<n/4;++i) {
+            keys[nbatch++] = 100 + n*2 + round*n + i;
+        }
+        for (i=0;i<nbatch;++i) {
+            values[i] = keys[i] * 10 + round;
+            kptrs[i] = &keys[i];
+            vptrs[i] = &values[i];
+        }
+        // the first round updates nodes that are already committed
+        br = btree_insert_batch(&btree, kptrs, vptrs, nbatch);
+        TEST_CHK(br == BTREE_RESULT_SUCCESS);
+        btreeblk_end(&btree_handle);
+
+        for (i=0;i<nbatch;++i) {
+            br = btree_find(&btree, kptrs[i], (void*)&v);
+            TEST_CHK(br == BTREE_RESULT_SUCCESS);
+            TEST_CHK(v == values[i]);
+        }
+    }
+    filemgr_commit(file, true, NULL);
+
+    // every key appears once and in order
+    k = 0;
+    i = 0;
+    btree_iterator_init(&btree, &bi, NULL);
+    while (btree_next(&bi, (void*)&keys[0], (void*)&v) == BTREE_RESULT_SUCCESS) {
+        TEST_CHK(i == 0 || keys[0] > k);
+        k = keys[0];
+        ++i;
+    }
+    btree_iterator_free(&bi);
+    // n evens, n/2 odds, 2 smallest keys, and n/2 appends
+    TEST_CHK(i == n + n/2 + 2 + n/2);
+
+    btreeblk_end(&btree_handle);
+    btreeblk_free(&btree_handle);
+    filemgr_close(file, true, NULL, NULL);
+    filemgr_shutdown();
+    free(keys);
+    free(values);
+    free(kptrs);
+    free(vptrs);
+
+    TEST_RESULT("batch insert test");
+}
+
+// Compare the B+tree routines specialized for the layout set in KV_OPS with
+// the ones that call the functions of KV_OPS, by running the same operations
+// on two trees that only differ in kv_ops->layout.
+void kv_layout_test(struct btree_kv_ops *kv_ops, int ksize)
+{
+    TEST_INIT();
+
+    int vsize = 8;
+    int nodesize = 4096;
+    int i, j, r, n = 5000;
+    struct filemgr *file;
+    struct btreeblk_handle bhandle;
+    struct btree btree[2];
+    struct btree_iterator bi[2];
+    struct btree_kv_ops kv_ops_any;
+    struct filemgr_config config;
+    btree_result br[2];
+    uint64_t v[2];
+    uint8_t k[2][8];
+    uint8_t *keys = (uint8_t *)malloc(n * ksize);
+    char *fname = (char *) "./btreeblock_testfile";
+
+    r = system(SHELL_DEL" btreeblock_testfile");
+    (void)r;
+
+    // the same ops, except that every access goes through the functions
+    kv_ops_any = *kv_ops;
+    kv_ops_any.layout = BTREE_KV_LAYOUT_ANY;
+
+    // random keys, which include some duplicates when they are 4 bytes long
+    for (i=0;i<n*ksize;++i) {
+        keys[i] = rand() & 0xff;
+    }
+    if (ksize == 4) {
+        for (i=0;i<n;i+=97) {
+            memcpy(keys + i*ksize, keys, ksize);
+        }
+    }
+
+    memset(&config, 0, sizeof(config));
+    config.blocksize = nodesize;
+    config.ncacheblock = 0;
+    config.options = FILEMGR_CREATE;
+    config.num_wal_shards = 8;
+    filemgr_open_result result = filemgr_open(fname, get_filemgr_ops(),
+                                              &config, NULL);
+    file = result.file;
+    btreeblk_init(&bhandle, file, nodesize);
+    btree_init(&btree[0], (void*)&bhandle, btreeblk_get_ops(), kv_ops,
+               nodesize, ksize, vsize, 0x0, NULL);
+    btree_init(&btree[1], (void*)&bhandle, btreeblk_get_ops(), &kv_ops_any,
+               nodesize, ksize, vsize, 0x0, NULL);
+
+    for (j=0;j<2;++j) {
+        for (i=0;i<n;++i) {
+            v[0] = i;
+            btree_insert(&btree[j], keys + i*ksize, (void*)&v[0]);
+            btreeblk_end(&bhandle);
+        }
+        // remove every tenth key
+        for (i=0;i<n;i+=10) {
+            btree_remove(&btree[j], keys + i*ksize);
+            btreeblk_end(&bhandle);
+        }
+    }
+
+    // both trees find the same values
+    for (i=0;i<n;++i) {
+        for (j=0;j<2;++j) {
+            v[j] = 0;
+            br[j] = btree_find(&btree[j], keys + i*ksize, (void*)&v[j]);
+            btreeblk_end(&bhandle);
+        }
+        TEST_CHK(br[0] == br[1]);
+        TEST_CHK(v[0] == v[1]);
+        TEST_CHK(br[0] == (i % 10 ? BTREE_RESULT_SUCCESS : BTREE_RESULT_FAIL) ||
+                 ksize == 4);
+    }
+
+    // and keep the same keys in the same order
+    for (j=0;j<2;++j) {
+        btree_iterator_init(&btree[j], &bi[j], NULL);
+    }
+    do {
+        for (j=0;j<2;++j) {
+            br[j] = btree_next(&bi[j], k[j], (void*)&v[j]);
+        }
+        TEST_CHK(br[0] == br[1]);
+        if (br[0] == BTREE_RESULT_SUCCESS) {
+            TEST_CHK(!memcmp(k[0], k[1], ksize));
+            TEST_CHK(v[0] == v[1]);
+        }
+    } while (br[0] == BTREE_RESULT_SUCCESS);
+    for (j=0;j<2;++j) {
+        btree_iterator_free(&bi[j]);
+    }
+    btreeblk_end(&bhandle);
+
+    btreeblk_free(&bhandle);
+    filemgr_close(file, true, NULL, NULL);
+    filemgr_shutdown();
+    free(keys);
+
+    TEST_RESULT("kv layout test");
+}
+
 int main()
 {
 #ifdef _MEMPOOL
@@ -884,8 +1094,20 @@ int main()
     range_test();
     subblock_test();
     btree_reverse_iterator_test();
+    batch_insert_test();
     btree_initial_load_test(10);
     btree_initial_load_test(100000);
 
+    struct btree_kv_ops *kv_ops, kv_ops_ku64;
+    kv_ops = btree_kv_get_kb64_vb64(NULL);
+    kv_layout_test(kv_ops, 8);
+    free(kv_ops);
+    kv_ops = btree_kv_get_kb32_vb64(NULL);
+    kv_layout_test(kv_ops, 4);
+    free(kv_ops);
+    kv_ops_ku64 = *btree_kv_get_ku64_vu64();
+    kv_ops_ku64.layout = BTREE_KV_LAYOUT_KU64_VB64;
+    kv_layout_test(&kv_ops_ku64, 8);
+
     return 0;
 }
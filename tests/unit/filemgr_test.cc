@@ -18,6 +18,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <fcntl.h>
 
 #include "filemgr.h"
 #include "filemgr_ops.h"
@@ -71,6 +72,96 @@ void mt_init_test()
     TEST_RESULT("multi threaded initialization test");
 }
 
+void io_uring_test()
+{
+    TEST_INIT();
+
+    struct filemgr_ops *ops = get_io_uring_filemgr_ops();
+    if (!ops) {
+        TEST_RESULT("io_uring test (not supported, skipped)");
+        return;
+    }
+
+    // more requests than the ring size, with gaps between some of them.
+    const size_t num = 300;
+    const size_t blocksize = 4096;
+    struct filemgr_io_req reqs[num];
+    uint8_t *wbuf = (uint8_t *) malloc(num * blocksize);
+    uint8_t *rbuf = (uint8_t *) malloc(num * blocksize);
+    size_t i;
+
+    int fd = ops->open("./filemgr_testfile", O_CREAT | O_RDWR, 0666);
+    TEST_CHK(fd >= 0);
+    for (i = 0; i < num; ++i) {
+        memset(wbuf + i * blocksize, i & 0xff, blocksize);
+        reqs[i].buf = wbuf + i * blocksize;
+        reqs[i].count = blocksize;
+        reqs[i].offset = (i + i / 10) * blocksize;
+    }
+    TEST_CHK(ops->pwrite_batch(fd, reqs, num, true) == FDB_RESULT_SUCCESS);
+    for (i = 0; i < num; ++i) {
+        TEST_CHK(reqs[i].result == (ssize_t) blocksize);
+        reqs[i].buf = rbuf + i * blocksize;
+    }
+    TEST_CHK(ops->pread_batch(fd, reqs, num) == FDB_RESULT_SUCCESS);
+    TEST_CMP(rbuf, wbuf, num * blocksize);
+
+    // single requests and syncs through the ring.
+    TEST_CHK(ops->pwrite(fd, wbuf, blocksize, 0) == (ssize_t) blocksize);
+    TEST_CHK(ops->pread(fd, rbuf, blocksize, 0) == (ssize_t) blocksize);
+    TEST_CMP(rbuf, wbuf, blocksize);
+    TEST_CHK(ops->fdatasync(fd) == FDB_RESULT_SUCCESS);
+    TEST_CHK(ops->fsync(fd) == FDB_RESULT_SUCCESS);
+    ops->close(fd);
+    free(wbuf);
+    free(rbuf);
+
+    // batched buffer cache flush and commit through the ring.
+    struct filemgr *file;
+    struct filemgr_config config;
+    const char *dbheader = "dbheader";
+    uint8_t block[4096];
+    bid_t bids[64];
+
+    int r = system(SHELL_DEL" filemgr_testfile");
+    (void)r;
+    memset(&config, 0, sizeof(config));
+    config.blocksize = blocksize;
+    config.ncacheblock = 1024;
+    config.options = FILEMGR_CREATE;
+    config.num_wal_shards = 8;
+
+    filemgr_open_result result = filemgr_open((char *) "./filemgr_testfile",
+                                              ops, &config, NULL);
+    file = result.file;
+    TEST_CHK(file);
+    for (i = 0; i < 64; ++i) {
+        memset(block, i, blocksize);
+        block[blocksize - 1] = BLK_MARKER_DOC;
+        bids[i] = filemgr_alloc(file, NULL);
+        TEST_CHK(filemgr_write(file, bids[i], block, NULL) ==
+                 FDB_RESULT_SUCCESS);
+    }
+    filemgr_update_header(file, (void*)dbheader, strlen(dbheader) + 1, true);
+    TEST_CHK(filemgr_commit(file, true, NULL) == FDB_RESULT_SUCCESS);
+    filemgr_close(file, true, NULL, NULL);
+
+    // read back through the POSIX ops.
+    result = filemgr_open((char *) "./filemgr_testfile", get_filemgr_ops(),
+                          &config, NULL);
+    file = result.file;
+    TEST_CMP(file->header.data, dbheader, strlen(dbheader) + 1);
+    for (i = 0; i < 64; ++i) {
+        TEST_CHK(filemgr_read(file, bids[i], block, NULL, true) ==
+                 FDB_RESULT_SUCCESS);
+        TEST_CHK(block[0] == (uint8_t) i);
+        TEST_CHK(block[blocksize - 1] == BLK_MARKER_DOC);
+    }
+    filemgr_close(file, true, NULL, NULL);
+
+    TEST_RESULT("io_uring test");
+}
+
 int main()
 {
     int r = system(SHELL_DEL" filemgr_testfile");
@@ -79,6 +170,7 @@ int main()
     basic_test(FDB_ENCRYPTION_NONE);
     basic_test(FDB_ENCRYPTION_BOGUS);
     mt_init_test();
+    io_uring_test();
 
     return 0;
 }
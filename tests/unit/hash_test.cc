@@ -172,10 +172,51 @@ void twohash_test()
     TEST_RESULT("two-integer hash test");
 }
 
+void words_hash_test()
+{
+    TEST_INIT();
+
+    int n = 11, nkeys = 110000;
+    int i, len, min, max;
+    int *array = alca(int, n);
+    char str[64];
+    uint32_t a, b;
+
+    // keys sharing a long common prefix should still spread evenly
+    for (i=0;i<n;++i) array[i] = 0;
+    for (i=0;i<nkeys;++i) {
+        len = sprintf(str, "user_profile_key_%08d", i);
+        array[hash_words((uint8_t *)str, len) % n]++;
+    }
+    min = max = array[0];
+    for (i=1;i<n;++i) {
+        min = MIN(min, array[i]);
+        max = MAX(max, array[i]);
+    }
+    DBG("min %d max %d\n", min, max);
+    TEST_CHK(min > (nkeys / n) * 9 / 10);
+    TEST_CHK(max < (nkeys / n) * 11 / 10);
+
+    // the tail bytes that do not fill a word are also hashed
+    sprintf(str, "0123456789a");
+    a = hash_words((uint8_t *)str, strlen(str));
+    sprintf(str, "0123456789b");
+    b = hash_words((uint8_t *)str, strlen(str));
+    TEST_CHK(a != b);
+    // so is the length
+    memset(str, 0, sizeof(str));
+    a = hash_words((uint8_t *)str, 3);
+    b = hash_words((uint8_t *)str, 4);
+    TEST_CHK(a != b);
+
+    TEST_RESULT("word-at-a-time hash test");
+}
+
 int main()
 {
     //basic_test();
     string_hash_test();
+    words_hash_test();
     //twohash_test();
 
     return 0;
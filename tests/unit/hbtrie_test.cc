@@ -23,6 +23,7 @@
 #include "libforestdb/forestdb.h"
 #include "test.h"
 #include "btreeblock.h"
+#include "btree_fast_str_kv.h"
 #include "docio.h"
 #include "filemgr.h"
 #include "filemgr_ops.h"
@@ -1498,6 +1499,442 @@ void initial_load_test_incremental_prefix()
     TEST_RESULT("initial load with tailing null test");
 }
 
+static void _prefix_test_key(char *buf, int i)
+{
+    if (i % 100 == 99) {
+        // keys without the common prefix of the others
+        sprintf(buf, "k%d", i);
+    } else {
+        sprintf(buf, "com.example.users/profile/%08d", i);
+    }
+}
+
+// Run the same operations on two B+trees of variable-length keys, one of
+// which stores its nodes in the prefix-compressed format.
+void prefix_compression_test()
+{
+    TEST_INIT();
+
+    int blocksize = 4096;
+    struct btreeblk_handle bhandle;
+    struct filemgr *file;
+    struct filemgr_config config;
+    struct btree btree[2];
+    struct btree_iterator bi[2];
+    struct btree_kv_ops *kv_ops[2];
+    btree_result br[2];
+    uint64_t pos, nbytes[2], v, v_out[2];
+    void *key, *k_out[2];
+    char keybuf[64], strbuf[2][64];
+    size_t len[2];
+    int i, j, rr, n = 3000, count;
+
+    memleak_start();
+
+    rr = system(SHELL_DEL " hbtrie_testfile");
+    (void)rr;
+
+    memset(&config, 0, sizeof(config));
+    config.blocksize = blocksize;
+    config.ncacheblock = 0;
+    config.options = FILEMGR_CREATE;
+    config.num_wal_shards = 8;
+    filemgr_open_result result = filemgr_open((char*)"./hbtrie_testfile",
+                                              get_filemgr_ops(), &config, NULL);
+    file = result.file;
+    btreeblk_init(&bhandle, file, blocksize);
+
+    kv_ops[0] = btree_fast_str_kv_get_kb64_vb64(NULL);
+    kv_ops[1] = btree_fast_str_kv_get_kb64_vb64(NULL);
+    btree_fast_str_kv_set_prefix_compression(kv_ops[1], true);
+
+    for (j=0;j<2;++j) {
+        pos = filemgr_get_pos(file);
+        btree_init(&btree[j], (void*)&bhandle, btreeblk_get_ops(), kv_ops[j],
+                   blocksize, sizeof(void *), sizeof(uint64_t), 0x0, NULL);
+        // insert in random order, and then update and remove some of the keys
+        for (i=0;i<n;++i) {
+            int idx = (int)(((uint64_t)i * 1103) % n);
+            _prefix_test_key(keybuf, idx);
+            btree_fast_str_kv_set_key(&key, keybuf, strlen(keybuf));
+            v = idx;
+            btree_insert(&btree[j], &key, &v);
+            btree_fast_str_kv_free_key(&key);
+            btreeblk_end(&bhandle);
+        }
+        for (i=0;i<n;i+=3) {
+            _prefix_test_key(keybuf, i);
+            btree_fast_str_kv_set_key(&key, keybuf, strlen(keybuf));
+            v = i + n;
+            btree_insert(&btree[j], &key, &v);
+            btree_fast_str_kv_free_key(&key);
+            btreeblk_end(&bhandle);
+        }
+        for (i=0;i<n;i+=5) {
+            _prefix_test_key(keybuf, i);
+            btree_fast_str_kv_set_key(&key, keybuf, strlen(keybuf));
+            btree_remove(&btree[j], &key);
+            btree_fast_str_kv_free_key(&key);
+            btreeblk_end(&bhandle);
+        }
+        nbytes[j] = filemgr_get_pos(file) - pos;
+    }
+    // the prefix-compressed nodes hold more keys
+    TEST_CHK(nbytes[1] < nbytes[0]);
+
+    // nodes in both formats are readable and writable with either kv_ops
+    btree[1].kv_ops = kv_ops[0];
+    for (i=n;i<n+100;++i) {
+        _prefix_test_key(keybuf, i);
+        btree_fast_str_kv_set_key(&key, keybuf, strlen(keybuf));
+        v = i;
+        for (j=0;j<2;++j) {
+            btree_insert(&btree[j], &key, &v);
+            btreeblk_end(&bhandle);
+        }
+        btree_fast_str_kv_free_key(&key);
+    }
+
+    for (i=0;i<n+100;++i) {
+        _prefix_test_key(keybuf, i);
+        btree_fast_str_kv_set_key(&key, keybuf, strlen(keybuf));
+        for (j=0;j<2;++j) {
+            br[j] = btree_find(&btree[j], &key, &v_out[j]);
+            btreeblk_end(&bhandle);
+        }
+        btree_fast_str_kv_free_key(&key);
+        if (i < n && i % 5 == 0) {
+            TEST_CHK(br[0] == BTREE_RESULT_FAIL && br[1] == BTREE_RESULT_FAIL);
+        } else {
+            v = (i < n && i % 3 == 0) ? i + n : i;
+            TEST_CHK(br[0] == BTREE_RESULT_SUCCESS &&
+                     br[1] == BTREE_RESULT_SUCCESS);
+            TEST_CHK(v_out[0] == v && v_out[1] == v);
+        }
+    }
+
+    // both trees have the same keys in the same order
+    count = 0;
+    for (j=0;j<2;++j) {
+        k_out[j] = NULL;
+        btree_iterator_init(&btree[j], &bi[j], NULL);
+    }
+    while (1) {
+        for (j=0;j<2;++j) {
+            br[j] = btree_next(&bi[j], &k_out[j], &v_out[j]);
+        }
+        TEST_CHK(br[0] == br[1]);
+        if (br[0] != BTREE_RESULT_SUCCESS) {
+            break;
+        }
+        for (j=0;j<2;++j) {
+            btree_fast_str_kv_get_key(&k_out[j], strbuf[j], &len[j]);
+            btree_fast_str_kv_free_key(&k_out[j]);
+        }
+        TEST_CHK(len[0] == len[1] && !memcmp(strbuf[0], strbuf[1], len[0]));
+        TEST_CHK(v_out[0] == v_out[1]);
+        count++;
+    }
+    for (j=0;j<2;++j) {
+        btree_iterator_free(&bi[j]);
+    }
+    TEST_CHK(count == n - (n+4)/5 + 100);
+    btreeblk_end(&bhandle);
+
+    btreeblk_free(&bhandle);
+    filemgr_close(file, true, NULL, NULL);
+    filemgr_shutdown();
+    free(kv_ops[0]);
+    free(kv_ops[1]);
+
+    memleak_end();
+
+    TEST_RESULT("prefix compression test");
+}
+
+static char (*_fp_keys)[32];
+static uint64_t _fp_readkey_count;
+size_t _readkey_wrap_fingerprint(void *handle, uint64_t offset, void *buf)
+{
+    keylen_t keylen;
+    offset = _endian_decode(offset);
+    keylen = strlen(_fp_keys[offset]);
+    memcpy(buf, _fp_keys[offset], keylen);
+    _fp_readkey_count++;
+    return keylen;
+}
+
+void key_fingerprint_test()
+{
+    TEST_INIT();
+
+    int blocksize = 4096;
+    struct btreeblk_handle bhandle;
+    struct filemgr *file;
+    struct filemgr_config config;
+    struct hbtrie trie[2];
+    struct hbtrie_iterator it;
+    hbtrie_result hr;
+    uint64_t offset, _offset, old_offset, nreads[2];
+    char keybuf[64];
+    size_t keylen;
+    int i, j, rr, n = 1000, count;
+
+    memleak_start();
+
+    rr = system(SHELL_DEL " hbtrie_testfile");
+    (void)rr;
+
+    // keys [0, n) are indexed, and keys [n, 2n) share the first chunk with
+    // them but differ afterwards
+    _fp_keys = (char (*)[32])malloc(sizeof(*_fp_keys) * 2 * n);
+    for (i=0;i<n;++i) {
+        sprintf(_fp_keys[i], "fp%06d_indexed_key", i);
+        sprintf(_fp_keys[i+n], "fp%06d_missing_key", i);
+    }
+
+    memset(&config, 0, sizeof(config));
+    config.blocksize = blocksize;
+    config.ncacheblock = 0;
+    config.options = FILEMGR_CREATE;
+    config.num_wal_shards = 8;
+    filemgr_open_result result = filemgr_open((char*)"./hbtrie_testfile",
+                                              get_filemgr_ops(), &config, NULL);
+    file = result.file;
+    btreeblk_init(&bhandle, file, blocksize);
+
+    for (j=0;j<2;++j) {
+        hbtrie_init(&trie[j], 8, 8, blocksize, BLK_NOT_FOUND,
+                    (void*)&bhandle, btreeblk_get_ops(), NULL,
+                    _readkey_wrap_fingerprint);
+        hbtrie_set_key_fingerprint(&trie[j], j == 1);
+        for (i=0;i<n;++i) {
+            _offset = _endian_encode((uint64_t)i);
+            hbtrie_insert(&trie[j], _fp_keys[i], strlen(_fp_keys[i]),
+                          &_offset, &old_offset);
+            btreeblk_end(&bhandle);
+        }
+        // old values are returned without fingerprints
+        for (i=0;i<n;i+=7) {
+            _offset = _endian_encode((uint64_t)i);
+            hbtrie_insert(&trie[j], _fp_keys[i], strlen(_fp_keys[i]),
+                          &_offset, &old_offset);
+            btreeblk_end(&bhandle);
+            TEST_CHK(_endian_decode(old_offset) == (uint64_t)i);
+        }
+    }
+
+    for (j=0;j<2;++j) {
+        _fp_readkey_count = 0;
+        for (i=0;i<2*n;++i) {
+            hr = hbtrie_find(&trie[j], _fp_keys[i], strlen(_fp_keys[i]),
+                             &offset);
+            btreeblk_end(&bhandle);
+            if (i < n) {
+                TEST_CHK(hr == HBTRIE_RESULT_SUCCESS);
+                TEST_CHK(_endian_decode(offset) == (uint64_t)i);
+            } else {
+                TEST_CHK(hr == HBTRIE_RESULT_FAIL);
+            }
+        }
+        nreads[j] = _fp_readkey_count;
+    }
+    // without fingerprints, each missing key costs one more key read
+    TEST_CHK(nreads[0] >= (uint64_t)2 * n);
+    TEST_CHK(nreads[1] < (uint64_t)n + n / 10);
+
+    // the iterator returns the offsets without fingerprints
+    count = 0;
+    hbtrie_iterator_init(&trie[1], &it, NULL, 0);
+    while ((hr = hbtrie_next(&it, keybuf, &keylen, &offset)) ==
+           HBTRIE_RESULT_SUCCESS) {
+        offset = _endian_decode(offset);
+        TEST_CHK(offset < (uint64_t)n);
+        TEST_CHK(keylen == strlen(_fp_keys[offset]) &&
+                 !memcmp(keybuf, _fp_keys[offset], keylen));
+        count++;
+    }
+    hbtrie_iterator_free(&it);
+    btreeblk_end(&bhandle);
+    TEST_CHK(count == n);
+
+    // tagged and plain offsets can be mixed in a trie, and are readable
+    // regardless of the flag
+    hbtrie_set_key_fingerprint(&trie[0], true);
+    hbtrie_set_key_fingerprint(&trie[1], false);
+    for (j=0;j<2;++j) {
+        for (i=0;i<n;i+=2) {
+            _offset = _endian_encode((uint64_t)i);
+            hbtrie_insert(&trie[j], _fp_keys[i], strlen(_fp_keys[i]),
+                          &_offset, &old_offset);
+            btreeblk_end(&bhandle);
+            TEST_CHK(_endian_decode(old_offset) == (uint64_t)i);
+        }
+        for (i=0;i<n;i+=3) {
+            hbtrie_remove(&trie[j], _fp_keys[i], strlen(_fp_keys[i]));
+            btreeblk_end(&bhandle);
+        }
+        for (i=0;i<2*n;++i) {
+            hr = hbtrie_find(&trie[j], _fp_keys[i], strlen(_fp_keys[i]),
+                             &offset);
+            btreeblk_end(&bhandle);
+            if (i < n && i % 3) {
+                TEST_CHK(hr == HBTRIE_RESULT_SUCCESS);
+                TEST_CHK(_endian_decode(offset) == (uint64_t)i);
+            } else {
+                TEST_CHK(hr == HBTRIE_RESULT_FAIL);
+            }
+        }
+        hbtrie_free(&trie[j]);
+    }
+
+    btreeblk_free(&bhandle);
+    filemgr_close(file, true, NULL, NULL);
+    filemgr_shutdown();
+    free(_fp_keys);
+
+    memleak_end();
+
+    TEST_RESULT("key fingerprint test");
+}
+
+static char (*_batch_keys)[48];
+size_t _readkey_wrap_batch(void *handle, uint64_t offset, void *buf)
+{
+    keylen_t keylen;
+    offset = _endian_decode(offset);
+    keylen = strlen(_batch_keys[offset]);
+    memcpy(buf, _batch_keys[offset], keylen);
+    return keylen;
+}
+
+void hbtrie_insert_batch_test()
+{
+    TEST_INIT();
+
+    int blocksize = 256;
+    struct btreeblk_handle bhandle;
+    struct filemgr *file;
+    struct filemgr_config config;
+    struct hbtrie trie[2];
+    hbtrie_result hr;
+    uint64_t offset, *offsets, *old_offsets, old_offset;
+    void **keys, **values, **oldvalues;
+    int *keylens;
+    int i, j, k, r, n = 3000, nbatch;
+
+    memleak_start();
+
+    r = system(SHELL_DEL " hbtrie_testfile");
+    (void)r;
+
+    // sorted keys of two full chunks; every 10th key is the previous key
+    // extended by a suffix, so that it needs a new sub-tree
+    _batch_keys = (char (*)[48])malloc(sizeof(*_batch_keys) * n);
+    for (i=0;i<n;++i) {
+        if (i % 10 == 9) {
+            sprintf(_batch_keys[i], "%s_suffix", _batch_keys[i-1]);
+        } else {
+            sprintf(_batch_keys[i], "batch%011d", i);
+        }
+    }
+    keys = (void **)malloc(sizeof(void *) * n);
+    keylens = (int *)malloc(sizeof(int) * n);
+    values = (void **)malloc(sizeof(void *) * n);
+    oldvalues = (void **)malloc(sizeof(void *) * n);
+    offsets = (uint64_t *)malloc(sizeof(uint64_t) * n);
+    old_offsets = (uint64_t *)malloc(sizeof(uint64_t) * n);
+
+    memset(&config, 0, sizeof(config));
+    config.blocksize = blocksize;
+    config.ncacheblock = 0;
+    config.options = FILEMGR_CREATE;
+    config.num_wal_shards = 8;
+    filemgr_open_result result = filemgr_open((char*)"./hbtrie_testfile",
+                                              get_filemgr_ops(), &config, NULL);
+    file = result.file;
+    btreeblk_init(&bhandle, file, blocksize);
+
+    // trie[0] is built by hbtrie_insert() and trie[1] by
+    // hbtrie_insert_batch(), with the fingerprints on
+    for (j=0;j<2;++j) {
+        hbtrie_init(&trie[j], 8, 8, blocksize, BLK_NOT_FOUND,
+                    (void*)&bhandle, btreeblk_get_ops(), NULL,
+                    _readkey_wrap_batch);
+        hbtrie_set_key_fingerprint(&trie[j], j == 1);
+    }
+
+    // 1st round inserts the even keys, and 2nd round inserts the odd keys
+    // and updates the even ones
+    for (k=0;k<2;++k) {
+        nbatch = 0;
+        for (i=0;i<n;++i) {
+            if (k == 0 && i % 2) {
+                continue;
+            }
+            offsets[nbatch] = _endian_encode((uint64_t)i);
+            keys[nbatch] = _batch_keys[i];
+            keylens[nbatch] = strlen(_batch_keys[i]);
+            values[nbatch] = &offsets[nbatch];
+            oldvalues[nbatch] = &old_offsets[nbatch];
+            nbatch++;
+        }
+
+        for (i=0;i<nbatch;++i) {
+            hbtrie_insert(&trie[0], keys[i], keylens[i], values[i],
+                          &old_offset);
+            btreeblk_end(&bhandle);
+            if (k == 0 || i % 2) {
+                TEST_CHK(old_offset == BLK_NOT_FOUND);
+            } else {
+                TEST_CHK(old_offset == offsets[i]);
+            }
+        }
+
+        hr = hbtrie_insert_batch(&trie[1], keys, keylens, values,
+                                 oldvalues, nbatch);
+        btreeblk_end(&bhandle);
+        TEST_CHK(hr == HBTRIE_RESULT_SUCCESS);
+        for (i=0;i<nbatch;++i) {
+            if (k == 0 || i % 2) {
+                TEST_CHK(old_offsets[i] == BLK_NOT_FOUND);
+            } else {
+                TEST_CHK(old_offsets[i] == offsets[i]);
+            }
+        }
+    }
+
+    // both tries hold the same keys
+    for (j=0;j<2;++j) {
+        for (i=0;i<n;++i) {
+            hr = hbtrie_find(&trie[j], _batch_keys[i],
+                             strlen(_batch_keys[i]), &offset);
+            btreeblk_end(&bhandle);
+            TEST_CHK(hr == HBTRIE_RESULT_SUCCESS);
+            TEST_CHK(_endian_decode(offset) == (uint64_t)i);
+        }
+        hr = hbtrie_find(&trie[j], (void*)"batch", 5, &offset);
+        btreeblk_end(&bhandle);
+        TEST_CHK(hr == HBTRIE_RESULT_FAIL);
+        hbtrie_free(&trie[j]);
+    }
+
+    btreeblk_free(&bhandle);
+    filemgr_close(file, true, NULL, NULL);
+    filemgr_shutdown();
+    free(_batch_keys);
+    free(keys);
+    free(keylens);
+    free(values);
+    free(oldvalues);
+    free(offsets);
+    free(old_offsets);
+
+    memleak_end();
+
+    TEST_RESULT("HB+trie insert batch test");
+}
+
 int main(){
 #ifdef _MEMPOOL
     mempool_init();
@@ -1514,6 +1951,9 @@ int main(){
     initial_load_test_nested_common_prefix();
     initial_load_test_tailing_null();
     initial_load_test_incremental_prefix();
+    prefix_compression_test();
+    key_fingerprint_test();
+    hbtrie_insert_batch_test();
 
     return 0;
 }
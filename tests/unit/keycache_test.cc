@@ -0,0 +1,172 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2010 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "keycache.h"
+#include "test.h"
+#include "common.h"
+#include "memleak.h"
+
+void basic_test()
+{
+    TEST_INIT();
+    memleak_start();
+
+    struct keycache kc;
+    char key[32];
+    uint64_t offset;
+    int i, n = 1000;
+
+    keycache_init(&kc, 1024 * 1024);
+
+    for (i=0;i<n;++i) {
+        sprintf(key, "key%d", i);
+        keycache_insert(&kc, key, strlen(key), i);
+    }
+    // update
+    for (i=0;i<n;i+=2) {
+        sprintf(key, "key%d", i);
+        keycache_insert(&kc, key, strlen(key), i + n);
+    }
+
+    for (i=0;i<n;++i) {
+        sprintf(key, "key%d", i);
+        TEST_CHK(keycache_find(&kc, key, strlen(key), &offset));
+        TEST_CHK(offset == (uint64_t)((i % 2) ? i : i + n));
+    }
+    // keys are binary, and a prefix of a key is a different key
+    TEST_CHK(!keycache_find(&kc, (void *)"key1", 3, &offset));
+    TEST_CHK(!keycache_find(&kc, (void *)"key1\0", 5, &offset));
+    TEST_CHK(kc.num_hits == (uint64_t)n && kc.num_misses == 2);
+
+    keycache_clear(&kc);
+    TEST_CHK(kc.size == 0);
+    sprintf(key, "key%d", 0);
+    TEST_CHK(!keycache_find(&kc, key, strlen(key), &offset));
+
+    keycache_free(&kc);
+
+    memleak_end();
+    TEST_RESULT("basic test");
+}
+
+void eviction_test()
+{
+    TEST_INIT();
+    memleak_start();
+
+    struct keycache kc;
+    char key[32];
+    uint64_t offset;
+    size_t budget = 4096;
+    int i, n = 1000, ncached;
+
+    keycache_init(&kc, budget);
+
+    for (i=0;i<n;++i) {
+        sprintf(key, "key%06d", i);
+        keycache_insert(&kc, key, strlen(key), i);
+        TEST_CHK(kc.size <= budget);
+        // keep the first key hot
+        TEST_CHK(keycache_find(&kc, (void *)"key000000", 9, &offset));
+        TEST_CHK(offset == 0);
+    }
+
+    // the most recently used keys are kept
+    ncached = 0;
+    for (i=n-1;i>0;--i) {
+        sprintf(key, "key%06d", i);
+        if (!keycache_find(&kc, key, strlen(key), &offset)) {
+            break;
+        }
+        TEST_CHK(offset == (uint64_t)i);
+        ncached++;
+    }
+    TEST_CHK(ncached > 0);
+    for (;i>0;--i) {
+        sprintf(key, "key%06d", i);
+        TEST_CHK(!keycache_find(&kc, key, strlen(key), &offset));
+    }
+
+    // keys larger than the budget are not cached
+    char *large_key = (char *)calloc(1, budget);
+    keycache_insert(&kc, large_key, budget, 1);
+    TEST_CHK(!keycache_find(&kc, large_key, budget, &offset));
+    free(large_key);
+
+    keycache_free(&kc);
+
+    memleak_end();
+    TEST_RESULT("eviction test");
+}
+
+void validate_test()
+{
+    TEST_INIT();
+    memleak_start();
+
+    struct keycache kc;
+    struct keycache_version version;
+    uint64_t offset;
+
+    keycache_init(&kc, 4096);
+    memset(&version, 0, sizeof(version));
+    version.file = (void *)&kc;
+    version.root_bid = 10;
+    version.header_revnum = 1;
+
+    keycache_validate(&kc, &version);
+    keycache_insert(&kc, (void *)"key", 3, 100);
+
+    // the same version keeps the entries
+    keycache_validate(&kc, &version);
+    TEST_CHK(keycache_find(&kc, (void *)"key", 3, &offset));
+    TEST_CHK(offset == 100);
+
+    // any change of the index drops them
+    version.num_index_updates++;
+    keycache_validate(&kc, &version);
+    TEST_CHK(!keycache_find(&kc, (void *)"key", 3, &offset));
+
+    keycache_insert(&kc, (void *)"key", 3, 200);
+    version.root_bid++;
+    keycache_validate(&kc, &version);
+    TEST_CHK(!keycache_find(&kc, (void *)"key", 3, &offset));
+
+    keycache_insert(&kc, (void *)"key", 3, 300);
+    version.header_revnum++;
+    keycache_validate(&kc, &version);
+    TEST_CHK(!keycache_find(&kc, (void *)"key", 3, &offset));
+    TEST_CHK(kc.size == 0);
+
+    keycache_free(&kc);
+
+    memleak_end();
+    TEST_RESULT("validate test");
+}
+
+int main()
+{
+    basic_test();
+    eviction_test();
+    validate_test();
+
+    return 0;
+}